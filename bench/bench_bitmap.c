@@ -0,0 +1,140 @@
+/**
+ * @file bench_bitmap.c
+ * @brief Microbenchmark: fuel and type bitmap indexes versus the strcmp scan.
+ *
+ * Builds synthetic fleets of 1M and 10M cars (or the sizes given on the command line) with
+ * fuels and vehicle types drawn at random, then times an exact fuel lookup and a fuel AND
+ * type conjunction, each through the bitmaps and through the scan search() used before
+ * them. Both paths must list the same rows. The size of each index is reported next to
+ * the 4 bytes per row a plain row list would take.
+ *
+ * Build from the repository root:
+ *
+ *     gcc -O2 -I. bench/bench_bitmap.c bench/bench_fleet.c car_store.c car_hash.c car_range.c car_trigram.c car_bitmap.c car_aggregate.c car_fuzzy.c car_prefix.c platform.c -o bench_bitmap
+ */
+
+#include "bench_fleet.h"
+#include "car_store.h"
+#include "platform.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** Number of timed runs of each query; the fastest is reported. */
+#define REPEATS 5
+
+/**
+ * @brief Lists the rows matching a fuel and optionally a type with strcmp on every row.
+ * @param set Car set to scan.
+ * @param fuel Fuel to match.
+ * @param type Vehicle type to match, or NULL for any.
+ * @param rows Receives the matching rows; must have room for every row.
+ * @return Number of matching rows.
+ */
+static int scanRows(const struct Cars *set, const char *fuel, const char *type, int *rows) {
+    int found = 0;
+    for (int i = 0; i < set->rows; i++) {
+        if (strcmp(carString(set, set->fuel[i]), fuel) == 0 &&
+            (!type || strcmp(carString(set, set->type[i]), type) == 0)) {
+            rows[found++] = i;
+        }
+    }
+    return found;
+}
+
+/**
+ * @brief Lists the rows matching a fuel and optionally a type through the bitmaps.
+ * @param set Car set to query.
+ * @param fuel Fuel to match.
+ * @param type Vehicle type to match, or NULL for any.
+ * @param rows Receives a malloc'd array of the matching rows.
+ * @return Number of matching rows.
+ */
+static int bitmapRows(const struct Cars *set, const char *fuel, const char *type, int **rows) {
+    const struct RowBitmap *terms[2];
+    terms[0] = findBitmap(&set->fuelBitmaps, fuel, strlen(fuel));
+    terms[1] = type ? findBitmap(&set->typeBitmaps, type, strlen(type)) : NULL;
+    if (!terms[0] || (type && !terms[1])) {
+        *rows = NULL;
+        return 0;
+    }
+    return combineBitmaps(terms, type ? 2 : 1, 1, rows);
+}
+
+/**
+ * @brief Times one query both ways, checks the results agree and prints a result line.
+ * @param set Car set to query.
+ * @param fuel Fuel to match.
+ * @param type Vehicle type to match, or NULL for any.
+ * @param scratch Row buffer for the scan, with room for every row.
+ */
+static void timeQuery(const struct Cars *set, const char *fuel, const char *type, int *scratch) {
+    double scanTime = 1e9, bitmapTime = 1e9;
+    int scanned = 0, listed = 0, *rows = NULL;
+    for (int r = 0; r < REPEATS; r++) {
+        double started = monotonicSeconds();
+        scanned = scanRows(set, fuel, type, scratch);
+        double elapsed = monotonicSeconds() - started;
+        scanTime = elapsed < scanTime ? elapsed : scanTime;
+
+        free(rows);
+        started = monotonicSeconds();
+        listed = bitmapRows(set, fuel, type, &rows);
+        elapsed = monotonicSeconds() - started;
+        bitmapTime = elapsed < bitmapTime ? elapsed : bitmapTime;
+    }
+
+    if (scanned != listed || (listed > 0 && memcmp(scratch, rows, (size_t)listed * sizeof *rows) != 0)) {
+        fprintf(stderr, "Result mismatch for %s %s: scan %d rows, bitmaps %d.\n", fuel, type ? type : "", scanned, listed);
+        exit(EXIT_FAILURE);
+    }
+    free(rows);
+
+    char label[64];
+    snprintf(label, sizeof label, "%s%s%s", fuel, type ? " and " : "", type ? type : "");
+    printf("    %-24s %9d rows: scan %9.3f ms, bitmaps %8.3f ms, speedup %.0fx\n", label, listed, scanTime * 1e3,
+           bitmapTime * 1e3, scanTime / bitmapTime);
+}
+
+/**
+ * @brief Runs the benchmark for one fleet size.
+ * @param records Number of cars in the fleet.
+ */
+static void runBenchmark(long records) {
+    struct Cars *set = buildFleet(records);
+
+    printf("%10ld records: fuel index %.2f MB, type index %.2f MB, row lists %.2f MB each\n", records,
+           bitmapIndexBytes(&set->fuelBitmaps) / 1e6, bitmapIndexBytes(&set->typeBitmaps) / 1e6,
+           records * sizeof(int) / 1e6);
+
+    int *scratch = (int *)malloc((size_t)records * sizeof *scratch);
+    if (!scratch) {
+        fprintf(stderr, "Memory allocation error.\n");
+        exit(EXIT_FAILURE);
+    }
+    timeQuery(set, "Diesel", NULL, scratch);
+    timeQuery(set, FLEET_RARE_FUEL, NULL, scratch);
+    timeQuery(set, "Diesel", "SUV", scratch);
+    timeQuery(set, FLEET_RARE_FUEL, "Coupe", scratch);
+    free(scratch);
+    destroyCarSet(set);
+}
+
+/**
+ * @brief Entry point: benchmarks each fleet size given on the command line (default 1M and 10M).
+ * @param argc Argument count.
+ * @param argv Fleet sizes.
+ * @return 0 on success.
+ */
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        runBenchmark(1000000);
+        runBenchmark(10000000);
+        return 0;
+    }
+
+    for (int i = 1; i < argc; i++) {
+        runBenchmark(atol(argv[i]));
+    }
+    return 0;
+}
@@ -0,0 +1,384 @@
+/**
+ * @file bench_database.c
+ * @brief Benchmark harness for the database operations behind the menu.
+ *
+ * Usage:
+ *
+ *     bench_database [--label NAME] [--repeats N] [--work DIR] FLEET...
+ *
+ * Each FLEET is a base.txt-format file, such as one written by tools/car_generate. It is
+ * copied into the work directory (default "bench-work") as base.txt, and the harness then
+ * times, through the same functions the menu calls:
+ *
+ * - readCars() parsing the text file, compactDatabase() rewriting it, and readCars()
+ *   mapping the resulting snapshot;
+ * - addCar() and removeCar() for BENCH_MUTATIONS cars, each followed by saveCars();
+ * - search() for every criterion, once with whole values and once with a part or a range,
+ *   first with the search cache cleared before every run and then answered from the cache
+ *   (reported with a ".cached" suffix);
+ * - refreshPlateTree() building the BK-tree on the registration numbers, and approximate
+ *   plate searches with one and two misread characters.
+ *
+ * The interactive functions read their answers from a scripted standard input, and their
+ * output goes to /dev/null. Every measurement is one JSON object per line on standard
+ * output, tagged with the label (for example a commit hash) so runs from different commits
+ * can be compared:
+ *
+ *     {"label":"3859ac9","records":1000000,"operation":"search.year.range","operations":1,
+ *      "repeats":3,"min_seconds":0.081234,"median_seconds":0.083012,"ops_per_second":12310.1}
+ *
+ * `make bench` generates fleets of 10K, 1M and 10M cars and runs the harness on them.
+ *
+ * Build from the repository root:
+ *
+ *     gcc -O2 -I. bench/bench_database.c car_database.c car_store.c car_hash.c car_range.c car_trigram.c car_bitmap.c car_aggregate.c car_fuzzy.c car_prefix.c car_scan.c car_parallel.c car_io.c car_journal.c car_paged.c car_partition.c car_import.c car_output.c car_stats.c car_query.c car_cache.c car_order.c car_server.c platform.c -o bench_database -lpthread
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "car_database.h"
+#include "platform.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/** Default number of timed runs per operation; the minimum and median are reported. */
+#define DEFAULT_REPEATS 3
+
+/** Cars added, and then removed, in each timed run of addCar() and removeCar(). */
+#define BENCH_MUTATIONS 1000
+
+/** Largest number of timed runs per operation. */
+#define MAX_REPEATS 100
+
+/** File holding the scripted answers of the interactive functions. */
+#define INPUT_FILE "bench-input.txt"
+
+/**
+ * @struct SearchCase
+ * @brief One scripted search.
+ */
+struct SearchCase {
+    const char *operation;  ///< Name reported in the results.
+    char criterion;         ///< Search menu choice, '1' to '7'.
+    const char *answers;    ///< Answers to the prompts of search(); NULL for the plate lookups.
+    int misread;            ///< Characters of the plate changed for a fuzzy plate lookup (answers NULL).
+};
+
+/** Searches timed on every fleet; the values match fleets written by tools/car_generate. */
+static const struct SearchCase searches[] = {
+    {"search.brand.exact", '1', "1\nToyota\n", 0},
+    {"search.brand.partial", '1', "2\nyot\n", 0},
+    {"search.model.exact", '2', "1\nCorolla\n", 0},
+    {"search.model.partial", '2', "2\noro\n", 0},
+    {"search.year.exact", '3', "1\n2015\n", 0},
+    {"search.year.range", '3', "2\n2010\n2014\n", 0},
+    {"search.capacity.exact", '4', "1\n1600\n", 0},
+    {"search.capacity.range", '4', "2\n1400\n1800\n", 0},
+    {"search.fuel.exact", '5', "1\nDiesel\n", 0},
+    {"search.fuel.partial", '5', "2\nybr\n", 0},
+    {"search.type.exact", '6', "1\nSUV\n", 0},
+    {"search.type.partial", '6', "2\nWag\n", 0},
+    {"search.registration.exact", '7', NULL, 0},
+    {"search.registration.fuzzy1", '7', NULL, 1},
+    {"search.registration.fuzzy2", '7', NULL, 2},
+    {"search.registration.partial", '7', "2\n123\n", 0},
+};
+
+static FILE *results;        ///< Where the measurements go (the original standard output).
+static const char *label;    ///< Label attached to every measurement.
+static int repeats;          ///< Timed runs per operation.
+
+/**
+ * @brief Opens the scripted input file for writing.
+ * @return The file.
+ */
+static FILE *startInput(void) {
+    FILE *input = fopen(INPUT_FILE, "w");
+    if (!input) {
+        fprintf(stderr, "Unable to write %s.\n", INPUT_FILE);
+        exit(EXIT_FAILURE);
+    }
+    return input;
+}
+
+/**
+ * @brief Closes the scripted input file and makes it the standard input.
+ * @param input File returned by startInput().
+ */
+static void useInput(FILE *input) {
+    if (fclose(input) != 0 || !freopen(INPUT_FILE, "r", stdin)) {
+        fprintf(stderr, "Unable to read %s.\n", INPUT_FILE);
+        exit(EXIT_FAILURE);
+    }
+}
+
+/**
+ * @brief Orders timings for qsort().
+ * @param a First timing.
+ * @param b Second timing.
+ * @return Negative, zero or positive as @p a is below, equal to or above @p b.
+ */
+static int compareSeconds(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief Writes one measurement as a JSON line.
+ * @param records Number of cars in the fleet.
+ * @param operation Name of the operation.
+ * @param operations Operations performed in each timed run.
+ * @param seconds Duration of each run; sorted in place.
+ */
+static void report(int records, const char *operation, int operations, double *seconds) {
+    qsort(seconds, (size_t)repeats, sizeof *seconds, compareSeconds);
+    double median = seconds[repeats / 2];
+    fprintf(results,
+            "{\"label\":\"%s\",\"records\":%d,\"operation\":\"%s\",\"operations\":%d,\"repeats\":%d,"
+            "\"min_seconds\":%.6f,\"median_seconds\":%.6f,\"ops_per_second\":%.1f}\n",
+            label, records, operation, operations, repeats, seconds[0], median,
+            median > 0.0 ? operations / median : 0.0);
+    fflush(results);
+    fprintf(stderr, "  %-30s %12.3f ms\n", operation, median * 1e3);
+}
+
+/**
+ * @brief Copies a fleet file into the work directory as base.txt.
+ * @param source Fleet file.
+ * @param target Path of the copy.
+ * @return 0 on success, -1 on an I/O error.
+ */
+static int copyFleet(const char *source, const char *target) {
+    FILE *in = fopen(source, "rb");
+    if (!in) {
+        return -1;
+    }
+    FILE *out = fopen(target, "wb");
+    if (!out) {
+        fclose(in);
+        return -1;
+    }
+
+    static char block[1 << 20];
+    size_t got;
+    while ((got = fread(block, 1, sizeof block, in)) > 0) {
+        if (fwrite(block, 1, got, out) != got) {
+            break;
+        }
+    }
+    int failed = ferror(in) || ferror(out);
+    fclose(in);
+    return (fclose(out) != 0 || failed) ? -1 : 0;
+}
+
+/**
+ * @brief Loads base.txt from the work directory repeatedly and times it.
+ * @param operation Name of the operation.
+ * @param set Receives the car set of the last run.
+ * @param count Receives the number of cars.
+ */
+static void timeRead(const char *operation, struct Cars **set, int *count) {
+    double seconds[MAX_REPEATS];
+    for (int r = 0; r < repeats; r++) {
+        if (*set) {
+            freeCarArray(*set);
+        }
+        *set = NULL;
+        *count = 0;
+        double started = monotonicSeconds();
+        readCars(set, count);
+        seconds[r] = monotonicSeconds() - started;
+    }
+    report(*count, operation, 1, seconds);
+}
+
+/**
+ * @brief Times one fleet.
+ * @param fleet Fleet file.
+ * @param work Work directory; the current directory is changed to it.
+ */
+static void runFleet(const char *fleet, const char *work) {
+    char base[4096];
+    snprintf(base, sizeof base, "%s/base.txt", work);
+    if (copyFleet(fleet, base) != 0 || chdir(work) != 0) {
+        fprintf(stderr, "Unable to copy %s into %s.\n", fleet, work);
+        exit(EXIT_FAILURE);
+    }
+    remove("base.bin");
+    remove("base.journal");
+    fprintf(stderr, "%s:\n", fleet);
+
+    struct Cars *set = NULL;
+    int count = 0;
+    double seconds[MAX_REPEATS];
+
+    timeRead("readCars.text", &set, &count);
+
+    for (int r = 0; r < repeats; r++) {
+        double started = monotonicSeconds();
+        compactDatabase(set, count);
+        seconds[r] = monotonicSeconds() - started;
+    }
+    report(count, "compactDatabase", 1, seconds);
+
+    timeRead("readCars.snapshot", &set, &count);
+    int records = count;
+
+    double saves[MAX_REPEATS];
+    for (int r = 0; r < repeats; r++) {
+        FILE *input = startInput();
+        for (int i = 0; i < BENCH_MUTATIONS; i++) {
+            fprintf(input, "Bench\nModel%d\n2020\n1600\nPetrol\nSedan\nBENCH%d-%07d\n", i % 10, r, i);
+        }
+        useInput(input);
+
+        double started = monotonicSeconds();
+        for (int i = 0; i < BENCH_MUTATIONS; i++) {
+            addCar(&set, &count);
+        }
+        double added = monotonicSeconds();
+        saveCars(set, count);
+        seconds[r] = added - started;
+        saves[r] = monotonicSeconds() - added;
+    }
+    report(records, "addCar", BENCH_MUTATIONS, seconds);
+    report(records, "saveCars.afterAdd", 1, saves);
+
+    for (int r = 0; r < repeats; r++) {
+        // Spread the removed cars over the fleet; every run takes a different set of rows.
+        int step = set->rows / BENCH_MUTATIONS;
+        FILE *input = startInput();
+        for (int i = 0; i < BENCH_MUTATIONS; i++) {
+            int row = step > repeats ? i * step + r : i;
+            while (isDeadRow(set, row)) {
+                row++;
+            }
+            fprintf(input, "%d\n", carId(set, row));
+        }
+        useInput(input);
+
+        double started = monotonicSeconds();
+        for (int i = 0; i < BENCH_MUTATIONS; i++) {
+            removeCar(&set, &count);
+        }
+        double removed = monotonicSeconds();
+        saveCars(set, count);
+        seconds[r] = removed - started;
+        saves[r] = monotonicSeconds() - removed;
+    }
+    report(records, "removeCar", BENCH_MUTATIONS, seconds);
+    report(records, "saveCars.afterRemove", 1, saves);
+
+    for (int r = 0; r < repeats; r++) {
+        freePlateTree(&set->plates);
+        double started = monotonicSeconds();
+        refreshPlateTree(set);
+        seconds[r] = monotonicSeconds() - started;
+    }
+    report(records, "refreshPlateTree", 1, seconds);
+
+    for (size_t s = 0; s < sizeof searches / sizeof searches[0]; s++) {
+        for (int cached = 0; cached < 2; cached++) {
+            for (int r = 0; r < repeats; r++) {
+                FILE *input = startInput();
+                if (searches[s].answers) {
+                    fputs(searches[s].answers, input);
+                } else {
+                    int row = nextLiveRow(set, set->rows / 2);
+                    char plate[100];
+                    snprintf(plate, sizeof plate, "%s", carString(set, set->registration[row < set->rows ? row : 0]));
+                    for (int i = 0; i < searches[s].misread && plate[i]; i++) {
+                        plate[i] = plate[i] == 'O' ? '0' : 'O';
+                    }
+                    if (searches[s].misread == 0) {
+                        fprintf(input, "1\n%s\n", plate);
+                    } else {
+                        fprintf(input, "3\n%s\n%d\n", plate, searches[s].misread);
+                    }
+                }
+                useInput(input);
+                if (!cached) {
+                    clearSearchCache();
+                }
+
+                double started = monotonicSeconds();
+                search(set, count, searches[s].criterion);
+                seconds[r] = monotonicSeconds() - started;
+            }
+            char operation[64];
+            snprintf(operation, sizeof operation, "%s%s", searches[s].operation, cached ? ".cached" : "");
+            report(records, operation, 1, seconds);
+        }
+    }
+
+    freeCarArray(set);
+    remove("base.txt");
+    remove("base.bin");
+    remove("base.journal");
+    remove(INPUT_FILE);
+    if (chdir("..") != 0) {
+        fprintf(stderr, "Unable to leave %s.\n", work);
+        exit(EXIT_FAILURE);
+    }
+}
+
+/**
+ * @brief Prints the command-line usage.
+ * @param program Name the harness was started with.
+ */
+static void printUsage(const char *program) {
+    fprintf(stderr, "Usage: %s [--label NAME] [--repeats N] [--work DIR] FLEET...\n", program);
+}
+
+/**
+ * @brief Entry point.
+ * @param argc Argument count.
+ * @param argv Options and fleet files.
+ * @return 0 on success, 1 on a usage error.
+ */
+int main(int argc, char **argv) {
+    const char *work = "bench-work";
+    label = "unlabeled";
+    repeats = DEFAULT_REPEATS;
+
+    int first = 1;
+    while (first + 1 < argc && strncmp(argv[first], "--", 2) == 0) {
+        if (strcmp(argv[first], "--label") == 0) {
+            label = argv[first + 1];
+        } else if (strcmp(argv[first], "--repeats") == 0) {
+            repeats = atoi(argv[first + 1]);
+        } else if (strcmp(argv[first], "--work") == 0) {
+            work = argv[first + 1];
+        } else {
+            break;
+        }
+        first += 2;
+    }
+    if (first >= argc || repeats < 1 || repeats > MAX_REPEATS || strchr(work, '/')) {
+        printUsage(argv[0]);
+        return 1;
+    }
+    if (mkdir(work, 0755) != 0 && errno != EEXIST) {
+        fprintf(stderr, "Unable to create %s.\n", work);
+        return 1;
+    }
+
+    // Measurements keep the real standard output; the program's own messages are discarded.
+    int resultsFd = dup(STDOUT_FILENO);
+    results = resultsFd >= 0 ? fdopen(resultsFd, "w") : NULL;
+    if (!results || !freopen("/dev/null", "w", stdout)) {
+        fprintf(stderr, "Unable to redirect the standard output.\n");
+        return 1;
+    }
+
+    for (int i = first; i < argc; i++) {
+        runFleet(argv[i], work);
+    }
+    rmdir(work);
+    fclose(results);
+    return 0;
+}
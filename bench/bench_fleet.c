@@ -0,0 +1,58 @@
+/**
+ * @file bench_fleet.c
+ * @brief Implementation of the synthetic benchmark fleet.
+ */
+
+#include "bench_fleet.h"
+#include <stdio.h>
+
+const char *const fleetModels[FLEET_MODELS] = {"Octavia", "Fabia", "Corolla", "Yaris",
+                                               "Golf",    "Passat", "Focus",  "Mondeo"};
+
+const char *const fleetFuels[FLEET_FUELS] = {"Petrol", "Diesel", "LPG", "Electric", "Hybrid"};
+
+const char *const fleetTypes[FLEET_TYPES] = {"Sedan", "Hatchback", "SUV", "Coupe", "StationWagon"};
+
+/**
+ * @brief Formats the registration number of synthetic car @p i.
+ *
+ * The two leading letters follow the car number, so consecutive cars do not come in
+ * registration order, and every number up to ten million gets its own plate.
+ *
+ * @param buffer Destination buffer of at least 24 bytes.
+ * @param i Car number.
+ */
+void fleetPlate(char *buffer, long i) {
+    snprintf(buffer, 24, "%c%c%07ld", 'A' + (int)(i % 26), 'A' + (int)(i / 26 % 26), i);
+}
+
+/**
+ * @brief Builds a synthetic fleet.
+ *
+ * Years are uniform over 1990-2024, capacities over 900-3800 cm3 in steps of 100, and
+ * models, fuels and types over their lists, except that one car in a thousand runs on
+ * FLEET_RARE_FUEL.
+ *
+ * @param records Number of cars.
+ * @return The fleet, indexes synchronized; release it with destroyCarSet().
+ */
+struct Cars *buildFleet(long records) {
+    struct Cars *set = createCarSet();
+    struct CarRecord car = {"Skoda", NULL, 0, 0, NULL, NULL, NULL};
+    char plate[24];
+    unsigned long long state = 11;
+
+    for (long i = 0; i < records; i++) {
+        car.model = fleetModels[nextRandom(&state) % FLEET_MODELS];
+        car.year = 1990 + (int)(nextRandom(&state) % 35);
+        car.capacity = 900 + 100 * (int)(nextRandom(&state) % 30);
+        unsigned long long pick = nextRandom(&state) % 5000;
+        car.fuel = pick < 5 ? FLEET_RARE_FUEL : fleetFuels[pick % FLEET_FUELS];
+        car.type = fleetTypes[nextRandom(&state) % FLEET_TYPES];
+        fleetPlate(plate, i);
+        car.registration = plate;
+        appendCar(set, &car);
+    }
+    syncIndexes(set);
+    return set;
+}
@@ -0,0 +1,62 @@
+/**
+ * @file bench_fleet.h
+ * @brief Synthetic fleets and the pseudo-random generator shared by the benchmarks.
+ *
+ * Every benchmark that needs a fleet in memory builds it with buildFleet(), so the timings
+ * of different benchmarks are taken on the same cars. The fleet is the same on every run:
+ * models, years, capacities, fuels and types are drawn from fixed lists with a fixed seed,
+ * and car @c i is registered as fleetPlate(i), so a benchmark can look any car up again.
+ * Larger fleets in the base.txt format come from tools/car_generate.
+ */
+
+#ifndef BENCH_FLEET_H
+#define BENCH_FLEET_H
+
+#include "car_store.h"
+
+/** Number of models in fleetModels. */
+#define FLEET_MODELS 8
+
+/** Number of fuels in fleetFuels. */
+#define FLEET_FUELS 5
+
+/** Number of vehicle types in fleetTypes. */
+#define FLEET_TYPES 5
+
+/** Fuel of one car in a thousand, so its bitmap containers stay sparse. */
+#define FLEET_RARE_FUEL "Hydrogen"
+
+/** Models of the synthetic fleet, all of brand Skoda. */
+extern const char *const fleetModels[FLEET_MODELS];
+
+/** Fuels of every other car of the synthetic fleet. */
+extern const char *const fleetFuels[FLEET_FUELS];
+
+/** Vehicle types of the synthetic fleet. */
+extern const char *const fleetTypes[FLEET_TYPES];
+
+/**
+ * @brief Advances a 64-bit linear congruential generator.
+ * @param state Generator state.
+ * @return Next pseudo-random value.
+ */
+static inline unsigned long long nextRandom(unsigned long long *state) {
+    *state = *state * 6364136223846793005ULL + 1442695040888963407ULL;
+    return *state >> 33;
+}
+
+/**
+ * @brief Formats the registration number of synthetic car @p i.
+ * @param buffer Destination buffer of at least 24 bytes.
+ * @param i Car number.
+ */
+void fleetPlate(char *buffer, long i);
+
+/**
+ * @brief Builds a synthetic fleet.
+ * @param records Number of cars.
+ * @return The fleet, indexes synchronized; release it with destroyCarSet().
+ */
+struct Cars *buildFleet(long records);
+
+#endif
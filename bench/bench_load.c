@@ -0,0 +1,104 @@
+/**
+ * @file bench_load.c
+ * @brief Scaling benchmark: loading a base.txt-format file on 1 to N threads.
+ *
+ * Times readTextCars() on the given file with 1, 2, 4, ... threads up to the processor count
+ * (or the second argument). One thread is the serial scanner; more threads parse the file
+ * in chunks on the worker pool. Every parallel load is checked against the serial one:
+ * same rows, same columns and a byte-identical string heap.
+ *
+ * Build from the repository root:
+ *
+ *     gcc -O2 -I. bench/bench_load.c car_io.c car_parallel.c car_store.c car_hash.c car_range.c car_trigram.c car_bitmap.c car_aggregate.c car_fuzzy.c car_prefix.c platform.c -o bench_load -lpthread
+ */
+
+#include "car_io.h"
+#include "car_parallel.h"
+#include "car_store.h"
+#include "platform.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** Number of timed loads per thread count; the fastest is reported. */
+#define REPEATS 3
+
+/**
+ * @brief Loads the file once.
+ * @param path File to load.
+ * @param seconds Receives the load time.
+ * @return The loaded set.
+ */
+static struct Cars *loadFile(const char *path, double *seconds) {
+    struct Cars *set = createCarSet();
+    double started = monotonicSeconds();
+    if (readTextCars(path, set, NULL) != 0) {
+        fprintf(stderr, "Unable to read %s.\n", path);
+        exit(EXIT_FAILURE);
+    }
+    *seconds = monotonicSeconds() - started;
+    return set;
+}
+
+/**
+ * @brief Checks that two loads of the same file produced the same set.
+ * @param a First set.
+ * @param b Second set.
+ * @return Non-zero if rows, columns and heap are identical.
+ */
+static int sameCars(const struct Cars *a, const struct Cars *b) {
+    size_t rows = (size_t)a->rows;
+    return a->rows == b->rows && a->heapUsed == b->heapUsed && memcmp(a->heap, b->heap, a->heapUsed) == 0 &&
+           memcmp(a->brand, b->brand, rows * sizeof *a->brand) == 0 &&
+           memcmp(a->model, b->model, rows * sizeof *a->model) == 0 &&
+           memcmp(a->year, b->year, rows * sizeof *a->year) == 0 &&
+           memcmp(a->capacity, b->capacity, rows * sizeof *a->capacity) == 0 &&
+           memcmp(a->fuel, b->fuel, rows * sizeof *a->fuel) == 0 &&
+           memcmp(a->type, b->type, rows * sizeof *a->type) == 0 &&
+           memcmp(a->registration, b->registration, rows * sizeof *a->registration) == 0;
+}
+
+/**
+ * @brief Entry point: FILE [max threads].
+ * @param argc Argument count.
+ * @param argv File to load and largest thread count.
+ * @return 0 on success, 1 on a usage error or a mismatch.
+ */
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s FILE [max threads]\n", argv[0]);
+        return 1;
+    }
+    int maxThreads = argc > 2 ? atoi(argv[2]) : processorCount();
+    if (maxThreads < 1) {
+        maxThreads = 1;
+    }
+
+    double seconds;
+    setScanThreads(1);
+    struct Cars *serial = loadFile(argv[1], &seconds);
+    printf("%s: %d records, %d processors\n", argv[1], serial->rows, processorCount());
+
+    double serialTime = 0.0;
+    for (int threads = 1; threads <= maxThreads; threads *= 2) {
+        setScanThreads(threads);
+        double best = 1e9;
+        for (int r = 0; r < REPEATS; r++) {
+            struct Cars *set = loadFile(argv[1], &seconds);
+            best = seconds < best ? seconds : best;
+            if (!sameCars(serial, set)) {
+                fprintf(stderr, "Load on %d threads differs from the serial load.\n", threads);
+                return 1;
+            }
+            destroyCarSet(set);
+        }
+        if (threads == 1) {
+            serialTime = best;
+        }
+        printf("    %2d threads: %9.3f ms, speedup %.2fx\n", threads, best * 1e3, serialTime / best);
+    }
+
+    stopScanPool();
+    destroyCarSet(serial);
+    return 0;
+}
@@ -0,0 +1,131 @@
+/**
+ * @file bench_order.c
+ * @brief Microbenchmark: top-K ordered listings versus sorting every match.
+ *
+ * Builds synthetic fleets of 1M and 10M cars (or the sizes given on the command line),
+ * then lists the first K cars of a few ordered queries twice: through runOrderedQuery(),
+ * which walks the year or capacity index or keeps a bounded heap, and by running the query
+ * and sorting all of its matches with qsort(). Both must list the same cars.
+ *
+ * Build from the repository root:
+ *
+ *     gcc -O2 -I. bench/bench_order.c bench/bench_fleet.c car_query.c car_order.c car_parallel.c car_scan.c car_store.c car_hash.c car_range.c car_trigram.c car_bitmap.c car_aggregate.c car_fuzzy.c car_prefix.c platform.c -o bench_order -lpthread
+ */
+
+#include "bench_fleet.h"
+#include "car_order.h"
+#include "car_query.h"
+#include "car_store.h"
+#include "platform.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** Number of timed runs of each query; the fastest is reported. */
+#define REPEATS 3
+
+/** Car set and order the qsort() comparator works on. */
+static const struct Cars *sortedSet;
+static const struct CarOrder *sortedOrder;
+
+/**
+ * @brief Adapts compareOrderedRows() to qsort().
+ * @param a First row.
+ * @param b Second row.
+ * @return Negative, zero or positive as for qsort().
+ */
+static int compareSorted(const void *a, const void *b) {
+    return compareOrderedRows(sortedSet, sortedOrder, *(const int *)a, *(const int *)b);
+}
+
+/**
+ * @brief Times one ordered query both ways, checks the results agree and prints a result line.
+ * @param set Car set to query.
+ * @param text Query text, or NULL for every car.
+ * @param orderText Order, as given to --order.
+ * @param keep Number of cars listed.
+ */
+static void timeQuery(const struct Cars *set, const char *text, const char *orderText, long keep) {
+    char error[128];
+    struct CarOrder order;
+    parseOrder(orderText, &order);
+    double sortTime = 1e9, topTime = 1e9;
+    int *sorted = NULL, *top = NULL, matches = 0, listed = 0;
+    long examined = 0;
+
+    for (int r = 0; r < REPEATS; r++) {
+        struct QueryNode *query = text ? parseQuery(text, error, sizeof error) : NULL;
+        free(sorted);
+        double started = monotonicSeconds();
+        if (query) {
+            matches = runQuery(set, query, &sorted, NULL);
+        } else {
+            sorted = (int *)malloc((size_t)set->rows * sizeof *sorted);
+            if (!sorted) {
+                fprintf(stderr, "Memory allocation error.\n");
+                exit(EXIT_FAILURE);
+            }
+            for (matches = 0; matches < set->rows; matches++) {
+                sorted[matches] = matches;
+            }
+        }
+        sortedSet = set;
+        sortedOrder = &order;
+        qsort(sorted, (size_t)matches, sizeof *sorted, compareSorted);
+        double elapsed = monotonicSeconds() - started;
+        sortTime = elapsed < sortTime ? elapsed : sortTime;
+
+        free(top);
+        started = monotonicSeconds();
+        listed = runOrderedQuery(set, query, &order, keep, &top, &examined);
+        elapsed = monotonicSeconds() - started;
+        topTime = elapsed < topTime ? elapsed : topTime;
+        freeQuery(query);
+    }
+
+    int expected = matches < keep ? matches : (int)keep;
+    if (listed != expected || (listed > 0 && memcmp(sorted, top, (size_t)listed * sizeof *top) != 0)) {
+        fprintf(stderr, "Result mismatch for %s by %s: expected %d cars, listed %d.\n", text ? text : "all cars",
+                orderText, expected, listed);
+        exit(EXIT_FAILURE);
+    }
+    free(sorted);
+    free(top);
+
+    printf("    %-26s %-16s K=%-4ld sort %9.3f ms, top-K %8.3f ms (%ld rows examined), speedup %.0fx\n",
+           text ? text : "all cars", orderText, keep, sortTime * 1e3, topTime * 1e3, examined, sortTime / topTime);
+}
+
+/**
+ * @brief Runs the benchmark for one fleet size.
+ * @param records Number of cars in the fleet.
+ */
+static void runBenchmark(long records) {
+    struct Cars *set = buildFleet(records);
+
+    printf("%10ld records:\n", records);
+    timeQuery(set, NULL, "year:desc", 10);
+    timeQuery(set, "fuel = Diesel", "year:desc", 10);
+    timeQuery(set, "fuel = Diesel", "capacity:desc", 100);
+    timeQuery(set, NULL, "registration", 10);
+    timeQuery(set, "year = 2000..2005", "registration", 10);
+    destroyCarSet(set);
+}
+
+/**
+ * @brief Entry point: benchmarks each fleet size given on the command line (default 1M and 10M).
+ * @param argc Argument count.
+ * @param argv Fleet sizes.
+ * @return 0 on success.
+ */
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        runBenchmark(1000000);
+        runBenchmark(10000000);
+    }
+    for (int i = 1; i < argc; i++) {
+        runBenchmark(atol(argv[i]));
+    }
+    stopScanPool();
+    return 0;
+}
@@ -0,0 +1,97 @@
+/**
+ * @file bench_output.c
+ * @brief Listing benchmark: one printf() per field versus the buffered renderer.
+ *
+ * Builds a synthetic fleet of 1M cars (or the size given as the first argument) and lists
+ * it to standard output three times: with the eight printf() calls per car the program
+ * used to make, with the buffered renderer in the same layout, and with the buffered
+ * renderer in the compact layout. Timings go to standard error, so redirect the listing:
+ *
+ *     ./bench_output > /dev/null
+ *     ./bench_output | cat > /dev/null
+ *
+ * Build from the repository root:
+ *
+ *     gcc -O2 -I. bench/bench_output.c bench/bench_fleet.c car_output.c car_store.c car_hash.c car_range.c car_trigram.c car_bitmap.c car_aggregate.c car_fuzzy.c car_prefix.c platform.c -o bench_output
+ */
+
+#include "bench_fleet.h"
+#include "car_output.h"
+#include "car_store.h"
+#include "platform.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+/**
+ * @brief Lists every car with one printf() per field, as printCar() used to.
+ * @param set Car set to list.
+ */
+static void listWithPrintf(const struct Cars *set) {
+    for (int row = 0; row < set->rows; row++) {
+        printf("\nCar number: %d\n", carId(set, row));
+        printf("Brand: %s\n", carString(set, set->brand[row]));
+        printf("Model: %s\n", carString(set, set->model[row]));
+        printf("Year: %d\n", set->year[row]);
+        printf("Engine capacity: %d cm^3\n", set->capacity[row]);
+        printf("Fuel: %s\n", carString(set, set->fuel[row]));
+        printf("Vehicle type: %s\n", carString(set, set->type[row]));
+        printf("Registration number: %s\n", carString(set, set->registration[row]));
+    }
+    fflush(stdout);
+}
+
+/**
+ * @brief Lists every car through the buffered renderer.
+ * @param set Car set to list.
+ */
+static void listBuffered(const struct Cars *set) {
+    struct CarOutput output;
+    beginOutput(&output);
+    for (int row = 0; row < set->rows; row++) {
+        outputCar(&output, set, row);
+    }
+    endOutput(&output);
+}
+
+/**
+ * @brief Times one way of listing the fleet and reports it on standard error.
+ * @param set Car set to list.
+ * @param name Label of the method.
+ * @param list Method to time.
+ * @param baseline Time of the baseline method, or 0 to report no speedup.
+ * @return Elapsed seconds.
+ */
+static double timeListing(const struct Cars *set, const char *name, void (*list)(const struct Cars *),
+                          double baseline) {
+    double started = monotonicSeconds();
+    list(set);
+    double elapsed = monotonicSeconds() - started;
+    fprintf(stderr, "  %-22s %9.2f ms, %10.0f cars/s", name, elapsed * 1e3, set->rows / elapsed);
+    if (baseline > 0.0) {
+        fprintf(stderr, ", speedup %.2fx", baseline / elapsed);
+    }
+    fprintf(stderr, "\n");
+    return elapsed;
+}
+
+/**
+ * @brief Entry point: [records].
+ * @param argc Argument count.
+ * @param argv Fleet size.
+ * @return 0 on success.
+ */
+int main(int argc, char **argv) {
+    long records = argc > 1 ? atol(argv[1]) : 1000000;
+
+    struct Cars *set = buildFleet(records);
+    fprintf(stderr, "%ld records\n", records);
+
+    double baseline = timeListing(set, "printf per field", listWithPrintf, 0.0);
+    timeListing(set, "buffered", listBuffered, baseline);
+    setOutputOptions(0, 0, 1);
+    timeListing(set, "buffered, compact", listBuffered, baseline);
+
+    freeOutputBuffer();
+    destroyCarSet(set);
+    return 0;
+}
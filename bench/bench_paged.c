@@ -0,0 +1,166 @@
+/**
+ * @file bench_paged.c
+ * @brief Benchmark: paged access to a base.txt-format file under memory limits.
+ *
+ * Opens the given file in paged mode with each memory limit in turn (default 8 and 64 MB),
+ * then times point lookups through the page cache, uniformly spread and skewed towards a
+ * few hot pages, and a query streamed over the whole file. The peak resident memory is
+ * reported after each limit, before the file is finally loaded whole to check that the
+ * streamed query found the same cars as the query engine, and to show what that costs.
+ *
+ * Build from the repository root:
+ *
+ *     gcc -O2 -I. bench/bench_paged.c car_paged.c car_io.c car_query.c car_order.c car_stats.c car_parallel.c car_scan.c car_store.c car_hash.c car_range.c car_trigram.c car_bitmap.c car_aggregate.c car_fuzzy.c car_prefix.c platform.c -o bench_paged -lpthread
+ */
+
+#include "bench_fleet.h"
+#include "car_io.h"
+#include "car_paged.h"
+#include "car_parallel.h"
+#include "car_query.h"
+#include "car_stats.h"
+#include "car_store.h"
+#include "platform.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+/** Number of timed point lookups of each kind. */
+#define LOOKUPS 200000
+
+/** Query streamed over the file and checked against the query engine. */
+#define QUERY "fuel = Diesel and year = 2010..2015"
+
+/** Skewed lookups go to the first 1/HOT_FRACTION of the cars nine times out of ten. */
+#define HOT_FRACTION 100
+
+/**
+ * @brief Counts the cars of a stream that match the query.
+ * @param set Car set holding the car.
+ * @param row Row of the car.
+ * @param context Pointer to the query, followed by the count.
+ * @return Always 1.
+ */
+static int countMatch(const struct Cars *set, int row, void *context) {
+    struct {
+        const struct QueryNode *query;
+        long matched;
+    } *search = context;
+    search->matched += matchesQuery(set, search->query, row);
+    return 1;
+}
+
+/**
+ * @brief Times point lookups of random record IDs.
+ * @param paged The paged file.
+ * @param skewed Non-zero to send most lookups to a few hot pages.
+ * @param state Generator state.
+ * @return Mean time per lookup in seconds.
+ */
+static double timeLookups(struct PagedCars *paged, int skewed, unsigned long long *state) {
+    int hot = paged->records / HOT_FRACTION > 0 ? paged->records / HOT_FRACTION : 1;
+    double started = monotonicSeconds();
+    for (long i = 0; i < LOOKUPS; i++) {
+        unsigned long long pick = nextRandom(state);
+        int range = skewed && pick % 10 != 0 ? hot : paged->records;
+        int id = (int)(nextRandom(state) % (unsigned long long)range) + 1;
+        const struct Cars *set;
+        int row;
+        if (findPagedCar(paged, id, &set, &row) != 0) {
+            fprintf(stderr, "Car %d not found.\n", id);
+            exit(EXIT_FAILURE);
+        }
+    }
+    return (monotonicSeconds() - started) / LOOKUPS;
+}
+
+/**
+ * @brief Runs the benchmark for one memory limit and prints a result line.
+ * @param path File to open.
+ * @param megabytes Memory limit in MB.
+ * @param query Query to stream.
+ * @return Number of cars the streamed query matched.
+ */
+static long runBenchmark(const char *path, long megabytes, const struct QueryNode *query) {
+    double started = monotonicSeconds();
+    struct PagedCars *paged = openPagedCars(path, (size_t)megabytes * 1000000);
+    if (!paged) {
+        fprintf(stderr, "Unable to page %s.\n", path);
+        exit(EXIT_FAILURE);
+    }
+    double indexTime = monotonicSeconds() - started;
+    if (paged->records == 0) {
+        fprintf(stderr, "%s holds no cars.\n", path);
+        exit(EXIT_FAILURE);
+    }
+
+    unsigned long long state = 42;
+    double uniformTime = timeLookups(paged, 0, &state);
+    double skewedTime = timeLookups(paged, 1, &state);
+
+    struct {
+        const struct QueryNode *query;
+        long matched;
+    } search = {query, 0};
+    started = monotonicSeconds();
+    streamPagedCars(paged, countMatch, &search);
+    double streamTime = monotonicSeconds() - started;
+
+    printf("%4ld MB limit: index %8.1f ms (%6.1f MB/s, %.0f KB), lookup %7.1f us uniform, %7.1f us skewed, "
+           "stream %8.1f ms (%6.1f MB/s, %ld matches), cache %.1f MB, peak RSS %.1f MB\n",
+           megabytes, indexTime * 1e3, (double)paged->size / indexTime / 1e6, pagedIndexBytes(paged) / 1e3,
+           uniformTime * 1e6, skewedTime * 1e6, streamTime * 1e3, (double)paged->size / streamTime / 1e6,
+           search.matched, paged->cacheBytes / 1e6, peakResidentBytes() / 1e6);
+    closePagedCars(paged);
+    return search.matched;
+}
+
+/**
+ * @brief Entry point: benchmarks paged access to a file under each memory limit given.
+ * @param argc Argument count.
+ * @param argv The file, then memory limits in MB.
+ * @return 0 on success, 1 on a usage error or a mismatch.
+ */
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s FILE [MB ...]\n", argv[0]);
+        return 1;
+    }
+
+    char error[128];
+    struct QueryNode *query = parseQuery(QUERY, error, sizeof error);
+    if (!query) {
+        fprintf(stderr, "Invalid query: %s.\n", error);
+        return 1;
+    }
+
+    long matched = 0;
+    if (argc < 3) {
+        matched = runBenchmark(argv[1], 8, query);
+        matched = runBenchmark(argv[1], 64, query);
+    }
+    for (int i = 2; i < argc; i++) {
+        matched = runBenchmark(argv[1], atol(argv[i]), query);
+    }
+
+    struct Cars *set = createCarSet();
+    double started = monotonicSeconds();
+    if (readTextCars(argv[1], set, NULL) != 0) {
+        fprintf(stderr, "Unable to read %s.\n", argv[1]);
+        return 1;
+    }
+    double loadTime = monotonicSeconds() - started;
+    int *rows;
+    int expected = runQuery(set, query, &rows, NULL);
+    free(rows);
+    printf("  whole file: load %8.1f ms, %d matches, peak RSS %.1f MB\n", loadTime * 1e3, expected,
+           peakResidentBytes() / 1e6);
+
+    freeQuery(query);
+    destroyCarSet(set);
+    stopScanPool();
+    if (matched != expected) {
+        fprintf(stderr, "Mismatch: the stream matched %ld cars, the query engine %d.\n", matched, expected);
+        return 1;
+    }
+    return 0;
+}
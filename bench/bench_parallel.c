@@ -0,0 +1,117 @@
+/**
+ * @file bench_parallel.c
+ * @brief Scaling benchmark: full-fleet substring scans on 1 to N threads.
+ *
+ * Builds a synthetic fleet of 10M cars (or the size given as the first argument) and times
+ * substring scans over model and registration through parallelScan() with 1, 2, 4, ...
+ * threads up to the processor count (or the second argument). Every run is checked against
+ * the single-threaded result, row by row.
+ *
+ * Build from the repository root:
+ *
+ *     gcc -O2 -I. bench/bench_parallel.c bench/bench_fleet.c car_parallel.c car_store.c car_hash.c car_range.c car_trigram.c car_bitmap.c car_aggregate.c car_fuzzy.c car_prefix.c platform.c -o bench_parallel -lpthread
+ */
+
+#include "bench_fleet.h"
+#include "car_parallel.h"
+#include "car_store.h"
+#include "platform.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** Number of timed scans per thread count; the fastest is reported. */
+#define REPEATS 3
+
+/**
+ * @struct Substring
+ * @brief Predicate context: substring search on one column.
+ */
+struct Substring {
+    const struct CarString *column;  ///< Column being searched.
+    const char *pattern;             ///< Pattern to look for.
+};
+
+/**
+ * @brief Tests whether a row's string contains the pattern.
+ * @param set Car set being scanned.
+ * @param row Row to test.
+ * @param context The Substring being evaluated.
+ * @return Non-zero on a match.
+ */
+static int containsPattern(const struct Cars *set, int row, const void *context) {
+    const struct Substring *match = (const struct Substring *)context;
+    return strstr(carString(set, match->column[row]), match->pattern) != NULL;
+}
+
+/**
+ * @brief Times one query at every thread count and prints the scaling table.
+ * @param set Car set to scan.
+ * @param name Label of the query.
+ * @param match Query to run.
+ * @param maxThreads Largest thread count to try.
+ */
+static void runQuery(const struct Cars *set, const char *name, const struct Substring *match, int maxThreads) {
+    int *expected = NULL;
+    int expectedCount = 0;
+    double single = 0.0;
+
+    printf("%s:\n", name);
+    // Doubling thread counts, always ending with maxThreads itself.
+    for (int threads = 1; threads <= maxThreads; threads = (threads < maxThreads && threads * 2 > maxThreads) ? maxThreads : threads * 2) {
+        setScanThreads(threads);
+        double best = 0.0;
+        for (int r = 0; r < REPEATS; r++) {
+            int *rows;
+            double started = monotonicSeconds();
+            int found = parallelScan(set, containsPattern, match, &rows);
+            double elapsed = monotonicSeconds() - started;
+            if (r == 0 || elapsed < best) {
+                best = elapsed;
+            }
+
+            if (!expected) {
+                expected = rows;
+                expectedCount = found;
+                continue;
+            }
+            if (found != expectedCount || (found > 0 && memcmp(rows, expected, (size_t)found * sizeof *rows) != 0)) {
+                fprintf(stderr, "Result mismatch with %d threads.\n", threads);
+                exit(EXIT_FAILURE);
+            }
+            free(rows);
+        }
+
+        if (threads == 1) {
+            single = best;
+        }
+        printf("  %3d threads: %8.2f ms, %9d matches, speedup %.2fx\n", threads, best * 1e3, expectedCount, single / best);
+    }
+    free(expected);
+}
+
+/**
+ * @brief Entry point: [records] [max threads].
+ * @param argc Argument count.
+ * @param argv Fleet size and largest thread count.
+ * @return 0 on success.
+ */
+int main(int argc, char **argv) {
+    long records = argc > 1 ? atol(argv[1]) : 10000000;
+    int maxThreads = argc > 2 ? atoi(argv[2]) : processorCount();
+    if (maxThreads < 1) {
+        maxThreads = 1;
+    }
+
+    struct Cars *set = buildFleet(records);
+    printf("%ld records, %d processors\n", records, processorCount());
+
+    struct Substring model = {set->model, "ss"};
+    struct Substring registration = {set->registration, "77"};
+    runQuery(set, "model contains \"ss\"", &model, maxThreads);
+    runQuery(set, "registration contains \"77\"", &registration, maxThreads);
+
+    stopScanPool();
+    destroyCarSet(set);
+    return 0;
+}
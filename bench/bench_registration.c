@@ -0,0 +1,96 @@
+/**
+ * @file bench_registration.c
+ * @brief Microbenchmark: registration hash index versus the full strcmp scan.
+ *
+ * Builds synthetic fleets of 1M and 10M cars (or the sizes given on the command line)
+ * and times exact registration lookups through findRegistrations() against the linear
+ * scan that search() used before the index existed.
+ *
+ * Build from the repository root:
+ *
+ *     gcc -O2 -I. bench/bench_registration.c bench/bench_fleet.c car_store.c car_hash.c car_range.c car_trigram.c car_bitmap.c car_aggregate.c car_fuzzy.c car_prefix.c platform.c -o bench_registration
+ */
+
+#include "bench_fleet.h"
+#include "car_store.h"
+#include "platform.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** Number of lookups timed through the hash index. */
+#define HASH_LOOKUPS 1000000
+
+/** Number of lookups timed through the full scan. */
+#define SCAN_LOOKUPS 20
+
+/**
+ * @brief Looks a plate up the way search() did before the index: strcmp on every row.
+ * @param set Car set to scan.
+ * @param plate Registration number to find.
+ * @return Number of matching cars.
+ */
+static int scanRegistrations(const struct Cars *set, const char *plate) {
+    int found = 0;
+    for (int i = 0; i < set->rows; i++) {
+        if (strcmp(carString(set, set->registration[i]), plate) == 0) {
+            found++;
+        }
+    }
+    return found;
+}
+
+/**
+ * @brief Runs the benchmark for one fleet size and prints a result line.
+ * @param records Number of cars in the fleet.
+ */
+static void runBenchmark(long records) {
+    char plate[24];
+    double started = monotonicSeconds();
+    struct Cars *set = buildFleet(records);
+    double buildTime = monotonicSeconds() - started;
+
+    unsigned long long state = 42;
+    long hits = 0;
+    started = monotonicSeconds();
+    for (long i = 0; i < HASH_LOOKUPS; i++) {
+        fleetPlate(plate, (long)(nextRandom(&state) % (unsigned long long)records));
+        hits += findRegistrations(set, plate, NULL, 0);
+    }
+    double hashTime = (monotonicSeconds() - started) / HASH_LOOKUPS;
+
+    started = monotonicSeconds();
+    for (long i = 0; i < SCAN_LOOKUPS; i++) {
+        fleetPlate(plate, (long)(nextRandom(&state) % (unsigned long long)records));
+        hits += scanRegistrations(set, plate);
+    }
+    double scanTime = (monotonicSeconds() - started) / SCAN_LOOKUPS;
+
+    if (hits != HASH_LOOKUPS + SCAN_LOOKUPS) {
+        fprintf(stderr, "Lookup mismatch: %ld hits.\n", hits);
+        exit(EXIT_FAILURE);
+    }
+
+    printf("%10ld records: insert+index %7.1f ns/car, hash lookup %8.1f ns, scan %12.1f ns, speedup %.0fx\n",
+           records, buildTime / records * 1e9, hashTime * 1e9, scanTime * 1e9, scanTime / hashTime);
+    destroyCarSet(set);
+}
+
+/**
+ * @brief Entry point: benchmarks each fleet size given on the command line (default 1M and 10M).
+ * @param argc Argument count.
+ * @param argv Fleet sizes.
+ * @return 0 on success.
+ */
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        runBenchmark(1000000);
+        runBenchmark(10000000);
+        return 0;
+    }
+
+    for (int i = 1; i < argc; i++) {
+        runBenchmark(atol(argv[i]));
+    }
+    return 0;
+}
@@ -0,0 +1,133 @@
+/**
+ * @file bench_scan.c
+ * @brief Checks the vectorized scan kernels against the scalar path and measures them.
+ *
+ * For several range widths over a 10M-row column (or the size given on the command line),
+ * every kernel the CPU supports is run, its output compared row by row with the scalar
+ * kernel, and its throughput reported next to the sorted range index.
+ *
+ * Build from the repository root:
+ *
+ *     gcc -O2 -I. bench/bench_scan.c car_scan.c car_range.c platform.c -o bench_scan
+ */
+
+#include "bench_fleet.h"
+#include "car_range.h"
+#include "car_scan.h"
+#include "platform.h"
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** Number of repetitions averaged for each measurement. */
+#define REPEATS 5
+
+/**
+ * @brief Allocates an int array, exiting when memory runs out.
+ * @param count Number of ints.
+ * @return The array.
+ */
+static int *allocateInts(size_t count) {
+    int *array = (int *)malloc(count * sizeof *array);
+    if (!array) {
+        fprintf(stderr, "Memory allocation error.\n");
+        exit(EXIT_FAILURE);
+    }
+    return array;
+}
+
+/**
+ * @brief Checks every kernel on small columns with extreme values and ragged tails.
+ * @return Number of mismatches found.
+ */
+static int checkEdgeCases(void) {
+    int column[37], expected[37 + SCAN_PADDING], actual[37 + SCAN_PADDING];
+    int values[] = {INT_MIN, INT_MIN + 1, -1, 0, 1, 2015, INT_MAX - 1, INT_MAX};
+    int nValues = (int)(sizeof values / sizeof values[0]);
+    int mismatches = 0;
+    unsigned long long state = 7;
+
+    for (int length = 0; length <= 37; length++) {
+        for (int i = 0; i < length; i++) {
+            column[i] = values[nextRandom(&state) % (unsigned long long)nValues];
+        }
+        for (int a = 0; a < nValues; a++) {
+            for (int b = 0; b < nValues; b++) {
+                setScanKernel(SCAN_SCALAR);
+                int n = scanIntRange(column, length, values[a], values[b], expected);
+                for (int k = SCAN_SSE42; k <= (int)detectScanKernel(); k++) {
+                    setScanKernel((enum ScanKernel)k);
+                    int m = scanIntRange(column, length, values[a], values[b], actual);
+                    if (m != n || memcmp(expected, actual, (size_t)n * sizeof *actual) != 0) {
+                        mismatches++;
+                    }
+                }
+            }
+        }
+    }
+    return mismatches;
+}
+
+/**
+ * @brief Entry point.
+ * @param argc Argument count.
+ * @param argv Optional column size.
+ * @return 0 when every kernel agrees with the scalar path, 1 otherwise.
+ */
+int main(int argc, char **argv) {
+    int count = (argc > 1) ? atoi(argv[1]) : 10000000;
+    int *column = allocateInts((size_t)count);
+    int *expected = allocateInts((size_t)count + SCAN_PADDING);
+    int *actual = allocateInts((size_t)count + SCAN_PADDING);
+    unsigned long long state = 42;
+
+    struct RangeIndex index = {0};
+    for (int i = 0; i < count; i++) {
+        column[i] = 1990 + (int)(nextRandom(&state) % 35);
+        appendRangeEntry(&index, column[i], i);
+    }
+    syncRangeIndex(&index);
+
+    int mismatches = checkEdgeCases();
+    printf("Edge cases: %s\n", mismatches ? "MISMATCH" : "ok");
+    printf("Detected kernel: %s, %d rows (%.1f MB)\n",
+           scanKernelName(detectScanKernel()), count, count * sizeof(int) / 1e6);
+
+    int ranges[][2] = {{2015, 2015}, {2000, 2004}, {1995, 2014}, {1990, 2024}};
+    for (size_t r = 0; r < sizeof ranges / sizeof ranges[0]; r++) {
+        int min = ranges[r][0], max = ranges[r][1];
+        setScanKernel(SCAN_SCALAR);
+        int n = scanIntRange(column, count, min, max, expected);
+        printf("[%d, %d] %d matches (%.1f%%):", min, max, n, 100.0 * n / count);
+
+        for (int k = SCAN_SCALAR; k <= (int)detectScanKernel(); k++) {
+            setScanKernel((enum ScanKernel)k);
+            double started = monotonicSeconds();
+            int m = 0;
+            for (int rep = 0; rep < REPEATS; rep++) {
+                m = scanIntRange(column, count, min, max, actual);
+            }
+            double elapsed = (monotonicSeconds() - started) / REPEATS;
+            if (m != n || memcmp(expected, actual, (size_t)n * sizeof *actual) != 0) {
+                mismatches++;
+                printf(" %s MISMATCH", scanKernelName((enum ScanKernel)k));
+            } else {
+                printf(" %s %.2f ms (%.1f GB/s)", scanKernelName((enum ScanKernel)k),
+                       elapsed * 1e3, count * sizeof(int) / elapsed / 1e9);
+            }
+        }
+
+        double started = monotonicSeconds();
+        for (int rep = 0; rep < REPEATS; rep++) {
+            collectRange(&index, min, max, actual);
+        }
+        printf(" | range index %.2f ms\n", (monotonicSeconds() - started) / REPEATS * 1e3);
+    }
+
+    freeRangeIndex(&index);
+    free(column);
+    free(expected);
+    free(actual);
+    return mismatches ? 1 : 0;
+}
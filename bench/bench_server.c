@@ -0,0 +1,335 @@
+/**
+ * @file bench_server.c
+ * @brief Load generator: throughput and latency of the --serve daemon under concurrent clients.
+ *
+ * Runs 1, 2, 4, ... client threads up to --clients, each for --seconds, against a server.
+ * Each client keeps one connection and sends requests back to back: registration lookups,
+ * counts over the fuel bitmaps and the year index, model substring scans over the whole
+ * fleet, and, for --writes percent of the requests, additions of a car alternating with its
+ * removal. Every phase reports the requests per second and the median and 99th percentile
+ * latency of reads and writes; writes keep their latency while scans run, because readers
+ * work on an immutable version and never hold a lock.
+ *
+ * Without --socket the benchmark builds a synthetic fleet of --cars cars and serves it
+ * in-process on a temporary socket; with --socket it loads a running car_database --serve
+ * (whose fleet then changes only by the cars added and removed again).
+ *
+ *     bench_server [--cars N] [--clients N] [--seconds S] [--writes PCT] [--socket PATH]
+ *
+ * Build from the repository root:
+ *
+ *     gcc -O2 -I. bench/bench_server.c bench/bench_fleet.c car_server.c car_query.c car_order.c car_journal.c car_parallel.c car_scan.c car_store.c car_hash.c car_range.c car_trigram.c car_bitmap.c car_aggregate.c car_fuzzy.c car_prefix.c platform.c -o bench_server -lpthread
+ */
+
+#include "bench_fleet.h"
+#include "car_parallel.h"
+#include "car_server.h"
+#include "car_store.h"
+#include "platform.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/**
+ * @struct Latencies
+ * @brief Growing list of request latencies, in seconds.
+ */
+struct Latencies {
+    double *values;  ///< Latencies.
+    long count;      ///< Number of latencies.
+    long allocated;  ///< Number of latencies @c values has room for.
+};
+
+/**
+ * @struct LoadClient
+ * @brief One client thread of a phase and what it measured.
+ */
+struct LoadClient {
+    const char *socketPath;    ///< Server socket.
+    int number;                ///< Client number, used in the registrations it adds.
+    int writePercent;          ///< Share of requests that add or remove a car.
+    double deadline;           ///< Monotonic time at which the client stops.
+    struct Latencies reads;    ///< Latencies of the read requests.
+    struct Latencies writes;   ///< Latencies of the additions and removals.
+    int failed;                ///< Non-zero if a request failed.
+};
+
+/**
+ * @struct ServerThread
+ * @brief In-process server and the fleet it serves.
+ */
+struct ServerThread {
+    struct Cars *set;    ///< Fleet served; replaced by the final set when the server stops.
+    const char *path;    ///< Socket path.
+};
+
+/**
+ * @brief Appends a latency to a list.
+ * @param list The list.
+ * @param seconds Latency to append.
+ */
+static void addLatency(struct Latencies *list, double seconds) {
+    if (list->count == list->allocated) {
+        list->allocated = list->allocated ? list->allocated * 2 : 1024;
+        double *grown = (double *)realloc(list->values, (size_t)list->allocated * sizeof *grown);
+        if (!grown) {
+            fprintf(stderr, "Memory allocation error.\n");
+            exit(EXIT_FAILURE);
+        }
+        list->values = grown;
+    }
+    list->values[list->count++] = seconds;
+}
+
+/**
+ * @brief Orders latencies for qsort().
+ * @param a First latency.
+ * @param b Second latency.
+ * @return Negative, zero or positive as for qsort().
+ */
+static int compareLatencies(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief Sends a request and reads its reply up to the status line.
+ * @param connection Connection to the server.
+ * @param request The request.
+ * @param status Receives the status line.
+ * @param size Size of @p status.
+ * @return 0 for an OK reply, -1 for an error reply or a broken connection.
+ */
+static int exchange(struct ServerConnection *connection, const char *request, char *status, size_t size) {
+    if (sendRequest(connection, request) != 0) {
+        return -1;
+    }
+    while (readLine(connection, status, size) >= 0) {
+        if (isStatusLine(status)) {
+            return strncmp(status, "OK", 2) == 0 ? 0 : -1;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Body of a client thread: sends a mix of requests until the deadline.
+ * @param arg The LoadClient.
+ * @return NULL.
+ */
+static void *runClient(void *arg) {
+    struct LoadClient *client = (struct LoadClient *)arg;
+    struct ServerConnection connection;
+    char request[256], status[SERVER_LINE_BYTES];
+    unsigned long long state = 977 + (unsigned long long)client->number;
+    int added = 0, sequence = 0;
+
+    if (connectServer(&connection, client->socketPath) != 0) {
+        client->failed = 1;
+        return NULL;
+    }
+    while (!client->failed && monotonicSeconds() < client->deadline) {
+        int write = (int)(nextRandom(&state) % 100) < client->writePercent;
+        int kind = (int)(nextRandom(&state) % 10);
+        if (write && added) {
+            snprintf(request, sizeof request, "REMOVE %d", added);
+        } else if (write) {
+            snprintf(request, sizeof request, "ADD Skoda Octavia 2020 1400 Petrol Sedan L%02d%08d", client->number,
+                     sequence++);
+        } else if (kind < 6) {
+            snprintf(request, sizeof request, "QUERY registration = R%09llu", nextRandom(&state) % 1000000000ULL);
+        } else if (kind < 9) {
+            snprintf(request, sizeof request, "COUNT fuel = %s and year = %d..%d", fleetFuels[nextRandom(&state) % FLEET_FUELS],
+                     1990 + (int)(nextRandom(&state) % 30), 1995 + (int)(nextRandom(&state) % 30));
+        } else {
+            snprintf(request, sizeof request, "COUNT model ~ %.3s and capacity > 2500",
+                     fleetModels[nextRandom(&state) % FLEET_MODELS] + 1);
+        }
+
+        double started = monotonicSeconds();
+        if (exchange(&connection, request, status, sizeof status) != 0) {
+            fprintf(stderr, "Request failed: %s -> %s\n", request, status);
+            client->failed = 1;
+            break;
+        }
+        addLatency(write ? &client->writes : &client->reads, monotonicSeconds() - started);
+        if (write) {
+            added = added ? 0 : atoi(status + 3);
+        }
+    }
+
+    // Leave the fleet as it was found.
+    if (added) {
+        snprintf(request, sizeof request, "REMOVE %d", added);
+        exchange(&connection, request, status, sizeof status);
+    }
+    closeServer(&connection);
+    return NULL;
+}
+
+/**
+ * @brief Merges the latencies of every client of a phase and sorts them.
+ * @param clients The clients.
+ * @param count Number of clients.
+ * @param writes Non-zero for the write latencies, zero for the read latencies.
+ * @param merged Receives the sorted list.
+ */
+static void mergeLatencies(const struct LoadClient *clients, int count, int writes, struct Latencies *merged) {
+    memset(merged, 0, sizeof *merged);
+    for (int c = 0; c < count; c++) {
+        const struct Latencies *list = writes ? &clients[c].writes : &clients[c].reads;
+        for (long i = 0; i < list->count; i++) {
+            addLatency(merged, list->values[i]);
+        }
+    }
+    qsort(merged->values, (size_t)merged->count, sizeof *merged->values, compareLatencies);
+}
+
+/**
+ * @brief Returns a percentile of a sorted latency list.
+ * @param list Sorted list.
+ * @param percent Percentile, from 0 to 100.
+ * @return Latency in milliseconds, or 0 for an empty list.
+ */
+static double percentile(const struct Latencies *list, double percent) {
+    if (list->count == 0) {
+        return 0.0;
+    }
+    long index = (long)(percent / 100.0 * (double)(list->count - 1) + 0.5);
+    return list->values[index] * 1e3;
+}
+
+/**
+ * @brief Runs one phase with a number of clients and prints its result line.
+ * @param socketPath Server socket.
+ * @param clients Number of client threads.
+ * @param seconds Length of the phase.
+ * @param writePercent Share of requests that add or remove a car.
+ * @return 0 on success, -1 if a client failed.
+ */
+static int runPhase(const char *socketPath, int clients, double seconds, int writePercent) {
+    struct LoadClient *load = (struct LoadClient *)calloc((size_t)clients, sizeof *load);
+    pthread_t *threads = (pthread_t *)malloc((size_t)clients * sizeof *threads);
+    if (!load || !threads) {
+        fprintf(stderr, "Memory allocation error.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    double started = monotonicSeconds();
+    for (int c = 0; c < clients; c++) {
+        load[c].socketPath = socketPath;
+        load[c].number = c;
+        load[c].writePercent = writePercent;
+        load[c].deadline = started + seconds;
+        pthread_create(&threads[c], NULL, runClient, &load[c]);
+    }
+    int failed = 0;
+    for (int c = 0; c < clients; c++) {
+        pthread_join(threads[c], NULL);
+        failed |= load[c].failed;
+    }
+    double elapsed = monotonicSeconds() - started;
+
+    struct Latencies reads, writes;
+    mergeLatencies(load, clients, 0, &reads);
+    mergeLatencies(load, clients, 1, &writes);
+    printf("    %3d clients: %9.0f requests/s | reads %8ld, p50 %8.3f ms, p99 %8.3f ms | "
+           "writes %6ld, p50 %8.3f ms, p99 %8.3f ms\n",
+           clients, (double)(reads.count + writes.count) / elapsed, reads.count, percentile(&reads, 50),
+           percentile(&reads, 99), writes.count, percentile(&writes, 50), percentile(&writes, 99));
+
+    free(reads.values);
+    free(writes.values);
+    for (int c = 0; c < clients; c++) {
+        free(load[c].reads.values);
+        free(load[c].writes.values);
+    }
+    free(load);
+    free(threads);
+    return failed ? -1 : 0;
+}
+
+/**
+ * @brief Body of the in-process server thread.
+ * @param arg The ServerThread.
+ * @return NULL.
+ */
+static void *runServer(void *arg) {
+    struct ServerThread *server = (struct ServerThread *)arg;
+    if (serveCars(&server->set, server->path, NULL) != 0) {
+        fprintf(stderr, "Unable to serve on %s.\n", server->path);
+        exit(EXIT_FAILURE);
+    }
+    return NULL;
+}
+
+/**
+ * @brief Entry point: [--cars N] [--clients N] [--seconds S] [--writes PCT] [--socket PATH].
+ * @param argc Argument count.
+ * @param argv Options.
+ * @return 0 on success, 1 on a usage error or a failed request.
+ */
+int main(int argc, char **argv) {
+    long records = 1000000;
+    int maxClients = 8, writePercent = 5;
+    double seconds = 3.0;
+    const char *socketPath = NULL;
+    char ownPath[64];
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--cars") == 0 && i + 1 < argc) {
+            records = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--clients") == 0 && i + 1 < argc) {
+            maxClients = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+            seconds = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--writes") == 0 && i + 1 < argc) {
+            writePercent = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--socket") == 0 && i + 1 < argc) {
+            socketPath = argv[++i];
+        } else {
+            fprintf(stderr, "Usage: %s [--cars N] [--clients N] [--seconds S] [--writes PCT] [--socket PATH]\n",
+                    argv[0]);
+            return 1;
+        }
+    }
+
+    struct ServerThread server = {NULL, NULL};
+    pthread_t serverThread;
+    if (!socketPath) {
+        snprintf(ownPath, sizeof ownPath, "/tmp/bench_server-%ld.sock", (long)getpid());
+        socketPath = ownPath;
+        server.set = buildFleet(records);
+        server.path = socketPath;
+        pthread_create(&serverThread, NULL, runServer, &server);
+
+        // Wait for the socket to accept connections.
+        struct ServerConnection probe;
+        while (connectServer(&probe, socketPath) != 0) {
+            usleep(10000);
+        }
+        closeServer(&probe);
+    }
+
+    printf("%s: %d processors, %d%% writes, %.1f s per phase\n", socketPath, processorCount(), writePercent,
+           seconds);
+    int status = 0;
+    for (int clients = 1; clients <= maxClients && status == 0; clients *= 2) {
+        status = runPhase(socketPath, clients, seconds, writePercent);
+    }
+
+    if (server.set) {
+        struct ServerConnection connection;
+        char reply[SERVER_LINE_BYTES];
+        if (connectServer(&connection, socketPath) == 0) {
+            exchange(&connection, "SHUTDOWN", reply, sizeof reply);
+            closeServer(&connection);
+        }
+        pthread_join(serverThread, NULL);
+        destroyCarSet(server.set);
+        stopScanPool();
+    }
+    return status == 0 ? 0 : 1;
+}
@@ -0,0 +1,396 @@
+/**
+ * @file car_aggregate.c
+ * @brief Implementation of the materialized fleet aggregates.
+ */
+
+#include "car_aggregate.h"
+#include "car_hash.h"
+#include "car_store.h"
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** Width of the longest bar of the year histogram, in characters. */
+#define HISTOGRAM_WIDTH 40
+
+/**
+ * @brief Hashes an integer key.
+ * @param value The key.
+ * @return Hash value.
+ */
+static unsigned int hashValue(int value) {
+    return (unsigned int)value * 2654435761u;
+}
+
+/**
+ * @brief Doubles a group table, moving every group to its new slot.
+ * @param table Table to grow.
+ */
+static void growGroups(struct GroupTable *table) {
+    size_t slots = table->slots ? (table->mask + 1) * 2 : 16;
+    struct GroupEntry *grown = (struct GroupEntry *)calloc(slots, sizeof *grown);
+    if (!grown) {
+        fprintf(stderr, "Memory allocation error.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (size_t i = 0; table->slots && i <= table->mask; i++) {
+        if (table->slots[i].used) {
+            size_t slot = table->slots[i].hash & (slots - 1);
+            while (grown[slot].used) {
+                slot = (slot + 1) & (slots - 1);
+            }
+            grown[slot] = table->slots[i];
+        }
+    }
+    free(table->slots);
+    table->slots = grown;
+    table->mask = slots - 1;
+}
+
+/**
+ * @brief Finds the group of a key, creating it if needed.
+ * @param table Table to search.
+ * @param text String key, or NULL for an integer key.
+ * @param length Length of the string key.
+ * @param value Integer key, used when @p text is NULL.
+ * @return The group.
+ */
+static struct GroupEntry *findGroup(struct GroupTable *table, const char *text, size_t length, int value) {
+    if (!table->slots || (table->used + 1) * 2 > table->mask + 1) {
+        growGroups(table);
+    }
+
+    unsigned int hash = text ? hashString(text, length) : hashValue(value);
+    size_t slot = hash & table->mask;
+    while (table->slots[slot].used) {
+        struct GroupEntry *entry = &table->slots[slot];
+        if (entry->hash == hash &&
+            (text ? entry->length == length && memcmp(entry->text, text, length) == 0 : entry->value == value)) {
+            return entry;
+        }
+        slot = (slot + 1) & table->mask;
+    }
+
+    struct GroupEntry *entry = &table->slots[slot];
+    entry->used = 1;
+    entry->hash = hash;
+    entry->value = value;
+    if (text) {
+        entry->text = (char *)malloc(length + 1);
+        if (!entry->text) {
+            fprintf(stderr, "Memory allocation error.\n");
+            exit(EXIT_FAILURE);
+        }
+        memcpy(entry->text, text, length);
+        entry->text[length] = '\0';
+        entry->length = (unsigned int)length;
+    }
+    table->used++;
+    return entry;
+}
+
+/**
+ * @brief Finds the group of a string stored in the set.
+ * @param table Table to search.
+ * @param set Car set owning the string.
+ * @param ref The string.
+ * @return The group.
+ */
+static struct GroupEntry *stringGroup(struct GroupTable *table, const struct Cars *set, struct CarString ref) {
+    return findGroup(table, carString(set, ref), ref.length, 0);
+}
+
+/**
+ * @brief Adds or removes one car from every aggregate.
+ * @param aggregates Aggregates to update.
+ * @param set Car set holding the car.
+ * @param row Row of the car.
+ * @param delta 1 to add the car, -1 to remove it.
+ */
+static void applyCar(struct Aggregates *aggregates, const struct Cars *set, int row, int delta) {
+    int year = set->year[row], capacity = set->capacity[row];
+    aggregates->cars += delta;
+    aggregates->yearSum += (long long)delta * year;
+    aggregates->capacitySum += (long long)delta * capacity;
+
+    stringGroup(&aggregates->brands, set, set->brand[row])->count += delta;
+    struct GroupEntry *fuel = stringGroup(&aggregates->fuels, set, set->fuel[row]);
+    fuel->count += delta;
+    fuel->capacitySum += (long long)delta * capacity;
+    stringGroup(&aggregates->types, set, set->type[row])->count += delta;
+    struct GroupEntry *yearGroup = findGroup(&aggregates->years, NULL, 0, year);
+    struct GroupEntry *capacityGroup = findGroup(&aggregates->capacities, NULL, 0, capacity);
+    yearGroup->count += delta;
+    capacityGroup->count += delta;
+
+    if (delta > 0) {
+        if (aggregates->cars == 1 || year < aggregates->minYear) {
+            aggregates->minYear = year;
+        }
+        if (aggregates->cars == 1 || year > aggregates->maxYear) {
+            aggregates->maxYear = year;
+        }
+        if (aggregates->cars == 1 || capacity < aggregates->minCapacity) {
+            aggregates->minCapacity = capacity;
+        }
+        if (aggregates->cars == 1 || capacity > aggregates->maxCapacity) {
+            aggregates->maxCapacity = capacity;
+        }
+    } else if ((yearGroup->count == 0 && (year == aggregates->minYear || year == aggregates->maxYear)) ||
+               (capacityGroup->count == 0 &&
+                (capacity == aggregates->minCapacity || capacity == aggregates->maxCapacity))) {
+        aggregates->boundsStale = 1;
+    }
+}
+
+/**
+ * @brief Adds a newly appended car to the aggregates, if they have been computed.
+ * @param set Car set holding the car.
+ * @param row Row of the car.
+ */
+void aggregateCar(struct Cars *set, int row) {
+    if (set->aggregates.valid) {
+        applyCar(&set->aggregates, set, row, 1);
+    }
+}
+
+/**
+ * @brief Removes a car from the aggregates, if they have been computed.
+ * @param set Car set holding the car.
+ * @param row Row of the car; must still be live.
+ */
+void unaggregateCar(struct Cars *set, int row) {
+    if (set->aggregates.valid) {
+        applyCar(&set->aggregates, set, row, -1);
+    }
+}
+
+/**
+ * @brief Finds the smallest and largest key of an integer table among non-empty groups.
+ * @param table Table to scan.
+ * @param min Receives the smallest key.
+ * @param max Receives the largest key.
+ */
+static void groupBounds(const struct GroupTable *table, int *min, int *max) {
+    *min = INT_MAX;
+    *max = INT_MIN;
+    for (size_t i = 0; table->slots && i <= table->mask; i++) {
+        const struct GroupEntry *entry = &table->slots[i];
+        if (entry->used && entry->count > 0) {
+            *min = entry->value < *min ? entry->value : *min;
+            *max = entry->value > *max ? entry->value : *max;
+        }
+    }
+}
+
+/**
+ * @brief Computes the aggregates in one pass if they are not materialized yet, and
+ *        refreshes stale bounds.
+ *
+ * The pass walks the live rows in storage order, reading each column sequentially.
+ *
+ * @param set Car set to summarize.
+ * @return The aggregates of the set.
+ */
+const struct Aggregates *refreshAggregates(struct Cars *set) {
+    struct Aggregates *aggregates = &set->aggregates;
+    if (!aggregates->valid) {
+        freeAggregates(aggregates);
+        for (int row = nextLiveRow(set, 0); row < set->rows; row = nextLiveRow(set, row + 1)) {
+            applyCar(aggregates, set, row, 1);
+        }
+        aggregates->valid = 1;
+    }
+    if (aggregates->boundsStale) {
+        groupBounds(&aggregates->years, &aggregates->minYear, &aggregates->maxYear);
+        groupBounds(&aggregates->capacities, &aggregates->minCapacity, &aggregates->maxCapacity);
+        aggregates->boundsStale = 0;
+    }
+    return aggregates;
+}
+
+/**
+ * @brief Adds the groups of one table to another.
+ * @param total Table to add to.
+ * @param part Table whose groups are added; empty groups are left out.
+ */
+static void mergeGroups(struct GroupTable *total, const struct GroupTable *part) {
+    for (size_t i = 0; part->slots && i <= part->mask; i++) {
+        const struct GroupEntry *entry = &part->slots[i];
+        if (entry->used && entry->count > 0) {
+            struct GroupEntry *group = findGroup(total, entry->text, entry->length, entry->value);
+            group->count += entry->count;
+            group->capacitySum += entry->capacitySum;
+        }
+    }
+}
+
+/**
+ * @brief Adds the aggregates of one group of cars to those of a larger one.
+ *
+ * Used to summarize cars held in several sets, such as the partitions of a partitioned
+ * database: each set's aggregates are refreshed and merged into a total, which is then
+ * printed and freed by the caller.
+ *
+ * @param total Aggregates to add to; start from zeroed aggregates.
+ * @param part Refreshed aggregates of a group of cars that are not in @p total yet.
+ */
+void mergeAggregates(struct Aggregates *total, const struct Aggregates *part) {
+    if (part->cars == 0) {
+        return;
+    }
+    if (total->cars == 0) {
+        total->minYear = part->minYear;
+        total->maxYear = part->maxYear;
+        total->minCapacity = part->minCapacity;
+        total->maxCapacity = part->maxCapacity;
+    } else {
+        total->minYear = part->minYear < total->minYear ? part->minYear : total->minYear;
+        total->maxYear = part->maxYear > total->maxYear ? part->maxYear : total->maxYear;
+        total->minCapacity = part->minCapacity < total->minCapacity ? part->minCapacity : total->minCapacity;
+        total->maxCapacity = part->maxCapacity > total->maxCapacity ? part->maxCapacity : total->maxCapacity;
+    }
+    total->cars += part->cars;
+    total->yearSum += part->yearSum;
+    total->capacitySum += part->capacitySum;
+    mergeGroups(&total->brands, &part->brands);
+    mergeGroups(&total->fuels, &part->fuels);
+    mergeGroups(&total->types, &part->types);
+    mergeGroups(&total->years, &part->years);
+    mergeGroups(&total->capacities, &part->capacities);
+    total->valid = 1;
+}
+
+/**
+ * @brief Orders groups by descending count, then by key.
+ * @param a First group.
+ * @param b Second group.
+ * @return Negative, zero or positive as @p a should be printed before, with or after @p b.
+ */
+static int compareByCount(const void *a, const void *b) {
+    const struct GroupEntry *x = *(const struct GroupEntry *const *)a, *y = *(const struct GroupEntry *const *)b;
+    if (x->count != y->count) {
+        return x->count > y->count ? -1 : 1;
+    }
+    return strcmp(x->text, y->text);
+}
+
+/**
+ * @brief Orders integer groups by ascending key.
+ * @param a First group.
+ * @param b Second group.
+ * @return Negative, zero or positive as @p a is below, equal to or above @p b.
+ */
+static int compareByValue(const void *a, const void *b) {
+    const struct GroupEntry *x = *(const struct GroupEntry *const *)a, *y = *(const struct GroupEntry *const *)b;
+    return (x->value > y->value) - (x->value < y->value);
+}
+
+/**
+ * @brief Lists the non-empty groups of a table in print order.
+ * @param table Table to list.
+ * @param compare Order of the list.
+ * @param count Receives the number of groups listed.
+ * @return Newly allocated array of pointers to the groups.
+ */
+static const struct GroupEntry **sortedGroups(const struct GroupTable *table,
+                                              int (*compare)(const void *, const void *), int *count) {
+    const struct GroupEntry **groups =
+        (const struct GroupEntry **)malloc((table->used ? table->used : 1) * sizeof *groups);
+    if (!groups) {
+        fprintf(stderr, "Memory allocation error.\n");
+        exit(EXIT_FAILURE);
+    }
+    *count = 0;
+    for (size_t i = 0; table->slots && i <= table->mask; i++) {
+        if (table->slots[i].used && table->slots[i].count > 0) {
+            groups[(*count)++] = &table->slots[i];
+        }
+    }
+    qsort(groups, (size_t)*count, sizeof *groups, compare);
+    return groups;
+}
+
+/**
+ * @brief Prints the cars per value of a string field, most common first.
+ * @param title Name of the field.
+ * @param table Groups of the field.
+ * @param cars Number of live cars, for the shares.
+ * @param capacities Non-zero to add the average engine capacity of each group.
+ */
+static void printGroups(const char *title, const struct GroupTable *table, long cars, int capacities) {
+    int count;
+    const struct GroupEntry **groups = sortedGroups(table, compareByCount, &count);
+    printf("\n%-20s %10s %8s%s\n", title, "Cars", "Share", capacities ? "  Avg capacity" : "");
+    for (int i = 0; i < count; i++) {
+        printf("%-20s %10ld %7.1f%%", groups[i]->text, groups[i]->count, 100.0 * groups[i]->count / cars);
+        if (capacities) {
+            printf("  %8.0f cm^3", (double)groups[i]->capacitySum / groups[i]->count);
+        }
+        printf("\n");
+    }
+    free(groups);
+}
+
+/**
+ * @brief Prints the fleet breakdown: year and capacity summaries, then the cars per brand,
+ *        per fuel (with the average capacity), per type and per year.
+ * @param aggregates Aggregates to print.
+ */
+void printAggregates(const struct Aggregates *aggregates) {
+    if (aggregates->cars == 0) {
+        printf("No cars in the database.\n");
+        return;
+    }
+
+    long cars = aggregates->cars;
+    printf("Cars: %ld\n", cars);
+    printf("Year: %d to %d, average %.1f\n", aggregates->minYear, aggregates->maxYear,
+           (double)aggregates->yearSum / cars);
+    printf("Engine capacity: %d to %d cm^3, average %.0f cm^3\n", aggregates->minCapacity, aggregates->maxCapacity,
+           (double)aggregates->capacitySum / cars);
+
+    printGroups("Brand", &aggregates->brands, cars, 0);
+    printGroups("Fuel", &aggregates->fuels, cars, 1);
+    printGroups("Type", &aggregates->types, cars, 0);
+
+    int count;
+    const struct GroupEntry **years = sortedGroups(&aggregates->years, compareByValue, &count);
+    long largest = 1;
+    for (int i = 0; i < count; i++) {
+        largest = years[i]->count > largest ? years[i]->count : largest;
+    }
+    printf("\n%-20s %10s\n", "Year", "Cars");
+    for (int i = 0; i < count; i++) {
+        int bar = (int)((years[i]->count * HISTOGRAM_WIDTH + largest - 1) / largest);
+        printf("%-20d %10ld  %.*s\n", years[i]->value, years[i]->count, bar,
+               "########################################");
+    }
+    free(years);
+}
+
+/**
+ * @brief Frees the string keys and the slots of a group table.
+ * @param table Table to free.
+ */
+static void freeGroups(struct GroupTable *table) {
+    for (size_t i = 0; table->slots && i <= table->mask; i++) {
+        free(table->slots[i].text);
+    }
+    free(table->slots);
+}
+
+/**
+ * @brief Frees the group tables and resets the aggregates.
+ * @param aggregates Aggregates to free.
+ */
+void freeAggregates(struct Aggregates *aggregates) {
+    freeGroups(&aggregates->brands);
+    freeGroups(&aggregates->fuels);
+    freeGroups(&aggregates->types);
+    freeGroups(&aggregates->years);
+    freeGroups(&aggregates->capacities);
+    memset(aggregates, 0, sizeof *aggregates);
+}
@@ -0,0 +1,111 @@
+/**
+ * @file car_aggregate.h
+ * @brief Materialized fleet aggregates: group-by counts, year and capacity summaries.
+ *
+ * The aggregates hold the number of cars per brand, fuel, type, year and engine capacity,
+ * the capacity total per fuel, and the sums, minima and maxima of year and capacity. They
+ * are computed in one pass over the columns the first time they are asked for, and from
+ * then on appendCarRow() and eraseCars() update them in O(1) per car, so asking again
+ * costs only the printing.
+ *
+ * Removing the last car with the smallest or largest year or capacity only marks the
+ * bounds stale; they are recomputed from the per-value counts, not the rows, when read.
+ */
+
+#ifndef CAR_AGGREGATE_H
+#define CAR_AGGREGATE_H
+
+#include <stddef.h>
+
+struct Cars;
+
+/**
+ * @struct GroupEntry
+ * @brief One group: a string or integer key with its counters.
+ */
+struct GroupEntry {
+    char *text;              ///< String key (owned), or NULL for an integer key or a free slot.
+    unsigned int length;     ///< Length of @c text.
+    unsigned int hash;       ///< Hash of the key.
+    int value;               ///< Integer key.
+    int used;                ///< Non-zero if the slot holds a group.
+    long count;              ///< Live cars in the group.
+    long long capacitySum;   ///< Sum of their engine capacities.
+};
+
+/**
+ * @struct GroupTable
+ * @brief Open-addressing table of groups keyed by a string or an integer.
+ *
+ * Groups whose count drops to zero stay in the table and are skipped when printed.
+ */
+struct GroupTable {
+    struct GroupEntry *slots;  ///< Slot array (NULL until the first group).
+    size_t mask;               ///< Number of slots minus one; a power of two.
+    size_t used;               ///< Number of groups.
+};
+
+/**
+ * @struct Aggregates
+ * @brief Materialized aggregates of the live cars of a set.
+ */
+struct Aggregates {
+    int valid;                     ///< Non-zero once computed; maintained incrementally from then on.
+    long cars;                     ///< Live cars.
+    long long yearSum;             ///< Sum of the years.
+    long long capacitySum;         ///< Sum of the engine capacities.
+    int minYear;                   ///< Smallest year.
+    int maxYear;                   ///< Largest year.
+    int minCapacity;               ///< Smallest engine capacity.
+    int maxCapacity;               ///< Largest engine capacity.
+    int boundsStale;               ///< Non-zero if a removal may have invalidated the minima or maxima.
+    struct GroupTable brands;      ///< Cars per brand.
+    struct GroupTable fuels;       ///< Cars and capacity total per fuel.
+    struct GroupTable types;       ///< Cars per vehicle type.
+    struct GroupTable years;       ///< Cars per year.
+    struct GroupTable capacities;  ///< Cars per engine capacity.
+};
+
+/**
+ * @brief Adds a newly appended car to the aggregates, if they have been computed.
+ * @param set Car set holding the car.
+ * @param row Row of the car.
+ */
+void aggregateCar(struct Cars *set, int row);
+
+/**
+ * @brief Removes a car from the aggregates, if they have been computed.
+ * @param set Car set holding the car.
+ * @param row Row of the car; must still be live.
+ */
+void unaggregateCar(struct Cars *set, int row);
+
+/**
+ * @brief Computes the aggregates in one pass if they are not materialized yet, and
+ *        refreshes stale bounds.
+ * @param set Car set to summarize.
+ * @return The aggregates of the set.
+ */
+const struct Aggregates *refreshAggregates(struct Cars *set);
+
+/**
+ * @brief Adds the aggregates of one group of cars to those of a larger one.
+ * @param total Aggregates to add to; start from zeroed aggregates.
+ * @param part Refreshed aggregates of a group of cars that are not in @p total yet.
+ */
+void mergeAggregates(struct Aggregates *total, const struct Aggregates *part);
+
+/**
+ * @brief Prints the fleet breakdown: year and capacity summaries, then the cars per brand,
+ *        per fuel (with the average capacity), per type and per year.
+ * @param aggregates Aggregates to print.
+ */
+void printAggregates(const struct Aggregates *aggregates);
+
+/**
+ * @brief Frees the group tables and resets the aggregates.
+ * @param aggregates Aggregates to free.
+ */
+void freeAggregates(struct Aggregates *aggregates);
+
+#endif // CAR_AGGREGATE_H
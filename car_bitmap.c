@@ -0,0 +1,611 @@
+/**
+ * @file car_bitmap.c
+ * @brief Implementation of the compressed bitmap indexes.
+ */
+
+#include "car_bitmap.h"
+#include "car_store.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** Number of 64-bit words in a dense container. */
+#define CHUNK_WORDS (BITMAP_CHUNK_ROWS / 64)
+
+/**
+ * @brief Reallocates a buffer, exiting the program when memory runs out.
+ * @param buffer Buffer to resize (may be NULL).
+ * @param size New size in bytes.
+ * @return The resized buffer.
+ */
+static void *resizeBuffer(void *buffer, size_t size) {
+    void *tmp = realloc(buffer, size);
+    if (!tmp) {
+        fprintf(stderr, "Memory allocation error.\n");
+        exit(EXIT_FAILURE);
+    }
+    return tmp;
+}
+
+/**
+ * @brief Finds the position of a row offset in a sorted array container.
+ * @param container Array container.
+ * @param offset Row offset inside the chunk.
+ * @return Position of the first entry not below @p offset.
+ */
+static int findOffset(const struct BitmapContainer *container, uint16_t offset) {
+    int low = 0, high = container->count;
+    while (low < high) {
+        int mid = low + (high - low) / 2;
+        if (container->array[mid] < offset) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+/**
+ * @brief Turns a full array container into a bit array.
+ * @param container Container to convert.
+ */
+static void makeDense(struct BitmapContainer *container) {
+    uint64_t *words = (uint64_t *)calloc(CHUNK_WORDS, sizeof *words);
+    if (!words) {
+        fprintf(stderr, "Memory allocation error.\n");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < container->count; i++) {
+        words[container->array[i] >> 6] |= (uint64_t)1 << (container->array[i] & 63);
+    }
+    free(container->array);
+    container->array = NULL;
+    container->allocated = 0;
+    container->words = words;
+}
+
+/**
+ * @brief Turns a bit array that has become sparse back into an array container.
+ * @param container Container to convert.
+ */
+static void makeSparse(struct BitmapContainer *container) {
+    container->allocated = container->count ? container->count : 1;
+    container->array = (uint16_t *)resizeBuffer(NULL, (size_t)container->allocated * sizeof *container->array);
+    int n = 0;
+    for (int w = 0; w < CHUNK_WORDS; w++) {
+        for (uint64_t bits = container->words[w]; bits; bits &= bits - 1) {
+            container->array[n++] = (uint16_t)(w * 64 + __builtin_ctzll(bits));
+        }
+    }
+    free(container->words);
+    container->words = NULL;
+}
+
+/**
+ * @brief Adds a row to a bitmap.
+ *
+ * Rows normally arrive in ascending order and land at the end of the last array container,
+ * so building a bitmap costs amortized O(1) per row.
+ *
+ * @param bitmap Bitmap to update.
+ * @param row Row to add; must not be in the bitmap yet.
+ */
+static void addBitmapRow(struct RowBitmap *bitmap, int row) {
+    int chunk = row / BITMAP_CHUNK_ROWS;
+    uint16_t offset = (uint16_t)(row % BITMAP_CHUNK_ROWS);
+    if (chunk >= bitmap->chunks) {
+        bitmap->containers = (struct BitmapContainer *)resizeBuffer(
+            bitmap->containers, (size_t)(chunk + 1) * sizeof *bitmap->containers);
+        memset(bitmap->containers + bitmap->chunks, 0, (size_t)(chunk + 1 - bitmap->chunks) * sizeof *bitmap->containers);
+        bitmap->chunks = chunk + 1;
+    }
+
+    struct BitmapContainer *container = &bitmap->containers[chunk];
+    if (container->words) {
+        container->words[offset >> 6] |= (uint64_t)1 << (offset & 63);
+    } else {
+        if (container->count == container->allocated) {
+            container->allocated = container->allocated ? container->allocated * 2 : 4;
+            container->array = (uint16_t *)resizeBuffer(container->array,
+                                                        (size_t)container->allocated * sizeof *container->array);
+        }
+        int at = (container->count == 0 || container->array[container->count - 1] < offset)
+                     ? container->count
+                     : findOffset(container, offset);
+        memmove(container->array + at + 1, container->array + at,
+                (size_t)(container->count - at) * sizeof *container->array);
+        container->array[at] = offset;
+    }
+    container->count++;
+    bitmap->count++;
+    if (!container->words && container->count > BITMAP_ARRAY_LIMIT) {
+        makeDense(container);
+    }
+}
+
+/**
+ * @brief Removes a row from a bitmap, if it is there.
+ * @param bitmap Bitmap to update.
+ * @param row Row to remove.
+ */
+static void removeBitmapRow(struct RowBitmap *bitmap, int row) {
+    int chunk = row / BITMAP_CHUNK_ROWS;
+    uint16_t offset = (uint16_t)(row % BITMAP_CHUNK_ROWS);
+    if (chunk >= bitmap->chunks) {
+        return;
+    }
+
+    struct BitmapContainer *container = &bitmap->containers[chunk];
+    if (container->words) {
+        uint64_t bit = (uint64_t)1 << (offset & 63);
+        if (!(container->words[offset >> 6] & bit)) {
+            return;
+        }
+        container->words[offset >> 6] &= ~bit;
+        // Converting back only well below the limit keeps a container near it from flapping.
+        if (--container->count < BITMAP_ARRAY_LIMIT / 2) {
+            makeSparse(container);
+        }
+    } else {
+        int at = findOffset(container, offset);
+        if (at == container->count || container->array[at] != offset) {
+            return;
+        }
+        memmove(container->array + at, container->array + at + 1,
+                (size_t)(container->count - at - 1) * sizeof *container->array);
+        container->count--;
+    }
+    bitmap->count--;
+}
+
+/**
+ * @brief Frees the containers of a bitmap.
+ * @param bitmap Bitmap to free.
+ */
+static void freeRowBitmap(struct RowBitmap *bitmap) {
+    for (int chunk = 0; chunk < bitmap->chunks; chunk++) {
+        free(bitmap->containers[chunk].array);
+        free(bitmap->containers[chunk].words);
+    }
+    free(bitmap->containers);
+    bitmap->containers = NULL;
+    bitmap->chunks = 0;
+    bitmap->count = 0;
+}
+
+/**
+ * @brief Finds the dictionary code of a value.
+ * @param index Index to search.
+ * @param text The value.
+ * @param length Length of the value.
+ * @return Code of the value, or -1 if it is not in the dictionary.
+ */
+static int findValue(const struct BitmapIndex *index, const char *text, size_t length) {
+    for (int code = 0; code < index->count; code++) {
+        const struct BitmapValue *value = &index->values[code];
+        if (value->length == length && memcmp(value->text, text, length) == 0) {
+            return code;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Adds a value to the dictionary.
+ * @param index Index to extend.
+ * @param text The value.
+ * @param length Length of the value.
+ * @return Code of the new value.
+ */
+static int addValue(struct BitmapIndex *index, const char *text, size_t length) {
+    if (index->count == index->allocated) {
+        index->allocated = index->allocated ? index->allocated * 2 : 8;
+        index->values = (struct BitmapValue *)resizeBuffer(index->values,
+                                                           (size_t)index->allocated * sizeof *index->values);
+    }
+
+    struct BitmapValue *value = &index->values[index->count];
+    memset(value, 0, sizeof *value);
+    value->text = (char *)resizeBuffer(NULL, length + 1);
+    memcpy(value->text, text, length);
+    value->text[length] = '\0';
+    value->length = (unsigned int)length;
+    return index->count++;
+}
+
+/**
+ * @brief Adds every row appended since the last call to the index.
+ *
+ * Consecutive rows often share a value, so the last code found is tried first.
+ *
+ * @param set Car set owning the column.
+ * @param index Index to update.
+ * @param column String column the index covers.
+ */
+void syncBitmapIndex(const struct Cars *set, struct BitmapIndex *index, const struct CarString *column) {
+    if (index->disabled) {
+        return;
+    }
+
+    int code = -1;
+    for (int row = index->indexed; row < set->rows; row++) {
+        if (isDeadRow(set, row)) {
+            continue;
+        }
+        const char *text = carString(set, column[row]);
+        size_t length = column[row].length;
+        if (code < 0 || index->values[code].length != length || memcmp(index->values[code].text, text, length) != 0) {
+            code = findValue(index, text, length);
+        }
+        if (code < 0) {
+            if (index->count == BITMAP_MAX_VALUES) {
+                freeBitmapIndex(index);
+                index->disabled = 1;
+                return;
+            }
+            code = addValue(index, text, length);
+        }
+        addBitmapRow(&index->values[code].rows, row);
+    }
+    index->indexed = set->rows;
+}
+
+/**
+ * @brief Removes a row from the index.
+ * @param set Car set owning the column.
+ * @param index Index to update.
+ * @param column String column the index covers.
+ * @param row Row of the car being removed.
+ */
+void eraseBitmapRow(const struct Cars *set, struct BitmapIndex *index, const struct CarString *column, int row) {
+    if (index->disabled || row >= index->indexed) {
+        return;
+    }
+    int code = findValue(index, carString(set, column[row]), column[row].length);
+    if (code >= 0) {
+        removeBitmapRow(&index->values[code].rows, row);
+    }
+}
+
+/**
+ * @brief Rebuilds the index from the column, after purgeCars() has moved the rows.
+ *
+ * Purging renumbers every row behind the first dead one, so shifting the bits would touch
+ * as much as rebuilding does; a value that no longer occurs leaves the dictionary.
+ *
+ * @param set Car set owning the column.
+ * @param index Index to rebuild.
+ * @param column String column the index covers.
+ */
+void rebuildBitmapIndex(const struct Cars *set, struct BitmapIndex *index, const struct CarString *column) {
+    freeBitmapIndex(index);
+    syncBitmapIndex(set, index, column);
+}
+
+/**
+ * @brief Looks up the rows holding a value.
+ * @param index Index to search.
+ * @param text The value.
+ * @param length Length of the value.
+ * @return The value's bitmap, or NULL if no indexed row holds it.
+ */
+const struct RowBitmap *findBitmap(const struct BitmapIndex *index, const char *text, size_t length) {
+    int code = findValue(index, text, length);
+    return (code >= 0 && index->values[code].rows.count > 0) ? &index->values[code].rows : NULL;
+}
+
+/**
+ * @brief Tests whether a container holds a row offset.
+ * @param container Container to test.
+ * @param offset Row offset inside the chunk.
+ * @return Non-zero if the offset is present.
+ */
+static int containsOffset(const struct BitmapContainer *container, uint16_t offset) {
+    if (container->words) {
+        return (int)(container->words[offset >> 6] >> (offset & 63) & 1);
+    }
+    int at = findOffset(container, offset);
+    return at < container->count && container->array[at] == offset;
+}
+
+/**
+ * @brief Returns the container of a chunk, or NULL if the bitmap has no rows there.
+ * @param bitmap Bitmap to read.
+ * @param chunk Chunk number.
+ * @return The container, or NULL.
+ */
+static const struct BitmapContainer *chunkContainer(const struct RowBitmap *bitmap, int chunk) {
+    return (chunk < bitmap->chunks && bitmap->containers[chunk].count > 0) ? &bitmap->containers[chunk] : NULL;
+}
+
+/**
+ * @brief Lists the rows in the intersection or the union of several bitmaps.
+ *
+ * Each chunk is combined on its own. An intersection that meets an array container probes
+ * the smallest one's offsets in the other containers; otherwise the containers are folded
+ * into a scratch bit array a word at a time and its set bits are listed.
+ *
+ * @param bitmaps Bitmaps to combine.
+ * @param count Number of bitmaps (at least one).
+ * @param intersect Non-zero for the intersection, zero for the union.
+ * @param rows Receives a malloc'd array of the rows in ascending order (NULL when empty).
+ * @return Number of rows.
+ */
+int combineBitmaps(const struct RowBitmap *const *bitmaps, int count, int intersect, int **rows) {
+    long bound = intersect ? bitmaps[0]->count : 0;
+    int chunks = 0;
+    for (int i = 0; i < count; i++) {
+        bound = intersect ? (bitmaps[i]->count < bound ? bitmaps[i]->count : bound) : bound + bitmaps[i]->count;
+        chunks = bitmaps[i]->chunks > chunks ? bitmaps[i]->chunks : chunks;
+    }
+    *rows = NULL;
+    if (bound == 0) {
+        return 0;
+    }
+    *rows = (int *)resizeBuffer(NULL, (size_t)bound * sizeof **rows);
+
+    uint64_t scratch[CHUNK_WORDS];
+    int n = 0;
+    for (int chunk = 0; chunk < chunks; chunk++) {
+        const struct BitmapContainer *probe = NULL;
+        int present = 0;
+        for (int i = 0; i < count; i++) {
+            const struct BitmapContainer *container = chunkContainer(bitmaps[i], chunk);
+            if (container) {
+                present++;
+                if (container->array && (!probe || container->count < probe->count)) {
+                    probe = container;
+                }
+            }
+        }
+        if (present == 0 || (intersect && present < count)) {
+            continue;
+        }
+        int base = chunk * BITMAP_CHUNK_ROWS;
+
+        if (intersect && probe) {
+            for (int e = 0; e < probe->count; e++) {
+                int keep = 1;
+                for (int i = 0; i < count && keep; i++) {
+                    const struct BitmapContainer *container = &bitmaps[i]->containers[chunk];
+                    keep = container == probe || containsOffset(container, probe->array[e]);
+                }
+                if (keep) {
+                    (*rows)[n++] = base + probe->array[e];
+                }
+            }
+            continue;
+        }
+
+        // Intersections start from all ones; unions from all zeros.
+        memset(scratch, intersect ? 0xff : 0, sizeof scratch);
+        for (int i = 0; i < count; i++) {
+            const struct BitmapContainer *container = chunkContainer(bitmaps[i], chunk);
+            if (!container) {
+                continue;
+            }
+            if (container->words) {
+                for (int w = 0; w < CHUNK_WORDS; w++) {
+                    scratch[w] = intersect ? scratch[w] & container->words[w] : scratch[w] | container->words[w];
+                }
+            } else {
+                // Only unions get here with an array: every intersection with one probes it above.
+                for (int e = 0; e < container->count; e++) {
+                    scratch[container->array[e] >> 6] |= (uint64_t)1 << (container->array[e] & 63);
+                }
+            }
+        }
+        for (int w = 0; w < CHUNK_WORDS; w++) {
+            for (uint64_t bits = scratch[w]; bits; bits &= bits - 1) {
+                (*rows)[n++] = base + w * 64 + __builtin_ctzll(bits);
+            }
+        }
+    }
+
+    if (n == 0) {
+        free(*rows);
+        *rows = NULL;
+    }
+    return n;
+}
+
+/**
+ * @brief Rounds a size up to the 8-byte alignment of encoded blocks.
+ * @param size Size in bytes.
+ * @return Padded size.
+ */
+static size_t padBlock(size_t size) {
+    return (size + 7) & ~(size_t)7;
+}
+
+/**
+ * @brief Encodes an index as one block for a snapshot.
+ *
+ * The block starts with four 32-bit words (value count, indexed rows, disabled flag, zero).
+ * Each value follows as four words (length, chunks, row count, zero), its text, one
+ * (count, dense) word pair per chunk, and then each chunk's offsets or bit array. Every
+ * part is zero-padded to 8 bytes, so the bit arrays stay aligned.
+ *
+ * @param index Index to encode.
+ * @param size Receives the size of the block, a multiple of 8 bytes.
+ * @return Newly allocated block.
+ */
+void *encodeBitmapIndex(const struct BitmapIndex *index, size_t *size) {
+    size_t bytes = 4 * sizeof(uint32_t);
+    for (int code = 0; code < index->count; code++) {
+        const struct RowBitmap *bitmap = &index->values[code].rows;
+        bytes += 4 * sizeof(uint32_t) + padBlock(index->values[code].length) +
+                 padBlock((size_t)bitmap->chunks * 2 * sizeof(uint32_t));
+        for (int chunk = 0; chunk < bitmap->chunks; chunk++) {
+            const struct BitmapContainer *container = &bitmap->containers[chunk];
+            bytes += container->words ? CHUNK_WORDS * sizeof(uint64_t)
+                                      : padBlock((size_t)container->count * sizeof(uint16_t));
+        }
+    }
+
+    char *block = (char *)calloc(1, bytes);
+    if (!block) {
+        fprintf(stderr, "Memory allocation error.\n");
+        exit(EXIT_FAILURE);
+    }
+    uint32_t *head = (uint32_t *)block;
+    head[0] = (uint32_t)index->count;
+    head[1] = (uint32_t)index->indexed;
+    head[2] = (uint32_t)index->disabled;
+    size_t at = 4 * sizeof(uint32_t);
+
+    for (int code = 0; code < index->count; code++) {
+        const struct BitmapValue *value = &index->values[code];
+        const struct RowBitmap *bitmap = &value->rows;
+        uint32_t *entry = (uint32_t *)(block + at);
+        entry[0] = value->length;
+        entry[1] = (uint32_t)bitmap->chunks;
+        entry[2] = (uint32_t)bitmap->count;
+        at += 4 * sizeof(uint32_t);
+        memcpy(block + at, value->text, value->length);
+        at += padBlock(value->length);
+
+        uint32_t *shapes = (uint32_t *)(block + at);
+        for (int chunk = 0; chunk < bitmap->chunks; chunk++) {
+            shapes[2 * chunk] = (uint32_t)bitmap->containers[chunk].count;
+            shapes[2 * chunk + 1] = bitmap->containers[chunk].words != NULL;
+        }
+        at += padBlock((size_t)bitmap->chunks * 2 * sizeof(uint32_t));
+
+        for (int chunk = 0; chunk < bitmap->chunks; chunk++) {
+            const struct BitmapContainer *container = &bitmap->containers[chunk];
+            if (container->words) {
+                memcpy(block + at, container->words, CHUNK_WORDS * sizeof(uint64_t));
+                at += CHUNK_WORDS * sizeof(uint64_t);
+            } else {
+                memcpy(block + at, container->array, (size_t)container->count * sizeof(uint16_t));
+                at += padBlock((size_t)container->count * sizeof(uint16_t));
+            }
+        }
+    }
+    *size = bytes;
+    return block;
+}
+
+/**
+ * @brief Decodes one dictionary value and its bitmap from an encoded block.
+ * @param index Index to add the value to.
+ * @param block The block.
+ * @param size Size of the block.
+ * @param at Offset of the value, advanced past it.
+ * @param rows Number of rows of the car set.
+ * @return 0 on success, -1 if the value does not fit in the block.
+ */
+static int decodeValue(struct BitmapIndex *index, const char *block, size_t size, size_t *at, int rows) {
+    const uint32_t *entry = (const uint32_t *)(block + *at);
+    size_t maxChunks = ((size_t)rows + BITMAP_CHUNK_ROWS - 1) / BITMAP_CHUNK_ROWS;
+    if (size - *at < 4 * sizeof(uint32_t) || entry[1] > maxChunks || entry[2] > (uint32_t)rows) {
+        return -1;
+    }
+    size_t length = entry[0], chunks = entry[1];
+    *at += 4 * sizeof(uint32_t);
+    if (padBlock(length) > size - *at || padBlock(chunks * 2 * sizeof(uint32_t)) > size - *at - padBlock(length)) {
+        return -1;
+    }
+    int code = addValue(index, block + *at, length);
+    struct RowBitmap *bitmap = &index->values[code].rows;
+    *at += padBlock(length);
+    const uint32_t *shapes = (const uint32_t *)(block + *at);
+    *at += padBlock(chunks * 2 * sizeof(uint32_t));
+
+    bitmap->containers = (struct BitmapContainer *)calloc(chunks ? chunks : 1, sizeof *bitmap->containers);
+    if (!bitmap->containers) {
+        fprintf(stderr, "Memory allocation error.\n");
+        exit(EXIT_FAILURE);
+    }
+    bitmap->chunks = (int)chunks;
+    for (size_t chunk = 0; chunk < chunks; chunk++) {
+        struct BitmapContainer *container = &bitmap->containers[chunk];
+        uint32_t count = shapes[2 * chunk], dense = shapes[2 * chunk + 1];
+        size_t payload = dense ? CHUNK_WORDS * sizeof(uint64_t) : padBlock(count * sizeof(uint16_t));
+        if (dense > 1 || count > (dense ? BITMAP_CHUNK_ROWS : BITMAP_ARRAY_LIMIT) || payload > size - *at) {
+            return -1;
+        }
+        container->count = (int)count;
+        if (dense) {
+            container->words = (uint64_t *)resizeBuffer(NULL, CHUNK_WORDS * sizeof(uint64_t));
+            memcpy(container->words, block + *at, CHUNK_WORDS * sizeof(uint64_t));
+        } else {
+            container->allocated = count ? (int)count : 1;
+            container->array = (uint16_t *)resizeBuffer(NULL, (size_t)container->allocated * sizeof(uint16_t));
+            memcpy(container->array, block + *at, count * sizeof(uint16_t));
+        }
+        bitmap->count += (int)count;
+        *at += payload;
+    }
+    return bitmap->count == (int)entry[2] ? 0 : -1;
+}
+
+/**
+ * @brief Rebuilds an index from a block written by encodeBitmapIndex().
+ *
+ * Every count and length is checked against the block size and the row count before it
+ * is used, so a block that does not fit is rejected rather than read out of bounds. The
+ * snapshot checksum has already been verified by then.
+ *
+ * @param index Empty index to fill.
+ * @param data The block, 8-byte aligned.
+ * @param size Size of the block.
+ * @param rows Number of rows of the car set the block belongs to.
+ * @return 0 on success, -1 if the block is damaged (the index is left empty).
+ */
+int decodeBitmapIndex(struct BitmapIndex *index, const void *data, size_t size, int rows) {
+    const char *block = (const char *)data;
+    const uint32_t *head = (const uint32_t *)block;
+    size_t at = 4 * sizeof(uint32_t);
+    if (size < at || head[0] > BITMAP_MAX_VALUES || head[1] > (uint32_t)rows || head[2] > 1) {
+        return -1;
+    }
+
+    for (uint32_t code = 0; code < head[0]; code++) {
+        if (decodeValue(index, block, size, &at, rows) != 0) {
+            freeBitmapIndex(index);
+            return -1;
+        }
+    }
+    if (at != size) {
+        freeBitmapIndex(index);
+        return -1;
+    }
+    index->indexed = (int)head[1];
+    index->disabled = (int)head[2];
+    return 0;
+}
+
+/**
+ * @brief Returns the bytes the bitmaps and the dictionary of an index occupy.
+ * @param index Index to measure.
+ * @return Bytes in use.
+ */
+size_t bitmapIndexBytes(const struct BitmapIndex *index) {
+    size_t bytes = (size_t)index->allocated * sizeof *index->values;
+    for (int code = 0; code < index->count; code++) {
+        const struct RowBitmap *bitmap = &index->values[code].rows;
+        bytes += index->values[code].length + 1 + (size_t)bitmap->chunks * sizeof *bitmap->containers;
+        for (int chunk = 0; chunk < bitmap->chunks; chunk++) {
+            const struct BitmapContainer *container = &bitmap->containers[chunk];
+            bytes += container->words ? CHUNK_WORDS * sizeof(uint64_t)
+                                      : (size_t)container->allocated * sizeof *container->array;
+        }
+    }
+    return bytes;
+}
+
+/**
+ * @brief Frees the dictionary and the bitmaps of an index and resets it.
+ * @param index Index to free.
+ */
+void freeBitmapIndex(struct BitmapIndex *index) {
+    for (int code = 0; code < index->count; code++) {
+        free(index->values[code].text);
+        freeRowBitmap(&index->values[code].rows);
+    }
+    free(index->values);
+    memset(index, 0, sizeof *index);
+}
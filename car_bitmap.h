@@ -0,0 +1,164 @@
+/**
+ * @file car_bitmap.h
+ * @brief Dictionary-encoded, compressed bitmap indexes on low-cardinality string columns.
+ *
+ * Fuel and vehicle type take a handful of distinct values. Each index keeps a dictionary of
+ * those values and, for every value, the set of rows holding it as a roaring-style bitmap:
+ * rows are split into chunks of BITMAP_CHUNK_ROWS, and each chunk stores a sorted array of
+ * 16-bit row offsets while it is sparse and a plain bit array once it holds more than
+ * BITMAP_ARRAY_LIMIT rows. A rare value costs two bytes per row and a common one an eighth
+ * of a byte, instead of a 4-byte row number each.
+ *
+ * The bitmaps cover rows [0, indexed); rows appended later are folded in by syncBitmapIndex(),
+ * and readers check the pending rows themselves. Removed rows are cleared at once, so the
+ * bitmaps never hold dead rows. A column with more than BITMAP_MAX_VALUES distinct values
+ * is not worth a bitmap per value: its index disables itself and queries scan the column
+ * instead. Snapshots store each index as one encoded block (see encodeBitmapIndex()),
+ * which is copied back into containers when the snapshot is loaded.
+ */
+
+#ifndef CAR_BITMAP_H
+#define CAR_BITMAP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct Cars;
+struct CarString;
+
+/** Rows covered by one container; row offsets inside a chunk fit in 16 bits. */
+#define BITMAP_CHUNK_ROWS 65536
+
+/** Largest array container; at this size an array takes as much room as the bit array. */
+#define BITMAP_ARRAY_LIMIT 4096
+
+/** Most distinct values an index keeps a bitmap for. */
+#define BITMAP_MAX_VALUES 64
+
+/**
+ * @struct BitmapContainer
+ * @brief Rows of one chunk, as a sorted array of offsets or as a bit array.
+ */
+struct BitmapContainer {
+    int count;        ///< Number of rows in the container.
+    int allocated;    ///< Entries @c array has room for.
+    uint16_t *array;  ///< Sorted row offsets while the container is sparse (NULL otherwise).
+    uint64_t *words;  ///< BITMAP_CHUNK_ROWS bits once the container is dense (NULL otherwise).
+};
+
+/**
+ * @struct RowBitmap
+ * @brief Compressed set of rows, one container per chunk.
+ */
+struct RowBitmap {
+    struct BitmapContainer *containers;  ///< Containers, indexed by row / BITMAP_CHUNK_ROWS.
+    int chunks;                          ///< Number of containers.
+    int count;                           ///< Number of rows in the set.
+};
+
+/**
+ * @struct BitmapValue
+ * @brief One dictionary entry: a distinct value and the rows holding it.
+ */
+struct BitmapValue {
+    char *text;            ///< The value (owned, NUL-terminated).
+    unsigned int length;   ///< Length of @c text.
+    struct RowBitmap rows;  ///< Live rows whose string equals @c text.
+};
+
+/**
+ * @struct BitmapIndex
+ * @brief Dictionary of the distinct values of a column, with a bitmap per value.
+ */
+struct BitmapIndex {
+    struct BitmapValue *values;  ///< Dictionary entries; the position is the value's code.
+    int count;                   ///< Number of distinct values.
+    int allocated;               ///< Entries @c values has room for.
+    int indexed;                 ///< Rows [0, indexed) are in the bitmaps; later rows are pending.
+    int disabled;                ///< Non-zero once the column has too many values to index.
+};
+
+/**
+ * @brief Adds every row appended since the last call to the index.
+ * @param set Car set owning the column.
+ * @param index Index to update.
+ * @param column String column the index covers.
+ */
+void syncBitmapIndex(const struct Cars *set, struct BitmapIndex *index, const struct CarString *column);
+
+/**
+ * @brief Removes a row from the index.
+ *
+ * Called by eraseCars() before the row is marked dead; pending rows are skipped when they
+ * are synchronized instead.
+ *
+ * @param set Car set owning the column.
+ * @param index Index to update.
+ * @param column String column the index covers.
+ * @param row Row of the car being removed.
+ */
+void eraseBitmapRow(const struct Cars *set, struct BitmapIndex *index, const struct CarString *column, int row);
+
+/**
+ * @brief Rebuilds the index from the column, after purgeCars() has moved the rows.
+ * @param set Car set owning the column.
+ * @param index Index to rebuild.
+ * @param column String column the index covers.
+ */
+void rebuildBitmapIndex(const struct Cars *set, struct BitmapIndex *index, const struct CarString *column);
+
+/**
+ * @brief Looks up the rows holding a value.
+ * @param index Index to search.
+ * @param text The value.
+ * @param length Length of the value.
+ * @return The value's bitmap, or NULL if no indexed row holds it.
+ */
+const struct RowBitmap *findBitmap(const struct BitmapIndex *index, const char *text, size_t length);
+
+/**
+ * @brief Lists the rows in the intersection or the union of several bitmaps.
+ *
+ * Chunks are combined a 64-bit word at a time, so an AND of two dense values costs
+ * BITMAP_CHUNK_ROWS / 64 word operations per chunk whatever the number of matches.
+ *
+ * @param bitmaps Bitmaps to combine.
+ * @param count Number of bitmaps (at least one).
+ * @param intersect Non-zero for the intersection, zero for the union.
+ * @param rows Receives a malloc'd array of the rows in ascending order (NULL when empty).
+ * @return Number of rows.
+ */
+int combineBitmaps(const struct RowBitmap *const *bitmaps, int count, int intersect, int **rows);
+
+/**
+ * @brief Encodes an index as one block for a snapshot.
+ * @param index Index to encode.
+ * @param size Receives the size of the block, a multiple of 8 bytes.
+ * @return Newly allocated block.
+ */
+void *encodeBitmapIndex(const struct BitmapIndex *index, size_t *size);
+
+/**
+ * @brief Rebuilds an index from a block written by encodeBitmapIndex().
+ * @param index Empty index to fill.
+ * @param data The block, 8-byte aligned.
+ * @param size Size of the block.
+ * @param rows Number of rows of the car set the block belongs to.
+ * @return 0 on success, -1 if the block is damaged (the index is left empty).
+ */
+int decodeBitmapIndex(struct BitmapIndex *index, const void *data, size_t size, int rows);
+
+/**
+ * @brief Returns the bytes the bitmaps and the dictionary of an index occupy.
+ * @param index Index to measure.
+ * @return Bytes in use.
+ */
+size_t bitmapIndexBytes(const struct BitmapIndex *index);
+
+/**
+ * @brief Frees the dictionary and the bitmaps of an index and resets it.
+ * @param index Index to free.
+ */
+void freeBitmapIndex(struct BitmapIndex *index);
+
+#endif // CAR_BITMAP_H
@@ -0,0 +1,299 @@
+/**
+ * @file car_cache.c
+ * @brief Implementation of the query result cache.
+ */
+
+#include "car_cache.h"
+#include "car_stats.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** Longest normalized query text that is cached. */
+#define KEY_BYTES 1024
+
+/**
+ * @struct CachedResult
+ * @brief Matching rows of one query, and the generation of the set they were computed at.
+ */
+struct CachedResult {
+    char *key;                    ///< Normalized text of the query (see formatQuery()).
+    const struct Cars *set;       ///< Car set the rows belong to.
+    unsigned long generation;     ///< Generation of @c set when the rows were computed.
+    int *rows;                    ///< Matching rows in ascending order (NULL when empty).
+    int count;                    ///< Number of rows.
+    int range;                    ///< Non-zero if the query is a single range predicate.
+    enum QueryField field;        ///< Field of the range predicate.
+    int min;                      ///< Smallest value of the range predicate.
+    int max;                      ///< Largest value of the range predicate.
+    struct CachedResult *newer;   ///< Next more recently used result.
+    struct CachedResult *older;   ///< Next less recently used result.
+};
+
+/**
+ * @brief Takes a result out of the recency list.
+ * @param cache The cache.
+ * @param result Result to unlink.
+ */
+static void unlinkResult(struct QueryCache *cache, struct CachedResult *result) {
+    if (result->newer) {
+        result->newer->older = result->older;
+    } else {
+        cache->newest = result->older;
+    }
+    if (result->older) {
+        result->older->newer = result->newer;
+    } else {
+        cache->oldest = result->newer;
+    }
+    result->newer = result->older = NULL;
+}
+
+/**
+ * @brief Puts a result at the most recently used end of the list.
+ * @param cache The cache.
+ * @param result Result to link, not in the list.
+ */
+static void linkNewest(struct QueryCache *cache, struct CachedResult *result) {
+    result->older = cache->newest;
+    result->newer = NULL;
+    if (cache->newest) {
+        cache->newest->newer = result;
+    } else {
+        cache->oldest = result;
+    }
+    cache->newest = result;
+}
+
+/**
+ * @brief Removes a result from the cache and frees it.
+ * @param cache The cache.
+ * @param result Result to drop.
+ */
+static void dropResult(struct QueryCache *cache, struct CachedResult *result) {
+    unlinkResult(cache, result);
+    cache->entries--;
+    cache->bytes -= (size_t)result->count * sizeof *result->rows;
+    free(result->key);
+    free(result->rows);
+    free(result);
+}
+
+/**
+ * @brief Copies a row list.
+ * @param rows Rows to copy.
+ * @param count Number of rows.
+ * @return Newly allocated copy, or NULL when empty.
+ */
+static int *copyRows(const int *rows, int count) {
+    if (count == 0) {
+        return NULL;
+    }
+    int *copy = (int *)malloc((size_t)count * sizeof *copy);
+    if (!copy) {
+        fprintf(stderr, "Memory allocation error.\n");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(copy, rows, (size_t)count * sizeof *copy);
+    return copy;
+}
+
+/**
+ * @brief Tests whether a cached range result holds every match of a range predicate.
+ * @param result Cached result.
+ * @param node Predicate.
+ * @return Non-zero if the predicate's range lies inside the cached one.
+ */
+static int coversRange(const struct CachedResult *result, const struct QueryNode *node) {
+    return result->range && node->kind == QUERY_RANGE && node->field == result->field && result->min <= node->min &&
+           node->max <= result->max;
+}
+
+/**
+ * @brief Tests whether a cached result holds every match of a query, so filtering it answers the query.
+ * @param result Cached result.
+ * @param query The query.
+ * @param childKeys Normalized text of each child of an AND query (unused otherwise).
+ * @return Non-zero if the query only matches cached rows.
+ */
+static int holdsMatches(const struct CachedResult *result, const struct QueryNode *query, char (*childKeys)[KEY_BYTES]) {
+    if (coversRange(result, query)) {
+        return 1;
+    }
+    if (query->kind == QUERY_AND) {
+        for (int i = 0; i < query->childCount; i++) {
+            if (strcmp(result->key, childKeys[i]) == 0 || coversRange(result, query->children[i])) {
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Looks a query up in the cache.
+ *
+ * Results computed at another generation, or for another set, are dropped on the way.
+ * The query's own key is an exact hit. Otherwise the smallest cached result that holds
+ * every match of the query is filtered with filterRows(), and the answer is cached under
+ * the query's key.
+ *
+ * @param cache The cache.
+ * @param set Car set the query is asked of.
+ * @param query The query; its children may be reordered by the planner.
+ * @param rows Receives a malloc'd array of the matching live rows in ascending order (NULL when empty).
+ * @param examined Receives the number of rows examined (may be NULL).
+ * @return Number of matching rows, or -1 if the cache cannot answer the query.
+ */
+int findCachedQuery(struct QueryCache *cache, const struct Cars *set, struct QueryNode *query, int **rows,
+                    long *examined) {
+    char key[KEY_BYTES];
+    *rows = NULL;
+    if (!set || formatQuery(query, key, sizeof key) < 0) {
+        cache->misses++;
+        countCacheLookup(CACHE_MISS);
+        return -1;
+    }
+
+    char (*childKeys)[KEY_BYTES] = NULL;
+    if (query->kind == QUERY_AND) {
+        childKeys = (char (*)[KEY_BYTES])malloc((size_t)query->childCount * sizeof *childKeys);
+        if (!childKeys) {
+            fprintf(stderr, "Memory allocation error.\n");
+            exit(EXIT_FAILURE);
+        }
+        for (int i = 0; i < query->childCount; i++) {
+            if (formatQuery(query->children[i], childKeys[i], sizeof *childKeys) < 0) {
+                childKeys[i][0] = '\0';
+            }
+        }
+    }
+
+    struct CachedResult *broader = NULL, *next;
+    for (struct CachedResult *result = cache->newest; result; result = next) {
+        next = result->older;
+        if (result->set != set || result->generation != set->generation) {
+            dropResult(cache, result);
+        } else if (strcmp(result->key, key) == 0) {
+            unlinkResult(cache, result);
+            linkNewest(cache, result);
+            free(childKeys);
+            cache->hits++;
+            countCacheLookup(CACHE_HIT);
+            *rows = copyRows(result->rows, result->count);
+            if (examined) {
+                *examined = 0;
+            }
+            return result->count;
+        } else if (holdsMatches(result, query, childKeys) && (!broader || result->count < broader->count)) {
+            broader = result;
+        }
+    }
+    free(childKeys);
+
+    if (!broader) {
+        cache->misses++;
+        countCacheLookup(CACHE_MISS);
+        return -1;
+    }
+
+    unlinkResult(cache, broader);
+    linkNewest(cache, broader);
+    *rows = copyRows(broader->rows, broader->count);
+    int count = filterRows(set, query, *rows, broader->count);
+    if (count == 0) {
+        free(*rows);
+        *rows = NULL;
+    }
+    if (examined) {
+        *examined = broader->count;
+    }
+    cache->partialHits++;
+    countCacheLookup(CACHE_PARTIAL);
+    storeCachedQuery(cache, set, query, *rows, count);
+    return count;
+}
+
+/**
+ * @brief Caches the result of a query.
+ *
+ * A result of the same query is replaced, and the least recently used results are evicted
+ * until the new one fits within QUERY_CACHE_ENTRIES and QUERY_CACHE_BYTES. Results larger
+ * than the whole byte budget, and queries too long to key, are not cached.
+ *
+ * @param cache The cache.
+ * @param set Car set the query was run on.
+ * @param query The query.
+ * @param rows Matching live rows in ascending order (copied).
+ * @param count Number of rows.
+ */
+void storeCachedQuery(struct QueryCache *cache, const struct Cars *set, const struct QueryNode *query,
+                      const int *rows, int count) {
+    char key[KEY_BYTES];
+    size_t bytes = (size_t)count * sizeof *rows;
+    if (!set || bytes > QUERY_CACHE_BYTES || formatQuery(query, key, sizeof key) < 0) {
+        return;
+    }
+
+    for (struct CachedResult *result = cache->newest; result; result = result->older) {
+        if (strcmp(result->key, key) == 0) {
+            dropResult(cache, result);
+            break;
+        }
+    }
+    while (cache->oldest && (cache->entries >= QUERY_CACHE_ENTRIES || cache->bytes + bytes > QUERY_CACHE_BYTES)) {
+        dropResult(cache, cache->oldest);
+    }
+
+    struct CachedResult *result = (struct CachedResult *)calloc(1, sizeof *result);
+    size_t keyLength = strlen(key);
+    char *copy = (char *)malloc(keyLength + 1);
+    if (!result || !copy) {
+        fprintf(stderr, "Memory allocation error.\n");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(copy, key, keyLength + 1);
+    result->key = copy;
+    result->set = set;
+    result->generation = set->generation;
+    result->rows = copyRows(rows, count);
+    result->count = count;
+    if (query->kind == QUERY_RANGE) {
+        result->range = 1;
+        result->field = query->field;
+        result->min = query->min;
+        result->max = query->max;
+    }
+    linkNewest(cache, result);
+    cache->entries++;
+    cache->bytes += bytes;
+}
+
+/**
+ * @brief Answers a query from the cache, or runs it and caches the result.
+ * @param cache The cache.
+ * @param set Car set to query.
+ * @param query The query; its children are reordered by the planner.
+ * @param rows Receives a malloc'd array of the matching live rows in ascending order (NULL when empty).
+ * @param examined Receives the number of rows examined (may be NULL).
+ * @return Number of matching rows.
+ */
+int cachedQuery(struct QueryCache *cache, const struct Cars *set, struct QueryNode *query, int **rows,
+                long *examined) {
+    int count = findCachedQuery(cache, set, query, rows, examined);
+    if (count < 0) {
+        count = runQuery(set, query, rows, examined);
+        storeCachedQuery(cache, set, query, *rows, count);
+    }
+    return count;
+}
+
+/**
+ * @brief Drops every cached result; the hit and miss counts are kept.
+ * @param cache The cache.
+ */
+void clearQueryCache(struct QueryCache *cache) {
+    while (cache->newest) {
+        dropResult(cache, cache->newest);
+    }
+}
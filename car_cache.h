@@ -0,0 +1,91 @@
+/**
+ * @file car_cache.h
+ * @brief Bounded LRU cache of query results, stamped with the generation of the car set.
+ *
+ * Each entry holds the matching rows of one query, keyed by the normalized text of the query
+ * (see formatQuery()), so "year = 2015..2018 and fuel = LPG" and "fuel = LPG and year =
+ * 2015..2018" share an entry. An entry is only used while the car set still has the
+ * generation it was computed at; adding, removing or purging cars bumps the generation, and
+ * stale entries are dropped when they are next looked at.
+ *
+ * A query that is not cached can still be answered from a broader cached result: a range
+ * inside a cached range on the same field, or an AND one of whose criteria is cached (or
+ * lies inside a cached range), is answered by testing only the cached rows. The smallest
+ * such result is used, and the answer is cached in turn.
+ *
+ * The cache keeps at most QUERY_CACHE_ENTRIES results and QUERY_CACHE_BYTES bytes of rows,
+ * evicting the least recently used result first.
+ */
+
+#ifndef CAR_CACHE_H
+#define CAR_CACHE_H
+
+#include "car_query.h"
+
+/** Results kept at most. */
+#define QUERY_CACHE_ENTRIES 32
+
+/** Bytes of cached rows kept at most; a larger result is not cached. */
+#define QUERY_CACHE_BYTES ((size_t)64 << 20)
+
+struct CachedResult;
+
+/**
+ * @struct QueryCache
+ * @brief Cached query results, most recently used first, and how lookups were answered.
+ */
+struct QueryCache {
+    struct CachedResult *newest;  ///< Most recently used result.
+    struct CachedResult *oldest;  ///< Least recently used result, evicted first.
+    int entries;                  ///< Number of cached results.
+    size_t bytes;                 ///< Bytes of rows held by the cached results.
+    unsigned long hits;           ///< Lookups answered with the result of the same query.
+    unsigned long partialHits;    ///< Lookups answered by filtering the result of a broader query.
+    unsigned long misses;         ///< Lookups that had to run the query.
+};
+
+/**
+ * @brief Looks a query up in the cache.
+ *
+ * A partial hit filters the broader result and caches the answer under the query's own key.
+ *
+ * @param cache The cache.
+ * @param set Car set the query is asked of.
+ * @param query The query; its children may be reordered by the planner.
+ * @param rows Receives a malloc'd array of the matching live rows in ascending order (NULL when empty).
+ * @param examined Receives the number of rows examined (may be NULL).
+ * @return Number of matching rows, or -1 if the cache cannot answer the query.
+ */
+int findCachedQuery(struct QueryCache *cache, const struct Cars *set, struct QueryNode *query, int **rows,
+                    long *examined);
+
+/**
+ * @brief Caches the result of a query.
+ * @param cache The cache.
+ * @param set Car set the query was run on.
+ * @param query The query.
+ * @param rows Matching live rows in ascending order (copied).
+ * @param count Number of rows.
+ */
+void storeCachedQuery(struct QueryCache *cache, const struct Cars *set, const struct QueryNode *query,
+                      const int *rows, int count);
+
+/**
+ * @brief Answers a query from the cache, or runs it and caches the result.
+ * @param cache The cache.
+ * @param set Car set to query.
+ * @param query The query; its children are reordered by the planner.
+ * @param rows Receives a malloc'd array of the matching live rows in ascending order (NULL when empty).
+ * @param examined Receives the number of rows examined (may be NULL).
+ * @return Number of matching rows.
+ */
+int cachedQuery(struct QueryCache *cache, const struct Cars *set, struct QueryNode *query, int **rows,
+                long *examined);
+
+/**
+ * @brief Drops every cached result; the hit and miss counts are kept.
+ * @param cache The cache.
+ */
+void clearQueryCache(struct QueryCache *cache);
+
+#endif // CAR_CACHE_H
@@ -4,134 +4,1216 @@
  */
 
 #include "car_database.h"
+#include "car_cache.h"
+#include "car_fuzzy.h"
+#include "car_import.h"
+#include "car_io.h"
+#include "car_journal.h"
+#include "car_order.h"
+#include "car_output.h"
+#include "car_paged.h"
+#include "car_parallel.h"
+#include "car_partition.h"
+#include "car_prefix.h"
+#include "car_query.h"
+#include "car_server.h"
+#include "car_stats.h"
+#include "platform.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+/** Longest string field accepted, matching the "%99s" conversions used for input. */
+#define MAX_FIELD_LENGTH 99
+
+/** Text file holding the car database. */
+#define DATABASE_FILE "base.txt"
+
+/** Binary snapshot written next to DATABASE_FILE. */
+#define SNAPSHOT_FILE "base.bin"
+
+/** Journal of the changes saved since DATABASE_FILE was last written. */
+#define JOURNAL_FILE "base.journal"
+
+/** Directory of the partitioned layout, used instead of DATABASE_FILE once it holds a manifest. */
+#define PARTITION_DIRECTORY "base.parts"
+
+/** Changes made since the last save, and the base file they apply to. */
+static struct Journal journal;
+
+/** Results of recent searches, reused while the cars have not changed. */
+static struct QueryCache queryCache;
+
+/** Order of the car list and of search results; inactive lists them in car-number order. */
+static struct CarOrder listingOrder;
+
+/** Memory limit of paged mode in bytes, or 0 to load the whole base file. */
+static size_t pagedLimit;
+
+/** The base file while it is opened in paged mode (see car_paged.h), or NULL when it is loaded whole. */
+static struct PagedCars *pagedCars;
+
+/** Layout requested on the command line; PARTITION_NONE with partitionRequested set merges the partitions back. */
+static enum PartitionScheme partitionScheme;
+
+/** Years per partition of the requested layout when partitioning by year. */
+static int partitionSpan;
+
+/** Non-zero if a layout was requested, so the database is converted to it when read. */
+static int partitionRequested;
+
+/** The database while it is partitioned (see car_partition.h), or NULL when it is one base file. */
+static struct PartitionedCars *partitions;
+
+/** Values listed by a prefix search before the rest are only counted. */
+#define PREFIX_VALUES_SHOWN 20
+
+/** Existing values suggested for a brand or model new to the database. */
+#define PREFIX_SUGGESTIONS 5
+
+/**
+ * @brief Returns the size of a file, for the statistics.
+ * @param path File to inspect.
+ * @return Size in bytes, or 0 if the file does not exist.
+ */
+static size_t fileBytes(const char *path) {
+    uint64_t size;
+    int64_t time;
+    return fileStamp(path, &size, &time) == 0 ? (size_t)size : 0;
+}
+
+/**
+ * @brief Reports the outcome of replaying the journal.
+ * @param replayed Value returned by the replay.
+ */
+static void reportReplay(int replayed) {
+    if (replayed < 0) {
+        printf("The journal %s does not match %s and was not applied.\n", JOURNAL_FILE, DATABASE_FILE);
+    } else if (replayed > 0) {
+        printf("Replayed %d saved changes from %s.\n", replayed, JOURNAL_FILE);
+    }
+    if (journal.damaged) {
+        printf("The journal ends in a damaged entry; the next save rewrites %s.\n", DATABASE_FILE);
+    }
+}
+
+/**
+ * @brief Removes a car of the paged base file while the journal is replayed.
+ * @param id Record ID of the car.
+ * @param context The paged file.
+ * @return 0 on success, -1 if there is no such car.
+ */
+static int erasePagedCar(int id, void *context) {
+    return removePagedCar((struct PagedCars *)context, id);
+}
+
+/**
+ * @brief Opens "base.txt" in paged mode and replays the journal over it.
+ *
+ * Only the offset index is built; the cars are read when a listing, a search or a removal
+ * needs them. The journal's added cars are kept in memory after those of the file.
+ *
+ * @param count Pointer to the number of cars in the database.
+ * @return 0 on success, -1 if the file must be loaded whole instead.
+ */
+static int readPagedCars(int *count) {
+    double started = monotonicSeconds();
+    pagedCars = openPagedCars(DATABASE_FILE, pagedLimit);
+    if (!pagedCars) {
+        if (fileBytes(DATABASE_FILE) > 0) {
+            printf("%s cannot be paged because a number runs into other characters; loading it whole.\n",
+                   DATABASE_FILE);
+        }
+        return -1;
+    }
+
+    startJournal(&journal, DATABASE_FILE);
+    int replayed = replayJournalWith(&journal, JOURNAL_FILE, pagedCars->added, erasePagedCar, pagedCars);
+    if (statsEnabled) {
+        countBytes(STAT_LOAD, (size_t)pagedCars->size + (replayed >= 0 ? fileBytes(JOURNAL_FILE) : 0), 0);
+    }
+    reportReplay(replayed);
+
+    *count = pagedLiveCars(pagedCars);
+    printf("Indexed %d records from the file in %d pages; they are read when needed.\n", *count,
+           pagedCars->pages);
+    double elapsed = monotonicSeconds() - started;
+    if (elapsed > 0.0) {
+        printf("Index time: %.3f ms (%.1f MB/s).\n", elapsed * 1e3, (double)pagedCars->size / elapsed / 1e6);
+    }
+    printf("Memory: %.1f KB of offset index and up to %.1f MB of page cache, within the %.1f MB limit.\n",
+           pagedIndexBytes(pagedCars) / 1e3, pagedCars->cacheLimit / 1e6, pagedLimit / 1e6);
+    if (listingOrder.active) {
+        printf("Listings are not sorted in paged mode; they follow the car numbers.\n");
+    }
+    endSample(STAT_LOAD, started, pagedIndexBytes(pagedCars));
+    return 0;
+}
+
+/**
+ * @brief Opens the partitioned layout again after its files were rewritten, dropping the cars held in memory.
+ */
+static void reopenPartitions(void) {
+    closePartitionedCars(partitions);
+    partitions = openPartitionedCars(PARTITION_DIRECTORY);
+    if (!partitions) {
+        fprintf(stderr, "Unable to reopen %s.\n", PARTITION_DIRECTORY);
+        exit(EXIT_FAILURE);
+    }
+}
+
+/**
+ * @brief Moves the cars of the open partitions into a new set of partitions under the requested scheme.
+ *
+ * The new files get numbers the old ones never had, and the new manifest replaces the old
+ * one before the old files are deleted, so an interrupted conversion leaves one complete
+ * layout behind. The cars keep their numbers.
+ */
+static void repartitionCars(void) {
+    struct PartitionedCars *converted = createPartitionedCars(PARTITION_DIRECTORY, partitionScheme, partitionSpan);
+    converted->nextFile = partitions->nextFile;
+    movePartitionedCars(converted, partitions);
+    size_t bytes;
+    if (savePartitionedCars(converted, 0, &bytes) < 0) {
+        fprintf(stderr, "Unable to write the partitions to %s.\n", PARTITION_DIRECTORY);
+        exit(EXIT_FAILURE);
+    }
+    countBytes(STAT_LOAD, 0, bytes);
+    removePartitionFiles(partitions, 0);
+    closePartitionedCars(converted);
+    reopenPartitions();
+}
+
+/**
+ * @brief Opens the partitioned layout, if there is one, converting it first to the requested layout.
+ *
+ * Only the manifest is read (see car_partition.h). When the base file is requested instead,
+ * the partitions are written back into "base.txt" and deleted, and the base file is then
+ * loaded as usual.
+ *
+ * @param count Pointer to the number of cars in the database.
+ * @return 0 if the database is open partitioned, -1 if it is to be loaded from the base file.
+ */
+static int readPartitionedCars(int *count) {
+    if (!partitionedLayoutExists(PARTITION_DIRECTORY)) {
+        return -1;
+    }
+    double started = monotonicSeconds();
+    partitions = openPartitionedCars(PARTITION_DIRECTORY);
+    if (!partitions) {
+        fprintf(stderr, "The partition manifest in %s is damaged or names a missing file.\n", PARTITION_DIRECTORY);
+        exit(EXIT_FAILURE);
+    }
+
+    if (partitionRequested && partitionScheme == PARTITION_NONE) {
+        if (writePartitionedText(partitions, DATABASE_FILE) != 0) {
+            fprintf(stderr, "Unable to write %s.\n", DATABASE_FILE);
+            exit(EXIT_FAILURE);
+        }
+        // The snapshot and the journal belong to an older base file.
+        remove(SNAPSHOT_FILE);
+        remove(JOURNAL_FILE);
+        printf("Merged %d partitions back into %s; the cars are numbered 1, 2, 3, ... again in the same order.\n",
+               partitions->count, DATABASE_FILE);
+        removePartitionFiles(partitions, 1);
+        closePartitionedCars(partitions);
+        partitions = NULL;
+        return -1;
+    }
+    if (partitionRequested && (partitionScheme != partitions->scheme ||
+                               (partitionScheme == PARTITION_BY_YEAR && partitionSpan != partitions->yearSpan))) {
+        repartitionCars();
+        printf("Repartitioned the cars into %d partitions.\n", partitions->count);
+    }
+    if (pagedLimit > 0) {
+        printf("The database is partitioned, so --paged is ignored.\n");
+    }
+    if (fileBytes(DATABASE_FILE) > 0) {
+        printf("%s is not used while %s holds the database.\n", DATABASE_FILE, PARTITION_DIRECTORY);
+    }
+
+    *count = partitionedLiveCars(partitions);
+    if (partitions->scheme == PARTITION_BY_YEAR) {
+        printf("Opened %d records in %d partitions of %d years; they are loaded when needed.\n", *count,
+               partitions->count, partitions->yearSpan);
+    } else {
+        printf("Opened %d records in %d partitions by brand; they are loaded when needed.\n", *count,
+               partitions->count);
+    }
+    double elapsed = monotonicSeconds() - started;
+    printf("Open time: %.3f ms.\n", elapsed * 1e3);
+    endSample(STAT_LOAD, started, partitionedBytes(partitions));
+    return 0;
+}
+
+/**
+ * @brief Splits the cars loaded from the base file into partitions under the requested scheme.
+ *
+ * The cars keep their numbers. Once the partitions and their manifest are written, the
+ * base file, its snapshot and its journal are deleted and the car set is freed; the layout
+ * is then opened like any other.
+ *
+ * @param set Pointer to the car database; NULL afterwards.
+ * @param count Pointer to the number of cars in the database.
+ */
+static void partitionLoadedCars(struct Cars **set, int *count) {
+    double started = beginSample();
+    partitions = createPartitionedCars(PARTITION_DIRECTORY, partitionScheme, partitionSpan);
+    if (*set) {
+        addPartitionedCars(partitions, *set);
+    }
+    size_t bytes;
+    if (savePartitionedCars(partitions, 0, &bytes) < 0) {
+        printf("Unable to write the partitions to %s; the database stays in %s.\n", PARTITION_DIRECTORY,
+               DATABASE_FILE);
+        closePartitionedCars(partitions);
+        partitions = NULL;
+        endSample(STAT_COMPACT, started, 0);
+        return;
+    }
+    countBytes(STAT_COMPACT, 0, bytes);
+
+    // A crash before this point leaves both layouts, and the partitions are opened next time.
+    remove(DATABASE_FILE);
+    remove(SNAPSHOT_FILE);
+    remove(JOURNAL_FILE);
+    destroyCarSet(*set);
+    *set = NULL;
+    reopenPartitions();
+    *count = partitionedLiveCars(partitions);
+    printf("Split %d records into %d partitions in %s.\n", *count, partitions->count, PARTITION_DIRECTORY);
+    endSample(STAT_COMPACT, started, partitionedBytes(partitions));
+}
+
 /**
  * @brief Reads cars from a file and initializes the car database.
  *
- * This function reads car data from a file named "base.txt". It dynamically allocates memory
- * for the car database, and each car is stored in a struct Cars array. The function keeps expanding
- * the memory as needed.
+ * This function first tries the binary snapshot "base.bin", which loads without parsing, and
+ * falls back to parsing "base.txt" when the snapshot is missing, damaged or older than the text
+ * file. The load time, throughput and memory used per record are reported once the cars are
+ * loaded. In paged mode (see setPagedMode()) "base.txt" is only indexed, and the car set
+ * stays NULL. When "base.parts" holds a partitioned layout only its manifest is read, and
+ * the car set stays NULL as well; a layout requested with setPartitioning() is put in place
+ * first.
  *
  * @param set Pointer to the car database.
  * @param count Pointer to the number of cars in the database.
  */
 void readCars(struct Cars **set, int *count) {
-    FILE *fptr = fopen("base.txt", "r");
-    if (!fptr) {
-        printf("Unable to open the file for reading.\n");
+    if (readPartitionedCars(count) == 0) {
+        *set = NULL;
+        return;
+    }
+    if (pagedLimit > 0 && readPagedCars(count) == 0) {
         *set = NULL;
-        *count = 0;
         return;
     }
 
-    int capacity = 1;
-    *set = (struct Cars *)malloc(capacity * sizeof(struct Cars));
+    double started = monotonicSeconds();
+    size_t bytes = 0;
+    const char *source = SNAPSHOT_FILE;
+
+    *set = readSnapshot(SNAPSHOT_FILE, DATABASE_FILE, &bytes);
     if (!*set) {
-        fprintf(stderr, "Memory allocation error.\n");
-        fclose(fptr);
-        exit(EXIT_FAILURE);
+        source = DATABASE_FILE;
+        *set = createCarSet();
+        if (readTextCars(DATABASE_FILE, *set, &bytes) != 0) {
+            printf("Unable to open the file for reading.\n");
+            destroyCarSet(*set);
+            *set = NULL;
+            *count = 0;
+            startJournal(&journal, DATABASE_FILE);
+            endSample(STAT_LOAD, started, 0);
+            if (partitionRequested && partitionScheme != PARTITION_NONE) {
+                partitionLoadedCars(set, count);
+            }
+            return;
+        }
     }
 
-    int i = 0;
-    while (fscanf(fptr, "%99s %99s %d %d %99s %99s %99s",
-                  (*set)[i].brand,
-                  (*set)[i].model,
-                  &(*set)[i].year,
-                  &(*set)[i].capacity,
-                  (*set)[i].fuel,
-                  (*set)[i].type,
-                  (*set)[i].registration) == 7) {
-        i++;
-        if (i >= capacity) {
-            capacity *= 2;
-            struct Cars *tmp = (struct Cars *)realloc(*set, capacity * sizeof(struct Cars));
-            if (!tmp) {
-                fprintf(stderr, "Memory reallocation error.\n");
-                free(*set);
-                fclose(fptr);
-                exit(EXIT_FAILURE);
+    startJournal(&journal, DATABASE_FILE);
+    int replayed = replayJournal(&journal, JOURNAL_FILE, *set);
+    if (statsEnabled) {
+        countBytes(STAT_LOAD, bytes + (replayed >= 0 ? fileBytes(JOURNAL_FILE) : 0), 0);
+    }
+    reportReplay(replayed);
+
+    *count = liveCars(*set);
+    printf("Loaded %d records from the file.\n", *count);
+
+    double elapsed = monotonicSeconds() - started;
+    if (elapsed > 0.0) {
+        printf("Load time: %.3f ms from %s (%.1f MB/s, %.0f records/s).\n",
+               elapsed * 1e3, source, (double)bytes / elapsed / 1e6, (double)*count / elapsed);
+    }
+    if (*count > 0) {
+        printf("Storage: %.1f bytes per record (%d bytes per record in the fixed-size layout).\n",
+               (double)carSetBytes(*set) / *count, (int)FIXED_RECORD_BYTES);
+    }
+    endSample(STAT_LOAD, started, carSetBytes(*set));
+    if (partitionRequested && partitionScheme != PARTITION_NONE) {
+        partitionLoadedCars(set, count);
+    }
+}
+
+/**
+ * @brief Returns the prefix trie of the brand or model column, building it on first use.
+ *
+ * When @p report is set and the trie is built by this call, how much memory it takes is
+ * printed next to the strings it indexes; the suggestions made while a car is entered
+ * build it quietly, so the prompt is not interrupted.
+ *
+ * @param set Car set holding the cars.
+ * @param field FIELD_BRAND or FIELD_MODEL.
+ * @param report Non-zero to print the size of a newly built trie.
+ * @return The trie.
+ */
+static const struct PrefixTrie *prefixTrie(struct Cars *set, enum QueryField field, int report) {
+    struct PrefixTrie *trie = field == FIELD_BRAND ? &set->brandPrefixes : &set->modelPrefixes;
+    if (trie->valid) {
+        return trie;
+    }
+
+    refreshPrefixTrie(set, trie, field == FIELD_BRAND ? set->brand : set->model);
+    if (!report) {
+        return trie;
+    }
+    struct PrefixFootprint footprint;
+    measurePrefixTrie(trie, &footprint);
+    printf("Built the %s prefix index: %d values in %d nodes, %.1f KB of trie and %.1f KB of postings "
+           "for %.1f KB of %s strings.\n",
+           field == FIELD_BRAND ? "brand" : "model", footprint.values, footprint.nodes, footprint.trieBytes / 1e3,
+           footprint.postingBytes / 1e3, footprint.rawBytes / 1e3, field == FIELD_BRAND ? "brand" : "model");
+    return trie;
+}
+
+/**
+ * @struct Suggestions
+ * @brief Values printed as suggestions for a new brand or model.
+ */
+struct Suggestions {
+    int shown;  ///< Values printed so far.
+};
+
+/**
+ * @brief Prints one suggested value, up to PREFIX_SUGGESTIONS of them.
+ * @param value The value.
+ * @param node Trie node of the value.
+ * @param context The suggestions printed so far.
+ */
+static void printSuggestion(const char *value, const struct PrefixNode *node, void *context) {
+    struct Suggestions *suggestions = (struct Suggestions *)context;
+    if (suggestions->shown < PREFIX_SUGGESTIONS) {
+        printf("%s%s (%d)", suggestions->shown > 0 ? ", " : "", value, node->cars);
+    }
+    suggestions->shown++;
+}
+
+/**
+ * @brief Points out that a brand or model is new to the database, with the existing values
+ *        that start the same way, to catch typing mistakes.
+ * @param set Car set holding the cars.
+ * @param field FIELD_BRAND or FIELD_MODEL.
+ * @param value Value entered.
+ */
+static void suggestValues(struct Cars *set, enum QueryField field, const char *value) {
+    if (liveCars(set) == 0) {
+        return;
+    }
+    const struct PrefixTrie *trie = prefixTrie(set, field, 0);
+    if (countValue(trie, value) > 0) {
+        return;
+    }
+
+    const char *name = field == FIELD_BRAND ? "brand" : "model";
+    char prefix[MAX_FIELD_LENGTH + 1];
+    size_t shared = sharedPrefix(trie, value);
+    if (shared == 0) {
+        printf("No car has this %s yet.\n", name);
+        return;
+    }
+    snprintf(prefix, sizeof prefix, "%.*s", (int)shared, value);
+
+    struct Suggestions suggestions = {0};
+    printf("No car has this %s yet; %ss starting with \"%s\": ", name, name, prefix);
+    visitPrefix(trie, prefix, printSuggestion, &suggestions);
+    if (suggestions.shown > PREFIX_SUGGESTIONS) {
+        printf(" and %d more", suggestions.shown - PREFIX_SUGGESTIONS);
+    }
+    printf(".\n");
+}
+
+/**
+ * @struct PagedMatch
+ * @brief A query streamed over the paged base file until its first match.
+ */
+struct PagedMatch {
+    const struct QueryNode *query;  ///< The query.
+    int found;                      ///< Non-zero once a car matched.
+};
+
+/**
+ * @brief Stops a stream at the first car matching a query.
+ * @param set Car set holding the car.
+ * @param row Row of the car.
+ * @param context The PagedMatch.
+ * @return Zero once the car matches, to stop the stream.
+ */
+static int stopAtMatch(const struct Cars *set, int row, void *context) {
+    struct PagedMatch *match = (struct PagedMatch *)context;
+    match->found = matchesQuery(set, match->query, row);
+    return !match->found;
+}
+
+/**
+ * @brief Checks whether a car with a registration number is already in the database.
+ *
+ * In paged mode the base file has no index, so it is streamed up to the first match. A
+ * partitioned database has no statistics on registration numbers, so every partition is
+ * loaded and its hash index looked up.
+ *
+ * @param set Car set new cars are appended to (NULL while partitioned).
+ * @param registration Registration number.
+ * @return Non-zero if the registration number is taken.
+ */
+static int registrationTaken(const struct Cars *set, const char *registration) {
+    if (partitions) {
+        for (int i = 0; i < partitions->count; i++) {
+            if (findRegistrations(loadPartition(partitions, i), registration, NULL, 0) > 0) {
+                return 1;
             }
-            *set = tmp;
         }
+        return 0;
     }
-
-    *count = i;
-    printf("Loaded %d records from the file.\n", i);
-    fclose(fptr);
+    if (findRegistrations(set, registration, NULL, 0) > 0) {
+        return 1;
+    }
+    if (!pagedCars) {
+        return 0;
+    }
+    struct QueryNode *query = stringPredicate(FIELD_REGISTRATION, QUERY_EXACT, registration);
+    struct PagedMatch match = {query, 0};
+    streamPagedCars(pagedCars, stopAtMatch, &match);
+    freeQuery(query);
+    return match.found;
 }
 
 /**
  * @brief Adds a new car to the database.
  *
- * This function adds a new car to the car database. It dynamically reallocates memory to accommodate
- * the new car entry.
+ * This function reads the new car from the user and appends it to the columns of the car database,
+ * which grow geometrically as needed. Registration numbers already in the database are rejected
+ * with a single hash index lookup. A brand or model no car has yet is pointed out, with the
+ * existing ones that start the same way, from the prefix tries (see car_prefix.h). In paged
+ * mode the car joins the cars added after the base file, and the base file is streamed to
+ * check the registration number; brands and models are not checked. A partitioned database
+ * adds the car to the partition of its year or brand, and does not check brands and models
+ * either.
  *
  * @param set Pointer to the car database.
  * @param count Pointer to the number of cars in the database.
  */
 void addCar(struct Cars **set, int *count) {
-    int i = *count;
+    char brand[MAX_FIELD_LENGTH + 1], model[MAX_FIELD_LENGTH + 1], fuel[MAX_FIELD_LENGTH + 1];
+    char type[MAX_FIELD_LENGTH + 1], registration[MAX_FIELD_LENGTH + 1];
+    struct CarRecord car;
 
-    struct Cars *tmp = (struct Cars *)realloc(*set, (*count + 1) * sizeof(struct Cars));
-    if (!tmp) {
-        fprintf(stderr, "Memory allocation error.\n");
-        exit(EXIT_FAILURE);
+    if (!pagedCars && !partitions && !*set) {
+        *set = createCarSet();
     }
-    *set = tmp;
+    struct Cars *target = pagedCars ? pagedCars->added : *set;
 
-    printf("This will be car number %d\n", i + 1);
+    printf("This will be car number %d\n", partitions ? partitions->nextId : nextCarId(target));
 
     printf("Enter brand: ");
-    scanf("%99s", (*set)[i].brand);
+    scanf("%99s", brand);
+    if (target && !pagedCars) {
+        suggestValues(target, FIELD_BRAND, brand);
+    }
 
     printf("Enter model: ");
-    scanf("%99s", (*set)[i].model);
+    scanf("%99s", model);
+    if (target && !pagedCars) {
+        suggestValues(target, FIELD_MODEL, model);
+    }
 
     printf("Enter year: ");
-    while (scanf("%d", &(*set)[i].year) != 1) {
+    while (scanf("%d", &car.year) != 1) {
         printf("Invalid input. Please enter a valid year: ");
         while (getchar() != '\n');
     }
 
     printf("Enter capacity: ");
-    while (scanf("%d", &(*set)[i].capacity) != 1) {
+    while (scanf("%d", &car.capacity) != 1) {
         printf("Invalid input. Please enter a valid capacity: ");
         while (getchar() != '\n');
     }
 
     printf("Enter fuel: ");
-    scanf("%99s", (*set)[i].fuel);
+    scanf("%99s", fuel);
 
     printf("Enter vehicle type: ");
-    scanf("%99s", (*set)[i].type);
+    scanf("%99s", type);
 
     printf("Enter registration number: ");
-    scanf("%99s", (*set)[i].registration);
+    while (scanf("%99s", registration) == 1 && registrationTaken(target, registration)) {
+        printf("A car with registration number %s already exists. Enter another registration number: ",
+               registration);
+    }
+
+    car.brand = brand;
+    car.model = model;
+    car.fuel = fuel;
+    car.type = type;
+    car.registration = registration;
+    double started = beginSample();
+    if (partitions) {
+        addPartitionedCar(partitions, &car);
+        *count = partitionedLiveCars(partitions);
+        endSample(STAT_ADD, started, partitionedBytes(partitions));
+        return;
+    }
+    appendCar(target, &car);
+    syncIndexes(target);
+    journalAdd(&journal, &car);
+
+    *count = pagedCars ? pagedLiveCars(pagedCars) : liveCars(target);
+    endSample(STAT_ADD, started, carSetBytes(target));
+}
+
+/**
+ * @brief Prints a list of matched cars through the buffered renderer.
+ *
+ * This is an internal helper function used to display the results of
+ * every search in a consistent format, honoring the listing offset and limit.
+ *
+ * @param set Car set holding the cars.
+ * @param rows Rows of the cars; their record IDs are displayed as the car numbers.
+ * @param matches Number of rows.
+ */
+static void printCars(const struct Cars *set, const int *rows, int matches) {
+    struct CarOutput output;
+    beginOutput(&output);
+    for (int i = 0; i < matches; i++) {
+        if (!outputCar(&output, set, rows[i])) {
+            break;
+        }
+    }
+    endOutput(&output);
+}
+
+/**
+ * @brief Renders one car of a paged listing.
+ * @param set Car set holding the car.
+ * @param row Row of the car.
+ * @param context The CarOutput.
+ * @return Zero once the limit is reached, to stop the listing.
+ */
+static int outputVisited(const struct Cars *set, int row, void *context) {
+    return outputCar((struct CarOutput *)context, set, row);
+}
+
+/**
+ * @struct PagedSearch
+ * @brief A query streamed over the paged base file, printing its matches.
+ */
+struct PagedSearch {
+    const struct QueryNode *query;  ///< The query.
+    struct CarOutput output;        ///< Listing of the matches.
+    long matched;                   ///< Cars matched so far.
+};
+
+/**
+ * @brief Prints one car of a paged search if it matches.
+ * @param set Car set holding the car.
+ * @param row Row of the car.
+ * @param context The PagedSearch.
+ * @return Zero once the limit is reached, to stop the stream.
+ */
+static int outputMatch(const struct Cars *set, int row, void *context) {
+    struct PagedSearch *search = (struct PagedSearch *)context;
+    if (!matchesQuery(set, search->query, row)) {
+        return 1;
+    }
+    search->matched++;
+    return outputCar(&search->output, set, row);
+}
+
+/**
+ * @brief Streams a query over the paged base file and prints the matching cars in car-number order.
+ *
+ * The file is read sequentially from the start, and the stream stops as soon as the
+ * listing limit is reached.
+ *
+ * @param query Query to run (freed).
+ */
+static void printPagedQuery(struct QueryNode *query) {
+    double started = beginSample();
+    struct PagedSearch search = {query, {0, 0, 0}, 0};
+    beginOutput(&search.output);
+    long examined = streamPagedCars(pagedCars, outputMatch, &search);
+    endOutput(&search.output);
+    if (examined < 0) {
+        printf("Unable to read %s to the end.\n", DATABASE_FILE);
+    }
+    countRows(STAT_SEARCH, examined, search.matched);
+    freeQuery(query);
+    endSample(STAT_SEARCH, started, 0);
+}
+
+/**
+ * @brief Prints the cars of a listing merged from several partitions.
+ * @param cars The cars, in listing order.
+ * @param count Number of cars.
+ */
+static void printPartitionRows(const struct PartitionRow *cars, int count) {
+    struct CarOutput output;
+    beginOutput(&output);
+    for (int i = 0; i < count; i++) {
+        if (!outputCar(&output, cars[i].set, cars[i].row)) {
+            break;
+        }
+    }
+    endOutput(&output);
+}
+
+/**
+ * @brief Frees the rows and ranks of the per-partition listings of a search.
+ * @param lists The listings (freed as well).
+ * @param count Number of listings.
+ */
+static void freePartitionMatches(struct PartitionMatches *lists, int count) {
+    for (int i = 0; i < count; i++) {
+        free(lists[i].rows);
+        free(lists[i].ranks);
+    }
+    free(lists);
+}
+
+/**
+ * @brief Allocates one listing per partition for a search.
+ * @return The listings, zeroed.
+ */
+static struct PartitionMatches *allocPartitionMatches(void) {
+    struct PartitionMatches *lists =
+        (struct PartitionMatches *)calloc((size_t)(partitions->count > 0 ? partitions->count : 1), sizeof *lists);
+    if (!lists) {
+        fprintf(stderr, "Memory allocation error.\n");
+        exit(EXIT_FAILURE);
+    }
+    return lists;
+}
+
+/**
+ * @brief Lists the cars of one loaded partition that match a query, as printQuery() would for a whole set.
+ *
+ * Without a listing order the rows are in car-number order; with one, only the first rows
+ * up to the end of the shown page are kept, in that order.
+ *
+ * @param partition The partition.
+ * @param query The query, or NULL for every live car.
+ * @param rows Receives a malloc'd array of the rows (NULL when empty).
+ * @param examined Receives the number of rows examined.
+ * @return Number of rows listed.
+ */
+static int queryPartition(struct Partition *partition, struct QueryNode *query, int **rows, long *examined) {
+    const struct Cars *set = partition->cars;
+    int matches;
+    if (!query && !listingOrder.active) {
+        long keep = outputWindow();
+        int live = liveCars(set);
+        int wanted = keep > 0 && keep < live ? (int)keep : live;
+        *rows = (int *)malloc((size_t)(wanted > 0 ? wanted : 1) * sizeof **rows);
+        if (!*rows) {
+            fprintf(stderr, "Memory allocation error.\n");
+            exit(EXIT_FAILURE);
+        }
+        matches = 0;
+        for (int row = nextLiveRow(set, 0); row < set->rows && matches < wanted; row = nextLiveRow(set, row + 1)) {
+            (*rows)[matches++] = row;
+        }
+        *examined = matches;
+        return matches;
+    }
+    if (!listingOrder.active) {
+        return cachedQuery(&partition->cache, set, query, rows, examined);
+    }
+    if (query && (matches = findCachedQuery(&partition->cache, set, query, rows, examined)) >= 0) {
+        return selectOrderedRows(set, &listingOrder, *rows, matches, outputWindow());
+    }
+    return runOrderedQuery(set, query, &listingOrder, outputWindow(), rows, examined);
+}
+
+/**
+ * @brief Runs a query over a partitioned database and prints the matching cars.
+ *
+ * Partitions whose statistics rule the query out are skipped without being loaded; the
+ * others are loaded if needed and searched one by one, each with its own query cache, and
+ * their listings are merged in car-number order or in the listing order.
+ *
+ * @param query Query to run (freed), or NULL to list every car.
+ * @param operation Operation the statistics are recorded under.
+ */
+static void printPartitionedQuery(struct QueryNode *query, enum StatOperation operation) {
+    double started = beginSample();
+    struct PartitionMatches *lists = allocPartitionMatches();
+    int searched = 0;
+    long examined = 0, matched = 0;
+    for (int i = 0; i < partitions->count; i++) {
+        struct Partition *partition = &partitions->partitions[i];
+        if (!partitionMayMatch(partition, query)) {
+            countPartitionEvent(PARTITION_SKIPPED);
+            continue;
+        }
+        struct PartitionMatches *list = &lists[searched++];
+        long scanned = 0;
+        list->set = loadPartition(partitions, i);
+        list->count = queryPartition(partition, query, &list->rows, &scanned);
+        examined += scanned;
+        matched += list->count;
+        countPartitionEvent(PARTITION_SEARCHED);
+    }
+
+    struct PartitionRow *cars;
+    int listed = mergePartitionMatches(lists, searched, &listingOrder, outputWindow(), &cars);
+    countRows(operation, examined, matched);
+    printPartitionRows(cars, listed);
+    free(cars);
+    freePartitionMatches(lists, searched);
+    if (query) {
+        printf("Searched %d of %d partitions; %d skipped by their statistics.\n", searched, partitions->count,
+               partitions->count - searched);
+        freeQuery(query);
+    }
+    endSample(operation, started, 0);
+}
+
+/**
+ * @brief Runs a query and prints the matching cars, in car-number order or in the listing order.
+ *
+ * The query engine picks between the indexes and a parallel scan (see car_query.h), so
+ * every search prints the same cars whichever path answers it. A search repeated while the
+ * cars have not changed, or one narrower than a recent search, is answered from the query
+ * cache (see car_cache.h). With a listing order and a limit, only the cars up to the end of
+ * the shown page are selected (see car_order.h); such a partial result is not cached. In
+ * paged mode the query is streamed over the base file instead, and a partitioned database
+ * searches only the partitions the query may match.
+ *
+ * @param set Car set holding the cars.
+ * @param query Query to run (freed).
+ */
+static void printQuery(const struct Cars *set, struct QueryNode *query) {
+    if (pagedCars) {
+        printPagedQuery(query);
+        return;
+    }
+    if (partitions) {
+        printPartitionedQuery(query, STAT_SEARCH);
+        return;
+    }
+
+    double started = beginSample();
+    int *rows;
+    long examined;
+    int matches;
+    if (!listingOrder.active) {
+        matches = cachedQuery(&queryCache, set, query, &rows, &examined);
+    } else if ((matches = findCachedQuery(&queryCache, set, query, &rows, &examined)) >= 0) {
+        matches = selectOrderedRows(set, &listingOrder, rows, matches, outputWindow());
+    } else {
+        matches = runOrderedQuery(set, query, &listingOrder, outputWindow(), &rows, &examined);
+    }
+    countRows(STAT_SEARCH, examined, matches);
+    printCars(set, rows, matches);
+    free(rows);
+    freeQuery(query);
+    endSample(STAT_SEARCH, started, 0);
+}
+
+/**
+ * @brief Prints the cars of a partitioned database whose registration number is within an edit distance of a plate.
+ *
+ * Registration numbers have no partition statistics, so every partition is searched with
+ * its own BK-tree, and the listings are merged by distance and then car number.
+ *
+ * @param plate Registration number as read.
+ * @param maxDistance Largest number of edits accepted.
+ * @param distances Receives a malloc'd array of the edit distance of each car, closest first (NULL when empty).
+ * @param examined Receives the number of registration numbers compared.
+ * @return Number of matching cars.
+ */
+static int printPartitionedPlates(const char *plate, int maxDistance, int **distances, long *examined) {
+    struct PartitionMatches *lists = allocPartitionMatches();
+    *examined = 0;
+    for (int i = 0; i < partitions->count; i++) {
+        long compared = 0;
+        struct Cars *set = loadPartition(partitions, i);
+        lists[i].set = set;
+        lists[i].count = findSimilarPlates(set, plate, maxDistance, &lists[i].rows, &lists[i].ranks, &compared);
+        *examined += compared;
+    }
+
+    struct PartitionRow *cars;
+    int matches = mergePartitionMatches(lists, partitions->count, NULL, 0, &cars);
+    printPartitionRows(cars, matches);
+    *distances = matches > 0 ? (int *)malloc((size_t)matches * sizeof **distances) : NULL;
+    if (matches > 0 && !*distances) {
+        fprintf(stderr, "Memory allocation error.\n");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < matches; i++) {
+        (*distances)[i] = cars[i].rank;
+    }
+    free(cars);
+    freePartitionMatches(lists, partitions->count);
+    return matches;
+}
+
+/**
+ * @brief Prints the cars whose registration number is within an edit distance of a plate, closest first.
+ *
+ * The candidates come from the BK-tree on the registration column (see car_fuzzy.h), which
+ * is built by the first such search. The listing is ranked by distance whatever the listing
+ * order, and ends with the number of cars found at each distance. A partitioned database
+ * searches each partition and merges the results.
+ *
+ * @param set Car set holding the cars.
+ * @param plate Registration number as read.
+ * @param maxDistance Largest number of edits accepted.
+ */
+static void printSimilarPlates(struct Cars *set, const char *plate, int maxDistance) {
+    if (pagedCars) {
+        printf("Approximate registration search needs the cars in memory; start the program without --paged.\n");
+        return;
+    }
+
+    double started = beginSample();
+    int *rows, *distances;
+    long examined;
+    int matches;
+    if (partitions) {
+        matches = printPartitionedPlates(plate, maxDistance, &distances, &examined);
+    } else {
+        matches = findSimilarPlates(set, plate, maxDistance, &rows, &distances, &examined);
+        printCars(set, rows, matches);
+        free(rows);
+    }
+    countRows(STAT_SEARCH, examined, matches);
+
+    printf("Cars by number of differing characters:");
+    for (int distance = 0, i = 0; distance <= maxDistance; distance++) {
+        int first = i;
+        while (i < matches && distances[i] == distance) {
+            i++;
+        }
+        printf(" %d: %d%s", distance, i - first, distance < maxDistance ? "," : "\n");
+    }
+    free(distances);
+    endSample(STAT_SEARCH, started, 0);
+}
+
+/**
+ * @brief Orders rows or record IDs for qsort().
+ * @param a First row.
+ * @param b Second row.
+ * @return Negative, zero or positive as @p a is below, equal to or above @p b.
+ */
+static int compareRows(const void *a, const void *b) {
+    int x = *(const int *)a, y = *(const int *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @struct PrefixListing
+ * @brief Values and rows gathered by a prefix search.
+ */
+struct PrefixListing {
+    const struct Cars *set;  ///< Car set searched.
+    int values;              ///< Values visited so far.
+    int *rows;               ///< Rows of the live cars with the values visited.
+    int count;               ///< Number of rows.
+};
+
+/**
+ * @brief Prints one value of a prefix search, up to PREFIX_VALUES_SHOWN of them, and gathers its cars.
+ * @param value The value.
+ * @param node Trie node of the value.
+ * @param context The listing.
+ */
+static void gatherPrefix(const char *value, const struct PrefixNode *node, void *context) {
+    struct PrefixListing *listing = (struct PrefixListing *)context;
+    if (listing->values++ < PREFIX_VALUES_SHOWN) {
+        printf("  %s: %d\n", value, node->cars);
+    }
+    for (int i = 0; i < node->count; i++) {
+        if (!isDeadRow(listing->set, node->rows[i])) {
+            listing->rows[listing->count++] = node->rows[i];
+        }
+    }
+}
+
+/**
+ * @struct PrefixValue
+ * @brief A brand or model found by a prefix search of one partition, with its number of cars there.
+ */
+struct PrefixValue {
+    char *value;  ///< The value (owned).
+    int cars;     ///< Cars with the value.
+};
+
+/**
+ * @struct PrefixValues
+ * @brief Values and rows gathered by a prefix search of one partition after another.
+ */
+struct PrefixValues {
+    struct PrefixValue *values;  ///< Values of all partitions searched so far, unmerged.
+    int count;                   ///< Number of values.
+    int allocated;               ///< Number of values there is room for.
+    struct PrefixListing rows;   ///< Rows of the partition being searched.
+};
+
+/**
+ * @brief Collects one value of a prefix search of a partition, with its cars.
+ * @param value The value.
+ * @param node Trie node of the value.
+ * @param context The PrefixValues.
+ */
+static void collectPrefix(const char *value, const struct PrefixNode *node, void *context) {
+    struct PrefixValues *values = (struct PrefixValues *)context;
+    if (values->count == values->allocated) {
+        values->allocated = values->allocated > 0 ? values->allocated * 2 : 16;
+        struct PrefixValue *tmp =
+            (struct PrefixValue *)realloc(values->values, (size_t)values->allocated * sizeof *tmp);
+        if (!tmp) {
+            fprintf(stderr, "Memory allocation error.\n");
+            exit(EXIT_FAILURE);
+        }
+        values->values = tmp;
+    }
+    size_t length = strlen(value);
+    struct PrefixValue *entry = &values->values[values->count++];
+    entry->value = (char *)malloc(length + 1);
+    if (!entry->value) {
+        fprintf(stderr, "Memory allocation error.\n");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(entry->value, value, length + 1);
+    entry->cars = node->cars;
+
+    values->rows.values++;
+    for (int i = 0; i < node->count; i++) {
+        if (!isDeadRow(values->rows.set, node->rows[i])) {
+            values->rows.rows[values->rows.count++] = node->rows[i];
+        }
+    }
+}
+
+/**
+ * @brief Orders prefix search values by their text for qsort().
+ * @param a First value.
+ * @param b Second value.
+ * @return Negative, zero or positive as @p a sorts before, with or after @p b.
+ */
+static int comparePrefixValues(const void *a, const void *b) {
+    return strcmp(((const struct PrefixValue *)a)->value, ((const struct PrefixValue *)b)->value);
+}
+
+/**
+ * @brief Prints the brands or models of a partitioned database starting with a prefix, then their cars.
+ *
+ * Partitions none of whose values can start with the prefix are skipped without being
+ * loaded. The others are searched with their own prefix tries; the counts of a value found
+ * in several partitions are added up, and the cars are merged in car-number order or in the
+ * listing order.
+ *
+ * @param field FIELD_BRAND or FIELD_MODEL.
+ * @param prefix Beginning of the value.
+ */
+static void printPartitionedPrefix(enum QueryField field, const char *prefix) {
+    double started = beginSample();
+    struct PartitionMatches *lists = allocPartitionMatches();
+    struct PrefixValues values = {NULL, 0, 0, {NULL, 0, NULL, 0}};
+    int searched = 0;
+    long matched = 0;
+    for (int i = 0; i < partitions->count; i++) {
+        if (!partitionMayStartWith(&partitions->partitions[i], field, prefix)) {
+            countPartitionEvent(PARTITION_SKIPPED);
+            continue;
+        }
+        struct Cars *set = loadPartition(partitions, i);
+        struct PrefixTrie *trie = field == FIELD_BRAND ? &set->brandPrefixes : &set->modelPrefixes;
+        if (!trie->valid) {
+            refreshPrefixTrie(set, trie, field == FIELD_BRAND ? set->brand : set->model);
+        }
+        int rows = countPrefix(trie, prefix);
+        values.rows.set = set;
+        values.rows.count = 0;
+        values.rows.rows = (int *)malloc((size_t)(rows > 0 ? rows : 1) * sizeof *values.rows.rows);
+        if (!values.rows.rows) {
+            fprintf(stderr, "Memory allocation error.\n");
+            exit(EXIT_FAILURE);
+        }
+        visitPrefix(trie, prefix, collectPrefix, &values);
+
+        // Postings are ascending per value; the values interleave.
+        struct PartitionMatches *list = &lists[searched++];
+        qsort(values.rows.rows, (size_t)values.rows.count, sizeof *values.rows.rows, compareRows);
+        list->set = set;
+        list->rows = values.rows.rows;
+        list->count = values.rows.count;
+        matched += list->count;
+        if (listingOrder.active) {
+            list->count = selectOrderedRows(set, &listingOrder, list->rows, list->count, outputWindow());
+        }
+        countPartitionEvent(PARTITION_SEARCHED);
+    }
+
+    // The same value may come from several partitions.
+    qsort(values.values, (size_t)values.count, sizeof *values.values, comparePrefixValues);
+    int distinct = 0;
+    for (int i = 0; i < values.count; i++) {
+        if (distinct > 0 && strcmp(values.values[distinct - 1].value, values.values[i].value) == 0) {
+            values.values[distinct - 1].cars += values.values[i].cars;
+            free(values.values[i].value);
+        } else {
+            values.values[distinct++] = values.values[i];
+        }
+    }
+
+    const char *name = field == FIELD_BRAND ? "brand" : "model";
+    printf("%s starting with \"%s\":\n", field == FIELD_BRAND ? "Brands" : "Models", prefix);
+    for (int i = 0; i < distinct && i < PREFIX_VALUES_SHOWN; i++) {
+        printf("  %s: %d\n", values.values[i].value, values.values[i].cars);
+    }
+    if (distinct > PREFIX_VALUES_SHOWN) {
+        printf("  ... and %d more\n", distinct - PREFIX_VALUES_SHOWN);
+    }
+    printf("%d %s%s, %ld cars.\n", distinct, name, distinct == 1 ? "" : "s", matched);
+
+    struct PartitionRow *cars;
+    int listed = mergePartitionMatches(lists, searched, &listingOrder, outputWindow(), &cars);
+    countRows(STAT_SEARCH, matched, matched);
+    printPartitionRows(cars, listed);
+    printf("Searched %d of %d partitions; %d skipped by their statistics.\n", searched, partitions->count,
+           partitions->count - searched);
+    free(cars);
+    freePartitionMatches(lists, searched);
+    for (int i = 0; i < distinct; i++) {
+        free(values.values[i].value);
+    }
+    free(values.values);
+    endSample(STAT_SEARCH, started, 0);
+}
 
-    (*count)++;
+/**
+ * @brief Prints the brands or models starting with a prefix, with their counts, then their cars.
+ *
+ * The values, their counts and their cars come from the prefix trie of the column (see
+ * car_prefix.h), built by the first such search, so the columns are not scanned. The cars
+ * are listed in car-number order, or in the listing order.
+ *
+ * @param set Car set holding the cars.
+ * @param field FIELD_BRAND or FIELD_MODEL.
+ * @param prefix Beginning of the value.
+ */
+static void printPrefix(struct Cars *set, enum QueryField field, const char *prefix) {
+    if (pagedCars) {
+        printf("Searching by the beginning of a name needs the cars in memory; start the program without --paged.\n");
+        return;
+    }
+    if (partitions) {
+        printPartitionedPrefix(field, prefix);
+        return;
+    }
+
+    double started = beginSample();
+    const struct PrefixTrie *trie = prefixTrie(set, field, 1);
+    const char *name = field == FIELD_BRAND ? "brand" : "model";
+    struct PrefixListing listing = {set, 0, NULL, 0};
+    int matches = countPrefix(trie, prefix);
+    listing.rows = (int *)malloc((size_t)(matches > 0 ? matches : 1) * sizeof *listing.rows);
+    if (!listing.rows) {
+        fprintf(stderr, "Memory allocation error.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    printf("%s starting with \"%s\":\n", field == FIELD_BRAND ? "Brands" : "Models", prefix);
+    visitPrefix(trie, prefix, gatherPrefix, &listing);
+    if (listing.values > PREFIX_VALUES_SHOWN) {
+        printf("  ... and %d more\n", listing.values - PREFIX_VALUES_SHOWN);
+    }
+    printf("%d %s%s, %d cars.\n", listing.values, name, listing.values == 1 ? "" : "s", listing.count);
+
+    // Postings are ascending per value; the values interleave.
+    qsort(listing.rows, (size_t)listing.count, sizeof *listing.rows, compareRows);
+    matches = listing.count;
+    if (listingOrder.active) {
+        matches = selectOrderedRows(set, &listingOrder, listing.rows, matches, outputWindow());
+    }
+    countRows(STAT_SEARCH, listing.count, listing.count);
+    printCars(set, listing.rows, matches);
+    free(listing.rows);
+    endSample(STAT_SEARCH, started, 0);
 }
 
 /**
- * @brief Prints details of a single car.
+ * @brief Records an imported car in the journal.
+ * @param car The imported car.
+ * @param context The journal.
+ */
+static void journalImported(const struct CarRecord *car, void *context) {
+    journalAdd((struct Journal *)context, car);
+}
+
+/**
+ * @brief Imports cars in bulk from a CSV, TSV or base.txt-format file.
  *
- * This is an internal helper function used to display
- * all fields of a single car in a consistent format.
+ * The imported cars are journaled like cars added through the menu, so saving afterwards
+ * keeps them. Malformed rows are reported and skipped. A partitioned database has no journal
+ * and is not imported into.
  *
- * @param car Pointer to the car to print.
- * @param index Zero-based index of the car in the array (used to display car number).
+ * @param set Pointer to the car database.
+ * @param count Pointer to the number of cars in the database.
+ * @param path File to import.
+ * @param format Format name ("csv", "tsv" or "text"), or NULL to go by the file extension.
+ * @return 0 on success, -1 if the format is unknown or the file cannot be read.
  */
-static void printCar(const struct Cars *car, int index) {
-    printf("\nCar number: %d\n", index + 1);
-    printf("Brand: %s\n", car->brand);
-    printf("Model: %s\n", car->model);
-    printf("Year: %d\n", car->year);
-    printf("Engine capacity: %d cm^3\n", car->capacity);
-    printf("Fuel: %s\n", car->fuel);
-    printf("Vehicle type: %s\n", car->type);
-    printf("Registration number: %s\n", car->registration);
+int importFile(struct Cars **set, int *count, const char *path, const char *format) {
+    enum ImportFormat layout = importFormatForPath(path);
+    if (format && parseImportFormat(format, &layout) != 0) {
+        printf("Unknown import format: %s\n", format);
+        return -1;
+    }
+    if (partitions) {
+        printf("Importing into a partitioned database is not supported; merge it back with --partition none first.\n");
+        return -1;
+    }
+
+    if (!*set) {
+        *set = createCarSet();
+    }
+
+    double started = beginSample();
+    struct ImportStats stats;
+    if (importCars(path, layout, *set, journalImported, &journal, &stats) != 0) {
+        printf("Unable to open the file for reading.\n");
+        *count = liveCars(*set);
+        return -1;
+    }
+    *count = liveCars(*set);
+    countRows(STAT_IMPORT, stats.imported + stats.rejected, stats.imported);
+    countBytes(STAT_IMPORT, stats.bytes, 0);
+    endSample(STAT_IMPORT, started, carSetBytes(*set));
+
+    if (stats.rejected > IMPORT_REPORTED_REJECTS) {
+        printf("... and %ld more rejected rows.\n", stats.rejected - IMPORT_REPORTED_REJECTS);
+    }
+    printf("Imported %ld records from %s, rejected %ld.\n", stats.imported, path, stats.rejected);
+    if (stats.seconds > 0.0) {
+        printf("Import time: %.3f ms (%.1f MB/s, %.0f rows/s).\n", stats.seconds * 1e3,
+               (double)stats.bytes / stats.seconds / 1e6, (double)(stats.imported + stats.rejected) / stats.seconds);
+    }
+    return 0;
 }
 
 /**
@@ -139,6 +1221,10 @@ static void printCar(const struct Cars *car, int index) {
  *
  * This function prints information about each car in the car database, including its number, brand,
  * model, year, engine capacity, fuel type, vehicle type, and registration number.
+ * The listing goes through the buffered renderer, so the offset, limit, compact layout and
+ * order set on the command line apply to it. In paged mode a listing with a limit reads only
+ * the pages it shows, through the page cache, and a full listing streams the base file. A
+ * partitioned database loads every partition and merges their listings.
  *
  * @param set Pointer to the car database (not modified).
  * @param count Number of cars in the database.
@@ -150,43 +1236,260 @@ void showCars(const struct Cars *set, int count) {
     }
 
     printf("List of cars in the database:\n");
+    if (partitions) {
+        printPartitionedQuery(NULL, STAT_SHOW);
+        printf("\n");
+        return;
+    }
 
-    for (int i = 0; i < count; i++) {
-        printCar(&set[i], i);
+    double started = beginSample();
+    if (pagedCars) {
+        // A page of the listing is read through the page cache; the whole list is streamed.
+        struct CarOutput output;
+        long streamed = 0;
+        beginOutput(&output);
+        if (outputWindow() > 0) {
+            // The pager skips the offset itself, without reading the pages it passes over.
+            output.skipped = visitPagedCars(pagedCars, outputOffset(), outputVisited, &output);
+        } else {
+            streamed = streamPagedCars(pagedCars, outputVisited, &output);
+        }
+        endOutput(&output);
+        if (streamed < 0) {
+            printf("Unable to read %s to the end.\n", DATABASE_FILE);
+        }
+        countRows(STAT_SHOW, output.skipped + output.shown, output.shown);
+    } else if (listingOrder.active) {
+        int *rows;
+        long examined;
+        int listed = runOrderedQuery(set, NULL, &listingOrder, outputWindow(), &rows, &examined);
+        countRows(STAT_SHOW, examined, listed);
+        printCars(set, rows, listed);
+        free(rows);
+    } else {
+        struct CarOutput output;
+        beginOutput(&output);
+        for (int row = nextLiveRow(set, 0); row < set->rows; row = nextLiveRow(set, row + 1)) {
+            if (!outputCar(&output, set, row)) {
+                break;
+            }
+        }
+        endOutput(&output);
+        countRows(STAT_SHOW, output.skipped + output.shown, output.shown);
     }
+    endSample(STAT_SHOW, started, 0);
 
     printf("\n");
 }
 
+/**
+ * @brief Sets the order of the car list and of search results.
+ * @param order The order; an inactive order lists cars in car-number order.
+ */
+void setListingOrder(const struct CarOrder *order) {
+    listingOrder = *order;
+}
+
+/**
+ * @brief Makes readCars() open "base.txt" in paged mode, for files larger than the memory available.
+ *
+ * Only an index of where each page of cars begins is built; cars are read through a
+ * bounded page cache when they are listed or removed, and searches stream over the file
+ * (see car_paged.h). The fleet summary, prefix and approximate searches and the listing
+ * order need every car in memory and are not available.
+ *
+ * @param memoryLimit Memory the program should stay within, in bytes; 0 loads the file whole.
+ */
+void setPagedMode(size_t memoryLimit) {
+    pagedLimit = memoryLimit;
+}
+
+/**
+ * @brief Makes readCars() put the database in a partitioned layout, or back into one base file.
+ *
+ * A database in "base.txt" is split into partitions in "base.parts", a partitioned one is
+ * repartitioned if its scheme differs, and PARTITION_NONE merges the partitions back into
+ * "base.txt". Without a call the database is read in whichever layout it is stored.
+ *
+ * @param scheme The layout.
+ * @param yearSpan Years per partition when partitioning by year.
+ */
+void setPartitioning(enum PartitionScheme scheme, int yearSpan) {
+    partitionScheme = scheme;
+    partitionSpan = yearSpan;
+    partitionRequested = 1;
+}
+
 /**
  * @brief Saves the car database to a file.
  *
- * This function saves the car database to a file named "base.txt". It writes the details of each
- * car to the file.
+ * This function appends the changes made since the last save to the journal "base.journal".
+ * If the journal cannot be used, for example because "base.txt" does not exist yet, the whole
+ * database is written with compactDatabase() instead. A partitioned database rewrites the
+ * files of the partitions whose cars changed, and then its manifest.
  *
- * @param set Pointer to the car database (not modified).
+ * @param set Pointer to the car database.
  * @param count Number of cars in the database.
  */
-void saveCars(const struct Cars *set, int count) {
-    FILE *fptr = fopen("base.txt", "w");
-    if (!fptr) {
+void saveCars(struct Cars *set, int count) {
+    double started = beginSample();
+    if (partitions) {
+        size_t bytes;
+        int total = partitions->count;
+        int written = savePartitionedCars(partitions, 0, &bytes);
+        if (written < 0) {
+            printf("Unable to write the partitions to %s.\n", PARTITION_DIRECTORY);
+        } else {
+            printf("Rewrote %d of %d partitions.\n", written, total);
+            countBytes(STAT_SAVE, 0, bytes);
+        }
+        endSample(STAT_SAVE, started, 0);
+        return;
+    }
+    size_t pending = journal.pendingBytes;
+
+    // Appending the changes is enough while the journal still applies to the base file.
+    if (flushJournal(&journal, JOURNAL_FILE, DATABASE_FILE) != 0) {
+        compactDatabase(set, count);
+    } else {
+        countBytes(STAT_SAVE, 0, pending);
+    }
+    endSample(STAT_SAVE, started, 0);
+}
+
+/**
+ * @brief Rewrites the paged base file without its removed cars and with the added ones, then reopens it.
+ *
+ * The live cars are streamed into a new file, which then replaces the old one. The snapshot
+ * would still hold the old cars, so it is deleted.
+ */
+static void compactPagedCars(void) {
+    const char *temporary = DATABASE_FILE ".new";
+    if (writePagedCars(pagedCars, temporary) != 0) {
+        printf("Unable to open the file for writing.\n");
+        remove(temporary);
+        return;
+    }
+    closePagedCars(pagedCars);
+    pagedCars = NULL;
+    if (replaceFile(temporary, DATABASE_FILE) != 0) {
+        fprintf(stderr, "Unable to replace %s with %s.\n", DATABASE_FILE, temporary);
+        exit(EXIT_FAILURE);
+    }
+    // The journal is stamped with the old base; compactDatabase() says when it could still apply.
+    remove(JOURNAL_FILE);
+    startJournal(&journal, DATABASE_FILE);
+    remove(SNAPSHOT_FILE);
+    if (statsEnabled) {
+        countBytes(STAT_COMPACT, 0, fileBytes(DATABASE_FILE));
+    }
+    pagedCars = openPagedCars(DATABASE_FILE, pagedLimit);
+    if (!pagedCars) {
+        fprintf(stderr, "Unable to reopen %s.\n", DATABASE_FILE);
+        exit(EXIT_FAILURE);
+    }
+}
+
+/**
+ * @brief Rewrites the database file and its snapshot, folding the journal into them.
+ *
+ * Removed cars are purged first. Afterwards the cars are numbered 1, 2, 3, ... again, as
+ * they will be when the file is loaded next time. In paged mode the file is rewritten by
+ * streaming over it, and no snapshot is written. A partitioned database numbers its cars
+ * again in the same order and rewrites every partition.
+ *
+ * @param set Pointer to the car database.
+ * @param count Number of cars in the database.
+ */
+void compactDatabase(struct Cars *set, int count) {
+    (void)count;  // The set knows its own size.
+    double started = beginSample();
+    if (pagedCars) {
+        compactPagedCars();
+        endSample(STAT_COMPACT, started, pagedIndexBytes(pagedCars));
+        return;
+    }
+    if (partitions) {
+        size_t bytes;
+        renumberPartitionedCars(partitions);
+        if (savePartitionedCars(partitions, 1, &bytes) < 0) {
+            printf("Unable to write the partitions to %s.\n", PARTITION_DIRECTORY);
+        } else {
+            countBytes(STAT_COMPACT, 0, bytes);
+        }
+        endSample(STAT_COMPACT, started, partitionedBytes(partitions));
+        return;
+    }
+    if (set) {
+        purgeCars(set);
+    }
+    if (writeTextCars(DATABASE_FILE, set) != 0) {
         printf("Unable to open the file for writing.\n");
         return;
     }
 
-    for (int j = 0; j < count; j++) {
-        fprintf(fptr, "%s\n%s\n%d\n%d\n%s\n%s\n%s%s",
-                set[j].brand,
-                set[j].model,
-                set[j].year,
-                set[j].capacity,
-                set[j].fuel,
-                set[j].type,
-                set[j].registration,
-                (j == count - 1) ? "" : "\n");
+    // Until the journal is removed, a crash leaves it next to the new base, stamped with the
+    // size and nanosecond modification time of the old one. It is then applied only if the
+    // new base has the same size and was written in the same file system clock tick.
+    remove(JOURNAL_FILE);
+    startJournal(&journal, DATABASE_FILE);
+
+    if (set && writeSnapshot(SNAPSHOT_FILE, set, DATABASE_FILE) != 0) {
+        printf("Unable to write the snapshot file.\n");
+    }
+    if (statsEnabled) {
+        countBytes(STAT_COMPACT, 0, fileBytes(DATABASE_FILE) + (set ? fileBytes(SNAPSHOT_FILE) : 0));
+    }
+    if (set) {
+        renumberCars(set);
+    }
+    endSample(STAT_COMPACT, started, set ? carSetBytes(set) : 0);
+}
+
+/**
+ * @brief Displays the fleet summary: counts per brand, fuel, type and year, with year and capacity statistics.
+ *
+ * The first call computes the aggregates in one pass over the columns; from then on adding
+ * and removing cars keeps them up to date, so later calls only print them. A partitioned
+ * database keeps aggregates per partition and adds them up.
+ *
+ * @param set Pointer to the car database.
+ * @param count Number of cars in the database.
+ */
+void showSummary(struct Cars *set, int count) {
+    if (count == 0) {
+        printf("No cars in the database.\n");
+        return;
+    }
+    if (pagedCars) {
+        printf("The fleet summary needs the cars in memory; start the program without --paged.\n");
+        return;
+    }
+
+    double started = beginSample();
+    if (partitions) {
+        struct Aggregates total;
+        long computed = 0;
+        memset(&total, 0, sizeof total);
+        for (int i = 0; i < partitions->count; i++) {
+            struct Cars *part = loadPartition(partitions, i);
+            computed += part->aggregates.valid ? 0 : liveCars(part);
+            mergeAggregates(&total, refreshAggregates(part));
+        }
+        countRows(STAT_SUMMARY, computed, total.cars);
+        printAggregates(&total);
+        freeAggregates(&total);
+        endSample(STAT_SUMMARY, started, 0);
+        printf("\n");
+        return;
     }
+    int computed = set->aggregates.valid;
+    const struct Aggregates *aggregates = refreshAggregates(set);
+    countRows(STAT_SUMMARY, computed ? 0 : liveCars(set), aggregates->cars);
+    printAggregates(aggregates);
+    endSample(STAT_SUMMARY, started, 0);
 
-    fclose(fptr);
+    printf("\n");
 }
 
 /**
@@ -200,14 +1503,19 @@ void saveCars(const struct Cars *set, int count) {
  * 5. Fuel
  * 6. Vehicle Type
  * 7. Registration Number
+ * 9. Several criteria, written as a query (see car_query.h)
  *
- * For each criterion, the user can choose to search for an exact match or a partial match.
+ * For each single criterion, the user can choose to search for an exact match or a partial match.
+ * Brands and models can also be searched by their beginning, which lists the matching values
+ * with their counts first, and registration numbers approximately, for plates that may have
+ * been misread. In paged mode the searches stream over the base file, and the prefix and
+ * approximate searches are not available.
  *
- * @param set Pointer to the car database (not modified).
+ * @param set Pointer to the car database; only its prefix tries and registration BK-tree may be built.
  * @param count Number of cars in the database.
  * @param choice User's choice for the search criterion.
  */
-void search(const struct Cars *set, int count, char choice) {
+void search(struct Cars *set, int count, char choice) {
     if (count == 0) {
         printf("No cars in the database.\n");
         return;
@@ -218,9 +1526,9 @@ void search(const struct Cars *set, int count, char choice) {
 
     switch (choice) {
         case '1': {  // Brand
-            printf("Choose 1 if you want to search for the entire entered name, or 2 if you only know a part:\n");
+            printf("Choose 1 if you want to search for the entire entered name, 2 if you only know a part, or 3 if you know how it begins:\n");
             if (scanf("%d", &searchOption) != 1) {
-                printf("Invalid option. You should have chosen 1 or 2!\n");
+                printf("Invalid option. You should have chosen 1, 2 or 3!\n");
                 while (getchar() != '\n');
                 break;
             }
@@ -229,26 +1537,26 @@ void search(const struct Cars *set, int count, char choice) {
                 printf("Enter the entire brand name:\n");
             } else if (searchOption == 2) {
                 printf("Enter a part of the brand name:\n");
+            } else if (searchOption == 3) {
+                printf("Enter the beginning of the brand name:\n");
             } else {
-                printf("Invalid option. You should have chosen 1 or 2!\n");
+                printf("Invalid option. You should have chosen 1, 2 or 3!\n");
                 break;
             }
 
             scanf("%99s", searchTerm);
-
-            for (int i = 0; i < count; i++) {
-                if ((searchOption == 1 && strcmp(set[i].brand, searchTerm) == 0) ||
-                    (searchOption == 2 && strstr(set[i].brand, searchTerm) != NULL)) {
-                    printCar(&set[i], i);
-                }
+            if (searchOption == 3) {
+                printPrefix(set, FIELD_BRAND, searchTerm);
+                break;
             }
+            printQuery(set, stringPredicate(FIELD_BRAND, searchOption == 1 ? QUERY_EXACT : QUERY_CONTAINS, searchTerm));
             break;
         }
 
         case '2': {  // Model
-            printf("Choose 1 if you want to search for the entire entered name, or 2 if you only know a part:\n");
+            printf("Choose 1 if you want to search for the entire entered name, 2 if you only know a part, or 3 if you know how it begins:\n");
             if (scanf("%d", &searchOption) != 1) {
-                printf("Invalid option. You should have chosen 1 or 2!\n");
+                printf("Invalid option. You should have chosen 1, 2 or 3!\n");
                 while (getchar() != '\n');
                 break;
             }
@@ -257,19 +1565,19 @@ void search(const struct Cars *set, int count, char choice) {
                 printf("Enter the entire model name:\n");
             } else if (searchOption == 2) {
                 printf("Enter a part of the model name:\n");
+            } else if (searchOption == 3) {
+                printf("Enter the beginning of the model name:\n");
             } else {
-                printf("Invalid option. You should have chosen 1 or 2!\n");
+                printf("Invalid option. You should have chosen 1, 2 or 3!\n");
                 break;
             }
 
             scanf("%99s", searchTerm);
-
-            for (int i = 0; i < count; i++) {
-                if ((searchOption == 1 && strcmp(set[i].model, searchTerm) == 0) ||
-                    (searchOption == 2 && strstr(set[i].model, searchTerm) != NULL)) {
-                    printCar(&set[i], i);
-                }
+            if (searchOption == 3) {
+                printPrefix(set, FIELD_MODEL, searchTerm);
+                break;
             }
+            printQuery(set, stringPredicate(FIELD_MODEL, searchOption == 1 ? QUERY_EXACT : QUERY_CONTAINS, searchTerm));
             break;
         }
 
@@ -307,11 +1615,10 @@ void search(const struct Cars *set, int count, char choice) {
                     }
                 }
 
-                for (int i = 0; i < count; i++) {
-                    if ((searchOption == 2 && set[i].year >= min && set[i].year <= max) ||
-                        (searchOption == 1 && set[i].year == year)) {
-                        printCar(&set[i], i);
-                    }
+                if (searchOption == 2) {
+                    printQuery(set, rangePredicate(FIELD_YEAR, min, max));
+                } else {
+                    printQuery(set, rangePredicate(FIELD_YEAR, year, year));
                 }
             } else {
                 printf("You should have chosen 1 or 2!\n");
@@ -353,11 +1660,10 @@ void search(const struct Cars *set, int count, char choice) {
                     }
                 }
 
-                for (int i = 0; i < count; i++) {
-                    if ((searchOption == 2 && set[i].capacity >= minCapacity && set[i].capacity <= maxCapacity) ||
-                        (searchOption == 1 && set[i].capacity == capacity)) {
-                        printCar(&set[i], i);
-                    }
+                if (searchOption == 2) {
+                    printQuery(set, rangePredicate(FIELD_CAPACITY, minCapacity, maxCapacity));
+                } else {
+                    printQuery(set, rangePredicate(FIELD_CAPACITY, capacity, capacity));
                 }
             } else {
                 printf("You should have chosen 1 or 2!\n");
@@ -385,12 +1691,7 @@ void search(const struct Cars *set, int count, char choice) {
             char fuel[50];
             scanf("%49s", fuel);
 
-            for (int i = 0; i < count; i++) {
-                if ((searchOption == 2 && strstr(set[i].fuel, fuel) != NULL) ||
-                    (searchOption == 1 && strcmp(set[i].fuel, fuel) == 0)) {
-                    printCar(&set[i], i);
-                }
-            }
+            printQuery(set, stringPredicate(FIELD_FUEL, searchOption == 1 ? QUERY_EXACT : QUERY_CONTAINS, fuel));
             break;
         }
 
@@ -414,19 +1715,14 @@ void search(const struct Cars *set, int count, char choice) {
             char type[50];
             scanf("%49s", type);
 
-            for (int i = 0; i < count; i++) {
-                if ((searchOption == 2 && strstr(set[i].type, type) != NULL) ||
-                    (searchOption == 1 && strcmp(set[i].type, type) == 0)) {
-                    printCar(&set[i], i);
-                }
-            }
+            printQuery(set, stringPredicate(FIELD_TYPE, searchOption == 1 ? QUERY_EXACT : QUERY_CONTAINS, type));
             break;
         }
 
         case '7': {  // Registration Number
-            printf("Choose 1 if you want to search for a full registration number, or 2 if you know only a part of it:\n");
+            printf("Choose 1 if you want to search for a full registration number, 2 if you know only a part of it, or 3 if some characters may be misread:\n");
             if (scanf("%d", &searchOption) != 1) {
-                printf("Invalid option. You should have chosen 1 or 2!\n");
+                printf("Invalid option. You should have chosen 1, 2 or 3!\n");
                 while (getchar() != '\n');
                 break;
             }
@@ -435,20 +1731,46 @@ void search(const struct Cars *set, int count, char choice) {
                 printf("Enter the full registration number:\n");
             } else if (searchOption == 2) {
                 printf("Enter the full registration number or a part of it:\n");
+            } else if (searchOption == 3) {
+                printf("Enter the registration number as read:\n");
             } else {
-                printf("Invalid option. You should have chosen 1 or 2!\n");
+                printf("Invalid option. You should have chosen 1, 2 or 3!\n");
                 break;
             }
 
             char reg[50];
             scanf("%49s", reg);
 
-            for (int i = 0; i < count; i++) {
-                if ((searchOption == 2 && strstr(set[i].registration, reg) != NULL) ||
-                    (searchOption == 1 && strcmp(set[i].registration, reg) == 0)) {
-                    printCar(&set[i], i);
+            if (searchOption == 3) {
+                int distance;
+                printf("Enter how many characters may be wrong, missing or extra (0-%d):\n", MAX_FUZZY_DISTANCE);
+                if (scanf("%d", &distance) != 1 || distance < 0 || distance > MAX_FUZZY_DISTANCE) {
+                    printf("Invalid number of characters.\n");
+                    while (getchar() != '\n');
+                    break;
                 }
+                printSimilarPlates(set, reg, distance);
+                break;
+            }
+
+            printQuery(set, stringPredicate(FIELD_REGISTRATION, searchOption == 1 ? QUERY_EXACT : QUERY_CONTAINS, reg));
+            break;
+        }
+
+        case '9': {  // Several criteria
+            printf("Enter the criteria, e.g. fuel = Diesel and year = 2015..2020 and (brand = Skoda or model ~ Golf):\n");
+            char line[512];
+            if (scanf(" %511[^\n]", line) != 1) {
+                break;
             }
+
+            char error[128];
+            struct QueryNode *query = parseQuery(line, error, sizeof error);
+            if (!query) {
+                printf("Invalid query: %s.\n", error);
+                break;
+            }
+            printQuery(set, query);
             break;
         }
 
@@ -460,11 +1782,48 @@ void search(const struct Cars *set, int count, char choice) {
 }
 
 /**
- * @brief Removes a car from the database based on the user-specified car number.
+ * @brief Forgets the results of earlier searches, so the next searches run against the cars again.
+ *
+ * Cached results are dropped on their own once the cars change; this is for measuring
+ * searches without the cache.
+ */
+void clearSearchCache(void) {
+    clearQueryCache(&queryCache);
+    for (int i = 0; partitions && i < partitions->count; i++) {
+        clearQueryCache(&partitions->partitions[i].cache);
+    }
+}
+
+/**
+ * @brief Checks whether there is a live car with a record ID.
+ *
+ * In paged mode the car's page is read through the page cache, and a partitioned database
+ * loads the partition the car belongs to.
  *
- * This function allows the user to remove a car from the database by specifying the car number.
- * The user is prompted to enter the car number they want to remove, and the function will remove
- * the corresponding car entry from the database. Memory is reallocated to adjust the size of the database.
+ * @param set Car set holding the cars (NULL in paged mode).
+ * @param id Record ID.
+ * @return Non-zero if the car exists.
+ */
+static int carExists(const struct Cars *set, int id) {
+    if (partitions) {
+        int partition, row;
+        return findPartitionedCar(partitions, id, &partition, &row) == 0;
+    }
+    if (pagedCars) {
+        const struct Cars *page;
+        int row;
+        return findPagedCar(pagedCars, id, &page, &row) == 0;
+    }
+    return findCarRow(set, id) >= 0;
+}
+
+/**
+ * @brief Removes cars from the database based on the user-specified car numbers.
+ *
+ * This function allows the user to remove cars from the database by specifying car numbers.
+ * The user is prompted to enter the car number they want to remove; further numbers on the
+ * same line are removed in the same call. Car numbers are record IDs, so the remaining cars
+ * keep their numbers.
  *
  * @param set Pointer to the car database.
  * @param count Pointer to the number of cars in the database.
@@ -479,9 +1838,7 @@ void removeCar(struct Cars **set, int *count) {
     int carNumberToRemove;
 
     while (1) {
-        if (scanf("%d", &carNumberToRemove) == 1 &&
-            carNumberToRemove > 0 &&
-            carNumberToRemove <= *count) {
+        if (scanf("%d", &carNumberToRemove) == 1 && carExists(*set, carNumberToRemove)) {
             break;
         } else {
             printf("Invalid input. Please enter a valid car number.\n");
@@ -489,35 +1846,130 @@ void removeCar(struct Cars **set, int *count) {
         }
     }
 
-    int j = carNumberToRemove - 1;
-    for (; j < *count - 1; j++) {
-        (*set)[j] = (*set)[j + 1];
+    int *ids = (int *)malloc(sizeof *ids);
+    if (!ids) {
+        fprintf(stderr, "Memory allocation error.\n");
+        exit(EXIT_FAILURE);
+    }
+    ids[0] = carNumberToRemove;
+    int selected = 1, allocated = 1;
+
+    // Further car numbers on the same line form one batch.
+    int c;
+    while ((c = getchar()) != '\n' && c != EOF) {
+        if (c == ' ' || c == '\t' || c == ',') {
+            continue;
+        }
+        ungetc(c, stdin);
+        if (scanf("%d", &carNumberToRemove) != 1) {
+            while ((c = getchar()) != '\n' && c != EOF);
+            break;
+        }
+        if (!carExists(*set, carNumberToRemove)) {
+            printf("There is no car number %d; it was skipped.\n", carNumberToRemove);
+            continue;
+        }
+        if (selected == allocated) {
+            allocated *= 2;
+            int *tmp = (int *)realloc(ids, (size_t)allocated * sizeof *tmp);
+            if (!tmp) {
+                fprintf(stderr, "Memory allocation error.\n");
+                exit(EXIT_FAILURE);
+            }
+            ids = tmp;
+        }
+        ids[selected++] = carNumberToRemove;
     }
 
-    (*count)--;
+    // Journal each car once, before a purge can move the rows.
+    double started = beginSample();
+    qsort(ids, (size_t)selected, sizeof *ids, compareRows);
+    int unique = 0;
+    for (int i = 0; i < selected; i++) {
+        if (unique == 0 || ids[unique - 1] != ids[i]) {
+            ids[unique++] = ids[i];
+            if (!partitions) {
+                journalRemove(&journal, ids[i]);
+            }
+        }
+    }
+    selected = unique;
 
-    if (*count == 0) {
-        free(*set);
-        *set = NULL;
-        return;
+    int removed = 0;
+    size_t memory;
+    if (partitions) {
+        for (int i = 0; i < selected; i++) {
+            removed += removePartitionedCar(partitions, ids[i]) == 0;
+        }
+        *count = partitionedLiveCars(partitions);
+        memory = partitionedBytes(partitions);
+    } else if (pagedCars) {
+        for (int i = 0; i < selected; i++) {
+            removed += removePagedCar(pagedCars, ids[i]) == 0;
+        }
+        *count = pagedLiveCars(pagedCars);
+        memory = pagedIndexBytes(pagedCars) + pagedCars->cacheBytes;
+    } else {
+        // Rows ascend with record IDs, so the rows come out sorted.
+        for (int i = 0; i < selected; i++) {
+            ids[i] = findCarRow(*set, ids[i]);
+        }
+        removed = eraseCars(*set, ids, selected);
+        *count = liveCars(*set);
+        memory = carSetBytes(*set);
+    }
+    free(ids);
+    if (removed > 1) {
+        printf("Removed %d cars.\n", removed);
     }
+    endSample(STAT_REMOVE, started, memory);
+}
 
-    struct Cars *tmp = (struct Cars *)realloc(*set, *count * sizeof **set);
-    if (!tmp) {
-        fprintf(stderr, "Memory reallocation error.\n");
-        exit(EXIT_FAILURE);
+/**
+ * @brief Serves the car database to clients over a Unix domain socket, then saves the changes they made.
+ *
+ * The server runs until a client sends SHUTDOWN or the process gets SIGINT or SIGTERM.
+ * Cars added and removed by clients are journaled like changes made through the menu and
+ * saved once the server has stopped. A partitioned database is not served.
+ *
+ * @param set Pointer to the car database.
+ * @param count Pointer to the number of cars in the database.
+ * @param socketPath Path of the socket.
+ * @return 0 when the server stopped normally, -1 if it could not start.
+ */
+int serveDatabase(struct Cars **set, int *count, const char *socketPath) {
+    if (partitions) {
+        printf("Serving a partitioned database is not supported; merge it back with --partition none first.\n");
+        return -1;
+    }
+    clearQueryCache(&queryCache);
+    if (serveCars(set, socketPath, &journal) != 0) {
+        printf("Unable to serve the database on %s.\n", socketPath);
+        return -1;
     }
-    *set = tmp;
+    *count = liveCars(*set);
+    saveCars(*set, *count);
+    return 0;
 }
 
 /**
  * @brief Frees the memory allocated for the car database.
  *
- * This function frees the memory allocated for the car database array.
+ * This function frees the columns and the string heap of the car database, closes the base
+ * file if it is open in paged mode, frees the partitions of a partitioned database, and
+ * stops the search worker threads.
  * It should be called before exiting the program to avoid memory leaks.
  *
  * @param set Pointer to the car database.
  */
 void freeCarArray(struct Cars *set) {
-    free(set);
+    stopScanPool();
+    closePagedCars(pagedCars);
+    pagedCars = NULL;
+    closePartitionedCars(partitions);
+    partitions = NULL;
+    clearQueryCache(&queryCache);
+    freeJournal(&journal);
+    freeOutputBuffer();
+    destroyCarSet(set);
 }
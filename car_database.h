@@ -6,19 +6,10 @@
 #ifndef CAR_DATABASE_H
 #define CAR_DATABASE_H
 
-/**
- * @struct Cars
- * @brief Structure representing a car with various attributes.
- */
-struct Cars {
-    char brand[100];         ///< Brand of the car.
-    char model[100];         ///< Model of the car.
-    int year;                ///< Year of manufacture.
-    int capacity;            ///< Engine capacity in cm^3.
-    char fuel[100];          ///< Type of fuel used.
-    char type[100];          ///< Type of the vehicle.
-    char registration[100];  ///< Registration number of the car.
-};
+#include "car_partition.h"
+#include "car_store.h"
+
+struct CarOrder;
 
 /**
  * @brief Reads cars from a file and initializes the car database.
@@ -34,6 +25,16 @@ void readCars(struct Cars **set, int *count);
  */
 void addCar(struct Cars **set, int *count);
 
+/**
+ * @brief Imports cars in bulk from a CSV, TSV or base.txt-format file.
+ * @param set Pointer to the car database.
+ * @param count Pointer to the number of cars in the database.
+ * @param path File to import.
+ * @param format Format name ("csv", "tsv" or "text"), or NULL to go by the file extension.
+ * @return 0 on success, -1 if the format is unknown or the file cannot be read.
+ */
+int importFile(struct Cars **set, int *count, const char *path, const char *format);
+
 /**
  * @brief Displays information about cars in the database.
  * @param set Pointer to the car database.
@@ -41,12 +42,45 @@ void addCar(struct Cars **set, int *count);
  */
 void showCars(const struct Cars *set, int count);
 
+/**
+ * @brief Sets the order of the car list and of search results.
+ * @param order The order; an inactive order lists cars in car-number order.
+ */
+void setListingOrder(const struct CarOrder *order);
+
+/**
+ * @brief Makes readCars() open "base.txt" in paged mode, for files larger than the memory available.
+ * @param memoryLimit Memory the program should stay within, in bytes; 0 loads the file whole.
+ */
+void setPagedMode(size_t memoryLimit);
+
+/**
+ * @brief Makes readCars() put the database in a partitioned layout, or back into one base file.
+ * @param scheme The layout; PARTITION_NONE merges the partitions back into "base.txt".
+ * @param yearSpan Years per partition when partitioning by year.
+ */
+void setPartitioning(enum PartitionScheme scheme, int yearSpan);
+
 /**
  * @brief Saves the car database to a file.
  * @param set Pointer to the car database.
  * @param count Number of cars in the database.
  */
-void saveCars(const struct Cars *set, int count);
+void saveCars(struct Cars *set, int count);
+
+/**
+ * @brief Rewrites the database file and its snapshot, folding the journal into them.
+ * @param set Pointer to the car database.
+ * @param count Number of cars in the database.
+ */
+void compactDatabase(struct Cars *set, int count);
+
+/**
+ * @brief Displays the fleet summary: counts per brand, fuel, type and year, with year and capacity statistics.
+ * @param set Pointer to the car database.
+ * @param count Number of cars in the database.
+ */
+void showSummary(struct Cars *set, int count);
 
 /**
  * @brief Searches for cars in the database based on a specified parameter.
@@ -54,15 +88,29 @@ void saveCars(const struct Cars *set, int count);
  * @param count Number of cars in the database.
  * @param choice Parameter for searching (e.g., brand, model, year).
  */
-void search(const struct Cars *set, int count, char choice);
+void search(struct Cars *set, int count, char choice);
 
 /**
- * @brief Removes a car from the database.
+ * @brief Forgets the results of earlier searches, so the next searches run against the cars again.
+ */
+void clearSearchCache(void);
+
+/**
+ * @brief Removes one or more cars from the database.
  * @param set Pointer to the car database.
  * @param count Pointer to the number of cars in the database.
  */
 void removeCar(struct Cars **set, int *count);
 
+/**
+ * @brief Serves the car database to clients over a Unix domain socket, then saves the changes they made.
+ * @param set Pointer to the car database.
+ * @param count Pointer to the number of cars in the database.
+ * @param socketPath Path of the socket.
+ * @return 0 when the server stopped normally, -1 if it could not start.
+ */
+int serveDatabase(struct Cars **set, int *count, const char *socketPath);
+
 /**
  * @brief Frees the memory allocated for the car database.
  * @param set Pointer to the car database.
@@ -0,0 +1,499 @@
+/**
+ * @file car_fuzzy.c
+ * @brief Implementation of the BK-tree on registration numbers.
+ */
+
+#include "car_fuzzy.h"
+#include "car_store.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** Longest pattern Myers' algorithm handles in one machine word. */
+#define WORD_BITS 64
+
+/**
+ * @struct EditPattern
+ * @brief A string prepared for computing its edit distance to many others.
+ *
+ * @c masks holds, for every byte value, the positions at which it occurs in the pattern.
+ * Only the entries of the pattern's own bytes are ever non-zero, and releasePattern()
+ * clears them again, so one zeroed pattern can be prepared over and over cheaply.
+ */
+struct EditPattern {
+    const char *text;     ///< The pattern.
+    size_t length;        ///< Length of the pattern.
+    uint64_t masks[256];  ///< Occurrence bitmask of every byte (patterns of up to WORD_BITS bytes only).
+};
+
+/**
+ * @struct PlateItem
+ * @brief A key waiting to be placed while the tree is built.
+ */
+struct PlateItem {
+    unsigned int key;  ///< Offset of the key in BkTree::keys.
+    int row;           ///< Row of the car.
+};
+
+/**
+ * @struct PlateMatch
+ * @brief A matching row and its distance, while the results are ranked.
+ */
+struct PlateMatch {
+    int distance;  ///< Edit distance to the searched plate.
+    int row;       ///< Row of the car.
+};
+
+/**
+ * @brief Reallocates an array, exiting the program when memory runs out.
+ * @param array Array to resize (may be NULL).
+ * @param size New size in bytes.
+ * @return The resized array.
+ */
+static void *resizeArray(void *array, size_t size) {
+    void *tmp = realloc(array, size ? size : 1);
+    if (!tmp) {
+        fprintf(stderr, "Memory allocation error.\n");
+        exit(EXIT_FAILURE);
+    }
+    return tmp;
+}
+
+/**
+ * @brief Prepares a pattern.
+ * @param pattern Pattern whose masks are all zero.
+ * @param text The pattern's string.
+ * @param length Length of the string.
+ */
+static void preparePattern(struct EditPattern *pattern, const char *text, size_t length) {
+    pattern->text = text;
+    pattern->length = length;
+    if (length <= WORD_BITS) {
+        for (size_t i = 0; i < length; i++) {
+            pattern->masks[(unsigned char)text[i]] |= (uint64_t)1 << i;
+        }
+    }
+}
+
+/**
+ * @brief Clears the masks set by preparePattern(), so the pattern can be prepared again.
+ * @param pattern Prepared pattern.
+ */
+static void releasePattern(struct EditPattern *pattern) {
+    if (pattern->length <= WORD_BITS) {
+        for (size_t i = 0; i < pattern->length; i++) {
+            pattern->masks[(unsigned char)pattern->text[i]] = 0;
+        }
+    }
+}
+
+/**
+ * @brief Computes the edit distance with the textbook dynamic program, one row at a time.
+ *
+ * Only used for patterns longer than WORD_BITS characters.
+ *
+ * @param a First string.
+ * @param aLength Length of @p a.
+ * @param b Second string.
+ * @param bLength Length of @p b.
+ * @return Edit distance.
+ */
+static int tableDistance(const char *a, size_t aLength, const char *b, size_t bLength) {
+    int *row = (int *)resizeArray(NULL, (aLength + 1) * sizeof *row);
+    for (size_t i = 0; i <= aLength; i++) {
+        row[i] = (int)i;
+    }
+    for (size_t j = 1; j <= bLength; j++) {
+        int diagonal = row[0];
+        row[0] = (int)j;
+        for (size_t i = 1; i <= aLength; i++) {
+            int above = row[i];
+            int best = diagonal + (a[i - 1] != b[j - 1]);
+            if (above + 1 < best) {
+                best = above + 1;
+            }
+            if (row[i - 1] + 1 < best) {
+                best = row[i - 1] + 1;
+            }
+            row[i] = best;
+            diagonal = above;
+        }
+    }
+    int distance = row[aLength];
+    free(row);
+    return distance;
+}
+
+/**
+ * @brief Computes the edit distance between a prepared pattern and a string.
+ *
+ * Myers' algorithm keeps one column of the dynamic programming table as two bit vectors of
+ * the differences between neighbouring cells (+1 and -1), so each character of @p text
+ * updates the whole column with a handful of word operations; the distance is tracked in the
+ * last cell.
+ *
+ * @param pattern Prepared pattern.
+ * @param text String to compare with.
+ * @param length Length of @p text.
+ * @return Edit distance.
+ */
+static int patternDistance(const struct EditPattern *pattern, const char *text, size_t length) {
+    if (pattern->length == 0) {
+        return (int)length;
+    }
+    if (pattern->length > WORD_BITS) {
+        return tableDistance(pattern->text, pattern->length, text, length);
+    }
+
+    uint64_t last = (uint64_t)1 << (pattern->length - 1);
+    uint64_t plus = ~(uint64_t)0, minus = 0;
+    int distance = (int)pattern->length;
+    for (size_t i = 0; i < length; i++) {
+        uint64_t equal = pattern->masks[(unsigned char)text[i]];
+        uint64_t vertical = equal | minus;
+        uint64_t horizontal = (((equal & plus) + plus) ^ plus) | equal;
+        uint64_t up = minus | ~(horizontal | plus);
+        uint64_t down = plus & horizontal;
+        if (up & last) {
+            distance++;
+        } else if (down & last) {
+            distance--;
+        }
+        // The first row of the table grows by one per character, hence the carried-in 1.
+        up = (up << 1) | 1;
+        down <<= 1;
+        plus = down | ~(vertical | up);
+        minus = up & vertical;
+    }
+    return distance;
+}
+
+/**
+ * @brief Returns the edit distance between two strings: the fewest inserted, deleted or
+ *        replaced characters that turn one into the other.
+ * @param a First string.
+ * @param aLength Length of @p a.
+ * @param b Second string.
+ * @param bLength Length of @p b.
+ * @return Edit distance.
+ */
+int editDistance(const char *a, size_t aLength, const char *b, size_t bLength) {
+    struct EditPattern pattern;
+    memset(pattern.masks, 0, sizeof pattern.masks);
+    preparePattern(&pattern, a, aLength);
+    return patternDistance(&pattern, b, bLength);
+}
+
+/**
+ * @brief Queues a newly appended car for the BK-tree, if it has been built.
+ *
+ * The row is placed in the tree by the next rebuild; searches compare it on its own until then.
+ *
+ * @param tree Tree to update.
+ * @param row Row of the car.
+ */
+void appendPlate(struct BkTree *tree, int row) {
+    if (!tree->valid) {
+        return;
+    }
+    if (tree->pendingCount == tree->pendingAllocated) {
+        tree->pendingAllocated = tree->pendingAllocated ? tree->pendingAllocated * 2 : 64;
+        tree->pending = (int *)resizeArray(tree->pending, (size_t)tree->pendingAllocated * sizeof *tree->pending);
+    }
+    tree->pending[tree->pendingCount++] = row;
+}
+
+/**
+ * @brief Renumbers the rows of the BK-tree after a purge.
+ *
+ * The node of a purged car stays, since its key decided where its descendants went; it only
+ * stops being a match. Purged rows are dropped from the queue.
+ *
+ * @param tree Tree to update.
+ * @param map New row of every old row, or -1 for dead rows.
+ */
+void remapPlateTree(struct BkTree *tree, const int *map) {
+    if (!tree->valid) {
+        return;
+    }
+    for (int i = 0; i < tree->count; i++) {
+        struct BkNode *node = &tree->nodes[i];
+        if (node->row >= 0) {
+            node->row = map[node->row];
+            tree->purged += node->row < 0;
+        }
+    }
+    int kept = 0;
+    for (int i = 0; i < tree->pendingCount; i++) {
+        if (map[tree->pending[i]] >= 0) {
+            tree->pending[kept++] = map[tree->pending[i]];
+        }
+    }
+    tree->pendingCount = kept;
+}
+
+/**
+ * @brief Builds the tree over the live rows of a set, replacing what it held.
+ *
+ * The first key becomes the root, and the nodes are then filled in level order: the keys
+ * below a node are grouped by their distance to it with a stable counting sort, the first
+ * key of each group becomes a child, and the rest of the group waits below that child. Each
+ * key is thus compared once per level above it, with the node's key as the prepared pattern,
+ * and the children of every node end up consecutive and sorted by edge.
+ *
+ * @param set Car set to index.
+ * @param tree Tree to build.
+ */
+static void buildPlateTree(const struct Cars *set, struct BkTree *tree) {
+    freePlateTree(tree);
+    int count = liveCars(set);
+    size_t bytes = 0, longest = 0;
+    for (int row = nextLiveRow(set, 0); row < set->rows; row = nextLiveRow(set, row + 1)) {
+        bytes += set->registration[row].length + 1;
+        if (set->registration[row].length > longest) {
+            longest = set->registration[row].length;
+        }
+    }
+
+    // Ranges of the items still to be placed below each node: [start[i], end[i]).
+    struct PlateItem *items = (struct PlateItem *)resizeArray(NULL, (size_t)count * sizeof *items);
+    struct PlateItem *sorted = (struct PlateItem *)resizeArray(NULL, (size_t)count * sizeof *sorted);
+    int *distances = (int *)resizeArray(NULL, (size_t)count * sizeof *distances);
+    int *start = (int *)resizeArray(NULL, (size_t)count * sizeof *start);
+    int *end = (int *)resizeArray(NULL, (size_t)count * sizeof *end);
+    int *buckets = (int *)resizeArray(NULL, (longest + 2) * sizeof *buckets);
+    tree->keys = (char *)resizeArray(NULL, bytes);
+    tree->nodes = (struct BkNode *)resizeArray(NULL, (size_t)count * sizeof *tree->nodes);
+
+    size_t used = 0;
+    int n = 0;
+    for (int row = nextLiveRow(set, 0); row < set->rows; row = nextLiveRow(set, row + 1)) {
+        memcpy(tree->keys + used, carString(set, set->registration[row]), set->registration[row].length + 1);
+        items[n].key = (unsigned int)used;
+        items[n].row = row;
+        used += set->registration[row].length + 1;
+        n++;
+    }
+
+    struct EditPattern pattern;
+    memset(pattern.masks, 0, sizeof pattern.masks);
+    if (count > 0) {
+        tree->nodes[0].row = items[0].row;
+        tree->nodes[0].key = items[0].key;
+        tree->nodes[0].distance = 0;
+        start[0] = 1;
+        end[0] = count;
+        tree->count = 1;
+    }
+    for (int i = 0; i < tree->count; i++) {
+        struct BkNode *node = &tree->nodes[i];
+        node->child = tree->count;
+        node->children = 0;
+        int low = start[i], high = end[i];
+        if (high <= low) {
+            continue;
+        }
+
+        const char *key = tree->keys + node->key;
+        preparePattern(&pattern, key, strlen(key));
+        for (int j = low; j < high; j++) {
+            const char *other = tree->keys + items[j].key;
+            distances[j] = patternDistance(&pattern, other, strlen(other));
+        }
+        releasePattern(&pattern);
+        int nearest = distances[low], farthest = distances[low];
+        for (int j = low + 1; j < high; j++) {
+            nearest = distances[j] < nearest ? distances[j] : nearest;
+            farthest = distances[j] > farthest ? distances[j] : farthest;
+        }
+
+        for (int d = nearest; d <= farthest + 1; d++) {
+            buckets[d] = 0;
+        }
+        for (int j = low; j < high; j++) {
+            buckets[distances[j] + 1]++;
+        }
+        buckets[nearest] = low;
+        for (int d = nearest + 1; d <= farthest + 1; d++) {
+            buckets[d] += buckets[d - 1];
+        }
+        // buckets[d] is now where the group at distance d starts; fill it in order.
+        for (int j = low; j < high; j++) {
+            sorted[buckets[distances[j]]++] = items[j];
+        }
+        memcpy(items + low, sorted + low, (size_t)(high - low) * sizeof *items);
+
+        // After the fill, buckets[d] is where the group at distance d ends.
+        int first = low;
+        for (int d = nearest; d <= farthest; d++) {
+            if (buckets[d] == first) {
+                continue;
+            }
+            struct BkNode *child = &tree->nodes[tree->count];
+            child->row = items[first].row;
+            child->key = items[first].key;
+            child->distance = (unsigned short)d;
+            start[tree->count] = first + 1;
+            end[tree->count] = buckets[d];
+            tree->count++;
+            node->children++;
+            first = buckets[d];
+        }
+    }
+
+    free(items);
+    free(sorted);
+    free(distances);
+    free(start);
+    free(end);
+    free(buckets);
+    tree->valid = 1;
+}
+
+/**
+ * @brief Builds the BK-tree if it has not been built yet, or rebuilds it once enough cars are
+ *        queued or purged.
+ * @param set Car set to index.
+ * @return The tree of the set.
+ */
+const struct BkTree *refreshPlateTree(struct Cars *set) {
+    struct BkTree *tree = &set->plates;
+    if (!tree->valid || (long long)tree->pendingCount * PLATE_PENDING_FRACTION > tree->count ||
+        (long long)tree->purged * 2 > tree->count) {
+        buildPlateTree(set, tree);
+    }
+    return tree;
+}
+
+/**
+ * @brief Records a match if it is close enough and still live.
+ * @param set Car set being searched.
+ * @param row Row of the car.
+ * @param distance Its distance to the plate.
+ * @param maxDistance Largest distance accepted.
+ * @param matches Matches found so far (reallocated as needed).
+ * @param count Number of matches, advanced when one is added.
+ * @param allocated Number of matches there is room for.
+ */
+static void addMatch(const struct Cars *set, int row, int distance, int maxDistance, struct PlateMatch **matches,
+                     int *count, int *allocated) {
+    if (row < 0 || distance > maxDistance || isDeadRow(set, row)) {
+        return;
+    }
+    if (*count == *allocated) {
+        *allocated = *allocated ? *allocated * 2 : 16;
+        *matches = (struct PlateMatch *)resizeArray(*matches, (size_t)*allocated * sizeof **matches);
+    }
+    (*matches)[*count].distance = distance;
+    (*matches)[*count].row = row;
+    (*count)++;
+}
+
+/**
+ * @brief Orders matches for qsort(): by distance, then by row.
+ * @param a First match.
+ * @param b Second match.
+ * @return Negative, zero or positive as @p a ranks before, with or after @p b.
+ */
+static int compareMatches(const void *a, const void *b) {
+    const struct PlateMatch *x = (const struct PlateMatch *)a, *y = (const struct PlateMatch *)b;
+    if (x->distance != y->distance) {
+        return x->distance - y->distance;
+    }
+    return (x->row > y->row) - (x->row < y->row);
+}
+
+/**
+ * @brief Finds the live cars whose registration number is within an edit distance of a plate.
+ *
+ * The tree is walked from the root with an explicit stack. At a node at distance d from the
+ * plate, every key in the subtree of the child with edge e is at distance at least |d - e|,
+ * so only the children with d - k <= e <= d + k are visited; as the children are sorted by
+ * edge, that is one run of them. Queued rows are then compared one by one.
+ *
+ * @param set Car set to search; the BK-tree is built first if needed.
+ * @param plate Registration number as read.
+ * @param maxDistance Largest edit distance accepted, at most MAX_FUZZY_DISTANCE.
+ * @param rows Receives a malloc'd array of the matching rows, closest first and then in row
+ *             order (NULL when empty).
+ * @param distances Receives a malloc'd array of the edit distance of each row (NULL when empty).
+ * @param examined Receives the number of registration numbers compared (may be NULL).
+ * @return Number of matching rows.
+ */
+int findSimilarPlates(struct Cars *set, const char *plate, int maxDistance, int **rows, int **distances,
+                      long *examined) {
+    const struct BkTree *tree = refreshPlateTree(set);
+    struct EditPattern pattern;
+    memset(pattern.masks, 0, sizeof pattern.masks);
+    preparePattern(&pattern, plate, strlen(plate));
+
+    struct PlateMatch *matches = NULL;
+    int count = 0, allocated = 0;
+    long compared = 0;
+
+    int stackSize = 64, depth = 0;
+    int *stack = (int *)resizeArray(NULL, (size_t)stackSize * sizeof *stack);
+    if (tree->count > 0) {
+        stack[depth++] = 0;
+    }
+    while (depth > 0) {
+        const struct BkNode *node = &tree->nodes[stack[--depth]];
+        const char *key = tree->keys + node->key;
+        int distance = patternDistance(&pattern, key, strlen(key));
+        compared++;
+        addMatch(set, node->row, distance, maxDistance, &matches, &count, &allocated);
+
+        for (int child = node->child; child < node->child + node->children; child++) {
+            int edge = tree->nodes[child].distance;
+            if (edge > distance + maxDistance) {
+                break;
+            }
+            if (edge >= distance - maxDistance) {
+                if (depth == stackSize) {
+                    stackSize *= 2;
+                    stack = (int *)resizeArray(stack, (size_t)stackSize * sizeof *stack);
+                }
+                stack[depth++] = child;
+            }
+        }
+    }
+    free(stack);
+
+    for (int i = 0; i < tree->pendingCount; i++) {
+        int row = tree->pending[i];
+        int distance = patternDistance(&pattern, carString(set, set->registration[row]), set->registration[row].length);
+        compared++;
+        addMatch(set, row, distance, maxDistance, &matches, &count, &allocated);
+    }
+
+    if (examined) {
+        *examined = compared;
+    }
+    *rows = NULL;
+    *distances = NULL;
+    if (count == 0) {
+        return 0;
+    }
+
+    qsort(matches, (size_t)count, sizeof *matches, compareMatches);
+    *rows = (int *)resizeArray(NULL, (size_t)count * sizeof **rows);
+    *distances = (int *)resizeArray(NULL, (size_t)count * sizeof **distances);
+    for (int i = 0; i < count; i++) {
+        (*rows)[i] = matches[i].row;
+        (*distances)[i] = matches[i].distance;
+    }
+    free(matches);
+    return count;
+}
+
+/**
+ * @brief Releases the memory of a BK-tree and marks it as not built.
+ * @param tree Tree to release.
+ */
+void freePlateTree(struct BkTree *tree) {
+    free(tree->nodes);
+    free(tree->keys);
+    free(tree->pending);
+    memset(tree, 0, sizeof *tree);
+}
@@ -0,0 +1,117 @@
+/**
+ * @file car_fuzzy.h
+ * @brief Approximate search on registration numbers: a BK-tree under the edit distance.
+ *
+ * A misread plate (0 for O, 8 for B, a character dropped or doubled) is a few edits away
+ * from the real one. The BK-tree stores each registration number in a node, and each child
+ * under the edit distance between its key and its parent's. By the triangle inequality, a
+ * search for keys within distance k of a plate only has to descend into the children whose
+ * edge lies within k of the distance to the node, so a small k visits a small part of the
+ * tree instead of every plate. Distances are computed with Myers' bit-parallel algorithm,
+ * which handles one character of the compared key per step for plates of up to 64
+ * characters.
+ *
+ * The tree is built in one pass, level by level, so the children of a node are consecutive
+ * nodes sorted by edge, and the keys are copied next to each other in node order; a search
+ * reads memory in runs instead of chasing a pointer per node. Like the aggregates, the tree
+ * is built the first time it is needed and maintained from then on. Like the range indexes,
+ * it queues appended cars, which searches compare one by one, and is rebuilt with them
+ * once they make up 1/PLATE_PENDING_FRACTION of it. Removed cars stay in place and are
+ * skipped; purged cars keep their node, which still guides the search, until they make up
+ * half of the tree and it is rebuilt.
+ */
+
+#ifndef CAR_FUZZY_H
+#define CAR_FUZZY_H
+
+#include <stddef.h>
+
+struct Cars;
+
+/** Largest edit distance a fuzzy search accepts. */
+#define MAX_FUZZY_DISTANCE 8
+
+/** The tree is rebuilt once more than 1/PLATE_PENDING_FRACTION of its size is queued. */
+#define PLATE_PENDING_FRACTION 8
+
+/**
+ * @struct BkNode
+ * @brief One registration number in the BK-tree.
+ */
+struct BkNode {
+    int row;                  ///< Row of the car, or -1 once the car is purged.
+    unsigned int key;         ///< Offset of the NUL-terminated key in BkTree::keys.
+    int child;                ///< First child; the children are consecutive, by increasing edge.
+    unsigned short children;  ///< Number of children.
+    unsigned short distance;  ///< Edit distance between this key and the parent's (the edge).
+};
+
+/**
+ * @struct BkTree
+ * @brief BK-tree over the registration column, rooted at node 0, and the rows queued for it.
+ */
+struct BkTree {
+    int valid;              ///< Non-zero once built; maintained incrementally from then on.
+    struct BkNode *nodes;   ///< Nodes in level order (NULL until built).
+    int count;              ///< Number of nodes.
+    int purged;             ///< Nodes whose car was purged.
+    char *keys;             ///< Keys of the nodes.
+    int *pending;           ///< Rows appended since the tree was built.
+    int pendingCount;       ///< Number of pending rows.
+    int pendingAllocated;   ///< Number of pending rows there is room for.
+};
+
+/**
+ * @brief Returns the edit distance between two strings: the fewest inserted, deleted or
+ *        replaced characters that turn one into the other.
+ * @param a First string.
+ * @param aLength Length of @p a.
+ * @param b Second string.
+ * @param bLength Length of @p b.
+ * @return Edit distance.
+ */
+int editDistance(const char *a, size_t aLength, const char *b, size_t bLength);
+
+/**
+ * @brief Queues a newly appended car for the BK-tree, if it has been built.
+ * @param tree Tree to update.
+ * @param row Row of the car.
+ */
+void appendPlate(struct BkTree *tree, int row);
+
+/**
+ * @brief Renumbers the rows of the BK-tree after a purge.
+ * @param tree Tree to update.
+ * @param map New row of every old row, or -1 for dead rows.
+ */
+void remapPlateTree(struct BkTree *tree, const int *map);
+
+/**
+ * @brief Builds the BK-tree if it has not been built yet, or rebuilds it once enough cars are
+ *        queued or purged.
+ * @param set Car set to index.
+ * @return The tree of the set.
+ */
+const struct BkTree *refreshPlateTree(struct Cars *set);
+
+/**
+ * @brief Finds the live cars whose registration number is within an edit distance of a plate.
+ * @param set Car set to search; the BK-tree is built first if needed.
+ * @param plate Registration number as read.
+ * @param maxDistance Largest edit distance accepted, at most MAX_FUZZY_DISTANCE.
+ * @param rows Receives a malloc'd array of the matching rows, closest first and then in row
+ *             order (NULL when empty).
+ * @param distances Receives a malloc'd array of the edit distance of each row (NULL when empty).
+ * @param examined Receives the number of registration numbers compared (may be NULL).
+ * @return Number of matching rows.
+ */
+int findSimilarPlates(struct Cars *set, const char *plate, int maxDistance, int **rows, int **distances,
+                      long *examined);
+
+/**
+ * @brief Releases the memory of a BK-tree and marks it as not built.
+ * @param tree Tree to release.
+ */
+void freePlateTree(struct BkTree *tree);
+
+#endif // CAR_FUZZY_H
@@ -0,0 +1,248 @@
+/**
+ * @file car_hash.c
+ * @brief Implementation of the registration number hash index.
+ */
+
+#include "car_hash.h"
+#include "car_store.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** Number of slots allocated by the first insert. */
+#define INITIAL_SLOTS 64
+
+/**
+ * @brief Hashes a string with 32-bit FNV-1a.
+ * @param text First character of the string.
+ * @param length Number of characters to hash.
+ * @return Hash value.
+ */
+unsigned int hashString(const char *text, size_t length) {
+    unsigned int hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (unsigned char)text[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * @brief Places an entry in the first free slot of its probe sequence.
+ * @param index Index to insert into; must have a free slot.
+ * @param hash Hash of the registration number.
+ * @param row Row of the car.
+ */
+static void placeSlot(struct RegistrationIndex *index, unsigned int hash, int row) {
+    size_t i = hash & index->mask;
+    while (index->slots[i].row != -1) {
+        i = (i + 1) & index->mask;
+    }
+    index->slots[i].hash = hash;
+    index->slots[i].row = row;
+}
+
+/**
+ * @brief Resizes the slot array and re-inserts every entry using the stored hashes.
+ * @param index Index to resize.
+ * @param count New number of slots, a power of two.
+ */
+static void resizeIndex(struct RegistrationIndex *index, size_t count) {
+    size_t oldCount = index->slots ? index->mask + 1 : 0;
+
+    struct HashSlot *slots = (struct HashSlot *)malloc(count * sizeof *slots);
+    if (!slots) {
+        fprintf(stderr, "Memory allocation error.\n");
+        exit(EXIT_FAILURE);
+    }
+    for (size_t i = 0; i < count; i++) {
+        slots[i].row = -1;
+    }
+
+    struct HashSlot *old = index->slots;
+    index->slots = slots;
+    index->mask = count - 1;
+    for (size_t i = 0; i < oldCount; i++) {
+        if (old[i].row != -1) {
+            placeSlot(index, old[i].hash, old[i].row);
+        }
+    }
+    if (!index->mapped) {
+        free(old);
+    }
+    index->mapped = 0;
+}
+
+/**
+ * @brief Adds every row appended since the last call to the index.
+ *
+ * The table is resized once for the whole batch and kept at most 70% full so probe sequences
+ * stay short. Hashes are computed a few rows ahead and their home slots prefetched, which
+ * hides most of the cache misses of a bulk load.
+ *
+ * @param set Car set owning the index.
+ */
+void syncRegistrations(struct Cars *set) {
+    struct RegistrationIndex *index = &set->registrations;
+    int first = index->indexed;
+    int last = set->rows;
+    if (first >= last) {
+        index->indexed = last;
+        return;
+    }
+
+    // Dead pending rows are counted too; the bound only has to be large enough.
+    size_t needed = index->used + (size_t)(last - first);
+    size_t count = index->slots ? index->mask + 1 : INITIAL_SLOTS;
+    while (needed * 10 > count * 7) {
+        count *= 2;
+    }
+    if (!index->slots || count != index->mask + 1) {
+        resizeIndex(index, count);
+    }
+
+    enum { AHEAD = 8 };
+    unsigned int hashes[AHEAD];
+    size_t placed = 0;
+    for (int row = first; row < last + AHEAD; row++) {
+        int ready = row - AHEAD;  // Shares its ring position with row, so place it first.
+        if (ready >= first && !isDeadRow(set, ready)) {
+            placeSlot(index, hashes[ready % AHEAD], ready);
+            placed++;
+        }
+        if (row < last) {
+            struct CarString plate = set->registration[row];
+            unsigned int hash = hashString(carString(set, plate), plate.length);
+            hashes[row % AHEAD] = hash;
+#if defined(__GNUC__)
+            __builtin_prefetch(&index->slots[hash & index->mask], 1);
+#endif
+        }
+    }
+
+    index->used += placed;
+    index->indexed = last;
+}
+
+/**
+ * @brief Removes a row from the index.
+ *
+ * The entry is deleted with backward-shift deletion, so no tombstones are left behind
+ * and the cost stays O(1) on average. Called by eraseCars() before the row is marked
+ * dead; rows that are still pending are skipped when they are synchronized instead.
+ *
+ * @param set Car set owning the index.
+ * @param row Row of the car being removed.
+ */
+void eraseRegistration(struct Cars *set, int row) {
+    struct RegistrationIndex *index = &set->registrations;
+    if (row >= index->indexed) {
+        return;  // Pending rows are not in the table yet.
+    }
+
+    struct CarString plate = set->registration[row];
+    size_t i = hashString(carString(set, plate), plate.length) & index->mask;
+    while (index->slots[i].row != row) {
+        if (index->slots[i].row == -1) {
+            return;
+        }
+        i = (i + 1) & index->mask;
+    }
+
+    for (size_t j = (i + 1) & index->mask; index->slots[j].row != -1; j = (j + 1) & index->mask) {
+        size_t home = index->slots[j].hash & index->mask;
+        // Move the entry back into the hole unless its home slot lies cyclically in (i, j].
+        int reachable = (i <= j) ? (i < home && home <= j) : (i < home || home <= j);
+        if (!reachable) {
+            index->slots[i] = index->slots[j];
+            i = j;
+        }
+    }
+    index->slots[i].row = -1;
+    index->used--;
+}
+
+/**
+ * @brief Renumbers the rows in the index after dead rows were purged.
+ *
+ * Dead rows were already removed from the table, so every slot keeps its place.
+ *
+ * @param set Car set owning the index.
+ * @param map New row of every old row, or -1 for dead rows.
+ */
+void remapRegistrations(struct Cars *set, const int *map) {
+    struct RegistrationIndex *index = &set->registrations;
+    for (size_t k = 0; index->slots && k <= index->mask; k++) {
+        if (index->slots[k].row != -1) {
+            index->slots[k].row = map[index->slots[k].row];
+        }
+    }
+
+    int indexed = 0;
+    for (int row = 0; row < index->indexed; row++) {
+        indexed += map[row] >= 0;
+    }
+    index->indexed = indexed;
+}
+
+/**
+ * @brief Finds the cars with exactly the given registration number.
+ * @param set Car set to search.
+ * @param plate Registration number to look up.
+ * @param rows Receives up to @p maxRows matching rows in ascending order (may be NULL).
+ * @param maxRows Capacity of @p rows.
+ * @return Total number of matching cars, which may exceed @p maxRows.
+ */
+int findRegistrations(const struct Cars *set, const char *plate, int *rows, int maxRows) {
+    const struct RegistrationIndex *index = &set->registrations;
+    size_t length = strlen(plate);
+    unsigned int hash = hashString(plate, length);
+    int found = 0;
+
+    for (size_t i = hash & index->mask; index->slots && index->slots[i].row != -1; i = (i + 1) & index->mask) {
+        const struct HashSlot *slot = &index->slots[i];
+        if (slot->hash != hash || set->registration[slot->row].length != length ||
+            memcmp(carString(set, set->registration[slot->row]), plate, length) != 0) {
+            continue;
+        }
+
+        if (rows && found < maxRows) {
+            // Insertion sort: duplicates are rare, so the list is almost always one entry long.
+            int k = found;
+            while (k > 0 && rows[k - 1] > slot->row) {
+                rows[k] = rows[k - 1];
+                k--;
+            }
+            rows[k] = slot->row;
+        }
+        found++;
+    }
+
+    // Pending rows come after every indexed row, so they keep the ascending order.
+    for (int row = index->indexed; row < set->rows; row++) {
+        if (!isDeadRow(set, row) && set->registration[row].length == length &&
+            memcmp(carString(set, set->registration[row]), plate, length) == 0) {
+            if (rows && found < maxRows) {
+                rows[found] = row;
+            }
+            found++;
+        }
+    }
+
+    return found;
+}
+
+/**
+ * @brief Releases the memory of a registration index.
+ * @param index Index to release.
+ */
+void freeRegistrationIndex(struct RegistrationIndex *index) {
+    if (!index->mapped) {
+        free(index->slots);
+    }
+    index->slots = NULL;
+    index->mask = 0;
+    index->used = 0;
+    index->indexed = 0;
+    index->mapped = 0;
+}
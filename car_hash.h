@@ -0,0 +1,86 @@
+/**
+ * @file car_hash.h
+ * @brief Open-addressing hash index on registration numbers.
+ */
+
+#ifndef CAR_HASH_H
+#define CAR_HASH_H
+
+#include <stddef.h>
+
+struct Cars;
+
+/**
+ * @struct HashSlot
+ * @brief One slot of the registration index.
+ */
+struct HashSlot {
+    unsigned int hash;  ///< Hash of the registration number stored in this slot.
+    int row;            ///< Row of the car, or -1 if the slot is empty.
+};
+
+/**
+ * @struct RegistrationIndex
+ * @brief Linear-probing hash table mapping registration numbers to rows.
+ *
+ * Duplicate registration numbers already present in base.txt are kept as separate entries,
+ * so an exact lookup finds every car the full scan would find. Rows appended after the
+ * last syncRegistrations() are still checked by lookups, with a short linear scan.
+ */
+struct RegistrationIndex {
+    struct HashSlot *slots;  ///< Slot array (NULL until the first insert).
+    size_t mask;             ///< Number of slots minus one; the slot count is a power of two.
+    size_t used;             ///< Number of occupied slots.
+    int indexed;             ///< Rows [0, indexed) are in the table; later rows are pending.
+    int mapped;              ///< Non-zero while @c slots points into a snapshot mapping.
+};
+
+/**
+ * @brief Hashes a string with 32-bit FNV-1a.
+ * @param text First character of the string.
+ * @param length Number of characters to hash.
+ * @return Hash value.
+ */
+unsigned int hashString(const char *text, size_t length);
+
+/**
+ * @brief Adds every row appended since the last call to the index.
+ * @param set Car set owning the index.
+ */
+void syncRegistrations(struct Cars *set);
+
+/**
+ * @brief Removes a row from the index.
+ *
+ * Called by eraseCars() before the row is marked dead; rows that are still pending are
+ * skipped when they are synchronized instead.
+ *
+ * @param set Car set owning the index.
+ * @param row Row of the car being removed.
+ */
+void eraseRegistration(struct Cars *set, int row);
+
+/**
+ * @brief Renumbers the rows in the index after dead rows were purged.
+ * @param set Car set owning the index.
+ * @param map New row of every old row, or -1 for dead rows.
+ */
+void remapRegistrations(struct Cars *set, const int *map);
+
+/**
+ * @brief Finds the cars with exactly the given registration number.
+ * @param set Car set to search.
+ * @param plate Registration number to look up.
+ * @param rows Receives up to @p maxRows matching rows in ascending order (may be NULL).
+ * @param maxRows Capacity of @p rows.
+ * @return Total number of matching cars, which may exceed @p maxRows.
+ */
+int findRegistrations(const struct Cars *set, const char *plate, int *rows, int maxRows);
+
+/**
+ * @brief Releases the memory of a registration index.
+ * @param index Index to release.
+ */
+void freeRegistrationIndex(struct RegistrationIndex *index);
+
+#endif // CAR_HASH_H
@@ -0,0 +1,494 @@
+/**
+ * @file car_import.c
+ * @brief Implementation of the bulk import.
+ */
+
+#include "car_import.h"
+#include "platform.h"
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** Longest string field accepted, matching the "%99s" conversions used for input. */
+#define MAX_FIELD_LENGTH 99
+
+/** Number of fields of one car. */
+#define CAR_FIELDS 7
+
+/**
+ * @struct ParsedCar
+ * @brief A validated car waiting in a batch; its strings live in the batch text.
+ */
+struct ParsedCar {
+    size_t text[5];  ///< Offsets of brand, model, fuel, type and registration in the batch text.
+    int year;        ///< Year of manufacture.
+    int capacity;    ///< Engine capacity in cm^3.
+    long line;       ///< Line the car starts on, for rejection messages.
+};
+
+/**
+ * @struct ImportBatch
+ * @brief Output of the parse stage for one chunk, consumed by the insert stage.
+ */
+struct ImportBatch {
+    struct ParsedCar *cars;  ///< Validated cars.
+    int count;               ///< Number of cars in the batch.
+    int allocated;           ///< Number of cars @c cars has room for.
+    char *text;              ///< NUL-terminated strings of the cars.
+    size_t textUsed;         ///< Bytes of @c text in use.
+    size_t textSize;         ///< Bytes allocated for @c text.
+};
+
+/**
+ * @struct ImportParser
+ * @brief State the parse stage carries from one line, and one chunk, to the next.
+ */
+struct ImportParser {
+    enum ImportFormat format;                      ///< Layout of the file.
+    long line;                                     ///< Number of the line being parsed.
+    int fields;                                    ///< Fields collected for the current base.txt record.
+    long recordLine;                               ///< Line the current base.txt record starts on.
+    char field[CAR_FIELDS][MAX_FIELD_LENGTH + 1];  ///< Fields of the current base.txt record.
+    const char *problem;                           ///< First problem found in the current base.txt record.
+    struct ImportStats *stats;                     ///< Counters being filled.
+};
+
+/**
+ * @brief Reports a rejected row and counts it.
+ * @param stats Counters being filled.
+ * @param line Line the row starts on.
+ * @param reason What is wrong with the row.
+ */
+static void rejectRow(struct ImportStats *stats, long line, const char *reason) {
+    if (stats->rejected < IMPORT_REPORTED_REJECTS) {
+        printf("Rejected line %ld: %s.\n", line, reason);
+    }
+    stats->rejected++;
+}
+
+/**
+ * @brief Picks the format of a file from its extension.
+ * @param path File name.
+ * @return IMPORT_CSV for ".csv", IMPORT_TSV for ".tsv", IMPORT_TEXT otherwise.
+ */
+enum ImportFormat importFormatForPath(const char *path) {
+    const char *dot = strrchr(path, '.');
+    if (dot && (strcmp(dot, ".csv") == 0 || strcmp(dot, ".CSV") == 0)) {
+        return IMPORT_CSV;
+    }
+    if (dot && (strcmp(dot, ".tsv") == 0 || strcmp(dot, ".TSV") == 0)) {
+        return IMPORT_TSV;
+    }
+    return IMPORT_TEXT;
+}
+
+/**
+ * @brief Parses a format name given on the command line.
+ * @param name "csv", "tsv" or "text".
+ * @param format Receives the format.
+ * @return 0 on success, -1 for an unknown name.
+ */
+int parseImportFormat(const char *name, enum ImportFormat *format) {
+    if (strcmp(name, "csv") == 0) {
+        *format = IMPORT_CSV;
+    } else if (strcmp(name, "tsv") == 0) {
+        *format = IMPORT_TSV;
+    } else if (strcmp(name, "text") == 0) {
+        *format = IMPORT_TEXT;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Checks a string field: non-empty, at most MAX_FIELD_LENGTH bytes, no whitespace.
+ *
+ * Whitespace is rejected because base.txt separates fields by whitespace.
+ *
+ * @param text First character of the field.
+ * @param length Length of the field.
+ * @return NULL if the field is valid, otherwise the reason it is not.
+ */
+static const char *checkString(const char *text, size_t length) {
+    if (length == 0) {
+        return "empty field";
+    }
+    if (length > MAX_FIELD_LENGTH) {
+        return "field longer than 99 characters";
+    }
+    for (size_t i = 0; i < length; i++) {
+        char c = text[i];
+        if (c == ' ' || c == '\t' || c == '\v' || c == '\f' || c == '\r' || c == '\n') {
+            return "whitespace inside a field";
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Parses a whole field as a decimal int.
+ * @param text First character of the field.
+ * @param length Length of the field.
+ * @param value Receives the number.
+ * @return 0 on success, -1 if the field is not a number or does not fit an int.
+ */
+static int parseNumber(const char *text, size_t length, int *value) {
+    size_t i = 0;
+    int negative = 0;
+    if (i < length && (text[i] == '-' || text[i] == '+')) {
+        negative = text[i] == '-';
+        i++;
+    }
+    if (i == length) {
+        return -1;
+    }
+
+    long long number = 0;
+    for (; i < length; i++) {
+        if (text[i] < '0' || text[i] > '9') {
+            return -1;
+        }
+        number = number * 10 + (text[i] - '0');
+        if (number > (long long)INT_MAX + 1) {
+            return -1;
+        }
+    }
+    number = negative ? -number : number;
+    if (number > INT_MAX || number < INT_MIN) {
+        return -1;
+    }
+    *value = (int)number;
+    return 0;
+}
+
+/**
+ * @brief Copies a string into the batch text.
+ * @param batch Batch being filled.
+ * @param text First character of the string.
+ * @param length Length of the string.
+ * @return Offset of the NUL-terminated copy.
+ */
+static size_t batchString(struct ImportBatch *batch, const char *text, size_t length) {
+    if (batch->textUsed + length + 1 > batch->textSize) {
+        size_t size = batch->textSize ? batch->textSize * 2 : 4096;
+        while (size < batch->textUsed + length + 1) {
+            size *= 2;
+        }
+        char *tmp = (char *)realloc(batch->text, size);
+        if (!tmp) {
+            fprintf(stderr, "Memory allocation error.\n");
+            exit(EXIT_FAILURE);
+        }
+        batch->text = tmp;
+        batch->textSize = size;
+    }
+
+    size_t offset = batch->textUsed;
+    memcpy(batch->text + offset, text, length);
+    batch->text[offset + length] = '\0';
+    batch->textUsed += length + 1;
+    return offset;
+}
+
+/**
+ * @brief Validates the seven fields of a car and adds it to the batch.
+ * @param batch Batch being filled.
+ * @param fields Fields in file order: brand, model, year, capacity, fuel, type, registration.
+ * @param lengths Length of each field.
+ * @param line Line the car starts on.
+ * @return NULL if the car was added, otherwise the reason it was rejected.
+ */
+static const char *addParsedCar(struct ImportBatch *batch, const char *const *fields, const size_t *lengths,
+                                long line) {
+    static const int strings[5] = {0, 1, 4, 5, 6};
+    struct ParsedCar car;
+
+    for (int s = 0; s < 5; s++) {
+        const char *problem = checkString(fields[strings[s]], lengths[strings[s]]);
+        if (problem) {
+            return problem;
+        }
+    }
+    if (parseNumber(fields[2], lengths[2], &car.year) != 0) {
+        return "year is not a number";
+    }
+    if (parseNumber(fields[3], lengths[3], &car.capacity) != 0) {
+        return "capacity is not a number";
+    }
+
+    for (int s = 0; s < 5; s++) {
+        car.text[s] = batchString(batch, fields[strings[s]], lengths[strings[s]]);
+    }
+    car.line = line;
+
+    if (batch->count == batch->allocated) {
+        int allocated = batch->allocated ? batch->allocated * 2 : 1024;
+        struct ParsedCar *tmp = (struct ParsedCar *)realloc(batch->cars, (size_t)allocated * sizeof *tmp);
+        if (!tmp) {
+            fprintf(stderr, "Memory allocation error.\n");
+            exit(EXIT_FAILURE);
+        }
+        batch->cars = tmp;
+        batch->allocated = allocated;
+    }
+    batch->cars[batch->count++] = car;
+    return NULL;
+}
+
+/**
+ * @brief Removes one level of double quotes around a CSV or TSV field.
+ * @param text First character of the field, advanced past an opening quote.
+ * @param length Length of the field, shortened accordingly.
+ */
+static void unquote(const char **text, size_t *length) {
+    if (*length >= 2 && (*text)[0] == '"' && (*text)[*length - 1] == '"') {
+        (*text)++;
+        *length -= 2;
+    }
+}
+
+/**
+ * @brief Parse stage for one CSV or TSV line.
+ * @param parser Parser state.
+ * @param line The line, without its newline.
+ * @param length Length of the line.
+ * @param batch Batch receiving the car.
+ */
+static void parseDelimitedLine(struct ImportParser *parser, const char *line, size_t length, struct ImportBatch *batch) {
+    char separator = parser->format == IMPORT_CSV ? ',' : '\t';
+    const char *fields[CAR_FIELDS];
+    size_t lengths[CAR_FIELDS];
+    int count = 0;
+
+    if (length > 0 && line[length - 1] == '\r') {
+        length--;
+    }
+    if (length == 0) {
+        return;
+    }
+
+    const char *start = line, *end = line + length;
+    for (const char *p = line; p <= end; p++) {
+        if (p < end && *p != separator) {
+            continue;
+        }
+        if (count == CAR_FIELDS) {
+            rejectRow(parser->stats, parser->line, "more than 7 fields");
+            return;
+        }
+        fields[count] = start;
+        lengths[count] = (size_t)(p - start);
+        unquote(&fields[count], &lengths[count]);
+        count++;
+        start = p + 1;
+    }
+    if (count < CAR_FIELDS) {
+        rejectRow(parser->stats, parser->line, "fewer than 7 fields");
+        return;
+    }
+
+    // A header line names the fields instead of holding a car.
+    if (parser->line == 1 && lengths[2] == 4 && strncmp(fields[2], "year", 4) == 0) {
+        return;
+    }
+
+    const char *problem = addParsedCar(batch, fields, lengths, parser->line);
+    if (problem) {
+        rejectRow(parser->stats, parser->line, problem);
+    }
+}
+
+/**
+ * @brief Parse stage for one base.txt-format line: collects one field of the current record.
+ * @param parser Parser state.
+ * @param line The line, without its newline.
+ * @param length Length of the line.
+ * @param batch Batch receiving the car once all seven fields are collected.
+ */
+static void parseTextLine(struct ImportParser *parser, const char *line, size_t length, struct ImportBatch *batch) {
+    // Trim surrounding whitespace; blank lines carry no field.
+    while (length > 0 && (line[0] == ' ' || line[0] == '\t' || line[0] == '\r')) {
+        line++;
+        length--;
+    }
+    while (length > 0 && (line[length - 1] == ' ' || line[length - 1] == '\t' || line[length - 1] == '\r')) {
+        length--;
+    }
+    if (length == 0) {
+        return;
+    }
+
+    if (parser->fields == 0) {
+        parser->recordLine = parser->line;
+        parser->problem = NULL;
+    }
+
+    int f = parser->fields++;
+    if (length > MAX_FIELD_LENGTH) {
+        parser->problem = parser->problem ? parser->problem : "field longer than 99 characters";
+        length = MAX_FIELD_LENGTH;
+    }
+    memcpy(parser->field[f], line, length);
+    parser->field[f][length] = '\0';
+
+    if (parser->fields < CAR_FIELDS) {
+        return;
+    }
+    parser->fields = 0;
+
+    const char *fields[CAR_FIELDS];
+    size_t lengths[CAR_FIELDS];
+    for (int k = 0; k < CAR_FIELDS; k++) {
+        fields[k] = parser->field[k];
+        lengths[k] = strlen(parser->field[k]);
+    }
+    const char *problem = parser->problem ? parser->problem : addParsedCar(batch, fields, lengths, parser->recordLine);
+    if (problem) {
+        rejectRow(parser->stats, parser->recordLine, problem);
+    }
+}
+
+/**
+ * @brief Insert stage: appends a batch of validated cars to the set.
+ *
+ * Room for the whole batch is reserved up front, and the registration index is kept in
+ * sync car by car so duplicates within the batch are caught by a hash lookup.
+ *
+ * @param batch Batch produced by the parse stage; emptied afterwards.
+ * @param set Car set to append to.
+ * @param added Called for each appended car (may be NULL).
+ * @param context Caller data passed to @p added.
+ * @param stats Counters being filled.
+ */
+static void insertBatch(struct ImportBatch *batch, struct Cars *set, ImportCallback added, void *context,
+                        struct ImportStats *stats) {
+    reserveCars(set, set->rows + batch->count, set->heapUsed + batch->textUsed);
+
+    for (int i = 0; i < batch->count; i++) {
+        const struct ParsedCar *parsed = &batch->cars[i];
+        struct CarRecord car;
+        car.brand = batch->text + parsed->text[0];
+        car.model = batch->text + parsed->text[1];
+        car.year = parsed->year;
+        car.capacity = parsed->capacity;
+        car.fuel = batch->text + parsed->text[2];
+        car.type = batch->text + parsed->text[3];
+        car.registration = batch->text + parsed->text[4];
+
+        if (findRegistrations(set, car.registration, NULL, 0) > 0) {
+            rejectRow(stats, parsed->line, "registration number already exists");
+            continue;
+        }
+        appendCar(set, &car);
+        syncRegistrations(set);
+        if (added) {
+            added(&car, context);
+        }
+        stats->imported++;
+    }
+
+    batch->count = 0;
+    batch->textUsed = 0;
+}
+
+/**
+ * @brief Streams a file into a car set.
+ *
+ * Each chunk is parsed completely before its cars are inserted. A line cut off by the end
+ * of a chunk is moved to the front of the buffer and completed by the next read; a line
+ * longer than a whole chunk is rejected.
+ *
+ * @param path File to import.
+ * @param format Layout of the file.
+ * @param set Car set to append to.
+ * @param added Called for each appended car (may be NULL).
+ * @param context Caller data passed to @p added.
+ * @param stats Receives the outcome.
+ * @return 0 on success, -1 if the file cannot be opened or read.
+ */
+int importCars(const char *path, enum ImportFormat format, struct Cars *set, ImportCallback added, void *context,
+               struct ImportStats *stats) {
+    double started = monotonicSeconds();
+    memset(stats, 0, sizeof *stats);
+
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        return -1;
+    }
+
+    char *buffer = (char *)malloc(IMPORT_CHUNK_BYTES);
+    struct ImportParser *parser = (struct ImportParser *)calloc(1, sizeof *parser);
+    if (!buffer || !parser) {
+        fprintf(stderr, "Memory allocation error.\n");
+        exit(EXIT_FAILURE);
+    }
+    parser->format = format;
+    parser->stats = stats;
+
+    struct ImportBatch batch = {NULL, 0, 0, NULL, 0, 0};
+    size_t carried = 0;
+    int skipping = 0;  // Inside a line that did not fit in the buffer.
+    size_t got;
+
+    while ((got = fread(buffer + carried, 1, IMPORT_CHUNK_BYTES - carried, file)) > 0 || carried > 0) {
+        stats->bytes += got;
+        size_t filled = carried + got;
+        int atEnd = got == 0;
+
+        // Parse stage: every complete line of the chunk (and the unterminated last line at the end).
+        size_t start = 0;
+        for (size_t i = 0; i <= filled; i++) {
+            if (i < filled ? buffer[i] != '\n' : !atEnd) {
+                continue;
+            }
+            if (i == filled && i == start) {
+                break;
+            }
+            parser->line++;
+            if (skipping) {
+                skipping = 0;
+            } else if (format == IMPORT_TEXT) {
+                parseTextLine(parser, buffer + start, i - start, &batch);
+            } else {
+                parseDelimitedLine(parser, buffer + start, i - start, &batch);
+            }
+            start = i + 1;
+        }
+
+        carried = start < filled ? filled - start : 0;
+        if (carried == IMPORT_CHUNK_BYTES) {
+            if (!skipping) {
+                rejectRow(stats, parser->line + 1, "line longer than the import buffer");
+                parser->fields = 0;  // A base.txt record lost a field; drop the rest of it.
+            }
+            skipping = 1;
+            carried = 0;
+        } else if (carried > 0) {
+            memmove(buffer, buffer + start, carried);
+        }
+
+        // Insert stage: the whole batch at once.
+        insertBatch(&batch, set, added, context, stats);
+
+        if (atEnd) {
+            break;
+        }
+    }
+
+    if (format == IMPORT_TEXT && parser->fields > 0) {
+        rejectRow(stats, parser->recordLine, "incomplete record at the end of the file");
+    }
+
+    int failed = ferror(file);
+    fclose(file);
+    free(buffer);
+    free(parser);
+    free(batch.cars);
+    free(batch.text);
+
+    syncIndexes(set);
+    stats->seconds = monotonicSeconds() - started;
+    return failed ? -1 : 0;
+}
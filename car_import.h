@@ -0,0 +1,85 @@
+/**
+ * @file car_import.h
+ * @brief Non-interactive bulk import of cars from CSV, TSV and base.txt-format files.
+ *
+ * The file is streamed in fixed-size chunks. Each chunk goes through two stages: the parse
+ * stage splits it into records and validates every field into a batch, and the insert stage
+ * appends the whole batch to the car set after reserving room for it at once. Malformed rows
+ * are counted and reported; they never stop the import.
+ *
+ * CSV and TSV files hold one car per line, as brand, model, year, capacity, fuel, type and
+ * registration separated by commas or tabs; fields may be wrapped in double quotes, and a
+ * leading header line naming the fields is skipped. base.txt-format files hold one field per
+ * line, seven lines per car; blank lines are ignored.
+ */
+
+#ifndef CAR_IMPORT_H
+#define CAR_IMPORT_H
+
+#include "car_store.h"
+
+/** Size of the chunks the file is read in. */
+#define IMPORT_CHUNK_BYTES (1 << 20)
+
+/** Number of rejected rows reported one by one; the rest are only counted. */
+#define IMPORT_REPORTED_REJECTS 10
+
+/** Layout of an import file. */
+enum ImportFormat {
+    IMPORT_TEXT,  ///< base.txt format: one field per line, seven lines per car.
+    IMPORT_CSV,   ///< One car per line, comma-separated.
+    IMPORT_TSV,   ///< One car per line, tab-separated.
+};
+
+/**
+ * @struct ImportStats
+ * @brief Outcome of one import.
+ */
+struct ImportStats {
+    long imported;   ///< Cars appended to the set.
+    long rejected;   ///< Malformed or duplicate rows skipped.
+    size_t bytes;    ///< Bytes read from the file.
+    double seconds;  ///< Wall-clock time of the whole import.
+};
+
+/**
+ * @brief Called for every car the import appends, e.g. to journal it.
+ * @param car The appended car; its strings are only valid during the call.
+ * @param context Caller data passed to importCars().
+ */
+typedef void (*ImportCallback)(const struct CarRecord *car, void *context);
+
+/**
+ * @brief Picks the format of a file from its extension.
+ * @param path File name.
+ * @return IMPORT_CSV for ".csv", IMPORT_TSV for ".tsv", IMPORT_TEXT otherwise.
+ */
+enum ImportFormat importFormatForPath(const char *path);
+
+/**
+ * @brief Parses a format name given on the command line.
+ * @param name "csv", "tsv" or "text".
+ * @param format Receives the format.
+ * @return 0 on success, -1 for an unknown name.
+ */
+int parseImportFormat(const char *name, enum ImportFormat *format);
+
+/**
+ * @brief Streams a file into a car set.
+ *
+ * Rows whose registration number is already in the set, or earlier in the file, are rejected
+ * like duplicates entered through addCar(). The first IMPORT_REPORTED_REJECTS rejections are
+ * printed with their line number and reason. The indexes are synchronized at the end.
+ *
+ * @param path File to import.
+ * @param format Layout of the file.
+ * @param set Car set to append to.
+ * @param added Called for each appended car (may be NULL).
+ * @param context Caller data passed to @p added.
+ * @param stats Receives the outcome.
+ * @return 0 on success, -1 if the file cannot be opened or read.
+ */
+int importCars(const char *path, enum ImportFormat format, struct Cars *set, ImportCallback added, void *context,
+               struct ImportStats *stats);
+
+#endif // CAR_IMPORT_H
@@ -0,0 +1,869 @@
+/**
+ * @file car_io.c
+ * @brief Implementation of the text and snapshot file formats.
+ */
+
+#include "car_io.h"
+#include "car_parallel.h"
+#include "platform.h"
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** Longest string field accepted, matching the "%99s" conversions used for input. */
+#define MAX_FIELD_LENGTH 99
+
+/** Fields of one car in the text format. */
+#define RECORD_FIELDS 7
+
+/** Bytes of a text file parsed by one task of the parallel loader. */
+#define TEXT_CHUNK_BYTES (4 * 1024 * 1024)
+
+/** Text files smaller than this are parsed on the calling thread only. */
+#define PARALLEL_MIN_BYTES (2 * TEXT_CHUNK_BYTES)
+
+/** Value of SnapshotHeader::byteOrder on the machine that wrote the file. */
+#define BYTE_ORDER_MARK 0x01020304u
+
+/**
+ * @brief Checks whether a byte is whitespace in the sense of the "%s" conversion.
+ * @param c Byte to test.
+ * @return Non-zero for space, tab, newline, vertical tab, form feed and carriage return.
+ */
+static int isFieldSpace(char c) {
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '\v' || c == '\f';
+}
+
+/**
+ * @brief Scans one whitespace-delimited string token straight out of the mapped file.
+ *
+ * Mirrors fscanf("%99s"): leading whitespace is skipped and at most @p width bytes are taken,
+ * so an over-long token is split exactly the way the old loader split it. The token is copied
+ * once, directly into the shared string heap.
+ *
+ * @param pos Current scan position, advanced past the token.
+ * @param end One past the last byte of the file.
+ * @param set Car set whose heap receives the token.
+ * @param width Maximum number of bytes to take.
+ * @param ref Receives the reference to the stored token.
+ * @return 1 if a token was read, 0 at end of input.
+ */
+static int scanString(const char **pos, const char *end, struct Cars *set, size_t width, struct CarString *ref) {
+    const char *p = *pos;
+    while (p < end && isFieldSpace(*p)) {
+        p++;
+    }
+
+    const char *start = p;
+    while (p < end && !isFieldSpace(*p) && (size_t)(p - start) < width) {
+        p++;
+    }
+    *pos = p;
+    if (p == start) {
+        return 0;
+    }
+
+    *ref = storeString(set, start, (size_t)(p - start));
+    return 1;
+}
+
+/**
+ * @brief Scans one decimal integer straight out of the mapped file.
+ *
+ * Mirrors fscanf("%d"): leading whitespace is skipped, an optional sign is accepted and
+ * parsing stops at the first non-digit.
+ *
+ * @param pos Current scan position, advanced past the number.
+ * @param end One past the last byte of the file.
+ * @param value Receives the parsed value.
+ * @return 1 if a number was read, 0 if the input does not start with one.
+ */
+static int scanInt(const char **pos, const char *end, int *value) {
+    const char *p = *pos;
+    while (p < end && isFieldSpace(*p)) {
+        p++;
+    }
+
+    int negative = 0;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = (*p == '-');
+        p++;
+    }
+
+    const char *digits = p;
+    long long result = 0;
+    while (p < end && *p >= '0' && *p <= '9') {
+        result = result * 10 + (*p - '0');
+        p++;
+    }
+    if (p == digits) {
+        return 0;
+    }
+
+    *value = (int)(negative ? -result : result);
+    *pos = p;
+    return 1;
+}
+
+/**
+ * @brief Scans a number field, noting whether other characters follow it in the same token.
+ * @param pos Current scan position, advanced past the number.
+ * @param end One past the last byte of the file.
+ * @param value Receives the parsed value.
+ * @param irregular Set to 1 if the number is not followed by whitespace or the end of the file,
+ *                  or is longer than a string field.
+ * @return 1 if a number was read, 0 if the input does not start with one.
+ */
+static int scanNumber(const char **pos, const char *end, int *value, int *irregular) {
+    while (*pos < end && isFieldSpace(**pos)) {
+        (*pos)++;
+    }
+    const char *start = *pos;
+    if (!scanInt(pos, end, value)) {
+        return 0;
+    }
+    // A number longer than a string field would also be counted as several fields.
+    if ((*pos < end && !isFieldSpace(**pos)) || *pos - start > MAX_FIELD_LENGTH) {
+        *irregular = 1;
+    }
+    return 1;
+}
+
+/**
+ * @brief Scans the seven fields of one car record out of the mapped file.
+ *
+ * The strings are stored in the set's heap; those of an incomplete record are dropped again.
+ *
+ * @param pos Current scan position, advanced past the record.
+ * @param end One past the last byte of the file.
+ * @param set Car set whose heap receives the strings.
+ * @param strings Receives brand, model, fuel, type and registration.
+ * @param numbers Receives year and capacity.
+ * @param irregular Set to 1 if a number runs into other characters, as in "2015x".
+ * @return 1 if a complete record was read, 0 otherwise.
+ */
+static int scanFields(const char **pos, const char *end, struct Cars *set, struct CarString strings[5],
+                      int numbers[2], int *irregular) {
+    size_t mark = set->heapUsed;
+    if (scanString(pos, end, set, MAX_FIELD_LENGTH, &strings[0]) &&
+        scanString(pos, end, set, MAX_FIELD_LENGTH, &strings[1]) &&
+        scanNumber(pos, end, &numbers[0], irregular) &&
+        scanNumber(pos, end, &numbers[1], irregular) &&
+        scanString(pos, end, set, MAX_FIELD_LENGTH, &strings[2]) &&
+        scanString(pos, end, set, MAX_FIELD_LENGTH, &strings[3]) &&
+        scanString(pos, end, set, MAX_FIELD_LENGTH, &strings[4])) {
+        return 1;
+    }
+
+    set->heapUsed = mark;  // Drop the strings of an incomplete trailing record.
+    return 0;
+}
+
+/**
+ * @brief Scans one seven-field car record out of the mapped file and appends it to the set.
+ * @param pos Current scan position, advanced past the record.
+ * @param end One past the last byte of the file.
+ * @param set Car set to append to.
+ * @return 1 if a complete record was read, 0 otherwise.
+ */
+static int scanCar(const char **pos, const char *end, struct Cars *set) {
+    struct CarString strings[5];
+    int numbers[2], irregular = 0;
+    if (!scanFields(pos, end, set, strings, numbers, &irregular)) {
+        return 0;
+    }
+    appendCarRow(set, strings[0], strings[1], numbers[0], numbers[1], strings[2], strings[3], strings[4]);
+    return 1;
+}
+
+/**
+ * @struct TextChunk
+ * @brief A byte range of a text file parsed by one task of the parallel loader.
+ */
+struct TextChunk {
+    const char *start;  ///< First byte of the range, at the start of a line.
+    const char *end;    ///< One past the last byte of the range.
+    long fields;        ///< Fields in the range, as scanString() splits them.
+    long skip;          ///< Leading fields that finish a record begun in an earlier range.
+    struct Cars *cars;  ///< Thread-local set holding the parsed cars: columns and heap, no indexes.
+    int complete;       ///< Non-zero if every record beginning in the range was read.
+    int irregular;      ///< Non-zero if a number ran into other characters, which shifts the fields.
+};
+
+/**
+ * @struct TextLoad
+ * @brief A text file being parsed by the parallel loader.
+ */
+struct TextLoad {
+    const char *end;           ///< One past the last byte of the file.
+    struct TextChunk *chunks;  ///< Ranges of the file, in file order.
+    int count;                 ///< Number of ranges.
+};
+
+/**
+ * @brief Skips the next field without storing it, splitting over-long tokens as scanString() does.
+ * @param pos Current scan position, advanced past the field.
+ * @param end One past the last byte to look at.
+ * @return 1 if a field was skipped, 0 at the end of the input.
+ */
+static int skipField(const char **pos, const char *end) {
+    const char *p = *pos;
+    while (p < end && isFieldSpace(*p)) {
+        p++;
+    }
+    const char *start = p;
+    while (p < end && !isFieldSpace(*p) && p - start < MAX_FIELD_LENGTH) {
+        p++;
+    }
+    *pos = p;
+    return p != start;
+}
+
+/**
+ * @brief Counts the fields of one range of the file.
+ * @param task Range to count.
+ * @param context The load.
+ */
+static void countChunkFields(int task, void *context) {
+    struct TextChunk *chunk = &((struct TextLoad *)context)->chunks[task];
+    static const unsigned char fieldSpace[256] = {[' '] = 1, ['\n'] = 1, ['\r'] = 1, ['\t'] = 1, ['\v'] = 1, ['\f'] = 1};
+    long fields = 0;
+    int run = 0;  // Bytes of the current field so far, restarting after MAX_FIELD_LENGTH.
+    for (const unsigned char *p = (const unsigned char *)chunk->start; p < (const unsigned char *)chunk->end; p++) {
+        if (fieldSpace[*p]) {
+            run = 0;
+        } else {
+            fields += run == 0;
+            run = run + 1 < MAX_FIELD_LENGTH ? run + 1 : 0;
+        }
+    }
+    chunk->fields = fields;
+}
+
+/**
+ * @brief Parses the records beginning in one range of the file into a thread-local set.
+ *
+ * The last record may run on into the next range; that range skips its remaining fields.
+ * Each number must be a whole field: "2015x" would make the serial scanner split fields
+ * differently from the field count, so the chunk is marked irregular instead.
+ *
+ * @param task Range to parse.
+ * @param context The load.
+ */
+static void parseChunk(int task, void *context) {
+    struct TextLoad *load = (struct TextLoad *)context;
+    struct TextChunk *chunk = &load->chunks[task];
+    struct Cars *cars = createCarSet();
+    chunk->cars = cars;
+    reserveCars(cars, 0, (size_t)(chunk->end - chunk->start) + 1);
+
+    const char *pos = chunk->start;
+    for (long i = 0; i < chunk->skip; i++) {
+        skipField(&pos, load->end);
+    }
+    for (;;) {
+        while (pos < load->end && isFieldSpace(*pos)) {
+            pos++;
+        }
+        if (pos >= chunk->end) {
+            chunk->complete = 1;
+            return;
+        }
+
+        struct CarString strings[5];
+        int numbers[2];
+        if (!scanFields(&pos, load->end, cars, strings, numbers, &chunk->irregular) || chunk->irregular) {
+            return;
+        }
+        int row = cars->rows;
+        reserveCars(cars, row + 1, 0);
+        cars->brand[row] = strings[0];
+        cars->model[row] = strings[1];
+        cars->year[row] = numbers[0];
+        cars->capacity[row] = numbers[1];
+        cars->fuel[row] = strings[2];
+        cars->type[row] = strings[3];
+        cars->registration[row] = strings[4];
+        cars->rows++;
+    }
+}
+/**
+ * @brief Parses a mapped text file on the worker pool and appends its cars to a set.
+ *
+ * The file is cut into ranges of about TEXT_CHUNK_BYTES, each ending at a line break. A
+ * first parallel pass counts the fields of every range; their running total tells where
+ * the first record beginning in each range starts, since every record has RECORD_FIELDS
+ * fields. A second pass parses each range into its own set. The sets are then appended
+ * in file order: their heaps are copied one after another and their rows are appended with
+ * rebased string offsets, which yields exactly the heap, rows and indexes of the serial scan.
+ *
+ * @param data First byte of the file.
+ * @param size Size of the file.
+ * @param set Car set to append to.
+ * @return 0 on success, -1 if a number runs into other characters; the set is unchanged then
+ *         and the file must be parsed serially.
+ */
+static int readTextParallel(const char *data, size_t size, struct Cars *set) {
+    struct TextLoad load = {data + size, NULL, 0};
+    load.chunks = (struct TextChunk *)calloc(size / TEXT_CHUNK_BYTES + 1, sizeof *load.chunks);
+    if (!load.chunks) {
+        fprintf(stderr, "Memory allocation error.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    const char *start = data;
+    while (start < load.end) {
+        const char *end = start + TEXT_CHUNK_BYTES < load.end ? start + TEXT_CHUNK_BYTES : load.end;
+        const char *newline = memchr(end - 1, '\n', (size_t)(load.end - (end - 1)));
+        end = newline ? newline + 1 : load.end;
+        load.chunks[load.count].start = start;
+        load.chunks[load.count].end = end;
+        load.count++;
+        start = end;
+    }
+
+    parallelFor(load.count, countChunkFields, &load);
+    long fields = 0;
+    for (int c = 0; c < load.count; c++) {
+        load.chunks[c].skip = (RECORD_FIELDS - fields % RECORD_FIELDS) % RECORD_FIELDS;
+        fields += load.chunks[c].fields;
+    }
+    parallelFor(load.count, parseChunk, &load);
+
+    // Like the serial scan, stop after the first range that ends in a bad or incomplete record.
+    int used = 0, irregular = 0, rows = set->rows;
+    while (used < load.count) {
+        irregular |= load.chunks[used].irregular;
+        rows += load.chunks[used].cars->rows;
+        if (!load.chunks[used++].complete) {
+            break;
+        }
+    }
+
+    if (!irregular) {
+        reserveCars(set, rows, set->heapUsed + size + 1);
+        for (int c = 0; c < used; c++) {
+            const struct Cars *cars = load.chunks[c].cars;
+            unsigned int base = (unsigned int)set->heapUsed;
+            memcpy(set->heap + set->heapUsed, cars->heap, cars->heapUsed);
+            set->heapUsed += cars->heapUsed;
+            for (int row = 0; row < cars->rows; row++) {
+                struct CarString brand = cars->brand[row], model = cars->model[row], fuel = cars->fuel[row];
+                struct CarString type = cars->type[row], registration = cars->registration[row];
+                brand.offset += base;
+                model.offset += base;
+                fuel.offset += base;
+                type.offset += base;
+                registration.offset += base;
+                appendCarRow(set, brand, model, cars->year[row], cars->capacity[row], fuel, type, registration);
+            }
+        }
+    }
+
+    for (int c = 0; c < load.count; c++) {
+        destroyCarSet(load.chunks[c].cars);
+    }
+    free(load.chunks);
+    return irregular ? -1 : 0;
+}
+
+/**
+ * @brief Parses the records of a block of a text file into the columns of a set, without indexing them.
+ *
+ * Used for blocks that start at the beginning of a record, such as the pages of a paged
+ * file. If the set has a record ID column, the cars receive consecutive IDs from
+ * Cars::nextId on.
+ *
+ * @param data First byte of the block.
+ * @param size Size of the block.
+ * @param set Car set to append to; only its columns and heap are filled.
+ * @return Number of cars appended.
+ */
+int parseTextRecords(const char *data, size_t size, struct Cars *set) {
+    reserveCars(set, 0, set->heapUsed + size + 1);
+
+    const char *pos = data;
+    const char *end = data + size;
+    int parsed = 0, irregular = 0;
+    struct CarString strings[5];
+    int numbers[2];
+    while (scanFields(&pos, end, set, strings, numbers, &irregular)) {
+        int row = set->rows;
+        reserveCars(set, row + 1, 0);
+        set->brand[row] = strings[0];
+        set->model[row] = strings[1];
+        set->year[row] = numbers[0];
+        set->capacity[row] = numbers[1];
+        set->fuel[row] = strings[2];
+        set->type[row] = strings[3];
+        set->registration[row] = strings[4];
+        if (set->ids) {
+            set->ids[row] = set->nextId++;
+        }
+        set->rows++;
+        parsed++;
+    }
+    return parsed;
+}
+
+/**
+ * @brief Parses a text file and appends its cars to a set.
+ *
+ * The file is mapped into memory and tokenized in place with a hand-written scanner, without
+ * going through stdio. Numbers go straight into the year and capacity columns and every string
+ * is copied once into the shared string heap, which is sized up front from the file length.
+ * Large files are parsed by several threads when scanThreads() allows it, with the same result.
+ *
+ * @param path Text file to read.
+ * @param set Car set to append to; its indexes are synchronized afterwards.
+ * @param bytes Receives the size of the file (may be NULL).
+ * @return 0 on success, -1 if the file cannot be opened.
+ */
+int readTextCars(const char *path, struct Cars *set, size_t *bytes) {
+    struct MappedFile file;
+    if (mapFile(path, &file) != 0) {
+        return -1;
+    }
+
+    if (file.size < PARALLEL_MIN_BYTES || scanThreads() < 2 || readTextParallel(file.data, file.size, set) != 0) {
+        // Every stored string is followed by at least one delimiter in the file, so the file
+        // size (plus a NUL for an unterminated last token) bounds the heap.
+        reserveCars(set, 0, set->heapUsed + file.size + 1);
+
+        const char *pos = file.data;
+        const char *end = file.data + file.size;
+        while (pos && scanCar(&pos, end, set));
+    }
+    syncIndexes(set);
+
+    if (bytes) {
+        *bytes = file.size;
+    }
+    unmapFile(&file);
+    return 0;
+}
+
+/**
+ * @brief Writes one car to a text file.
+ * @param file Stream to write to.
+ * @param set Car set holding the car.
+ * @param row Row of the car.
+ * @param first Non-zero for the first car of the file, which is not preceded by a newline.
+ */
+void writeTextRecord(FILE *file, const struct Cars *set, int row, int first) {
+    fprintf(file, "%s%s\n%s\n%d\n%d\n%s\n%s\n%s",
+            first ? "" : "\n",
+            carString(set, set->brand[row]),
+            carString(set, set->model[row]),
+            set->year[row],
+            set->capacity[row],
+            carString(set, set->fuel[row]),
+            carString(set, set->type[row]),
+            carString(set, set->registration[row]));
+}
+
+/**
+ * @brief Writes every live car of a set to a text file.
+ *
+ * Records are separated by newlines, with no newline after the last one.
+ *
+ * @param path Text file to write.
+ * @param set Car set to write (NULL writes an empty file).
+ * @return 0 on success, -1 if the file cannot be written.
+ */
+int writeTextCars(const char *path, const struct Cars *set) {
+    FILE *fptr = fopen(path, "w");
+    if (!fptr) {
+        return -1;
+    }
+
+    int count = set ? set->rows : 0;
+    int first = set ? nextLiveRow(set, 0) : 0;
+    for (int j = first; j < count; j = nextLiveRow(set, j + 1)) {
+        writeTextRecord(fptr, set, j, j == first);
+    }
+
+    int failed = ferror(fptr);
+    return (fclose(fptr) != 0 || failed) ? -1 : 0;
+}
+
+/**
+ * @brief Rotates a 64-bit value left.
+ * @param x Value to rotate.
+ * @param bits Number of bits, 1 to 63.
+ * @return Rotated value.
+ */
+static uint64_t rotateLeft(uint64_t x, int bits) {
+    return (x << bits) | (x >> (64 - bits));
+}
+
+/**
+ * @brief Extends a checksum over a block of bytes.
+ *
+ * Four independent multiply-rotate lanes consume 32 bytes per step, so the checksum keeps
+ * up with reading the file; the remaining bytes are folded in one at a time.
+ *
+ * @param data First byte of the block.
+ * @param size Number of bytes.
+ * @param hash Checksum of everything before the block.
+ * @return Checksum including the block.
+ */
+static uint64_t checksumBytes(const void *data, size_t size, uint64_t hash) {
+    const uint64_t prime = 0x9E3779B185EBCA87ULL;
+    const unsigned char *p = (const unsigned char *)data;
+    uint64_t lanes[4] = {hash, hash ^ 0xC2B2AE3D27D4EB4FULL, hash ^ 0x165667B19E3779F9ULL, hash ^ prime};
+
+    for (; size >= 32; p += 32, size -= 32) {
+        for (int k = 0; k < 4; k++) {
+            uint64_t word;
+            memcpy(&word, p + 8 * k, sizeof word);
+            lanes[k] = rotateLeft(lanes[k] ^ word, 29) * prime;
+        }
+    }
+
+    hash = lanes[0] ^ rotateLeft(lanes[1], 7) ^ rotateLeft(lanes[2], 13) ^ rotateLeft(lanes[3], 19);
+    for (; size > 0; p++, size--) {
+        hash = (hash ^ *p) * 0x100000001B3ULL;
+    }
+    return hash;
+}
+
+/**
+ * @brief Rounds a section size up to the 8-byte section alignment.
+ * @param size Size in bytes.
+ * @return Padded size.
+ */
+static uint64_t padSection(uint64_t size) {
+    return (size + 7) & ~(uint64_t)7;
+}
+
+/**
+ * @brief Returns the next section of a mapped snapshot and folds it into the checksum.
+ * @param base First byte of the mapping.
+ * @param offset Offset of the section, advanced past it and its padding.
+ * @param size Size of the section without padding.
+ * @param hash Running checksum.
+ * @return First byte of the section.
+ */
+static char *nextSection(char *base, uint64_t *offset, uint64_t size, uint64_t *hash) {
+    char *section = base + *offset;
+    *hash = checksumBytes(section, (size_t)size, *hash);
+    *hash = checksumBytes(section + size, (size_t)(padSection(size) - size), *hash);
+    *offset += padSection(size);
+    return section;
+}
+
+/**
+ * @brief Returns the size a snapshot with the given header must have.
+ * @param header Header of the snapshot.
+ * @return Total file size in bytes.
+ */
+static uint64_t snapshotSize(const struct SnapshotHeader *header) {
+    uint64_t rows = header->rows;
+    return sizeof *header +
+           5 * padSection(rows * sizeof(struct CarString)) + 2 * padSection(rows * sizeof(int)) +
+           padSection(header->heapBytes) + 2 * padSection(rows * sizeof(struct RangeEntry)) +
+           padSection(header->hashSlots * sizeof(struct HashSlot)) +
+           padSection((uint64_t)header->brandLists * 2 * sizeof(uint32_t)) +
+           padSection(header->brandPostings * sizeof(int)) +
+           padSection((uint64_t)header->modelLists * 2 * sizeof(uint32_t)) +
+           padSection(header->modelPostings * sizeof(int)) + padSection(header->fuelBitmapBytes) +
+           padSection(header->typeBitmapBytes);
+}
+
+/**
+ * @brief Attaches the posting lists of one trigram index stored in a mapped snapshot.
+ * @param index Index to fill.
+ * @param table (trigram, count) pairs of the lists.
+ * @param lists Number of lists.
+ * @param postings Rows of all lists, in table order.
+ * @param total Number of rows in @p postings.
+ * @return 0 on success, -1 if the table does not match the postings.
+ */
+static int attachTrigrams(struct TrigramIndex *index, const uint32_t *table, uint32_t lists, int *postings,
+                          uint64_t total) {
+    uint64_t used = 0;
+    for (uint32_t i = 0; i < lists; i++) {
+        uint32_t trigram = table[2 * i], count = table[2 * i + 1];
+        if (trigram == 0 || count > total - used) {
+            return -1;
+        }
+        attachPostingList(index, trigram, postings + used, (int)count);
+        used += count;
+    }
+    return used == total ? 0 : -1;
+}
+
+/**
+ * @brief Maps a snapshot if it is present, intact and not older than its text file.
+ *
+ * The file is mapped copy-on-write and the columns, heap and indexes of the new set point
+ * straight into it, so loading costs one pass to verify the checksum; pages are copied only
+ * when the set modifies them.
+ *
+ * @param path Snapshot file to read.
+ * @param sourcePath Text file the snapshot must match, or NULL to skip the staleness check.
+ * @param bytes Receives the size of the snapshot (may be NULL).
+ * @return Newly created car set, or NULL if the snapshot is missing, stale or damaged.
+ */
+struct Cars *readSnapshot(const char *path, const char *sourcePath, size_t *bytes) {
+    struct MappedFile file;
+    if (mapFileCopy(path, &file) != 0) {
+        return NULL;
+    }
+
+    struct SnapshotHeader header;
+    uint64_t sourceSize;
+    int64_t sourceTime;
+    if (file.size < sizeof header) {
+        unmapFile(&file);
+        return NULL;
+    }
+    memcpy(&header, file.data, sizeof header);
+
+    if (memcmp(header.magic, SNAPSHOT_MAGIC, sizeof SNAPSHOT_MAGIC) != 0 ||
+        header.version != SNAPSHOT_VERSION || header.byteOrder != BYTE_ORDER_MARK ||
+        header.rows > INT_MAX || header.hashIndexed > header.rows ||
+        header.yearsSorted > header.rows || header.capacitiesSorted > header.rows ||
+        header.heapBytes >= UINT_MAX || header.heapGarbage > header.heapBytes ||
+        header.hashSlots > ((uint64_t)1 << 32) || (header.hashSlots & (header.hashSlots - 1)) != 0 ||
+        header.hashUsed > header.hashSlots ||
+        header.brandPostings > ((uint64_t)1 << 40) || header.modelPostings > ((uint64_t)1 << 40) ||
+        header.fuelBitmapBytes > ((uint64_t)1 << 40) || header.typeBitmapBytes > ((uint64_t)1 << 40) ||
+        snapshotSize(&header) != file.size ||
+        (sourcePath && (fileStamp(sourcePath, &sourceSize, &sourceTime) != 0 ||
+                        sourceSize != header.sourceSize || sourceTime != header.sourceTime))) {
+        unmapFile(&file);
+        return NULL;
+    }
+
+    char *base = (char *)file.data;
+    uint64_t offset = sizeof header;
+    uint64_t hash = 0;
+    uint64_t rows = header.rows;
+    struct Cars *set = createCarSet();
+
+    set->brand = (struct CarString *)nextSection(base, &offset, rows * sizeof(struct CarString), &hash);
+    set->model = (struct CarString *)nextSection(base, &offset, rows * sizeof(struct CarString), &hash);
+    set->year = (int *)nextSection(base, &offset, rows * sizeof(int), &hash);
+    set->capacity = (int *)nextSection(base, &offset, rows * sizeof(int), &hash);
+    set->fuel = (struct CarString *)nextSection(base, &offset, rows * sizeof(struct CarString), &hash);
+    set->type = (struct CarString *)nextSection(base, &offset, rows * sizeof(struct CarString), &hash);
+    set->registration = (struct CarString *)nextSection(base, &offset, rows * sizeof(struct CarString), &hash);
+    set->heap = nextSection(base, &offset, header.heapBytes, &hash);
+    set->rows = set->allocated = (int)rows;
+    set->heapUsed = set->heapSize = (size_t)header.heapBytes;
+    set->heapGarbage = (size_t)header.heapGarbage;
+    set->mapped = 1;
+    set->snapshot = file;
+
+    set->years.entries = (struct RangeEntry *)nextSection(base, &offset, rows * sizeof(struct RangeEntry), &hash);
+    set->years.count = set->years.allocated = (int)rows;
+    set->years.sorted = (int)header.yearsSorted;
+    set->years.mapped = 1;
+    set->capacities.entries = (struct RangeEntry *)nextSection(base, &offset, rows * sizeof(struct RangeEntry), &hash);
+    set->capacities.count = set->capacities.allocated = (int)rows;
+    set->capacities.sorted = (int)header.capacitiesSorted;
+    set->capacities.mapped = 1;
+
+    struct HashSlot *slots = (struct HashSlot *)nextSection(base, &offset, header.hashSlots * sizeof(struct HashSlot), &hash);
+    if (header.hashSlots > 0) {
+        set->registrations.slots = slots;
+        set->registrations.mask = (size_t)header.hashSlots - 1;
+        set->registrations.used = (size_t)header.hashUsed;
+        set->registrations.mapped = 1;
+    }
+    set->registrations.indexed = (int)header.hashIndexed;
+
+    const uint32_t *brandTable = (const uint32_t *)nextSection(base, &offset, (uint64_t)header.brandLists * 2 * sizeof(uint32_t), &hash);
+    int *brandPostings = (int *)nextSection(base, &offset, header.brandPostings * sizeof(int), &hash);
+    const uint32_t *modelTable = (const uint32_t *)nextSection(base, &offset, (uint64_t)header.modelLists * 2 * sizeof(uint32_t), &hash);
+    int *modelPostings = (int *)nextSection(base, &offset, header.modelPostings * sizeof(int), &hash);
+    const char *fuelBitmaps = nextSection(base, &offset, header.fuelBitmapBytes, &hash);
+    const char *typeBitmaps = nextSection(base, &offset, header.typeBitmapBytes, &hash);
+
+    if (hash != header.checksum ||
+        attachTrigrams(&set->brandTrigrams, brandTable, header.brandLists, brandPostings, header.brandPostings) != 0 ||
+        attachTrigrams(&set->modelTrigrams, modelTable, header.modelLists, modelPostings, header.modelPostings) != 0 ||
+        decodeBitmapIndex(&set->fuelBitmaps, fuelBitmaps, (size_t)header.fuelBitmapBytes, set->rows) != 0 ||
+        decodeBitmapIndex(&set->typeBitmaps, typeBitmaps, (size_t)header.typeBitmapBytes, set->rows) != 0) {
+        destroyCarSet(set);
+        return NULL;
+    }
+
+    syncIndexes(set);
+    if (bytes) {
+        *bytes = file.size;
+    }
+    return set;
+}
+
+/**
+ * @brief Writes one section of a snapshot, pads it and folds it into the running checksum.
+ * @param file Snapshot being written.
+ * @param data Source (may be NULL when @p size is 0).
+ * @param size Number of bytes to write.
+ * @param hash Running checksum.
+ * @return 1 on success, 0 on a write error.
+ */
+static int writeSection(FILE *file, const void *data, uint64_t size, uint64_t *hash) {
+    static const char zeros[8] = {0};
+    size_t padding = (size_t)(padSection(size) - size);
+    if ((size > 0 && fwrite(data, 1, (size_t)size, file) != size) ||
+        (padding > 0 && fwrite(zeros, 1, padding, file) != padding)) {
+        return 0;
+    }
+    *hash = checksumBytes(data, (size_t)size, *hash);
+    *hash = checksumBytes(zeros, padding, *hash);
+    return 1;
+}
+
+/**
+ * @brief Writes the posting lists of one trigram index.
+ * @param file Snapshot being written.
+ * @param index Index to write.
+ * @param hash Running checksum.
+ * @return 1 on success, 0 on a write error.
+ */
+static int writeTrigrams(FILE *file, const struct TrigramIndex *index, uint64_t *hash) {
+    size_t slots = index->lists ? index->mask + 1 : 0;
+    uint32_t *table = (uint32_t *)malloc((slots ? slots : 1) * 2 * sizeof *table);
+    if (!table) {
+        fprintf(stderr, "Memory allocation error.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    uint32_t lists = 0;
+    for (size_t i = 0; i < slots; i++) {
+        if (index->lists[i].count > 0) {
+            table[2 * lists] = index->lists[i].trigram;
+            table[2 * lists + 1] = (uint32_t)index->lists[i].count;
+            lists++;
+        }
+    }
+
+    int written = writeSection(file, table, (uint64_t)lists * 2 * sizeof *table, hash);
+    free(table);
+
+    // The rows of all lists form one section, so they are hashed as one block.
+    uint64_t total = 0;
+    for (size_t i = 0; i < slots; i++) {
+        total += (uint64_t)index->lists[i].count;
+    }
+    int *postings = (int *)malloc((size_t)(total ? total : 1) * sizeof *postings);
+    if (!postings) {
+        fprintf(stderr, "Memory allocation error.\n");
+        exit(EXIT_FAILURE);
+    }
+    uint64_t used = 0;
+    for (size_t i = 0; i < slots; i++) {
+        if (index->lists[i].count > 0) {
+            memcpy(postings + used, index->lists[i].rows, (size_t)index->lists[i].count * sizeof *postings);
+            used += (uint64_t)index->lists[i].count;
+        }
+    }
+    written = written && writeSection(file, postings, total * sizeof *postings, hash);
+    free(postings);
+    return written;
+}
+
+/**
+ * @brief Counts the non-empty posting lists and their rows.
+ * @param index Index to measure.
+ * @param lists Receives the number of non-empty lists.
+ * @param postings Receives the number of rows in all lists.
+ */
+static void measureTrigrams(const struct TrigramIndex *index, uint32_t *lists, uint64_t *postings) {
+    *lists = 0;
+    *postings = 0;
+    for (size_t i = 0; index->lists && i <= index->mask; i++) {
+        if (index->lists[i].count > 0) {
+            (*lists)++;
+            *postings += (uint64_t)index->lists[i].count;
+        }
+    }
+}
+
+/**
+ * @brief Writes a snapshot of a set.
+ *
+ * The file is written under a temporary name and renamed into place, so readers never
+ * see a partial snapshot. The header is written last, once the checksum is known.
+ *
+ * @param path Snapshot file to write.
+ * @param set Car set to write; removed cars must have been purged with purgeCars().
+ * @param sourcePath Text file the snapshot is written alongside, or NULL if there is none.
+ * @return 0 on success, -1 if the set has unpurged removed cars or the file cannot be written.
+ */
+int writeSnapshot(const char *path, const struct Cars *set, const char *sourcePath) {
+    char temporary[FILENAME_MAX];
+    if (set->deadRows > 0 || snprintf(temporary, sizeof temporary, "%s.tmp", path) >= (int)sizeof temporary) {
+        return -1;
+    }
+
+    FILE *file = fopen(temporary, "wb");
+    if (!file) {
+        return -1;
+    }
+
+    struct SnapshotHeader header;
+    memset(&header, 0, sizeof header);
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof SNAPSHOT_MAGIC);
+    header.version = SNAPSHOT_VERSION;
+    header.byteOrder = BYTE_ORDER_MARK;
+    header.rows = (uint32_t)set->rows;
+    header.hashIndexed = (uint32_t)set->registrations.indexed;
+    header.heapBytes = set->heapUsed;
+    header.heapGarbage = set->heapGarbage;
+    if (sourcePath && fileStamp(sourcePath, &header.sourceSize, &header.sourceTime) != 0) {
+        header.sourceSize = 0;
+        header.sourceTime = 0;
+    }
+    header.hashSlots = set->registrations.slots ? set->registrations.mask + 1 : 0;
+    header.hashUsed = set->registrations.used;
+    header.yearsSorted = (uint32_t)set->years.sorted;
+    header.capacitiesSorted = (uint32_t)set->capacities.sorted;
+    measureTrigrams(&set->brandTrigrams, &header.brandLists, &header.brandPostings);
+    measureTrigrams(&set->modelTrigrams, &header.modelLists, &header.modelPostings);
+    size_t fuelBytes, typeBytes;
+    void *fuelBitmaps = encodeBitmapIndex(&set->fuelBitmaps, &fuelBytes);
+    void *typeBitmaps = encodeBitmapIndex(&set->typeBitmaps, &typeBytes);
+    header.fuelBitmapBytes = fuelBytes;
+    header.typeBitmapBytes = typeBytes;
+
+    uint64_t hash = 0;
+    uint64_t rows = (uint64_t)set->rows;
+    int written = fwrite(&header, sizeof header, 1, file) == 1 &&
+                  writeSection(file, set->brand, rows * sizeof *set->brand, &hash) &&
+                  writeSection(file, set->model, rows * sizeof *set->model, &hash) &&
+                  writeSection(file, set->year, rows * sizeof *set->year, &hash) &&
+                  writeSection(file, set->capacity, rows * sizeof *set->capacity, &hash) &&
+                  writeSection(file, set->fuel, rows * sizeof *set->fuel, &hash) &&
+                  writeSection(file, set->type, rows * sizeof *set->type, &hash) &&
+                  writeSection(file, set->registration, rows * sizeof *set->registration, &hash) &&
+                  writeSection(file, set->heap, set->heapUsed, &hash) &&
+                  writeSection(file, set->years.entries, rows * sizeof(struct RangeEntry), &hash) &&
+                  writeSection(file, set->capacities.entries, rows * sizeof(struct RangeEntry), &hash) &&
+                  writeSection(file, set->registrations.slots, header.hashSlots * sizeof(struct HashSlot), &hash) &&
+                  writeTrigrams(file, &set->brandTrigrams, &hash) &&
+                  writeTrigrams(file, &set->modelTrigrams, &hash) &&
+                  writeSection(file, fuelBitmaps, fuelBytes, &hash) &&
+                  writeSection(file, typeBitmaps, typeBytes, &hash);
+    free(fuelBitmaps);
+    free(typeBitmaps);
+
+    header.checksum = hash;
+    written = written && fseek(file, 0, SEEK_SET) == 0 && fwrite(&header, sizeof header, 1, file) == 1;
+    if (fclose(file) != 0 || !written) {
+        remove(temporary);
+        return -1;
+    }
+
+    // rename() does not replace an existing file on Windows.
+    if (rename(temporary, path) != 0 && (remove(path) != 0 || rename(temporary, path) != 0)) {
+        remove(temporary);
+        return -1;
+    }
+    return 0;
+}
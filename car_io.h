@@ -0,0 +1,122 @@
+/**
+ * @file car_io.h
+ * @brief File formats of the car database: the base.txt text format and the binary snapshot.
+ *
+ * The text format is seven whitespace-separated fields per car. The snapshot is a memory
+ * image of a car set, columns and indexes included, that is mapped and used in place:
+ *
+ *     SnapshotHeader
+ *     brand, model                   rows x CarString
+ *     year, capacity                 rows x int
+ *     fuel, type, registration       rows x CarString
+ *     heap                           heapBytes bytes
+ *     year and capacity indexes      rows x RangeEntry each
+ *     registration index             hashSlots x HashSlot
+ *     brand trigram index            brandLists x (trigram, count), then brandPostings rows
+ *     model trigram index            modelLists x (trigram, count), then modelPostings rows
+ *     fuel and type bitmap indexes   fuelBitmapBytes and typeBitmapBytes bytes (see encodeBitmapIndex())
+ *
+ * Every section is zero-padded to a multiple of 8 bytes, and all values are in the byte
+ * order of the machine that wrote the file. The header records the size and modification
+ * time of the text file the snapshot was written alongside, so a text file edited by hand
+ * makes the snapshot stale.
+ */
+
+#ifndef CAR_IO_H
+#define CAR_IO_H
+
+#include "car_store.h"
+#include <stdint.h>
+#include <stdio.h>
+
+/** Identifies a snapshot file. */
+#define SNAPSHOT_MAGIC "CARSNAP"
+
+/** Current snapshot format version; files with another version are ignored. */
+#define SNAPSHOT_VERSION 2
+
+/**
+ * @struct SnapshotHeader
+ * @brief Fixed-size header at the start of a snapshot file.
+ */
+struct SnapshotHeader {
+    char magic[8];              ///< SNAPSHOT_MAGIC, NUL-padded.
+    uint32_t version;           ///< SNAPSHOT_VERSION.
+    uint32_t byteOrder;         ///< 0x01020304 as written by the producing machine.
+    uint32_t rows;              ///< Number of cars.
+    uint32_t hashIndexed;       ///< Rows already in the registration index.
+    uint64_t heapBytes;         ///< Bytes of the string heap.
+    uint64_t heapGarbage;       ///< Bytes of the heap held by strings of removed cars.
+    uint64_t sourceSize;        ///< Size of the text file when the snapshot was written.
+    int64_t sourceTime;         ///< Modification time of the text file, in nanoseconds.
+    uint64_t checksum;          ///< Checksum of every section after the header.
+    uint64_t hashSlots;         ///< Slots of the registration index (0 or a power of two).
+    uint64_t hashUsed;          ///< Occupied slots of the registration index.
+    uint32_t yearsSorted;       ///< Leading year index entries in sorted order.
+    uint32_t capacitiesSorted;  ///< Leading capacity index entries in sorted order.
+    uint32_t brandLists;        ///< Non-empty posting lists of the brand trigram index.
+    uint32_t modelLists;        ///< Non-empty posting lists of the model trigram index.
+    uint64_t brandPostings;     ///< Rows in all brand posting lists together.
+    uint64_t modelPostings;     ///< Rows in all model posting lists together.
+    uint64_t fuelBitmapBytes;   ///< Bytes of the encoded fuel bitmap index.
+    uint64_t typeBitmapBytes;   ///< Bytes of the encoded vehicle type bitmap index.
+};
+
+/**
+ * @brief Parses a text file and appends its cars to a set.
+ * @param path Text file to read.
+ * @param set Car set to append to; its indexes are synchronized afterwards.
+ * @param bytes Receives the size of the file (may be NULL).
+ * @return 0 on success, -1 if the file cannot be opened.
+ */
+int readTextCars(const char *path, struct Cars *set, size_t *bytes);
+
+/**
+ * @brief Parses the records of a block of a text file into the columns of a set, without indexing them.
+ * @param data First byte of the block, at the beginning of a record.
+ * @param size Size of the block.
+ * @param set Car set to append to; cars get IDs from Cars::nextId on if it has an ID column.
+ * @return Number of cars appended.
+ */
+int parseTextRecords(const char *data, size_t size, struct Cars *set);
+
+/**
+ * @brief Writes one car to a text file.
+ * @param file Stream to write to.
+ * @param set Car set holding the car.
+ * @param row Row of the car.
+ * @param first Non-zero for the first car of the file, which is not preceded by a newline.
+ */
+void writeTextRecord(FILE *file, const struct Cars *set, int row, int first);
+
+/**
+ * @brief Writes every live car of a set to a text file.
+ * @param path Text file to write.
+ * @param set Car set to write.
+ * @return 0 on success, -1 if the file cannot be written.
+ */
+int writeTextCars(const char *path, const struct Cars *set);
+
+/**
+ * @brief Maps a snapshot if it is present, intact and not older than its text file.
+ * @param path Snapshot file to read.
+ * @param sourcePath Text file the snapshot must match, or NULL to skip the staleness check.
+ * @param bytes Receives the size of the snapshot (may be NULL).
+ * @return Newly created car set, or NULL if the snapshot is missing, stale or damaged.
+ */
+struct Cars *readSnapshot(const char *path, const char *sourcePath, size_t *bytes);
+
+/**
+ * @brief Writes a snapshot of a set.
+ *
+ * The file is written under a temporary name and renamed into place, so readers never
+ * see a partial snapshot.
+ *
+ * @param path Snapshot file to write.
+ * @param set Car set to write; removed cars must have been purged with purgeCars().
+ * @param sourcePath Text file the snapshot is written alongside, or NULL if there is none.
+ * @return 0 on success, -1 if the set has unpurged removed cars or the file cannot be written.
+ */
+int writeSnapshot(const char *path, const struct Cars *set, const char *sourcePath);
+
+#endif // CAR_IO_H
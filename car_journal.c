@@ -0,0 +1,383 @@
+/**
+ * @file car_journal.c
+ * @brief Implementation of the change journal.
+ */
+
+#include "car_journal.h"
+#include "platform.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** Largest entry body: operation, year, capacity and five strings of up to 65535 bytes. */
+#define MAX_ENTRY_BYTES (1 + 2 * 4 + 5 * (2 + 65535))
+
+/**
+ * @brief Makes room for a number of bytes at the end of the pending entries.
+ * @param journal Journal to grow.
+ * @param bytes Number of bytes about to be appended.
+ * @return Pointer to the first free byte.
+ */
+static unsigned char *reservePending(struct Journal *journal, size_t bytes) {
+    if (journal->pendingBytes + bytes > journal->allocated) {
+        size_t allocated = journal->allocated ? journal->allocated * 2 : 4096;
+        while (allocated < journal->pendingBytes + bytes) {
+            allocated *= 2;
+        }
+        unsigned char *tmp = (unsigned char *)realloc(journal->pending, allocated);
+        if (!tmp) {
+            fprintf(stderr, "Memory allocation error.\n");
+            exit(EXIT_FAILURE);
+        }
+        journal->pending = tmp;
+        journal->allocated = allocated;
+    }
+    return journal->pending + journal->pendingBytes;
+}
+
+/**
+ * @brief Appends a 32-bit value to an entry being encoded.
+ * @param out Write position, advanced past the value.
+ * @param value Value to append.
+ */
+static void putUint32(unsigned char **out, uint32_t value) {
+    memcpy(*out, &value, sizeof value);
+    *out += sizeof value;
+}
+
+/**
+ * @brief Appends a length-prefixed string to an entry being encoded.
+ *
+ * Strings longer than 65535 bytes are cut at that length.
+ *
+ * @param out Write position, advanced past the string.
+ * @param text String to append.
+ * @param length Length of the string in bytes.
+ */
+static void putString(unsigned char **out, const char *text, size_t length) {
+    uint16_t stored = length > 65535 ? 65535 : (uint16_t)length;
+    memcpy(*out, &stored, sizeof stored);
+    memcpy(*out + sizeof stored, text, stored);
+    *out += sizeof stored + stored;
+}
+
+/**
+ * @brief Seals the entry encoded after the pending bytes: writes its size and checksum.
+ * @param journal Journal the entry was encoded into.
+ * @param end One past the last byte of the entry body.
+ */
+static void sealEntry(struct Journal *journal, unsigned char *end) {
+    unsigned char *entry = journal->pending + journal->pendingBytes;
+    uint32_t size = (uint32_t)(end - entry - 8);
+    uint32_t checksum = hashString((const char *)entry + 8, size);
+    memcpy(entry, &size, sizeof size);
+    memcpy(entry + 4, &checksum, sizeof checksum);
+    journal->pendingBytes += 8 + size;
+    journal->pendingEntries++;
+}
+
+/**
+ * @brief Tests whether a journal header belongs to the journal's base file.
+ * @param journal Journal bound to a base file.
+ * @param header Header read from a journal file.
+ * @return Non-zero if the header matches.
+ */
+static int headerMatches(const struct Journal *journal, const struct JournalHeader *header) {
+    return memcmp(header->magic, JOURNAL_MAGIC, sizeof JOURNAL_MAGIC) == 0 &&
+           header->version == JOURNAL_VERSION && header->byteOrder == 0x01020304 &&
+           journal->hasBase && header->baseSize == journal->baseSize && header->baseTime == journal->baseTime;
+}
+
+/**
+ * @brief Reads a 32-bit value from an entry being decoded.
+ * @param in Read position, advanced past the value.
+ * @param end One past the last byte of the entry.
+ * @param value Receives the value.
+ * @return 0 on success, -1 if the entry ends first.
+ */
+static int getUint32(unsigned char **in, const unsigned char *end, uint32_t *value) {
+    if ((size_t)(end - *in) < sizeof *value) {
+        return -1;
+    }
+    memcpy(value, *in, sizeof *value);
+    *in += sizeof *value;
+    return 0;
+}
+
+/**
+ * @brief Reads a length-prefixed string from an entry being decoded.
+ *
+ * The string is NUL-terminated in place by moving it over its length prefix.
+ *
+ * @param in Read position, advanced past the string.
+ * @param end One past the last byte of the entry.
+ * @param text Receives the string.
+ * @return 0 on success, -1 if the entry ends first.
+ */
+static int getString(unsigned char **in, const unsigned char *end, const char **text) {
+    uint16_t length;
+    if ((size_t)(end - *in) < sizeof length) {
+        return -1;
+    }
+    memcpy(&length, *in, sizeof length);
+    if ((size_t)(end - *in) - sizeof length < length) {
+        return -1;
+    }
+    // The prefix is two bytes, so the moved string always leaves room for its NUL.
+    memmove(*in, *in + sizeof length, length);
+    (*in)[length] = '\0';
+    *text = (const char *)*in;
+    *in += sizeof length + length;
+    return 0;
+}
+
+/**
+ * @brief Removes the live car with a record ID from the set being replayed into.
+ * @param id Record ID of the car.
+ * @param context The car set.
+ * @return 0 on success, -1 if there is no such car.
+ */
+static int eraseById(int id, void *context) {
+    struct Cars *set = (struct Cars *)context;
+    int row = findCarRow(set, id);
+    if (row < 0) {
+        return -1;
+    }
+    eraseCar(set, row);
+    return 0;
+}
+
+/**
+ * @brief Applies one decoded entry body to a car set.
+ * @param body Entry body; its strings are NUL-terminated in place.
+ * @param size Size of the body in bytes.
+ * @param set Car set added cars are appended to.
+ * @param eraseId Removes a car by record ID.
+ * @param context Passed to @p eraseId.
+ * @return 0 on success, -1 if the entry is malformed.
+ */
+static int applyEntry(unsigned char *body, size_t size, struct Cars *set, JournalRemover eraseId, void *context) {
+    const unsigned char *end = body + size;
+    unsigned char *in = body + 1;
+    uint32_t year, capacity, id;
+
+    if (size == 0) {
+        return -1;
+    }
+
+    if (body[0] == JOURNAL_ADD) {
+        struct CarRecord car;
+        if (getUint32(&in, end, &year) != 0 ||
+            getUint32(&in, end, &capacity) != 0 ||
+            getString(&in, end, &car.brand) != 0 || getString(&in, end, &car.model) != 0 ||
+            getString(&in, end, &car.fuel) != 0 || getString(&in, end, &car.type) != 0 ||
+            getString(&in, end, &car.registration) != 0 || in != end) {
+            return -1;
+        }
+        car.year = (int)year;
+        car.capacity = (int)capacity;
+        appendCar(set, &car);
+        return 0;
+    }
+
+    if (body[0] == JOURNAL_REMOVE) {
+        if (getUint32(&in, end, &id) != 0 || in != end || eraseId((int)id, context) != 0) {
+            return -1;
+        }
+        return 0;
+    }
+
+    return -1;
+}
+
+/**
+ * @brief Binds a journal to the current state of a base file and drops pending entries.
+ * @param journal Journal to reset.
+ * @param basePath Base file the journal applies to.
+ */
+void startJournal(struct Journal *journal, const char *basePath) {
+    journal->pendingBytes = 0;
+    journal->pendingEntries = 0;
+    journal->damaged = 0;
+    journal->hasBase = fileStamp(basePath, &journal->baseSize, &journal->baseTime) == 0;
+}
+
+/**
+ * @brief Records that a car was appended.
+ * @param journal Journal to record into.
+ * @param car Car that was appended.
+ */
+void journalAdd(struct Journal *journal, const struct CarRecord *car) {
+    const char *fields[5] = {car->brand, car->model, car->fuel, car->type, car->registration};
+    size_t bytes = 8 + 1 + 2 * 4;
+    for (int f = 0; f < 5; f++) {
+        bytes += 2 + strlen(fields[f]);
+    }
+
+    unsigned char *out = reservePending(journal, bytes) + 8;
+    *out++ = JOURNAL_ADD;
+    putUint32(&out, (uint32_t)car->year);
+    putUint32(&out, (uint32_t)car->capacity);
+    for (int f = 0; f < 5; f++) {
+        putString(&out, fields[f], strlen(fields[f]));
+    }
+    sealEntry(journal, out);
+}
+
+/**
+ * @brief Records that a car was removed.
+ * @param journal Journal to record into.
+ * @param id Record ID of the removed car.
+ */
+void journalRemove(struct Journal *journal, int id) {
+    unsigned char *out = reservePending(journal, 8 + 1 + 4) + 8;
+    *out++ = JOURNAL_REMOVE;
+    putUint32(&out, (uint32_t)id);
+    sealEntry(journal, out);
+}
+
+/**
+ * @brief Applies a journal file to a car set loaded from the journal's base file.
+ *
+ * Entries are applied up to the first torn or damaged one, which marks the journal as
+ * damaged so the next save rewrites the base instead of appending after it.
+ *
+ * @param journal Journal bound to the base file by startJournal().
+ * @param path Journal file to replay.
+ * @param set Car set to apply the entries to.
+ * @return Number of entries applied, or -1 if the file belongs to another base or version.
+ */
+int replayJournal(struct Journal *journal, const char *path, struct Cars *set) {
+    return replayJournalWith(journal, path, set, eraseById, set);
+}
+
+/**
+ * @brief Applies a journal file, appending added cars to a set and handing removals to a callback.
+ *
+ * Used when the cars of the base file are not all in the set, as in paged mode (see
+ * car_paged.h).
+ *
+ * @param journal Journal bound to the base file by startJournal().
+ * @param path Journal file to replay.
+ * @param set Car set added cars are appended to.
+ * @param eraseId Removes a car by record ID.
+ * @param context Passed to @p eraseId.
+ * @return Number of entries applied, or -1 if the file belongs to another base or version.
+ */
+int replayJournalWith(struct Journal *journal, const char *path, struct Cars *set, JournalRemover eraseId,
+                      void *context) {
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        return 0;
+    }
+
+    struct JournalHeader header;
+    if (fread(&header, sizeof header, 1, file) != 1 || !headerMatches(journal, &header)) {
+        fclose(file);
+        return -1;
+    }
+
+    unsigned char *body = (unsigned char *)malloc(MAX_ENTRY_BYTES);
+    if (!body) {
+        fprintf(stderr, "Memory allocation error.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    int applied = 0;
+    uint32_t prefix[2];
+    size_t got;
+    while ((got = fread(prefix, 1, sizeof prefix, file)) == sizeof prefix) {
+        if (prefix[0] > MAX_ENTRY_BYTES || fread(body, 1, prefix[0], file) != prefix[0] ||
+            hashString((const char *)body, prefix[0]) != prefix[1] ||
+            applyEntry(body, prefix[0], set, eraseId, context) != 0) {
+            journal->damaged = 1;
+            break;
+        }
+        applied++;
+    }
+    if (got > 0 && got < sizeof prefix) {
+        journal->damaged = 1;
+    }
+
+    free(body);
+    fclose(file);
+    syncIndexes(set);
+    return applied;
+}
+
+/**
+ * @brief Appends the pending entries to a journal file and synchronizes it once.
+ *
+ * Nothing is written if no entries are pending. The journal file is created on first use.
+ *
+ * @param journal Journal holding the pending entries; they are dropped once written.
+ * @param path Journal file to append to.
+ * @param basePath Base file the journal applies to.
+ * @return 0 on success, -1 if the base must be rewritten instead (the base file is missing
+ *         or changed, the journal file is damaged or belongs to another base, or an I/O
+ *         error occurred).
+ */
+int flushJournal(struct Journal *journal, const char *path, const char *basePath) {
+    if (journal->pendingEntries == 0) {
+        return 0;
+    }
+
+    uint64_t size;
+    int64_t time;
+    if (journal->damaged || !journal->hasBase || fileStamp(basePath, &size, &time) != 0 ||
+        size != journal->baseSize || time != journal->baseTime) {
+        return -1;
+    }
+
+    struct JournalHeader header;
+    int exists = 0;
+    FILE *file = fopen(path, "rb");
+    if (file) {
+        exists = 1;
+        int matches = fread(&header, sizeof header, 1, file) == 1 && headerMatches(journal, &header);
+        fclose(file);
+        if (!matches) {
+            return -1;
+        }
+    }
+
+    file = fopen(path, "ab");
+    if (!file) {
+        return -1;
+    }
+
+    int failed = 0;
+    if (!exists) {
+        memset(&header, 0, sizeof header);
+        memcpy(header.magic, JOURNAL_MAGIC, sizeof JOURNAL_MAGIC);
+        header.version = JOURNAL_VERSION;
+        header.byteOrder = 0x01020304;
+        header.baseSize = journal->baseSize;
+        header.baseTime = journal->baseTime;
+        failed = fwrite(&header, sizeof header, 1, file) != 1;
+    }
+    if (!failed) {
+        failed = fwrite(journal->pending, 1, journal->pendingBytes, file) != journal->pendingBytes ||
+                 syncFile(file) != 0;
+    }
+    failed |= fclose(file) != 0;
+    if (failed) {
+        return -1;
+    }
+
+    journal->pendingBytes = 0;
+    journal->pendingEntries = 0;
+    return 0;
+}
+
+/**
+ * @brief Frees the pending entries of a journal.
+ * @param journal Journal to free.
+ */
+void freeJournal(struct Journal *journal) {
+    free(journal->pending);
+    journal->pending = NULL;
+    journal->pendingBytes = 0;
+    journal->allocated = 0;
+    journal->pendingEntries = 0;
+}
@@ -0,0 +1,142 @@
+/**
+ * @file car_journal.h
+ * @brief Append-only journal of the changes made since the base file was last written.
+ *
+ * Adding and removing cars only records an entry in memory. Saving appends the recorded
+ * entries to the journal file and synchronizes it once, so the cost of a save follows the
+ * number of changes instead of the size of the fleet. On startup the journal is replayed
+ * over the loaded base, and compaction folds it back into a fresh base file.
+ *
+ *     JournalHeader
+ *     entry, entry, ...
+ *
+ * Each entry is a 32-bit body size, a 32-bit hashString() checksum of the body, and the
+ * body: an operation byte followed by either the seven fields of an added car (year and
+ * capacity as 32-bit integers, strings as a 16-bit length and their bytes) or the 32-bit
+ * record ID of a removed car, counted as if the base file had just been loaded. A torn or
+ * damaged entry ends the replay. The header records the size and nanosecond modification
+ * time of the base file the journal applies to, so a journal left next to a rewritten base
+ * is not applied to it; only a rewrite to the same size in the same tick of the file system
+ * clock would keep the stamp.
+ */
+
+#ifndef CAR_JOURNAL_H
+#define CAR_JOURNAL_H
+
+#include "car_store.h"
+#include <stdint.h>
+
+/** Identifies a journal file. */
+#define JOURNAL_MAGIC "CARJRNL"
+
+/** Current journal format version; files with another version are not applied. */
+#define JOURNAL_VERSION 2
+
+/** Operation codes stored in the first byte of an entry. */
+enum JournalOperation {
+    JOURNAL_ADD = 1,     ///< A car was appended.
+    JOURNAL_REMOVE = 2,  ///< The car with a record ID was removed.
+};
+
+/**
+ * @struct JournalHeader
+ * @brief Fixed-size header at the start of a journal file.
+ */
+struct JournalHeader {
+    char magic[8];       ///< JOURNAL_MAGIC, NUL-padded.
+    uint32_t version;    ///< JOURNAL_VERSION.
+    uint32_t byteOrder;  ///< 0x01020304 as written by the producing machine.
+    uint64_t baseSize;   ///< Size of the base file the journal applies to.
+    int64_t baseTime;    ///< Modification time of that base file, in nanoseconds.
+};
+
+/**
+ * @struct Journal
+ * @brief Entries waiting to be saved, and the base file they apply to.
+ */
+struct Journal {
+    unsigned char *pending;  ///< Encoded entries not yet written to the journal file.
+    size_t pendingBytes;     ///< Bytes used in @c pending.
+    size_t allocated;        ///< Bytes @c pending has room for.
+    int pendingEntries;      ///< Number of entries in @c pending.
+    int hasBase;             ///< Non-zero if the base file existed when it was loaded.
+    uint64_t baseSize;       ///< Size of the base file when it was loaded or written.
+    int64_t baseTime;        ///< Modification time of the base file at that point.
+    int damaged;             ///< Non-zero if the journal file ends in a damaged entry.
+};
+
+/**
+ * @brief Removes a car by record ID while a journal is replayed.
+ * @param id Record ID of the removed car.
+ * @param context Context passed to replayJournalWith().
+ * @return 0 on success, -1 if there is no live car with that ID.
+ */
+typedef int (*JournalRemover)(int id, void *context);
+
+/**
+ * @brief Binds a journal to the current state of a base file and drops pending entries.
+ * @param journal Journal to reset.
+ * @param basePath Base file the journal applies to.
+ */
+void startJournal(struct Journal *journal, const char *basePath);
+
+/**
+ * @brief Records that a car was appended.
+ * @param journal Journal to record into.
+ * @param car Car that was appended.
+ */
+void journalAdd(struct Journal *journal, const struct CarRecord *car);
+
+/**
+ * @brief Records that a car was removed.
+ * @param journal Journal to record into.
+ * @param id Record ID of the removed car.
+ */
+void journalRemove(struct Journal *journal, int id);
+
+/**
+ * @brief Applies a journal file to a car set loaded from the journal's base file.
+ *
+ * Entries are applied up to the first torn or damaged one, which marks the journal as
+ * damaged so the next save rewrites the base instead of appending after it.
+ *
+ * @param journal Journal bound to the base file by startJournal().
+ * @param path Journal file to replay.
+ * @param set Car set to apply the entries to.
+ * @return Number of entries applied, or -1 if the file belongs to another base or version.
+ */
+int replayJournal(struct Journal *journal, const char *path, struct Cars *set);
+
+/**
+ * @brief Applies a journal file, appending added cars to a set and handing removals to a callback.
+ * @param journal Journal bound to the base file by startJournal().
+ * @param path Journal file to replay.
+ * @param set Car set added cars are appended to.
+ * @param eraseId Removes a car by record ID.
+ * @param context Passed to @p eraseId.
+ * @return Number of entries applied, or -1 if the file belongs to another base or version.
+ */
+int replayJournalWith(struct Journal *journal, const char *path, struct Cars *set, JournalRemover eraseId,
+                      void *context);
+
+/**
+ * @brief Appends the pending entries to a journal file and synchronizes it once.
+ *
+ * Nothing is written if no entries are pending. The journal file is created on first use.
+ *
+ * @param journal Journal holding the pending entries; they are dropped once written.
+ * @param path Journal file to append to.
+ * @param basePath Base file the journal applies to.
+ * @return 0 on success, -1 if the base must be rewritten instead (the base file is missing
+ *         or changed, the journal file is damaged or belongs to another base, or an I/O
+ *         error occurred).
+ */
+int flushJournal(struct Journal *journal, const char *path, const char *basePath);
+
+/**
+ * @brief Frees the pending entries of a journal.
+ * @param journal Journal to free.
+ */
+void freeJournal(struct Journal *journal);
+
+#endif // CAR_JOURNAL_H
@@ -0,0 +1,293 @@
+/**
+ * @file car_order.c
+ * @brief Implementation of ordered listings and top-K selection.
+ */
+
+#include "car_order.h"
+#include "car_range.h"
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Parses an order written as FIELD, FIELD:asc or FIELD:desc.
+ * @param text The order, e.g. "year:desc".
+ * @param order Receives the order.
+ * @return 0 on success, -1 if the field or the direction is unknown.
+ */
+int parseOrder(const char *text, struct CarOrder *order) {
+    const char *colon = strchr(text, ':');
+    size_t length = colon ? (size_t)(colon - text) : strlen(text);
+    int field = findQueryField(text, length);
+    if (field < 0) {
+        return -1;
+    }
+
+    int descending = 0;
+    if (colon && strcmp(colon + 1, "desc") == 0) {
+        descending = 1;
+    } else if (colon && strcmp(colon + 1, "asc") != 0) {
+        return -1;
+    }
+    order->active = 1;
+    order->field = (enum QueryField)field;
+    order->descending = descending;
+    return 0;
+}
+
+/**
+ * @brief Compares the values of the order's field of two cars, which may belong to different sets.
+ * @param order Order to apply.
+ * @param a Car set holding the first car.
+ * @param rowA Row of the first car.
+ * @param b Car set holding the second car.
+ * @param rowB Row of the second car.
+ * @return Negative, zero or positive as the first value comes before, with or after the second.
+ */
+static int compareOrderedValues(const struct CarOrder *order, const struct Cars *a, int rowA, const struct Cars *b,
+                                int rowB) {
+    int result;
+    switch (order->field) {
+        case FIELD_YEAR:
+            result = (a->year[rowA] > b->year[rowB]) - (a->year[rowA] < b->year[rowB]);
+            break;
+        case FIELD_CAPACITY:
+            result = (a->capacity[rowA] > b->capacity[rowB]) - (a->capacity[rowA] < b->capacity[rowB]);
+            break;
+        default: {
+            const struct CarString *columnA = order->field == FIELD_BRAND   ? a->brand
+                                              : order->field == FIELD_MODEL ? a->model
+                                              : order->field == FIELD_FUEL  ? a->fuel
+                                              : order->field == FIELD_TYPE  ? a->type
+                                                                            : a->registration;
+            const struct CarString *columnB = order->field == FIELD_BRAND   ? b->brand
+                                              : order->field == FIELD_MODEL ? b->model
+                                              : order->field == FIELD_FUEL  ? b->fuel
+                                              : order->field == FIELD_TYPE  ? b->type
+                                                                            : b->registration;
+            result = strcmp(carString(a, columnA[rowA]), carString(b, columnB[rowB]));
+            break;
+        }
+    }
+    return order->descending ? -result : result;
+}
+
+/**
+ * @brief Compares two rows under an order, breaking ties by row.
+ * @param set Car set holding the rows.
+ * @param order Order to apply.
+ * @param a First row.
+ * @param b Second row.
+ * @return Negative, zero or positive as @p a comes before, with or after @p b.
+ */
+int compareOrderedRows(const struct Cars *set, const struct CarOrder *order, int a, int b) {
+    int result = compareOrderedValues(order, set, a, set, b);
+    if (result != 0) {
+        return result;
+    }
+    return (a > b) - (a < b);
+}
+
+/**
+ * @brief Compares two cars of possibly different sets under an order, breaking ties by record ID.
+ *
+ * Used to merge listings of several car sets whose record IDs do not overlap, such as the
+ * partitions of a partitioned database.
+ *
+ * @param order Order to apply.
+ * @param a Car set holding the first car.
+ * @param rowA Row of the first car.
+ * @param b Car set holding the second car.
+ * @param rowB Row of the second car.
+ * @return Negative, zero or positive as the first car comes before, with or after the second.
+ */
+int compareOrderedCars(const struct CarOrder *order, const struct Cars *a, int rowA, const struct Cars *b, int rowB) {
+    int result = compareOrderedValues(order, a, rowA, b, rowB);
+    if (result != 0) {
+        return result;
+    }
+    int idA = carId(a, rowA), idB = carId(b, rowB);
+    return (idA > idB) - (idA < idB);
+}
+
+/**
+ * @brief Restores the heap property below one entry of a heap whose root is the last row in order.
+ * @param set Car set holding the rows.
+ * @param order Order to apply.
+ * @param heap The heap.
+ * @param size Number of rows in the heap.
+ * @param i Entry to move down.
+ */
+static void siftDown(const struct Cars *set, const struct CarOrder *order, int *heap, int size, int i) {
+    for (;;) {
+        int last = i, left = 2 * i + 1, right = left + 1;
+        if (left < size && compareOrderedRows(set, order, heap[left], heap[last]) > 0) {
+            last = left;
+        }
+        if (right < size && compareOrderedRows(set, order, heap[right], heap[last]) > 0) {
+            last = right;
+        }
+        if (last == i) {
+            return;
+        }
+        int row = heap[i];
+        heap[i] = heap[last];
+        heap[last] = row;
+        i = last;
+    }
+}
+
+/**
+ * @brief Moves the first @p keep rows under an order to the front of a list, sorted.
+ *
+ * The front of the list serves as a heap of the best rows seen so far, with the last of
+ * them at the root; a later row only enters by replacing the root. Heapsort then puts the
+ * kept rows in order.
+ *
+ * @param set Car set holding the rows.
+ * @param order Order to apply.
+ * @param rows Row list, reordered in place.
+ * @param count Number of rows.
+ * @param keep Number of leading rows wanted, or 0 to sort them all.
+ * @return Number of sorted rows at the front of @p rows.
+ */
+int selectOrderedRows(const struct Cars *set, const struct CarOrder *order, int *rows, int count, long keep) {
+    int size = keep > 0 && keep < count ? (int)keep : count;
+    for (int i = size / 2 - 1; i >= 0; i--) {
+        siftDown(set, order, rows, size, i);
+    }
+    for (int i = size; i < count; i++) {
+        if (compareOrderedRows(set, order, rows[i], rows[0]) < 0) {
+            rows[0] = rows[i];
+            siftDown(set, order, rows, size, 0);
+        }
+    }
+    for (int last = size - 1; last > 0; last--) {
+        int row = rows[0];
+        rows[0] = rows[last];
+        rows[last] = row;
+        siftDown(set, order, rows, last, 0);
+    }
+    return size;
+}
+
+/**
+ * @brief Returns the sorted index on the field of an order, if there is one.
+ * @param set Car set to look in.
+ * @param order The order.
+ * @return The range index on the field, or NULL if the field has none.
+ */
+const struct RangeIndex *orderIndex(const struct Cars *set, const struct CarOrder *order) {
+    switch (order->field) {
+        case FIELD_YEAR:
+            return &set->years;
+        case FIELD_CAPACITY:
+            return &set->capacities;
+        default:
+            return NULL;
+    }
+}
+
+/**
+ * @brief Appends a row to a growing row list.
+ * @param rows The list.
+ * @param count Number of rows in the list.
+ * @param allocated Number of rows the list has room for.
+ * @param row Row to append.
+ */
+static void appendRow(int **rows, int *count, int *allocated, int row) {
+    if (*count == *allocated) {
+        *allocated = *allocated ? *allocated * 2 : 64;
+        int *grown = (int *)realloc(*rows, (size_t)*allocated * sizeof *grown);
+        if (!grown) {
+            fprintf(stderr, "Memory allocation error.\n");
+            exit(EXIT_FAILURE);
+        }
+        *rows = grown;
+    }
+    (*rows)[(*count)++] = row;
+}
+
+/**
+ * @brief Tests whether a row belongs in an ordered listing.
+ * @param set Car set holding the row.
+ * @param row Row to test.
+ * @param predicate Test the row must pass, or NULL.
+ * @param context Data passed to @p predicate.
+ * @return Non-zero if the row is live and passes the test.
+ */
+static int wantedRow(const struct Cars *set, int row, RowPredicate predicate, const void *context) {
+    return !isDeadRow(set, row) && (!predicate || predicate(set, row, context));
+}
+
+/**
+ * @brief Lists the first matching live rows under an order by walking its sorted index.
+ *
+ * Entries are sorted by (key, row). Walking backwards for a descending order, each run of
+ * equal keys is located with a binary search and read forwards, so equal cars still come
+ * out in car-number order.
+ *
+ * @param set Car set to list; the order's field must have an index (see orderIndex()).
+ * @param order Order to apply.
+ * @param predicate Test a row must pass, or NULL to list every live row.
+ * @param context Data passed to @p predicate.
+ * @param keep Number of rows wanted, or 0 for all of them.
+ * @param rows Receives a malloc'd array of the rows in order (NULL when empty).
+ * @param examined Incremented by the number of index entries visited.
+ * @return Number of rows listed.
+ */
+int walkOrderIndex(const struct Cars *set, const struct CarOrder *order, RowPredicate predicate, const void *context,
+                   long keep, int **rows, long *examined) {
+    const struct RangeIndex *index = orderIndex(set, order);
+    const struct RangeEntry *entries = index->entries;
+    long wanted = keep > 0 ? keep : LONG_MAX;
+    int count = 0, allocated = 0;
+    long visited = 0;
+    *rows = NULL;
+
+    if (!order->descending) {
+        for (int i = 0; i < index->sorted && count < wanted; i++, visited++) {
+            if (wantedRow(set, entries[i].row, predicate, context)) {
+                appendRow(rows, &count, &allocated, entries[i].row);
+            }
+        }
+    } else {
+        int end = index->sorted;
+        while (end > 0 && count < wanted) {
+            int key = entries[end - 1].key, low = 0, high = end - 1;
+            while (low < high) {
+                int middle = low + (high - low) / 2;
+                if (entries[middle].key < key) {
+                    low = middle + 1;
+                } else {
+                    high = middle;
+                }
+            }
+            for (int i = low; i < end && count < wanted; i++, visited++) {
+                if (wantedRow(set, entries[i].row, predicate, context)) {
+                    appendRow(rows, &count, &allocated, entries[i].row);
+                }
+            }
+            end = low;
+        }
+    }
+
+    // Pending entries can belong anywhere in the order; they join the selection.
+    int sortedRows = count;
+    for (int i = index->sorted; i < index->count; i++, visited++) {
+        if (wantedRow(set, entries[i].row, predicate, context)) {
+            appendRow(rows, &count, &allocated, entries[i].row);
+        }
+    }
+    if (count > sortedRows) {
+        count = selectOrderedRows(set, order, *rows, count, keep);
+    }
+
+    *examined += visited;
+    if (count == 0) {
+        free(*rows);
+        *rows = NULL;
+    }
+    return count;
+}
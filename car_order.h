@@ -0,0 +1,97 @@
+/**
+ * @file car_order.h
+ * @brief Ordered listings: sorting rows on any field and selecting the first K of them.
+ *
+ * Listings are in car-number order unless an order is set. When only the first K cars of a
+ * listing can be shown, the rows are not sorted as a whole: a bounded heap of K rows keeps
+ * the best ones seen so far, so ordering n rows costs O(n log K). Year and engine capacity
+ * have sorted range indexes, and for them the rows can instead be read off the index in
+ * order, stopping after K matches. Cars that compare equal are listed in car-number order.
+ */
+
+#ifndef CAR_ORDER_H
+#define CAR_ORDER_H
+
+#include "car_parallel.h"
+#include "car_query.h"
+
+/**
+ * @struct CarOrder
+ * @brief Field and direction a listing is sorted on.
+ */
+struct CarOrder {
+    int active;             ///< Non-zero if the listing is sorted; car-number order otherwise.
+    enum QueryField field;  ///< Field to sort on.
+    int descending;         ///< Non-zero for the largest value (or the last string) first.
+};
+
+/**
+ * @brief Parses an order written as FIELD, FIELD:asc or FIELD:desc.
+ * @param text The order, e.g. "year:desc".
+ * @param order Receives the order.
+ * @return 0 on success, -1 if the field or the direction is unknown.
+ */
+int parseOrder(const char *text, struct CarOrder *order);
+
+/**
+ * @brief Compares two rows under an order, breaking ties by row.
+ * @param set Car set holding the rows.
+ * @param order Order to apply.
+ * @param a First row.
+ * @param b Second row.
+ * @return Negative, zero or positive as @p a comes before, with or after @p b.
+ */
+int compareOrderedRows(const struct Cars *set, const struct CarOrder *order, int a, int b);
+
+/**
+ * @brief Compares two cars of possibly different sets under an order, breaking ties by record ID.
+ * @param order Order to apply.
+ * @param a Car set holding the first car.
+ * @param rowA Row of the first car.
+ * @param b Car set holding the second car.
+ * @param rowB Row of the second car.
+ * @return Negative, zero or positive as the first car comes before, with or after the second.
+ */
+int compareOrderedCars(const struct CarOrder *order, const struct Cars *a, int rowA, const struct Cars *b, int rowB);
+
+/**
+ * @brief Moves the first @p keep rows under an order to the front of a list, sorted.
+ *
+ * A bounded heap of @p keep rows is filled in one pass, so the cost is O(count log keep).
+ *
+ * @param set Car set holding the rows.
+ * @param order Order to apply.
+ * @param rows Row list, reordered in place.
+ * @param count Number of rows.
+ * @param keep Number of leading rows wanted, or 0 to sort them all.
+ * @return Number of sorted rows at the front of @p rows.
+ */
+int selectOrderedRows(const struct Cars *set, const struct CarOrder *order, int *rows, int count, long keep);
+
+/**
+ * @brief Returns the sorted index on the field of an order, if there is one.
+ * @param set Car set to look in.
+ * @param order The order.
+ * @return The range index on the field, or NULL if the field has none.
+ */
+const struct RangeIndex *orderIndex(const struct Cars *set, const struct CarOrder *order);
+
+/**
+ * @brief Lists the first matching live rows under an order by walking its sorted index.
+ *
+ * The sorted part of the index is read from the front or the back and the walk stops once
+ * @p keep rows have matched; entries still pending in the index are all tested.
+ *
+ * @param set Car set to list; the order's field must have an index (see orderIndex()).
+ * @param order Order to apply.
+ * @param predicate Test a row must pass, or NULL to list every live row.
+ * @param context Data passed to @p predicate.
+ * @param keep Number of rows wanted, or 0 for all of them.
+ * @param rows Receives a malloc'd array of the rows in order (NULL when empty).
+ * @param examined Incremented by the number of index entries visited.
+ * @return Number of rows listed.
+ */
+int walkOrderIndex(const struct Cars *set, const struct CarOrder *order, RowPredicate predicate, const void *context,
+                   long keep, int **rows, long *examined);
+
+#endif // CAR_ORDER_H
@@ -0,0 +1,211 @@
+/**
+ * @file car_output.c
+ * @brief Implementation of the buffered listing renderer.
+ */
+
+#include "car_output.h"
+#include "platform.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static char *buffer = NULL;    ///< Render buffer of OUTPUT_BUFFER_BYTES, allocated on first use.
+static size_t used = 0;        ///< Bytes of the buffer waiting to be written.
+static long firstShown = 0;    ///< Matching cars skipped at the start of each listing.
+static long maxShown = 0;      ///< Largest number of cars per listing, or 0 for no limit.
+static int compactLayout = 0;  ///< Non-zero for one line per car.
+
+/**
+ * @brief Writes the buffered bytes to standard output.
+ *
+ * A failed write, e.g. to a closed pipe, drops the bytes, as printf() would.
+ */
+static void flushBuffer(void) {
+    if (used > 0) {
+        writeStream(stdout, buffer, used);
+    }
+    used = 0;
+}
+
+/**
+ * @brief Appends bytes to the buffer, writing it out whenever it fills up.
+ * @param data Bytes to append.
+ * @param size Number of bytes.
+ */
+static void putBytes(const char *data, size_t size) {
+    while (size > OUTPUT_BUFFER_BYTES - used) {
+        size_t room = OUTPUT_BUFFER_BYTES - used;
+        memcpy(buffer + used, data, room);
+        used += room;
+        data += room;
+        size -= room;
+        flushBuffer();
+    }
+    memcpy(buffer + used, data, size);
+    used += size;
+}
+
+/**
+ * @brief Appends a string literal to the buffer.
+ * @param literal The literal.
+ */
+#define PUT_LITERAL(literal) putBytes(literal, sizeof(literal) - 1)
+
+/**
+ * @brief Appends a string from the car set's heap, using its stored length.
+ * @param set Car set owning the string.
+ * @param ref Reference to the string.
+ */
+static void putString(const struct Cars *set, struct CarString ref) {
+    putBytes(carString(set, ref), ref.length);
+}
+
+/**
+ * @brief Appends an integer in decimal.
+ * @param value The integer.
+ */
+static void putInt(long value) {
+    char digits[24];
+    char *end = digits + sizeof digits, *start = end;
+    unsigned long magnitude = value < 0 ? 0UL - (unsigned long)value : (unsigned long)value;
+    do {
+        *--start = (char)('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude > 0);
+    if (value < 0) {
+        *--start = '-';
+    }
+    putBytes(start, (size_t)(end - start));
+}
+
+/**
+ * @brief Sets the pagination and layout of all later listings.
+ * @param offset Number of matching cars to skip at the start of each listing.
+ * @param limit Largest number of cars shown per listing, or 0 for no limit.
+ * @param compact Non-zero for one line per car, zero for the multi-line layout.
+ */
+void setOutputOptions(long offset, long limit, int compact) {
+    firstShown = offset > 0 ? offset : 0;
+    maxShown = limit > 0 ? limit : 0;
+    compactLayout = compact;
+}
+
+/**
+ * @brief Returns how many leading cars of a listing decide what it shows.
+ * @return Number of leading cars, or 0 without a limit.
+ */
+long outputWindow(void) {
+    return maxShown > 0 ? firstShown + maxShown + 1 : 0;
+}
+
+/**
+ * @brief Returns how many leading cars of every listing are skipped.
+ * @return The offset set by setOutputOptions().
+ */
+long outputOffset(void) {
+    return firstShown;
+}
+
+/**
+ * @brief Starts a listing.
+ * @param output Listing to start.
+ */
+void beginOutput(struct CarOutput *output) {
+    if (!buffer) {
+        buffer = (char *)malloc(OUTPUT_BUFFER_BYTES);
+        if (!buffer) {
+            fprintf(stderr, "Memory allocation error.\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    fflush(stdout);
+    used = 0;
+    output->skipped = 0;
+    output->shown = 0;
+    output->truncated = 0;
+}
+
+/**
+ * @brief Renders one car of a listing, subject to the offset and limit.
+ *
+ * The multi-line layout matches what the program has always printed for a car; the compact
+ * layout puts the same fields on one line.
+ *
+ * @param output Listing being rendered.
+ * @param set Car set holding the car.
+ * @param row Row of the car; its record ID is displayed as the car number.
+ * @return Non-zero if more cars may follow, zero once the limit is reached.
+ */
+int outputCar(struct CarOutput *output, const struct Cars *set, int row) {
+    if (output->skipped < firstShown) {
+        output->skipped++;
+        return 1;
+    }
+    if (maxShown > 0 && output->shown >= maxShown) {
+        output->truncated = 1;
+        return 0;
+    }
+    output->shown++;
+
+    if (compactLayout) {
+        PUT_LITERAL("Car ");
+        putInt(carId(set, row));
+        PUT_LITERAL(": ");
+        putString(set, set->brand[row]);
+        PUT_LITERAL(" ");
+        putString(set, set->model[row]);
+        PUT_LITERAL(", ");
+        putInt(set->year[row]);
+        PUT_LITERAL(", ");
+        putInt(set->capacity[row]);
+        PUT_LITERAL(" cm^3, ");
+        putString(set, set->fuel[row]);
+        PUT_LITERAL(", ");
+        putString(set, set->type[row]);
+        PUT_LITERAL(", ");
+        putString(set, set->registration[row]);
+        PUT_LITERAL("\n");
+        return 1;
+    }
+
+    PUT_LITERAL("\nCar number: ");
+    putInt(carId(set, row));
+    PUT_LITERAL("\nBrand: ");
+    putString(set, set->brand[row]);
+    PUT_LITERAL("\nModel: ");
+    putString(set, set->model[row]);
+    PUT_LITERAL("\nYear: ");
+    putInt(set->year[row]);
+    PUT_LITERAL("\nEngine capacity: ");
+    putInt(set->capacity[row]);
+    PUT_LITERAL(" cm^3\nFuel: ");
+    putString(set, set->fuel[row]);
+    PUT_LITERAL("\nVehicle type: ");
+    putString(set, set->type[row]);
+    PUT_LITERAL("\nRegistration number: ");
+    putString(set, set->registration[row]);
+    PUT_LITERAL("\n");
+    return 1;
+}
+
+/**
+ * @brief Finishes a listing and writes out what is left in the buffer.
+ * @param output Listing to finish.
+ */
+void endOutput(struct CarOutput *output) {
+    if (output->truncated) {
+        PUT_LITERAL("\nMore cars match; use --offset ");
+        putInt(output->skipped + output->shown);
+        PUT_LITERAL(" to see the next ones.\n");
+    }
+    flushBuffer();
+}
+
+/**
+ * @brief Frees the render buffer; the next listing allocates it again.
+ */
+void freeOutputBuffer(void) {
+    free(buffer);
+    buffer = NULL;
+    used = 0;
+}
@@ -0,0 +1,87 @@
+/**
+ * @file car_output.h
+ * @brief Buffered rendering of car listings with pagination and a compact layout.
+ *
+ * Cars are formatted into one large reusable buffer, copying strings straight from the
+ * string heap, and the buffer is handed to write() whenever it fills up. A listing of a
+ * million cars therefore costs a few hundred system calls instead of millions of small,
+ * locked stdio writes. The offset, limit and layout set by setOutputOptions() apply to
+ * every listing: the full list and the results of each search.
+ */
+
+#ifndef CAR_OUTPUT_H
+#define CAR_OUTPUT_H
+
+#include "car_store.h"
+
+/** Size of the render buffer; it is written out whenever it fills up. */
+#define OUTPUT_BUFFER_BYTES (256 * 1024)
+
+/**
+ * @struct CarOutput
+ * @brief Progress of one listing.
+ */
+struct CarOutput {
+    long skipped;   ///< Cars passed over because of the offset.
+    long shown;     ///< Cars rendered so far.
+    int truncated;  ///< Non-zero once a car was refused because of the limit.
+};
+
+/**
+ * @brief Sets the pagination and layout of all later listings.
+ * @param offset Number of matching cars to skip at the start of each listing.
+ * @param limit Largest number of cars shown per listing, or 0 for no limit.
+ * @param compact Non-zero for one line per car, zero for the multi-line layout.
+ */
+void setOutputOptions(long offset, long limit, int compact);
+
+/**
+ * @brief Returns how many leading cars of a listing decide what it shows.
+ *
+ * That is the offset, the limit and one more car, which tells whether the listing was cut
+ * short. An ordered listing only needs to select that many cars.
+ *
+ * @return Number of leading cars, or 0 without a limit.
+ */
+long outputWindow(void);
+
+/**
+ * @brief Returns how many leading cars of every listing are skipped.
+ * @return The offset set by setOutputOptions().
+ */
+long outputOffset(void);
+
+/**
+ * @brief Starts a listing.
+ *
+ * Anything already printed with stdio is flushed first, so the listing follows it.
+ *
+ * @param output Listing to start.
+ */
+void beginOutput(struct CarOutput *output);
+
+/**
+ * @brief Renders one car of a listing, subject to the offset and limit.
+ * @param output Listing being rendered.
+ * @param set Car set holding the car.
+ * @param row Row of the car; its record ID is displayed as the car number.
+ * @return Non-zero if more cars may follow, zero once the limit is reached (the car was not
+ *         rendered, and the caller can stop looking for matches).
+ */
+int outputCar(struct CarOutput *output, const struct Cars *set, int row);
+
+/**
+ * @brief Finishes a listing and writes out what is left in the buffer.
+ *
+ * A listing cut short by the limit ends with a note giving the offset to continue from.
+ *
+ * @param output Listing to finish.
+ */
+void endOutput(struct CarOutput *output);
+
+/**
+ * @brief Frees the render buffer; the next listing allocates it again.
+ */
+void freeOutputBuffer(void);
+
+#endif // CAR_OUTPUT_H
@@ -0,0 +1,612 @@
+/**
+ * @file car_paged.c
+ * @brief Implementation of paged access to large text files.
+ */
+
+#include "car_paged.h"
+#include "car_io.h"
+#include "car_stats.h"
+#include <stdlib.h>
+#include <string.h>
+
+/** Longest string field, as split by the text loader (see car_io.c). */
+#define MAX_FIELD_LENGTH 99
+
+/** Fields of one car in the text format. */
+#define RECORD_FIELDS 7
+
+/**
+ * @brief Allocates zeroed memory or exits.
+ * @param count Number of elements.
+ * @param size Size of one element.
+ * @return The memory.
+ */
+static void *allocateZeroed(size_t count, size_t size) {
+    void *memory = calloc(count > 0 ? count : 1, size);
+    if (!memory) {
+        fprintf(stderr, "Memory allocation error.\n");
+        exit(EXIT_FAILURE);
+    }
+    return memory;
+}
+
+/**
+ * @brief Makes the read buffer at least a given size.
+ * @param paged The paged file.
+ * @param size Bytes needed.
+ */
+static void reserveBuffer(struct PagedCars *paged, size_t size) {
+    if (size <= paged->bufferSize) {
+        return;
+    }
+    char *buffer = (char *)realloc(paged->buffer, size);
+    if (!buffer) {
+        fprintf(stderr, "Memory allocation error.\n");
+        exit(EXIT_FAILURE);
+    }
+    paged->buffer = buffer;
+    paged->bufferSize = size;
+}
+
+/**
+ * @brief Reads a byte range of the paged file into the read buffer.
+ * @param paged The paged file.
+ * @param offset First byte.
+ * @param size Number of bytes.
+ * @return 0 on success, -1 on an I/O error or if the file has shrunk.
+ */
+static int readRange(struct PagedCars *paged, uint64_t offset, size_t size) {
+    reserveBuffer(paged, size);
+    if (seekFile(paged->file, offset) != 0 || fread(paged->buffer, 1, size, paged->file) != size) {
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @struct FieldCounter
+ * @brief State of the sequential pass that finds where the pages begin.
+ */
+struct FieldCounter {
+    long long fields;      ///< Fields begun so far.
+    int run;               ///< Bytes of the current field, restarting after MAX_FIELD_LENGTH like the loader.
+    int numeric;           ///< Non-zero while the current field is a year or a capacity.
+    int digits;            ///< Digits in the current number field.
+    int valid;             ///< Non-zero while the current number field is a plain decimal integer.
+    int irregular;         ///< Non-zero once a number field is not a plain decimal integer.
+    uint64_t *offsets;     ///< Page offsets found so far.
+    int count;             ///< Number of page offsets.
+    int allocated;         ///< Number of page offsets there is room for.
+};
+
+/**
+ * @brief Finishes the current field, checking it if it is a number.
+ * @param counter The pass.
+ */
+static void endField(struct FieldCounter *counter) {
+    if (counter->numeric && (!counter->valid || counter->digits == 0)) {
+        counter->irregular = 1;
+    }
+    counter->run = 0;
+    counter->numeric = 0;
+}
+
+/**
+ * @brief Feeds one block of the file to the pass.
+ *
+ * Fields are counted exactly as countChunkFields() in car_io.c counts them, so every
+ * seventh field starts a record and every PAGE_RECORDS-th record a page. The loader reads
+ * a number as far as its digits go, which only splits fields the same way when the number
+ * is the whole field; any other number field marks the file irregular.
+ *
+ * @param counter The pass.
+ * @param block Bytes of the block.
+ * @param size Size of the block.
+ * @param offset File offset of the block.
+ */
+static void countFields(struct FieldCounter *counter, const char *block, size_t size, uint64_t offset) {
+    static const unsigned char fieldSpace[256] = {[' '] = 1, ['\n'] = 1, ['\r'] = 1, ['\t'] = 1, ['\v'] = 1, ['\f'] = 1};
+    const unsigned char *bytes = (const unsigned char *)block;
+    for (size_t i = 0; i < size; i++) {
+        unsigned char c = bytes[i];
+        if (fieldSpace[c]) {
+            if (counter->run > 0) {
+                endField(counter);
+            }
+            continue;
+        }
+
+        int isDigit = c >= '0' && c <= '9';
+        if (counter->run == 0) {
+            long long field = counter->fields++;
+            if (field % ((long long)RECORD_FIELDS * PAGE_RECORDS) == 0) {
+                if (counter->count == counter->allocated) {
+                    counter->allocated = counter->allocated ? counter->allocated * 2 : 1024;
+                    uint64_t *offsets = (uint64_t *)realloc(counter->offsets,
+                                                            (size_t)counter->allocated * sizeof *offsets);
+                    if (!offsets) {
+                        fprintf(stderr, "Memory allocation error.\n");
+                        exit(EXIT_FAILURE);
+                    }
+                    counter->offsets = offsets;
+                }
+                counter->offsets[counter->count++] = offset + i;
+            }
+            counter->numeric = field % RECORD_FIELDS == 2 || field % RECORD_FIELDS == 3;
+            counter->valid = isDigit || c == '+' || c == '-';
+            counter->digits = isDigit;
+        } else {
+            counter->valid &= isDigit;
+            counter->digits += isDigit;
+        }
+
+        if (++counter->run == MAX_FIELD_LENGTH) {
+            // The loader splits the token here; a number this long is not a plain field.
+            if (counter->numeric) {
+                counter->irregular = 1;
+            }
+            endField(counter);
+        }
+    }
+}
+
+/**
+ * @brief Opens a text file in paged mode, building its offset index with one sequential read.
+ *
+ * The page cache gets what is left of the memory limit once the index, the removal bitmap,
+ * the read buffer and PAGED_RESERVED_BYTES are set aside, but room for at least
+ * PAGED_MIN_CACHE_PAGES pages.
+ *
+ * @param path Text file to open.
+ * @param memoryLimit Memory the program should stay within.
+ * @return The paged file, or NULL if it cannot be read or a number runs into other characters.
+ */
+struct PagedCars *openPagedCars(const char *path, size_t memoryLimit) {
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        return NULL;
+    }
+
+    struct PagedCars *paged = (struct PagedCars *)allocateZeroed(1, sizeof *paged);
+    paged->file = file;
+    reserveBuffer(paged, PAGED_READ_BYTES);
+    adviseSequential(file);
+
+    struct FieldCounter counter = {0};
+    size_t got;
+    while ((got = fread(paged->buffer, 1, PAGED_READ_BYTES, file)) > 0) {
+        countFields(&counter, paged->buffer, got, paged->size);
+        paged->size += got;
+    }
+    if (counter.run > 0) {
+        endField(&counter);
+    }
+    if (ferror(file) || counter.irregular || counter.fields / RECORD_FIELDS > INT32_MAX) {
+        free(counter.offsets);
+        closePagedCars(paged);
+        return NULL;
+    }
+
+    paged->records = (int)(counter.fields / RECORD_FIELDS);
+    paged->pages = (paged->records + PAGE_RECORDS - 1) / PAGE_RECORDS;
+    // The last offset may start an incomplete record; the file size ends the last page instead.
+    paged->offsets = (uint64_t *)allocateZeroed((size_t)paged->pages + 1, sizeof *paged->offsets);
+    if (paged->pages > 0) {
+        memcpy(paged->offsets, counter.offsets, (size_t)paged->pages * sizeof *paged->offsets);
+    }
+    paged->offsets[paged->pages] = paged->size;
+    free(counter.offsets);
+
+    paged->cached = (struct CachedPage **)allocateZeroed((size_t)paged->pages, sizeof *paged->cached);
+    paged->added = createCarSet();
+    useCarIds(paged->added);
+    paged->added->nextId = paged->records + 1;
+
+    size_t bitmapBytes = ((size_t)paged->records + 63) / 64 * sizeof *paged->dead +
+                         (size_t)paged->pages * sizeof *paged->deadInPage;
+    size_t fixed = pagedIndexBytes(paged) + bitmapBytes + paged->bufferSize + PAGED_RESERVED_BYTES;
+    size_t minimum = (size_t)PAGED_MIN_CACHE_PAGES * PAGE_RECORDS * (FIXED_RECORD_BYTES / 4);
+    paged->cacheLimit = memoryLimit > fixed + minimum ? memoryLimit - fixed : minimum;
+    return paged;
+}
+
+/**
+ * @brief Takes a page out of the recency list.
+ * @param paged The paged file.
+ * @param page Cached page to unlink.
+ */
+static void unlinkPage(struct PagedCars *paged, struct CachedPage *page) {
+    if (page->newer) {
+        page->newer->older = page->older;
+    } else {
+        paged->newest = page->older;
+    }
+    if (page->older) {
+        page->older->newer = page->newer;
+    } else {
+        paged->oldest = page->newer;
+    }
+    page->newer = page->older = NULL;
+}
+
+/**
+ * @brief Puts a page at the most recently used end of the list.
+ * @param paged The paged file.
+ * @param page Cached page, not in the list.
+ */
+static void linkNewest(struct PagedCars *paged, struct CachedPage *page) {
+    page->older = paged->newest;
+    page->newer = NULL;
+    if (paged->newest) {
+        paged->newest->newer = page;
+    } else {
+        paged->oldest = page;
+    }
+    paged->newest = page;
+}
+
+/**
+ * @brief Removes a page from the cache and frees it.
+ * @param paged The paged file.
+ * @param page Cached page to drop.
+ */
+static void dropPage(struct PagedCars *paged, struct CachedPage *page) {
+    unlinkPage(paged, page);
+    paged->cached[page->page] = NULL;
+    paged->cacheBytes -= page->bytes;
+    destroyCarSet(page->cars);
+    free(page);
+}
+
+/**
+ * @brief Empties a car set used to parse pages into, keeping its memory.
+ * @param set Scratch set without indexes.
+ * @param firstId Record ID of the first car to be parsed into it.
+ */
+static void resetScratch(struct Cars *set, int firstId) {
+    set->rows = 0;
+    set->heapUsed = 0;
+    set->nextId = firstId;
+}
+
+/**
+ * @brief Returns the cars of a page, from the cache or read and parsed into it.
+ *
+ * A page read from the file becomes the most recently used one, and the least recently
+ * used pages are evicted until the cache is back within its budget.
+ *
+ * @param paged The paged file.
+ * @param page Page number.
+ * @return Cars of the page, or NULL on an I/O error.
+ */
+static const struct Cars *loadPage(struct PagedCars *paged, int page) {
+    struct CachedPage *cached = paged->cached[page];
+    if (cached) {
+        unlinkPage(paged, cached);
+        linkNewest(paged, cached);
+        countPageLookup(PAGE_HIT);
+        return cached->cars;
+    }
+
+    size_t size = (size_t)(paged->offsets[page + 1] - paged->offsets[page]);
+    if (readRange(paged, paged->offsets[page], size) != 0) {
+        return NULL;
+    }
+    struct Cars *cars = createCarSet();
+    reserveCars(cars, PAGE_RECORDS, size + 1);
+    useCarIds(cars);
+    resetScratch(cars, page * PAGE_RECORDS + 1);
+    parseTextRecords(paged->buffer, size, cars);
+
+    cached = (struct CachedPage *)allocateZeroed(1, sizeof *cached);
+    cached->page = page;
+    cached->cars = cars;
+    cached->bytes = sizeof *cached + sizeof *cars + cars->heapSize +
+                    (size_t)cars->allocated * (5 * sizeof(struct CarString) + 3 * sizeof(int));
+    paged->cached[page] = cached;
+    paged->cacheBytes += cached->bytes;
+    linkNewest(paged, cached);
+    countPageLookup(PAGE_MISS);
+
+    while (paged->cacheBytes > paged->cacheLimit && paged->oldest != cached) {
+        dropPage(paged, paged->oldest);
+        countPageLookup(PAGE_EVICTED);
+    }
+    return cars;
+}
+
+/**
+ * @brief Tests whether a record of the file was removed.
+ * @param paged The paged file.
+ * @param id Record ID, at most PagedCars::records.
+ * @return Non-zero if the record was removed.
+ */
+static int isRemoved(const struct PagedCars *paged, int id) {
+    return paged->dead && (paged->dead[(id - 1) >> 6] >> ((id - 1) & 63) & 1);
+}
+
+/**
+ * @brief Returns the number of records of a page that were not removed.
+ * @param paged The paged file.
+ * @param page Page number.
+ * @return Number of live records.
+ */
+static int livePageRecords(const struct PagedCars *paged, int page) {
+    int records = page == paged->pages - 1 ? paged->records - page * PAGE_RECORDS : PAGE_RECORDS;
+    return records - (paged->deadInPage ? paged->deadInPage[page] : 0);
+}
+
+/**
+ * @brief Closes a paged file and frees its index, its cache and its added cars.
+ * @param paged Paged file to close (may be NULL).
+ */
+void closePagedCars(struct PagedCars *paged) {
+    if (!paged) {
+        return;
+    }
+    while (paged->newest) {
+        dropPage(paged, paged->newest);
+    }
+    fclose(paged->file);
+    destroyCarSet(paged->added);
+    free(paged->offsets);
+    free(paged->dead);
+    free(paged->deadInPage);
+    free(paged->cached);
+    free(paged->buffer);
+    free(paged);
+}
+
+/**
+ * @brief Returns the number of live cars: those of the file not removed, and the added ones.
+ * @param paged The paged file.
+ * @return Number of cars.
+ */
+int pagedLiveCars(const struct PagedCars *paged) {
+    return paged->records - paged->deadRecords + liveCars(paged->added);
+}
+
+/**
+ * @brief Returns the memory held by the offset index and the removal bitmap.
+ * @param paged The paged file.
+ * @return Bytes.
+ */
+size_t pagedIndexBytes(const struct PagedCars *paged) {
+    size_t bytes = ((size_t)paged->pages + 1) * sizeof *paged->offsets + (size_t)paged->pages * sizeof *paged->cached;
+    if (paged->dead) {
+        bytes += ((size_t)paged->records + 63) / 64 * sizeof *paged->dead +
+                 (size_t)paged->pages * sizeof *paged->deadInPage;
+    }
+    return bytes;
+}
+
+/**
+ * @brief Finds the live car with a record ID, reading its page through the page cache.
+ *
+ * Cars of the file are found on page (ID - 1) / PAGE_RECORDS, at row (ID - 1) % PAGE_RECORDS.
+ *
+ * @param paged The paged file.
+ * @param id Record ID.
+ * @param set Receives the car set holding the car, valid until the next page is read.
+ * @param row Receives the row of the car.
+ * @return 0 on success, -1 if there is no live car with that ID.
+ */
+int findPagedCar(struct PagedCars *paged, int id, const struct Cars **set, int *row) {
+    if (id > paged->records) {
+        *set = paged->added;
+        *row = findCarRow(paged->added, id);
+        return *row >= 0 ? 0 : -1;
+    }
+    if (id < 1 || isRemoved(paged, id)) {
+        return -1;
+    }
+    const struct Cars *cars = loadPage(paged, (id - 1) / PAGE_RECORDS);
+    if (!cars || (id - 1) % PAGE_RECORDS >= cars->rows) {
+        return -1;
+    }
+    *set = cars;
+    *row = (id - 1) % PAGE_RECORDS;
+    return 0;
+}
+
+/**
+ * @brief Removes the live car with a record ID.
+ *
+ * A car of the file is only marked in the removal bitmap; its page is not read.
+ *
+ * @param paged The paged file.
+ * @param id Record ID.
+ * @return 0 on success, -1 if there is no live car with that ID.
+ */
+int removePagedCar(struct PagedCars *paged, int id) {
+    if (id > paged->records) {
+        int row = findCarRow(paged->added, id);
+        if (row < 0) {
+            return -1;
+        }
+        eraseCar(paged->added, row);
+        return 0;
+    }
+    if (id < 1 || isRemoved(paged, id)) {
+        return -1;
+    }
+    if (!paged->dead) {
+        paged->dead = (uint64_t *)allocateZeroed(((size_t)paged->records + 63) / 64, sizeof *paged->dead);
+        paged->deadInPage = (unsigned short *)allocateZeroed((size_t)paged->pages, sizeof *paged->deadInPage);
+    }
+    paged->dead[(id - 1) >> 6] |= (uint64_t)1 << ((id - 1) & 63);
+    paged->deadInPage[(id - 1) / PAGE_RECORDS]++;
+    paged->deadRecords++;
+    return 0;
+}
+
+/**
+ * @brief Visits the live added cars.
+ * @param paged The paged file.
+ * @param visit Visitor.
+ * @param context Passed to the visitor.
+ * @param visited Incremented for every car visited.
+ * @return Non-zero if the visitor did not stop.
+ */
+static int visitAdded(struct PagedCars *paged, PagedVisitor visit, void *context, long *visited) {
+    const struct Cars *added = paged->added;
+    for (int row = nextLiveRow(added, 0); row < added->rows; row = nextLiveRow(added, row + 1)) {
+        (*visited)++;
+        if (!visit(added, row, context)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * @brief Visits the live cars in car-number order through the page cache, after skipping some.
+ *
+ * Whole pages among the skipped cars are passed over with the per-page removal counts,
+ * without being read. Each page visited goes through the cache, so listing the same cars
+ * again reads nothing; a listing of the whole file would evict everything, which is what
+ * streamPagedCars() is for.
+ *
+ * @param paged The paged file.
+ * @param skip Leading live cars to skip.
+ * @param visit Visitor.
+ * @param context Passed to the visitor.
+ * @return Number of cars skipped.
+ */
+long visitPagedCars(struct PagedCars *paged, long skip, PagedVisitor visit, void *context) {
+    long skipped = 0;
+    int page = 0;
+    while (page < paged->pages && skipped + livePageRecords(paged, page) <= skip) {
+        skipped += livePageRecords(paged, page);
+        page++;
+    }
+
+    for (; page < paged->pages; page++) {
+        const struct Cars *cars = loadPage(paged, page);
+        if (!cars) {
+            return skipped;
+        }
+        for (int row = 0; row < cars->rows; row++) {
+            if (isRemoved(paged, carId(cars, row))) {
+                continue;
+            }
+            if (skipped < skip) {
+                skipped++;
+                continue;
+            }
+            if (!visit(cars, row, context)) {
+                return skipped;
+            }
+        }
+    }
+
+    const struct Cars *added = paged->added;
+    for (int row = nextLiveRow(added, 0); row < added->rows; row = nextLiveRow(added, row + 1)) {
+        if (skipped < skip) {
+            skipped++;
+        } else if (!visit(added, row, context)) {
+            break;
+        }
+    }
+    return skipped;
+}
+
+/**
+ * @brief Streams over the live cars in car-number order with sequential reads, bypassing the page cache.
+ *
+ * Consecutive pages are read together, about PAGED_READ_BYTES at a time, with the
+ * operating system reading ahead; each page is parsed into the same scratch set, so the
+ * memory used does not depend on the size of the file and the cached pages stay cached.
+ *
+ * @param paged The paged file.
+ * @param visit Visitor.
+ * @param context Passed to the visitor.
+ * @return Number of cars visited, or -1 if the file could not be read to the end.
+ */
+long streamPagedCars(struct PagedCars *paged, PagedVisitor visit, void *context) {
+    long visited = 0;
+    struct Cars *scratch = createCarSet();
+    reserveCars(scratch, PAGE_RECORDS, 0);
+    useCarIds(scratch);
+    adviseSequential(paged->file);
+
+    int page = 0, going = 1, failed = 0;
+    while (going && page < paged->pages) {
+        int end = page + 1;
+        while (end < paged->pages && paged->offsets[end + 1] - paged->offsets[page] <= PAGED_READ_BYTES) {
+            end++;
+        }
+        int first = page;
+        if (readRange(paged, paged->offsets[first], (size_t)(paged->offsets[end] - paged->offsets[first])) != 0) {
+            failed = 1;
+            break;
+        }
+
+        for (; going && page < end; page++) {
+            if (livePageRecords(paged, page) == 0) {
+                continue;
+            }
+            resetScratch(scratch, page * PAGE_RECORDS + 1);
+            parseTextRecords(paged->buffer + (paged->offsets[page] - paged->offsets[first]),
+                             (size_t)(paged->offsets[page + 1] - paged->offsets[page]), scratch);
+            for (int row = 0; row < scratch->rows; row++) {
+                if (isRemoved(paged, carId(scratch, row))) {
+                    continue;
+                }
+                visited++;
+                if (!visit(scratch, row, context)) {
+                    going = 0;
+                    break;
+                }
+            }
+        }
+    }
+    destroyCarSet(scratch);
+
+    if (failed) {
+        return -1;
+    }
+    if (going) {
+        visitAdded(paged, visit, context, &visited);
+    }
+    return visited;
+}
+
+/**
+ * @struct PagedWriter
+ * @brief Progress of writePagedCars().
+ */
+struct PagedWriter {
+    FILE *file;  ///< File being written.
+    int first;   ///< Non-zero until the first car is written.
+};
+
+/**
+ * @brief Writes one car for writePagedCars().
+ * @param set Car set holding the car.
+ * @param row Row of the car.
+ * @param context The writer.
+ * @return Always 1.
+ */
+static int writeVisited(const struct Cars *set, int row, void *context) {
+    struct PagedWriter *writer = (struct PagedWriter *)context;
+    writeTextRecord(writer->file, set, row, writer->first);
+    writer->first = 0;
+    return 1;
+}
+
+/**
+ * @brief Writes the live cars to a text file, streaming over the paged file.
+ * @param paged The paged file.
+ * @param path Text file to write; must not be the paged file.
+ * @return 0 on success, -1 if the file cannot be written.
+ */
+int writePagedCars(struct PagedCars *paged, const char *path) {
+    struct PagedWriter writer = {fopen(path, "w"), 1};
+    if (!writer.file) {
+        return -1;
+    }
+    int failed = streamPagedCars(paged, writeVisited, &writer) < 0;
+    failed |= ferror(writer.file);
+    return (fclose(writer.file) != 0 || failed) ? -1 : 0;
+}
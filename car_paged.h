@@ -0,0 +1,162 @@
+/**
+ * @file car_paged.h
+ * @brief Paged access to a base.txt file too large to load: an offset index and a bounded page cache.
+ *
+ * Opening a file in paged mode reads it once, sequentially, only to note where every page
+ * of PAGE_RECORDS records begins; nothing is parsed or kept but those offsets. A page is
+ * read and parsed when a car on it is needed, into a small car set that holds columns and
+ * strings but no indexes, and kept in a cache of recently used pages that evicts the least
+ * recently used ones to stay within its byte budget. Record IDs are the positions in the
+ * file, as when the file is loaded whole, so the page of a car is its ID divided by
+ * PAGE_RECORDS.
+ *
+ * Searches and full listings stream over the file instead: runs of pages are read with
+ * large sequential reads into one buffer and parsed into one scratch set, and the operating
+ * system is told to read ahead, so a scan neither thrashes nor grows the cache.
+ *
+ * Removed cars are marked in a bitmap by ID. Cars added after the file was written, from
+ * the journal or in this session, are held in an ordinary car set after the file's cars.
+ */
+
+#ifndef CAR_PAGED_H
+#define CAR_PAGED_H
+
+#include "car_store.h"
+#include <stdint.h>
+#include <stdio.h>
+
+/** Records per page: the unit the offset index points at and the page cache holds. */
+#define PAGE_RECORDS 64
+
+/** Bytes read at a time when the file is indexed or streamed. */
+#define PAGED_READ_BYTES (1024 * 1024)
+
+/** Memory kept out of the page cache budget for the rest of the program: code, stacks, stdio, output. */
+#define PAGED_RESERVED_BYTES (4 * 1024 * 1024)
+
+/** The page cache holds at least this many pages, whatever the memory limit. */
+#define PAGED_MIN_CACHE_PAGES 16
+
+/**
+ * @struct CachedPage
+ * @brief One parsed page in the page cache.
+ */
+struct CachedPage {
+    int page;                   ///< Page number.
+    struct Cars *cars;          ///< Cars of the page, in file order, with their record IDs; no indexes.
+    size_t bytes;               ///< Memory held by the page.
+    struct CachedPage *newer;   ///< Next more recently used page.
+    struct CachedPage *older;   ///< Next less recently used page.
+};
+
+/**
+ * @struct PagedCars
+ * @brief A base.txt file opened in paged mode.
+ */
+struct PagedCars {
+    FILE *file;                  ///< The open text file.
+    uint64_t size;               ///< Size of the file when it was indexed.
+    int records;                 ///< Complete records in the file.
+    int pages;                   ///< Number of pages.
+    uint64_t *offsets;           ///< File offset of the first record of each page, then the file size.
+    uint64_t *dead;              ///< Bitmap of removed records, by ID - 1 (NULL until the first removal).
+    unsigned short *deadInPage;  ///< Removed records per page (NULL until the first removal).
+    int deadRecords;             ///< Removed records of the file.
+    struct CachedPage **cached;  ///< Cached page of each page number, or NULL.
+    struct CachedPage *newest;   ///< Most recently used cached page.
+    struct CachedPage *oldest;   ///< Least recently used cached page.
+    size_t cacheBytes;           ///< Memory held by the cached pages.
+    size_t cacheLimit;           ///< Byte budget of the page cache.
+    char *buffer;                ///< Read buffer.
+    size_t bufferSize;           ///< Bytes allocated for @c buffer.
+    struct Cars *added;          ///< Cars added after the file was written, with IDs following the file's.
+};
+
+/**
+ * @brief Callback receiving the cars visited by visitPagedCars() and streamPagedCars().
+ * @param set Car set holding the car; it is only valid during the call.
+ * @param row Row of the car.
+ * @param context Context passed to the visiting function.
+ * @return Non-zero to go on, zero to stop.
+ */
+typedef int (*PagedVisitor)(const struct Cars *set, int row, void *context);
+
+/**
+ * @brief Opens a text file in paged mode, building its offset index with one sequential read.
+ * @param path Text file to open.
+ * @param memoryLimit Memory the program should stay within; what the index and buffers leave
+ *                    of it, less PAGED_RESERVED_BYTES, is the page cache budget.
+ * @return The paged file, or NULL if it cannot be read or a number runs into other characters,
+ *         as in "2015x", which only the serial loader splits the same way.
+ */
+struct PagedCars *openPagedCars(const char *path, size_t memoryLimit);
+
+/**
+ * @brief Closes a paged file and frees its index, its cache and its added cars.
+ * @param paged Paged file to close (may be NULL).
+ */
+void closePagedCars(struct PagedCars *paged);
+
+/**
+ * @brief Returns the number of live cars: those of the file not removed, and the added ones.
+ * @param paged The paged file.
+ * @return Number of cars.
+ */
+int pagedLiveCars(const struct PagedCars *paged);
+
+/**
+ * @brief Returns the memory held by the offset index and the removal bitmap.
+ * @param paged The paged file.
+ * @return Bytes.
+ */
+size_t pagedIndexBytes(const struct PagedCars *paged);
+
+/**
+ * @brief Finds the live car with a record ID, reading its page through the page cache.
+ * @param paged The paged file.
+ * @param id Record ID.
+ * @param set Receives the car set holding the car, valid until the next page is read.
+ * @param row Receives the row of the car.
+ * @return 0 on success, -1 if there is no live car with that ID.
+ */
+int findPagedCar(struct PagedCars *paged, int id, const struct Cars **set, int *row);
+
+/**
+ * @brief Removes the live car with a record ID.
+ * @param paged The paged file.
+ * @param id Record ID.
+ * @return 0 on success, -1 if there is no live car with that ID.
+ */
+int removePagedCar(struct PagedCars *paged, int id);
+
+/**
+ * @brief Visits the live cars in car-number order through the page cache, after skipping some.
+ *
+ * Whole pages among the skipped cars are not read. For short listings.
+ *
+ * @param paged The paged file.
+ * @param skip Leading live cars to skip.
+ * @param visit Visitor.
+ * @param context Passed to the visitor.
+ * @return Number of cars skipped.
+ */
+long visitPagedCars(struct PagedCars *paged, long skip, PagedVisitor visit, void *context);
+
+/**
+ * @brief Streams over the live cars in car-number order with sequential reads, bypassing the page cache.
+ * @param paged The paged file.
+ * @param visit Visitor.
+ * @param context Passed to the visitor.
+ * @return Number of cars visited, or -1 if the file could not be read to the end.
+ */
+long streamPagedCars(struct PagedCars *paged, PagedVisitor visit, void *context);
+
+/**
+ * @brief Writes the live cars to a text file, streaming over the paged file.
+ * @param paged The paged file.
+ * @param path Text file to write; must not be the paged file.
+ * @return 0 on success, -1 if the file cannot be written.
+ */
+int writePagedCars(struct PagedCars *paged, const char *path);
+
+#endif // CAR_PAGED_H
@@ -0,0 +1,338 @@
+/**
+ * @file car_parallel.c
+ * @brief Implementation of the worker pool and the parallel scans.
+ *
+ * POSIX builds use a pthread pool. Windows builds run every task on the calling thread,
+ * which keeps the Dev-C++ project free of a pthread dependency.
+ */
+
+#include "car_parallel.h"
+#include "car_store.h"
+#include "platform.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
+/** Rows per chunk claimed by a thread. */
+#define CHUNK_ROWS 16384
+
+/** Sets smaller than this are scanned on the calling thread only. */
+#define PARALLEL_MIN_ROWS (4 * CHUNK_ROWS)
+
+/**
+ * @struct ChunkResult
+ * @brief Matches of one chunk, in ascending row order.
+ */
+struct ChunkResult {
+    int *rows;      ///< Matching rows (NULL when none).
+    int count;      ///< Number of matching rows.
+    int allocated;  ///< Number of rows the array has room for.
+};
+
+/**
+ * @struct ScanJob
+ * @brief One parallelScan() call: the test and the matches of every chunk.
+ */
+struct ScanJob {
+    const struct Cars *set;       ///< Car set being scanned.
+    RowPredicate predicate;       ///< Test applied to each row.
+    const void *context;          ///< Caller data for the predicate.
+    struct ChunkResult *results;  ///< One result per chunk.
+};
+
+/**
+ * @struct PoolJob
+ * @brief One parallelFor() call shared by the calling thread and the workers.
+ */
+struct PoolJob {
+    ParallelTask run;  ///< Function run for each task.
+    void *context;     ///< Caller data passed to @c run.
+    int tasks;         ///< Number of tasks.
+    int nextTask;      ///< Next task to claim, advanced atomically.
+};
+
+/** Requested thread count; 0 means one per online processor. */
+static int requestedThreads = 0;
+
+/**
+ * @brief Claims tasks until none are left and runs them.
+ * @param job Job being run.
+ */
+static void runTasks(struct PoolJob *job) {
+    for (;;) {
+        int task = __atomic_fetch_add(&job->nextTask, 1, __ATOMIC_RELAXED);
+        if (task >= job->tasks) {
+            return;
+        }
+        job->run(task, job->context);
+    }
+}
+
+/**
+ * @brief Collects the matches of one chunk of a scan.
+ * @param chunk Chunk to scan.
+ * @param context The scan.
+ */
+static void scanChunk(int chunk, void *context) {
+    struct ScanJob *job = (struct ScanJob *)context;
+    struct ChunkResult *result = &job->results[chunk];
+    int first = chunk * CHUNK_ROWS;
+    int end = first + CHUNK_ROWS < job->set->rows ? first + CHUNK_ROWS : job->set->rows;
+    for (int row = first; row < end; row++) {
+        if (isDeadRow(job->set, row) || !job->predicate(job->set, row, job->context)) {
+            continue;
+        }
+        if (result->count == result->allocated) {
+            int allocated = result->allocated ? result->allocated * 2 : 64;
+            int *tmp = (int *)realloc(result->rows, (size_t)allocated * sizeof *tmp);
+            if (!tmp) {
+                fprintf(stderr, "Memory allocation error.\n");
+                exit(EXIT_FAILURE);
+            }
+            result->rows = tmp;
+            result->allocated = allocated;
+        }
+        result->rows[result->count++] = row;
+    }
+}
+
+#ifndef _WIN32
+/**
+ * @brief Worker threads and the job they are currently helping with.
+ *
+ * Each job bumps @c generation and wakes the workers; every worker decrements @c busy
+ * once it finds no more tasks, and the last one wakes the calling thread.
+ */
+static struct {
+    pthread_t *threads;        ///< Worker threads (the calling thread is not included).
+    int workers;               ///< Number of worker threads running.
+    pthread_mutex_t lock;      ///< Protects every field below.
+    pthread_cond_t wake;       ///< Signalled when a job is posted or the pool stops.
+    pthread_cond_t idle;       ///< Signalled when the last worker finishes a job.
+    struct PoolJob *job;       ///< Job being run.
+    unsigned long generation;  ///< Number of jobs posted so far.
+    unsigned long started;     ///< Value of @c generation when the workers were started.
+    int busy;                  ///< Workers still running the current job.
+    int stopping;              ///< Non-zero while stopScanPool() shuts the workers down.
+} pool = {NULL, 0, PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER, NULL, 0, 0, 0, 0};
+
+/**
+ * @brief Body of a worker thread: runs the tasks of each posted job.
+ * @param arg Unused.
+ * @return NULL.
+ */
+static void *workerMain(void *arg) {
+    (void)arg;
+    pthread_mutex_lock(&pool.lock);
+    // A worker may first run after a job was posted, so it starts from the pool's baseline.
+    unsigned long seen = pool.started;
+    for (;;) {
+        while (!pool.stopping && pool.generation == seen) {
+            pthread_cond_wait(&pool.wake, &pool.lock);
+        }
+        if (pool.stopping) {
+            break;
+        }
+        seen = pool.generation;
+        struct PoolJob *job = pool.job;
+        pthread_mutex_unlock(&pool.lock);
+
+        runTasks(job);
+
+        pthread_mutex_lock(&pool.lock);
+        if (--pool.busy == 0) {
+            pthread_cond_signal(&pool.idle);
+        }
+    }
+    pthread_mutex_unlock(&pool.lock);
+    return NULL;
+}
+
+/**
+ * @brief Starts the worker threads if the pool is not running.
+ *
+ * Called with the pool lock held. If a thread cannot be created, the pool keeps the ones
+ * already started.
+ *
+ * @param workers Number of worker threads wanted.
+ */
+static void startPool(int workers) {
+    if (pool.threads || workers <= 0) {
+        return;
+    }
+
+    pool.threads = (pthread_t *)malloc((size_t)workers * sizeof *pool.threads);
+    if (!pool.threads) {
+        fprintf(stderr, "Memory allocation error.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    pool.started = pool.generation;
+    pool.workers = 0;
+    while (pool.workers < workers &&
+           pthread_create(&pool.threads[pool.workers], NULL, workerMain, NULL) == 0) {
+        pool.workers++;
+    }
+}
+#endif
+
+/**
+ * @brief Sets the number of threads used by parallelScan() and parallelFor(), including the calling thread.
+ *
+ * Takes effect on the next scan; a running pool of a different size is stopped first.
+ *
+ * @param threads Number of threads, or 0 for one per online processor.
+ */
+void setScanThreads(int threads) {
+    requestedThreads = threads > 0 ? threads : 0;
+#ifndef _WIN32
+    if (pool.threads && pool.workers != scanThreads() - 1) {
+        stopScanPool();
+    }
+#endif
+}
+
+/**
+ * @brief Returns the number of threads parallelScan() and parallelFor() use.
+ * @return Number of threads, at least 1.
+ */
+int scanThreads(void) {
+#ifdef _WIN32
+    return 1;
+#else
+    return requestedThreads > 0 ? requestedThreads : processorCount();
+#endif
+}
+
+/**
+ * @brief Runs tasks on the worker pool and waits for all of them.
+ *
+ * The pool is started on first use. The calling thread claims tasks as well, so a single
+ * task, or a single thread, runs entirely on the calling thread. The pool helps one job at
+ * a time: a call made from another thread while it is busy runs its tasks on its own thread.
+ *
+ * @param tasks Number of tasks.
+ * @param run Function run once for each task number in [0, tasks); must be safe to call
+ *            from several threads at once.
+ * @param context Caller data passed to @p run.
+ */
+void parallelFor(int tasks, ParallelTask run, void *context) {
+    struct PoolJob job = {run, context, tasks, 0};
+#ifndef _WIN32
+    int workers = (tasks < scanThreads() ? tasks : scanThreads()) - 1;
+    if (workers > 0) {
+        pthread_mutex_lock(&pool.lock);
+        startPool(scanThreads() - 1);
+        if (pool.workers == 0 || pool.job) {
+            pthread_mutex_unlock(&pool.lock);
+            runTasks(&job);
+            return;
+        }
+        pool.job = &job;
+        pool.busy = pool.workers;
+        pool.generation++;
+        pthread_cond_broadcast(&pool.wake);
+        pthread_mutex_unlock(&pool.lock);
+
+        runTasks(&job);
+
+        pthread_mutex_lock(&pool.lock);
+        while (pool.busy > 0) {
+            pthread_cond_wait(&pool.idle, &pool.lock);
+        }
+        pool.job = NULL;
+        pthread_mutex_unlock(&pool.lock);
+        return;
+    }
+#endif
+    runTasks(&job);
+}
+
+/**
+ * @brief Collects the live rows of a car set that satisfy a predicate.
+ *
+ * Small sets are scanned on the calling thread; larger ones are split into chunks of
+ * CHUNK_ROWS rows run by parallelFor(), and the per-chunk matches are concatenated in
+ * chunk order at the end.
+ *
+ * @param set Car set to scan; must not be modified during the scan.
+ * @param predicate Test applied to each row; must be safe to call from several threads.
+ * @param context Caller data passed to the predicate.
+ * @param rows Receives a malloc'd array of matching rows in ascending order (NULL when empty).
+ * @return Number of matching rows.
+ */
+int parallelScan(const struct Cars *set, RowPredicate predicate, const void *context, int **rows) {
+    struct ScanJob job = {set, predicate, context, NULL};
+    int chunks = (set->rows + CHUNK_ROWS - 1) / CHUNK_ROWS;
+    *rows = NULL;
+    if (chunks == 0) {
+        return 0;
+    }
+
+    job.results = (struct ChunkResult *)calloc((size_t)chunks, sizeof *job.results);
+    if (!job.results) {
+        fprintf(stderr, "Memory allocation error.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (set->rows >= PARALLEL_MIN_ROWS) {
+        parallelFor(chunks, scanChunk, &job);
+    } else {
+        for (int c = 0; c < chunks; c++) {
+            scanChunk(c, &job);
+        }
+    }
+
+    int found = 0;
+    for (int c = 0; c < chunks; c++) {
+        found += job.results[c].count;
+    }
+
+    if (found > 0) {
+        *rows = (int *)malloc((size_t)found * sizeof **rows);
+        if (!*rows) {
+            fprintf(stderr, "Memory allocation error.\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    int offset = 0;
+    for (int c = 0; c < chunks; c++) {
+        if (job.results[c].count > 0) {
+            memcpy(*rows + offset, job.results[c].rows, (size_t)job.results[c].count * sizeof **rows);
+            offset += job.results[c].count;
+        }
+        free(job.results[c].rows);
+    }
+    free(job.results);
+    return found;
+}
+
+/**
+ * @brief Stops and joins the worker threads; the next scan starts them again.
+ */
+void stopScanPool(void) {
+#ifndef _WIN32
+    if (!pool.threads) {
+        return;
+    }
+
+    pthread_mutex_lock(&pool.lock);
+    pool.stopping = 1;
+    pthread_cond_broadcast(&pool.wake);
+    pthread_mutex_unlock(&pool.lock);
+
+    for (int i = 0; i < pool.workers; i++) {
+        pthread_join(pool.threads[i], NULL);
+    }
+
+    free(pool.threads);
+    pool.threads = NULL;
+    pool.workers = 0;
+    pool.stopping = 0;
+#endif
+}
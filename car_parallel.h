@@ -0,0 +1,80 @@
+/**
+ * @file car_parallel.h
+ * @brief Parallel full-fleet scans, and other chunked work, on a fixed pool of worker threads.
+ *
+ * The car set is split into fixed-size chunks that the workers claim one at a time; each
+ * chunk collects its own matches and the chunks are concatenated in order, so the result
+ * is the same ascending row list a single-threaded loop would produce. parallelFor() runs
+ * any other work split into numbered tasks, such as the chunks of a text file being loaded.
+ */
+
+#ifndef CAR_PARALLEL_H
+#define CAR_PARALLEL_H
+
+struct Cars;
+
+/**
+ * @brief Tests one row of a car set.
+ * @param set Car set being scanned.
+ * @param row Row to test.
+ * @param context Caller data passed through parallelScan().
+ * @return Non-zero if the row matches.
+ */
+typedef int (*RowPredicate)(const struct Cars *set, int row, const void *context);
+
+/**
+ * @brief Runs one task of a parallelFor() call.
+ * @param task Task number.
+ * @param context Caller data passed through parallelFor().
+ */
+typedef void (*ParallelTask)(int task, void *context);
+
+/**
+ * @brief Sets the number of threads used by parallelScan() and parallelFor(), including the calling thread.
+ *
+ * Takes effect on the next scan; a running pool of a different size is stopped first.
+ *
+ * @param threads Number of threads, or 0 for one per online processor.
+ */
+void setScanThreads(int threads);
+
+/**
+ * @brief Returns the number of threads parallelScan() and parallelFor() use.
+ * @return Number of threads, at least 1.
+ */
+int scanThreads(void);
+
+/**
+ * @brief Runs tasks on the worker pool and waits for all of them.
+ *
+ * The calling thread claims tasks as well; tasks are claimed in order but may finish in
+ * any order. Several threads may call it at once: while the pool is busy with one job, the
+ * others run on their calling threads alone.
+ *
+ * @param tasks Number of tasks.
+ * @param run Function run once for each task number in [0, tasks); must be safe to call
+ *            from several threads at once.
+ * @param context Caller data passed to @p run.
+ */
+void parallelFor(int tasks, ParallelTask run, void *context);
+
+/**
+ * @brief Collects the live rows of a car set that satisfy a predicate.
+ *
+ * Small sets are scanned on the calling thread; larger ones are shared with the pool,
+ * which is started on first use.
+ *
+ * @param set Car set to scan; must not be modified during the scan.
+ * @param predicate Test applied to each row; must be safe to call from several threads.
+ * @param context Caller data passed to the predicate.
+ * @param rows Receives a malloc'd array of matching rows in ascending order (NULL when empty).
+ * @return Number of matching rows.
+ */
+int parallelScan(const struct Cars *set, RowPredicate predicate, const void *context, int **rows);
+
+/**
+ * @brief Stops and joins the worker threads; the next scan starts them again.
+ */
+void stopScanPool(void);
+
+#endif // CAR_PARALLEL_H
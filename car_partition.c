@@ -0,0 +1,1202 @@
+/**
+ * @file car_partition.c
+ * @brief Implementation of partitioned storage and partition pruning.
+ */
+
+#include "car_partition.h"
+#include "car_io.h"
+#include "car_stats.h"
+#include "platform.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Copies a string into newly allocated memory.
+ * @param text String to copy.
+ * @return The copy.
+ */
+static char *copyText(const char *text) {
+    size_t length = strlen(text);
+    char *copy = (char *)malloc(length + 1);
+    if (!copy) {
+        fprintf(stderr, "Memory allocation error.\n");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(copy, text, length + 1);
+    return copy;
+}
+
+/**
+ * @brief Builds the path of a file inside the partition directory.
+ * @param parts The database.
+ * @param name Name of the file.
+ * @param path Receives the path; PARTITION_PATH_LENGTH bytes.
+ */
+static void directoryPath(const struct PartitionedCars *parts, const char *name, char *path) {
+    snprintf(path, PARTITION_PATH_LENGTH, "%s/%s", parts->directory, name);
+}
+
+/**
+ * @brief Builds the path of a partition file.
+ * @param parts The database.
+ * @param partition The partition.
+ * @param path Receives the path; PARTITION_PATH_LENGTH bytes.
+ */
+static void partitionPath(const struct PartitionedCars *parts, const struct Partition *partition, char *path) {
+    snprintf(path, PARTITION_PATH_LENGTH, "%s/part-%d.txt", parts->directory, partition->file);
+}
+
+/**
+ * @brief Builds the path of the file holding the record IDs of a partition's cars.
+ * @param parts The database.
+ * @param partition The partition.
+ * @param path Receives the path; PARTITION_PATH_LENGTH bytes.
+ */
+static void idsPath(const struct PartitionedCars *parts, const struct Partition *partition, char *path) {
+    snprintf(path, PARTITION_PATH_LENGTH, "%s/part-%d.ids", parts->directory, partition->file);
+}
+
+/**
+ * @brief Sets the range of record IDs of a partition from its live cars.
+ * @param partition The partition, loaded and with at least one live car.
+ */
+static void computeIdRange(struct Partition *partition) {
+    const struct Cars *set = partition->cars;
+    int last = set->rows - 1;
+    while (last >= 0 && isDeadRow(set, last)) {
+        last--;
+    }
+    // IDs ascend with the rows.
+    partition->minId = carId(set, nextLiveRow(set, 0));
+    partition->maxId = carId(set, last);
+}
+
+/**
+ * @brief Adds a value to a value list unless it is there already.
+ *
+ * Once the list would exceed PARTITION_VALUES values it is dropped and marked as overflowed.
+ *
+ * @param values The list.
+ * @param text The value.
+ */
+static void noteValue(struct PartitionValues *values, const char *text) {
+    if (values->overflow) {
+        return;
+    }
+    for (int i = 0; i < values->count; i++) {
+        if (strcmp(values->values[i], text) == 0) {
+            return;
+        }
+    }
+    if (values->count == PARTITION_VALUES) {
+        for (int i = 0; i < values->count; i++) {
+            free(values->values[i]);
+        }
+        values->count = 0;
+        values->overflow = 1;
+        return;
+    }
+    values->values[values->count++] = copyText(text);
+}
+
+/**
+ * @brief Frees the values of a value list and empties it.
+ * @param values The list.
+ */
+static void freeValues(struct PartitionValues *values) {
+    for (int i = 0; i < values->count; i++) {
+        free(values->values[i]);
+    }
+    values->count = 0;
+    values->overflow = 0;
+}
+
+/**
+ * @brief Frees the value lists of partition statistics and resets them to no cars.
+ * @param stats The statistics.
+ */
+static void resetStats(struct PartitionStats *stats) {
+    freeValues(&stats->brands);
+    freeValues(&stats->models);
+    freeValues(&stats->fuels);
+    freeValues(&stats->types);
+    memset(stats, 0, sizeof *stats);
+}
+
+/**
+ * @brief Widens partition statistics to cover one more car.
+ * @param stats The statistics.
+ * @param car The car.
+ */
+static void noteCar(struct PartitionStats *stats, const struct CarRecord *car) {
+    if (stats->cars == 0) {
+        stats->minYear = stats->maxYear = car->year;
+        stats->minCapacity = stats->maxCapacity = car->capacity;
+    } else {
+        stats->minYear = car->year < stats->minYear ? car->year : stats->minYear;
+        stats->maxYear = car->year > stats->maxYear ? car->year : stats->maxYear;
+        stats->minCapacity = car->capacity < stats->minCapacity ? car->capacity : stats->minCapacity;
+        stats->maxCapacity = car->capacity > stats->maxCapacity ? car->capacity : stats->maxCapacity;
+    }
+    stats->cars++;
+    noteValue(&stats->brands, car->brand);
+    noteValue(&stats->models, car->model);
+    noteValue(&stats->fuels, car->fuel);
+    noteValue(&stats->types, car->type);
+}
+
+/**
+ * @brief Recomputes partition statistics from the live cars of a set.
+ * @param stats The statistics.
+ * @param set Cars of the partition.
+ */
+static void computeStats(struct PartitionStats *stats, const struct Cars *set) {
+    resetStats(stats);
+    struct CarRecord car;
+    for (int row = nextLiveRow(set, 0); row < set->rows; row = nextLiveRow(set, row + 1)) {
+        getCar(set, row, &car);
+        noteCar(stats, &car);
+    }
+}
+
+/**
+ * @brief Returns the first year of the year range holding a year.
+ * @param parts The database.
+ * @param year The year.
+ * @return First year of its partition.
+ */
+static int yearKey(const struct PartitionedCars *parts, int year) {
+    int offset = year % parts->yearSpan;
+    return year - (offset < 0 ? offset + parts->yearSpan : offset);
+}
+
+/**
+ * @brief Compares the key of a partition with the key a car belongs under.
+ * @param parts The database.
+ * @param partition The partition.
+ * @param car The car.
+ * @return Negative, zero or positive as the partition comes before, at or after the car's key.
+ */
+static int compareKey(const struct PartitionedCars *parts, const struct Partition *partition,
+                      const struct CarRecord *car) {
+    if (parts->scheme == PARTITION_BY_BRAND) {
+        return strcmp(partition->brand, car->brand);
+    }
+    int key = yearKey(parts, car->year);
+    return (partition->firstYear > key) - (partition->firstYear < key);
+}
+
+/**
+ * @brief Finds the partition a car belongs to, inserting an empty one in key order if there is none.
+ * @param parts The database.
+ * @param car The car.
+ * @return Index of the partition.
+ */
+static int partitionFor(struct PartitionedCars *parts, const struct CarRecord *car) {
+    int low = 0, high = parts->count;
+    while (low < high) {
+        int mid = low + (high - low) / 2;
+        if (compareKey(parts, &parts->partitions[mid], car) < 0) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    if (low < parts->count && compareKey(parts, &parts->partitions[low], car) == 0) {
+        return low;
+    }
+
+    if (parts->count == parts->allocated) {
+        int allocated = parts->allocated > 0 ? parts->allocated * 2 : 16;
+        struct Partition *tmp =
+            (struct Partition *)realloc(parts->partitions, (size_t)allocated * sizeof *tmp);
+        if (!tmp) {
+            fprintf(stderr, "Memory allocation error.\n");
+            exit(EXIT_FAILURE);
+        }
+        parts->partitions = tmp;
+        parts->allocated = allocated;
+    }
+    memmove(&parts->partitions[low + 1], &parts->partitions[low],
+            (size_t)(parts->count - low) * sizeof *parts->partitions);
+    parts->count++;
+
+    // A new partition has no file yet, so its cars are all in memory from the start.
+    struct Partition *partition = &parts->partitions[low];
+    memset(partition, 0, sizeof *partition);
+    partition->file = parts->nextFile++;
+    if (parts->scheme == PARTITION_BY_BRAND) {
+        partition->brand = copyText(car->brand);
+    } else {
+        partition->firstYear = yearKey(parts, car->year);
+    }
+    partition->cars = createCarSet();
+    useCarIds(partition->cars);
+    partition->changed = 1;
+    return low;
+}
+
+/**
+ * @brief Frees a partition's cars, cached results, key and statistics.
+ * @param partition The partition.
+ */
+static void freePartition(struct Partition *partition) {
+    destroyCarSet(partition->cars);
+    partition->cars = NULL;
+    clearQueryCache(&partition->cache);
+    free(partition->brand);
+    partition->brand = NULL;
+    resetStats(&partition->stats);
+}
+
+/**
+ * @brief Parses a partitioning scheme written as "year", "year:SPAN", "brand" or "none".
+ * @param text The scheme.
+ * @param scheme Receives the scheme.
+ * @param yearSpan Receives the years per partition (PARTITION_YEAR_SPAN unless given).
+ * @return 0 on success, -1 if the text is not a scheme.
+ */
+int parsePartitionScheme(const char *text, enum PartitionScheme *scheme, int *yearSpan) {
+    *yearSpan = PARTITION_YEAR_SPAN;
+    if (strcmp(text, "none") == 0) {
+        *scheme = PARTITION_NONE;
+        return 0;
+    }
+    if (strcmp(text, "brand") == 0) {
+        *scheme = PARTITION_BY_BRAND;
+        return 0;
+    }
+    if (strncmp(text, "year", 4) != 0 || (text[4] != '\0' && text[4] != ':')) {
+        return -1;
+    }
+    if (text[4] == ':') {
+        char *end;
+        long span = strtol(text + 5, &end, 10);
+        if (end == text + 5 || *end != '\0' || span <= 0 || span > 1000) {
+            return -1;
+        }
+        *yearSpan = (int)span;
+    }
+    *scheme = PARTITION_BY_YEAR;
+    return 0;
+}
+
+/**
+ * @brief Checks whether a directory holds a partition manifest.
+ * @param directory Partition directory.
+ * @return Non-zero if the manifest exists.
+ */
+int partitionedLayoutExists(const char *directory) {
+    char path[PARTITION_PATH_LENGTH];
+    uint64_t size;
+    int64_t time;
+    snprintf(path, sizeof path, "%s/%s", directory, PARTITION_MANIFEST);
+    return fileStamp(path, &size, &time) == 0;
+}
+
+/**
+ * @brief Creates an empty partitioned database in memory; nothing is written until it is saved.
+ * @param directory Partition directory, created when the database is saved.
+ * @param scheme PARTITION_BY_YEAR or PARTITION_BY_BRAND.
+ * @param yearSpan Years per partition when partitioning by year.
+ * @return The database.
+ */
+struct PartitionedCars *createPartitionedCars(const char *directory, enum PartitionScheme scheme, int yearSpan) {
+    struct PartitionedCars *parts = (struct PartitionedCars *)calloc(1, sizeof *parts);
+    if (!parts) {
+        fprintf(stderr, "Memory allocation error.\n");
+        exit(EXIT_FAILURE);
+    }
+    parts->directory = copyText(directory);
+    parts->scheme = scheme;
+    parts->yearSpan = yearSpan > 0 ? yearSpan : PARTITION_YEAR_SPAN;
+    parts->nextFile = 1;
+    parts->nextId = 1;
+    parts->manifestChanged = 1;
+    return parts;
+}
+
+/**
+ * @brief Reads a value list of the manifest.
+ * @param file The manifest.
+ * @param name Name the list is written under.
+ * @param values Receives the values.
+ * @return 0 on success, -1 if the list is damaged.
+ */
+static int readValues(FILE *file, const char *name, struct PartitionValues *values) {
+    char label[16], value[100];
+    int count;
+    if (fscanf(file, " %15s %d", label, &count) != 2 || strcmp(label, name) != 0 || count < -1 ||
+        count > PARTITION_VALUES) {
+        return -1;
+    }
+    values->overflow = count < 0;
+    for (int i = 0; i < count; i++) {
+        if (fscanf(file, " %99s", value) != 1) {
+            return -1;
+        }
+        values->values[values->count++] = copyText(value);
+    }
+    return 0;
+}
+
+/**
+ * @brief Reads the manifest into a database with no partitions yet.
+ * @param parts The database.
+ * @param file The manifest.
+ * @return 0 on success, -1 if the manifest is damaged.
+ */
+static int readManifest(struct PartitionedCars *parts, FILE *file) {
+    char magic[16], scheme[16];
+    int version, count;
+    if (fscanf(file, "%15s %d %15s %d next %d ids %d partitions %d", magic, &version, scheme, &parts->yearSpan,
+               &parts->nextFile, &parts->nextId, &count) != 7 ||
+        strcmp(magic, PARTITION_MAGIC) != 0 || version != PARTITION_VERSION || parts->nextId <= 0 || count < 0) {
+        return -1;
+    }
+    if (strcmp(scheme, "year") == 0 && parts->yearSpan > 0) {
+        parts->scheme = PARTITION_BY_YEAR;
+    } else if (strcmp(scheme, "brand") == 0) {
+        parts->scheme = PARTITION_BY_BRAND;
+    } else {
+        return -1;
+    }
+
+    parts->partitions = (struct Partition *)calloc((size_t)(count > 0 ? count : 1), sizeof *parts->partitions);
+    if (!parts->partitions) {
+        fprintf(stderr, "Memory allocation error.\n");
+        exit(EXIT_FAILURE);
+    }
+    parts->allocated = count > 0 ? count : 1;
+
+    for (int i = 0; i < count; i++) {
+        struct Partition *partition = &parts->partitions[parts->count++];
+        struct PartitionStats *stats = &partition->stats;
+        char key[100];
+        unsigned long long size;
+        long long time;
+        if (fscanf(file, " part %d key %99s records %d ids %d %d size %llu time %lld years %d %d capacities %d %d",
+                   &partition->file, key, &partition->records, &partition->minId, &partition->maxId, &size, &time,
+                   &stats->minYear, &stats->maxYear, &stats->minCapacity, &stats->maxCapacity) != 11 ||
+            partition->file <= 0 || partition->file >= parts->nextFile || partition->records < 0 ||
+            partition->maxId >= parts->nextId) {
+            return -1;
+        }
+        if (parts->scheme == PARTITION_BY_BRAND) {
+            partition->brand = copyText(key);
+        } else if (sscanf(key, "%d", &partition->firstYear) != 1) {
+            return -1;
+        }
+        partition->size = size;
+        partition->time = time;
+        stats->cars = partition->records;
+        if (readValues(file, "brands", &stats->brands) != 0 || readValues(file, "models", &stats->models) != 0 ||
+            readValues(file, "fuels", &stats->fuels) != 0 || readValues(file, "types", &stats->types) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Opens a partitioned database by reading its manifest; no partition is loaded unless
+ *        its file changed since the manifest was written.
+ *
+ * A partition whose file no longer has the size and time recorded in the manifest is loaded
+ * at once, to count its cars and recompute its statistics and range of record IDs, and the
+ * manifest is rewritten at the next save.
+ *
+ * @param directory Partition directory.
+ * @return The database, or NULL if the manifest is missing or damaged, or names a missing file.
+ */
+struct PartitionedCars *openPartitionedCars(const char *directory) {
+    struct PartitionedCars *parts = createPartitionedCars(directory, PARTITION_BY_YEAR, PARTITION_YEAR_SPAN);
+    parts->manifestChanged = 0;
+
+    char path[PARTITION_PATH_LENGTH];
+    directoryPath(parts, PARTITION_MANIFEST, path);
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        closePartitionedCars(parts);
+        return NULL;
+    }
+    int status = readManifest(parts, file);
+    fclose(file);
+    if (status != 0) {
+        closePartitionedCars(parts);
+        return NULL;
+    }
+
+    for (int i = 0; i < parts->count; i++) {
+        struct Partition *partition = &parts->partitions[i];
+        uint64_t size;
+        int64_t time;
+        partitionPath(parts, partition, path);
+        if (fileStamp(path, &size, &time) != 0) {
+            closePartitionedCars(parts);
+            return NULL;
+        }
+        if (size != partition->size || time != partition->time) {
+            // Changed outside the program: the manifest's count and statistics cannot be trusted.
+            partition->records = loadPartition(parts, i)->rows;
+            computeStats(&partition->stats, partition->cars);
+            if (partition->records > 0) {
+                computeIdRange(partition);
+            }
+            partition->size = size;
+            partition->time = time;
+            parts->manifestChanged = 1;
+        }
+    }
+    return parts;
+}
+
+/**
+ * @brief Frees a partitioned database, including its loaded cars, without saving it.
+ * @param parts Database to free (may be NULL).
+ */
+void closePartitionedCars(struct PartitionedCars *parts) {
+    if (!parts) {
+        return;
+    }
+    for (int i = 0; i < parts->count; i++) {
+        freePartition(&parts->partitions[i]);
+    }
+    free(parts->partitions);
+    free(parts->directory);
+    free(parts);
+}
+
+/**
+ * @brief Returns the number of live cars, counting those of unloaded partitions from the manifest.
+ * @param parts The database.
+ * @return Number of cars.
+ */
+int partitionedLiveCars(const struct PartitionedCars *parts) {
+    int cars = 0;
+    for (int i = 0; i < parts->count; i++) {
+        const struct Partition *partition = &parts->partitions[i];
+        cars += partition->cars ? liveCars(partition->cars) : partition->records;
+    }
+    return cars;
+}
+
+/**
+ * @brief Returns the memory held by the loaded partitions.
+ * @param parts The database.
+ * @return Bytes.
+ */
+size_t partitionedBytes(const struct PartitionedCars *parts) {
+    size_t bytes = 0;
+    for (int i = 0; i < parts->count; i++) {
+        if (parts->partitions[i].cars) {
+            bytes += carSetBytes(parts->partitions[i].cars);
+        }
+    }
+    return bytes;
+}
+
+/**
+ * @brief Returns the cars of a partition, loading its file first if needed.
+ *
+ * The file is parsed like base.txt, with every index, and its cars get the record IDs read
+ * from the partition's ID file. Should that file not account for every car, as after the
+ * partition file was edited by hand, the cars it misses are numbered after all the others
+ * and the partition is marked as changed, so the next save writes the IDs out.
+ *
+ * @param parts The database.
+ * @param index Partition to load.
+ * @return Cars of the partition.
+ */
+struct Cars *loadPartition(struct PartitionedCars *parts, int index) {
+    struct Partition *partition = &parts->partitions[index];
+    if (partition->cars) {
+        return partition->cars;
+    }
+
+    char path[PARTITION_PATH_LENGTH];
+    partitionPath(parts, partition, path);
+    struct Cars *set = createCarSet();
+    if (readTextCars(path, set, NULL) != 0) {
+        fprintf(stderr, "Unable to read the partition file %s.\n", path);
+        exit(EXIT_FAILURE);
+    }
+    useCarIds(set);
+
+    // The IDs kept are those that still ascend; the rest of the cars are numbered afresh.
+    int row = 0;
+    idsPath(parts, partition, path);
+    FILE *file = fopen(path, "r");
+    if (file) {
+        int id, last = 0;
+        while (row < set->rows && fscanf(file, "%d", &id) == 1 && id > last && id < parts->nextId) {
+            set->ids[row++] = last = id;
+        }
+        fclose(file);
+    }
+    int renumbered = row < set->rows;
+    for (; row < set->rows; row++) {
+        set->ids[row] = parts->nextId++;
+    }
+    set->nextId = parts->nextId;
+    partition->cars = set;
+    if (renumbered) {
+        computeIdRange(partition);
+        partition->changed = 1;
+        parts->manifestChanged = 1;
+    }
+    countPartitionEvent(PARTITION_LOADED);
+    return set;
+}
+
+/**
+ * @brief Checks whether a value list may hold a value a string predicate matches.
+ * @param values The list.
+ * @param node QUERY_EXACT or QUERY_CONTAINS predicate.
+ * @return Non-zero if some value matches or the values were not kept.
+ */
+static int mayHoldValue(const struct PartitionValues *values, const struct QueryNode *node) {
+    if (values->overflow) {
+        return 1;
+    }
+    for (int i = 0; i < values->count; i++) {
+        if (node->kind == QUERY_EXACT ? strcmp(values->values[i], node->text) == 0
+                                      : strstr(values->values[i], node->text) != NULL) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Tests a query node against partition statistics.
+ * @param stats The statistics.
+ * @param node The node.
+ * @return Zero if no car described by the statistics can match, non-zero if some may.
+ */
+static int statsMayMatch(const struct PartitionStats *stats, const struct QueryNode *node) {
+    switch (node->kind) {
+        case QUERY_EXACT:
+        case QUERY_CONTAINS:
+            switch (node->field) {
+                case FIELD_BRAND:
+                    return mayHoldValue(&stats->brands, node);
+                case FIELD_MODEL:
+                    return mayHoldValue(&stats->models, node);
+                case FIELD_FUEL:
+                    return mayHoldValue(&stats->fuels, node);
+                case FIELD_TYPE:
+                    return mayHoldValue(&stats->types, node);
+                default:
+                    return 1;
+            }
+        case QUERY_RANGE:
+            if (node->field == FIELD_YEAR) {
+                return stats->maxYear >= node->min && stats->minYear <= node->max;
+            }
+            return stats->maxCapacity >= node->min && stats->minCapacity <= node->max;
+        case QUERY_AND:
+            for (int i = 0; i < node->childCount; i++) {
+                if (!statsMayMatch(stats, node->children[i])) {
+                    return 0;
+                }
+            }
+            return 1;
+        default:
+            for (int i = 0; i < node->childCount; i++) {
+                if (statsMayMatch(stats, node->children[i])) {
+                    return 1;
+                }
+            }
+            return 0;
+    }
+}
+
+/**
+ * @brief Checks whether some car of a partition may match a query, from its statistics alone.
+ *
+ * Ranges are tested against the smallest and largest year and capacity, and string
+ * predicates against the kept values of the field. Registration numbers have no statistics.
+ *
+ * @param partition The partition.
+ * @param query The query, or NULL for every car.
+ * @return Zero if no car of the partition can match, non-zero if some may.
+ */
+int partitionMayMatch(const struct Partition *partition, const struct QueryNode *query) {
+    if (partition->stats.cars == 0) {
+        return 0;
+    }
+    return !query || statsMayMatch(&partition->stats, query);
+}
+
+/**
+ * @brief Checks whether some car of a partition may have a brand or model starting with a prefix.
+ * @param partition The partition.
+ * @param field FIELD_BRAND or FIELD_MODEL.
+ * @param prefix The prefix.
+ * @return Zero if no car of the partition can have it, non-zero if some may.
+ */
+int partitionMayStartWith(const struct Partition *partition, enum QueryField field, const char *prefix) {
+    const struct PartitionValues *values = field == FIELD_BRAND ? &partition->stats.brands : &partition->stats.models;
+    if (partition->stats.cars == 0) {
+        return 0;
+    }
+    if (values->overflow) {
+        return 1;
+    }
+    size_t length = strlen(prefix);
+    for (int i = 0; i < values->count; i++) {
+        if (strncmp(values->values[i], prefix, length) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Appends a car to its partition with a record ID.
+ * @param parts The database.
+ * @param car The car.
+ * @param id Record ID of the car, above those of the partition's cars, or 0 to number it after every other car.
+ * @param set Receives the cars of the partition, whose indexes the caller synchronizes.
+ * @return Record ID of the car.
+ */
+static int appendToPartition(struct PartitionedCars *parts, const struct CarRecord *car, int id, struct Cars **set) {
+    int index = partitionFor(parts, car);
+    struct Partition *partition = &parts->partitions[index];
+    *set = loadPartition(parts, index);
+    if (id <= 0) {
+        id = parts->nextId;
+    }
+    if (id >= parts->nextId) {
+        parts->nextId = id + 1;
+    }
+    (*set)->nextId = id;
+    appendCar(*set, car);
+    if (partition->stats.cars == 0) {
+        partition->minId = id;
+    }
+    partition->maxId = id;
+    noteCar(&partition->stats, car);
+    partition->changed = 1;
+    return id;
+}
+
+/**
+ * @brief Adds a car to the partition of its year or brand, creating the partition if needed.
+ *
+ * The partition is loaded first, so its file can be rewritten with the new car.
+ *
+ * @param parts The database.
+ * @param car The car.
+ * @return Record ID of the car.
+ */
+int addPartitionedCar(struct PartitionedCars *parts, const struct CarRecord *car) {
+    struct Cars *set;
+    int id = appendToPartition(parts, car, 0, &set);
+    syncIndexes(set);
+    return id;
+}
+
+/**
+ * @brief Synchronizes the indexes of every loaded partition after cars were appended in bulk.
+ * @param parts The database.
+ */
+static void syncPartitions(struct PartitionedCars *parts) {
+    for (int i = 0; i < parts->count; i++) {
+        if (parts->partitions[i].cars) {
+            syncIndexes(parts->partitions[i].cars);
+        }
+    }
+}
+
+/**
+ * @brief Adds every live car of a set, in row order, keeping their record IDs.
+ *
+ * IDs ascend with the rows of the set, so they ascend within each partition too. The
+ * indexes of each partition are synchronized once at the end rather than per car, and
+ * the next added car is numbered after the set's next ID, as it would have been there.
+ *
+ * @param parts The database, whose cars all have smaller IDs than those of the set.
+ * @param set Cars to add.
+ */
+void addPartitionedCars(struct PartitionedCars *parts, const struct Cars *set) {
+    struct CarRecord car;
+    struct Cars *target;
+    for (int row = nextLiveRow(set, 0); row < set->rows; row = nextLiveRow(set, row + 1)) {
+        getCar(set, row, &car);
+        appendToPartition(parts, &car, carId(set, row), &target);
+    }
+    if (nextCarId(set) > parts->nextId) {
+        parts->nextId = nextCarId(set);
+    }
+    syncPartitions(parts);
+}
+
+/**
+ * @brief Finds the live car with a record ID, loading its partition if needed.
+ *
+ * Only partitions whose range of record IDs holds the ID are searched, and loaded if needed.
+ *
+ * @param parts The database.
+ * @param id Record ID.
+ * @param partition Receives the partition holding the car.
+ * @param row Receives the row of the car.
+ * @return 0 on success, -1 if there is no live car with that ID.
+ */
+int findPartitionedCar(struct PartitionedCars *parts, int id, int *partition, int *row) {
+    for (int i = 0; i < parts->count; i++) {
+        const struct Partition *candidate = &parts->partitions[i];
+        if (id < candidate->minId || id > candidate->maxId) {
+            continue;
+        }
+        *row = findCarRow(loadPartition(parts, i), id);
+        if (*row >= 0) {
+            *partition = i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Removes the live car with a record ID.
+ * @param parts The database.
+ * @param id Record ID.
+ * @return 0 on success, -1 if there is no live car with that ID.
+ */
+int removePartitionedCar(struct PartitionedCars *parts, int id) {
+    int index, row;
+    if (findPartitionedCar(parts, id, &index, &row) != 0) {
+        return -1;
+    }
+    eraseCar(parts->partitions[index].cars, row);
+    parts->partitions[index].changed = 1;
+    return 0;
+}
+
+/**
+ * @brief Writes a value list of the manifest.
+ * @param file The manifest.
+ * @param name Name the list is written under.
+ * @param values The values.
+ */
+static void writeValues(FILE *file, const char *name, const struct PartitionValues *values) {
+    if (values->overflow) {
+        fprintf(file, " %s -1", name);
+        return;
+    }
+    fprintf(file, " %s %d", name, values->count);
+    for (int i = 0; i < values->count; i++) {
+        fprintf(file, " %s", values->values[i]);
+    }
+}
+
+/**
+ * @brief Writes the manifest through a temporary file that then replaces it.
+ * @param parts The database.
+ * @param bytes Incremented by the size of the manifest.
+ * @return 0 on success, -1 if the manifest cannot be written.
+ */
+static int writeManifest(const struct PartitionedCars *parts, size_t *bytes) {
+    char path[PARTITION_PATH_LENGTH], temporary[PARTITION_PATH_LENGTH];
+    directoryPath(parts, PARTITION_MANIFEST, path);
+    directoryPath(parts, PARTITION_MANIFEST ".new", temporary);
+    FILE *file = fopen(temporary, "w");
+    if (!file) {
+        return -1;
+    }
+
+    fprintf(file, "%s %d %s %d next %d ids %d partitions %d\n", PARTITION_MAGIC, PARTITION_VERSION,
+            parts->scheme == PARTITION_BY_BRAND ? "brand" : "year", parts->yearSpan, parts->nextFile, parts->nextId,
+            parts->count);
+    for (int i = 0; i < parts->count; i++) {
+        const struct Partition *partition = &parts->partitions[i];
+        const struct PartitionStats *stats = &partition->stats;
+        fprintf(file, "part %d key ", partition->file);
+        if (partition->brand) {
+            fprintf(file, "%s", partition->brand);
+        } else {
+            fprintf(file, "%d", partition->firstYear);
+        }
+        fprintf(file, " records %d ids %d %d size %llu time %lld years %d %d capacities %d %d", stats->cars,
+                partition->minId, partition->maxId, (unsigned long long)partition->size, (long long)partition->time, stats->minYear, stats->maxYear,
+                stats->minCapacity, stats->maxCapacity);
+        writeValues(file, "brands", &stats->brands);
+        writeValues(file, "models", &stats->models);
+        writeValues(file, "fuels", &stats->fuels);
+        writeValues(file, "types", &stats->types);
+        fprintf(file, "\n");
+    }
+
+    long size = ftell(file);
+    int failed = ferror(file);
+    if (fclose(file) != 0 || failed || replaceFile(temporary, path) != 0) {
+        remove(temporary);
+        return -1;
+    }
+    *bytes += size > 0 ? (size_t)size : 0;
+    return 0;
+}
+
+/**
+ * @brief Writes the record IDs of a partition's live cars through a temporary file that then replaces its ID file.
+ * @param parts The database.
+ * @param partition The partition, loaded.
+ * @param bytes Incremented by the size of the file.
+ * @return 0 on success, -1 if the file cannot be written.
+ */
+static int writeIds(const struct PartitionedCars *parts, const struct Partition *partition, size_t *bytes) {
+    char path[PARTITION_PATH_LENGTH], temporary[PARTITION_PATH_LENGTH + 4];
+    idsPath(parts, partition, path);
+    snprintf(temporary, sizeof temporary, "%s.new", path);
+    FILE *file = fopen(temporary, "w");
+    if (!file) {
+        return -1;
+    }
+    const struct Cars *set = partition->cars;
+    for (int row = nextLiveRow(set, 0); row < set->rows; row = nextLiveRow(set, row + 1)) {
+        fprintf(file, "%d\n", carId(set, row));
+    }
+    long size = ftell(file);
+    int failed = ferror(file);
+    if (fclose(file) != 0 || failed || replaceFile(temporary, path) != 0) {
+        remove(temporary);
+        return -1;
+    }
+    *bytes += size > 0 ? (size_t)size : 0;
+    return 0;
+}
+
+/**
+ * @brief Writes the files of the changed partitions, then the manifest.
+ *
+ * Each file is written under a temporary name that then replaces it, so a failed save
+ * leaves the old file in place; the ID file follows the partition file. The manifest is
+ * written last; a crash before it leaves files that do not match their manifest entries,
+ * which opening the database detects.
+ * Statistics are recomputed from the cars written, so removals narrow them again.
+ *
+ * @param parts The database.
+ * @param everything Non-zero to load and rewrite every partition, as when compacting.
+ * @param bytes Receives the number of bytes written (may be NULL).
+ * @return Number of partition files written, or -1 if a file cannot be written.
+ */
+int savePartitionedCars(struct PartitionedCars *parts, int everything, size_t *bytes) {
+    size_t written = 0;
+    int files = 0;
+    if (bytes) {
+        *bytes = 0;
+    }
+    if (makeDirectory(parts->directory) != 0) {
+        return -1;
+    }
+
+    for (int i = 0; i < parts->count; i++) {
+        struct Partition *partition = &parts->partitions[i];
+        if (everything) {
+            loadPartition(parts, i);
+            partition->changed = 1;
+        }
+        if (!partition->changed) {
+            continue;
+        }
+
+        char path[PARTITION_PATH_LENGTH], temporary[PARTITION_PATH_LENGTH + 4];
+        partitionPath(parts, partition, path);
+        parts->manifestChanged = 1;
+        if (liveCars(partition->cars) == 0) {
+            remove(path);
+            idsPath(parts, partition, path);
+            remove(path);
+            freePartition(partition);
+            memmove(partition, partition + 1, (size_t)(parts->count - i - 1) * sizeof *partition);
+            parts->count--;
+            i--;
+            continue;
+        }
+
+        snprintf(temporary, sizeof temporary, "%s.new", path);
+        if (writeTextCars(temporary, partition->cars) != 0 || replaceFile(temporary, path) != 0 ||
+            fileStamp(path, &partition->size, &partition->time) != 0) {
+            remove(temporary);
+            return -1;
+        }
+        written += (size_t)partition->size;
+        if (writeIds(parts, partition, &written) != 0) {
+            return -1;
+        }
+        computeStats(&partition->stats, partition->cars);
+        computeIdRange(partition);
+        partition->changed = 0;
+        files++;
+        countPartitionEvent(PARTITION_WRITTEN);
+    }
+
+    if (parts->manifestChanged) {
+        if (writeManifest(parts, &written) != 0) {
+            return -1;
+        }
+        parts->manifestChanged = 0;
+    }
+    if (bytes) {
+        *bytes = written;
+    }
+    return files;
+}
+
+/**
+ * @brief Deletes the partition files and, optionally, the manifest and the directory.
+ * @param parts The database whose files are deleted.
+ * @param layout Non-zero to delete the manifest and the directory as well.
+ */
+void removePartitionFiles(const struct PartitionedCars *parts, int layout) {
+    char path[PARTITION_PATH_LENGTH];
+    if (layout) {
+        // Without its manifest the directory is no longer a database, so it goes first.
+        directoryPath(parts, PARTITION_MANIFEST, path);
+        remove(path);
+    }
+    for (int i = 0; i < parts->count; i++) {
+        partitionPath(parts, &parts->partitions[i], path);
+        remove(path);
+        idsPath(parts, &parts->partitions[i], path);
+        remove(path);
+    }
+    if (layout) {
+        removeDirectory(parts->directory);
+    }
+}
+
+/**
+ * @brief Compares the next cars of two listings being merged.
+ * @param lists The listings.
+ * @param next Position of the next car of each listing.
+ * @param order Order of the listings, or NULL for record-ID order.
+ * @param a First listing.
+ * @param b Second listing.
+ * @return Negative, zero or positive as the car of @p a comes before, with or after that of @p b.
+ */
+static int compareNext(const struct PartitionMatches *lists, const int *next, const struct CarOrder *order, int a,
+                       int b) {
+    const struct PartitionMatches *x = &lists[a], *y = &lists[b];
+    int rowX = x->rows[next[a]], rowY = y->rows[next[b]];
+    int rankX = x->ranks ? x->ranks[next[a]] : 0, rankY = y->ranks ? y->ranks[next[b]] : 0;
+    if (rankX != rankY) {
+        return (rankX > rankY) - (rankX < rankY);
+    }
+    if (order && order->active) {
+        return compareOrderedCars(order, x->set, rowX, y->set, rowY);
+    }
+    int idX = carId(x->set, rowX), idY = carId(y->set, rowY);
+    return (idX > idY) - (idX < idY);
+}
+
+/**
+ * @brief Restores the heap property below one entry of a heap of listings, first car on top.
+ * @param lists The listings.
+ * @param next Position of the next car of each listing.
+ * @param order Order of the listings, or NULL for record-ID order.
+ * @param heap The heap of listing numbers.
+ * @param size Number of listings in the heap.
+ * @param i Entry to move down.
+ */
+static void siftListings(const struct PartitionMatches *lists, const int *next, const struct CarOrder *order,
+                         int *heap, int size, int i) {
+    for (;;) {
+        int first = i, left = 2 * i + 1, right = left + 1;
+        if (left < size && compareNext(lists, next, order, heap[left], heap[first]) < 0) {
+            first = left;
+        }
+        if (right < size && compareNext(lists, next, order, heap[right], heap[first]) < 0) {
+            first = right;
+        }
+        if (first == i) {
+            return;
+        }
+        int list = heap[i];
+        heap[i] = heap[first];
+        heap[first] = list;
+        i = first;
+    }
+}
+
+/**
+ * @brief Merges sorted listings of several partitions into one.
+ *
+ * A heap holds the listings by their next car, so merging n cars from k listings costs
+ * O(n log k), and the merge stops after @p keep cars.
+ *
+ * @param lists Sorted listing of each partition.
+ * @param count Number of listings.
+ * @param order Order of the listings, or NULL for record-ID order.
+ * @param keep Number of leading cars wanted, or 0 for all of them.
+ * @param merged Receives a malloc'd array of the merged cars (NULL when empty).
+ * @return Number of merged cars.
+ */
+int mergePartitionMatches(const struct PartitionMatches *lists, int count, const struct CarOrder *order, long keep,
+                          struct PartitionRow **merged) {
+    long total = 0;
+    for (int i = 0; i < count; i++) {
+        total += lists[i].count;
+    }
+    if (keep > 0 && keep < total) {
+        total = keep;
+    }
+    *merged = NULL;
+    if (total == 0) {
+        return 0;
+    }
+
+    *merged = (struct PartitionRow *)malloc((size_t)total * sizeof **merged);
+    int *heap = (int *)malloc((size_t)count * sizeof *heap);
+    int *next = (int *)calloc((size_t)count, sizeof *next);
+    if (!*merged || !heap || !next) {
+        fprintf(stderr, "Memory allocation error.\n");
+        exit(EXIT_FAILURE);
+    }
+    int size = 0;
+    for (int i = 0; i < count; i++) {
+        if (lists[i].count > 0) {
+            heap[size++] = i;
+        }
+    }
+    for (int i = size / 2 - 1; i >= 0; i--) {
+        siftListings(lists, next, order, heap, size, i);
+    }
+
+    for (long n = 0; n < total; n++) {
+        int list = heap[0];
+        struct PartitionRow *car = &(*merged)[n];
+        car->set = lists[list].set;
+        car->row = lists[list].rows[next[list]];
+        car->rank = lists[list].ranks ? lists[list].ranks[next[list]] : 0;
+        if (++next[list] == lists[list].count) {
+            heap[0] = heap[--size];
+        }
+        siftListings(lists, next, order, heap, size, 0);
+    }
+    free(heap);
+    free(next);
+    return (int)total;
+}
+
+/**
+ * @brief Lists every live car of a partitioned database in record-ID order.
+ * @param parts The database; every partition is loaded.
+ * @param merged Receives a malloc'd array of the cars (NULL when empty).
+ * @return Number of cars.
+ */
+static int listAllCars(struct PartitionedCars *parts, struct PartitionRow **merged) {
+    struct PartitionMatches *lists =
+        (struct PartitionMatches *)calloc((size_t)(parts->count > 0 ? parts->count : 1), sizeof *lists);
+    if (!lists) {
+        fprintf(stderr, "Memory allocation error.\n");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < parts->count; i++) {
+        const struct Cars *set = loadPartition(parts, i);
+        lists[i].set = set;
+        lists[i].rows = (int *)malloc((size_t)(set->rows > 0 ? set->rows : 1) * sizeof *lists[i].rows);
+        if (!lists[i].rows) {
+            fprintf(stderr, "Memory allocation error.\n");
+            exit(EXIT_FAILURE);
+        }
+        for (int row = nextLiveRow(set, 0); row < set->rows; row = nextLiveRow(set, row + 1)) {
+            lists[i].rows[lists[i].count++] = row;
+        }
+    }
+    int count = mergePartitionMatches(lists, parts->count, NULL, 0, merged);
+    for (int i = 0; i < parts->count; i++) {
+        free(lists[i].rows);
+    }
+    free(lists);
+    return count;
+}
+
+/**
+ * @brief Adds the cars of one partitioned database to another, in record-ID order and keeping their IDs.
+ *
+ * Taking the cars in ID order keeps the IDs ascending within each new partition, however
+ * the two schemes group them. The next added car gets the same ID it would have had before.
+ *
+ * @param parts The database the cars are added to, with no cars yet.
+ * @param from The database the cars are taken from; every partition is loaded.
+ */
+void movePartitionedCars(struct PartitionedCars *parts, struct PartitionedCars *from) {
+    struct PartitionRow *cars;
+    int count = listAllCars(from, &cars);
+    struct CarRecord car;
+    struct Cars *target;
+    for (int i = 0; i < count; i++) {
+        getCar(cars[i].set, cars[i].row, &car);
+        appendToPartition(parts, &car, carId(cars[i].set, cars[i].row), &target);
+    }
+    free(cars);
+    if (from->nextId > parts->nextId) {
+        parts->nextId = from->nextId;
+    }
+    syncPartitions(parts);
+}
+
+/**
+ * @brief Numbers the cars 1, 2, 3, ... again in record-ID order, as compacting a base file does.
+ *
+ * The order of the cars is kept, so the IDs still ascend within each partition and only
+ * the ID columns are rewritten; every partition is marked as changed, so the next save
+ * writes the new IDs.
+ *
+ * @param parts The database.
+ */
+void renumberPartitionedCars(struct PartitionedCars *parts) {
+    struct PartitionRow *cars;
+    int count = listAllCars(parts, &cars);
+    int index = 0;
+    for (int i = 0; i < count; i++) {
+        // Consecutive cars mostly share a partition.
+        if (parts->partitions[index].cars != cars[i].set) {
+            index = 0;
+            while (parts->partitions[index].cars != cars[i].set) {
+                index++;
+            }
+        }
+        parts->partitions[index].cars->ids[cars[i].row] = i + 1;
+    }
+    free(cars);
+    parts->nextId = count + 1;
+    for (int i = 0; i < parts->count; i++) {
+        struct Partition *partition = &parts->partitions[i];
+        partition->cars->nextId = parts->nextId;
+        partition->changed = 1;
+        if (liveCars(partition->cars) > 0) {
+            computeIdRange(partition);
+        }
+    }
+    parts->manifestChanged = 1;
+}
+
+/**
+ * @brief Writes every live car to one base.txt-format file, in record-ID order.
+ *
+ * The cars come out in the order they had before they were partitioned, followed by those
+ * added since; loading the file numbers them 1, 2, 3, ... in that order.
+ *
+ * @param parts The database.
+ * @param path Text file to write.
+ * @return 0 on success, -1 if the file cannot be written.
+ */
+int writePartitionedText(struct PartitionedCars *parts, const char *path) {
+    FILE *file = fopen(path, "w");
+    if (!file) {
+        return -1;
+    }
+    struct PartitionRow *cars;
+    int count = listAllCars(parts, &cars);
+    for (int i = 0; i < count; i++) {
+        writeTextRecord(file, cars[i].set, cars[i].row, i == 0);
+    }
+    free(cars);
+    int failed = ferror(file);
+    return (fclose(file) != 0 || failed) ? -1 : 0;
+}
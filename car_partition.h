@@ -0,0 +1,325 @@
+/**
+ * @file car_partition.h
+ * @brief Partitioned storage: cars sharded into files by year range or brand, with a manifest
+ *        of per-partition statistics used to skip partitions a search cannot match.
+ *
+ * A partitioned database is a directory holding one base.txt-format file per partition, the
+ * record IDs of its cars in a file next to it (part-N.txt and part-N.ids, one ID per line
+ * in the order of the cars), and a manifest. Every car belongs to the partition of its year
+ * range (e.g. 2010-2014) or of its brand. The manifest holds the record ID of the next car
+ * and lists the partitions in key order with their range of record IDs, the size and
+ * modification time of their files and statistics of their cars:
+ *
+ *     CARPARTS 1 year 5 next 7 ids 25001 partitions 3
+ *     part 4 key 2005 records 1210 ids 3 24870 size 51873 time 1700000000123456789 years 2005 2009
+ *         capacities 900 3000 brands 12 Audi BMW ... models -1 fuels 4 Diesel Electric LPG ...
+ *
+ * (one line per partition). A value list holds the distinct values of the field, or -1 when
+ * there are more than PARTITION_VALUES of them; such a field is never used to skip the
+ * partition. Opening the database reads only the manifest. A partition's file is loaded
+ * into a car set of its own, with every index, the first time an operation needs its cars;
+ * a search first tests the query against the statistics of each partition and leaves out
+ * the partitions none of whose cars can match, without loading or scanning them.
+ *
+ * Cars keep their record IDs when they are split into partitions, repartitioned or the
+ * database is opened again, and cars added later are numbered after all of them; within
+ * a partition the IDs ascend with the rows. Saving rewrites only the files of the
+ * partitions whose cars changed, each through a temporary file, and then the manifest; a
+ * file whose size or time no longer matches the manifest is loaded when the database is
+ * opened and its statistics are recomputed, and cars its ID file does not account for get
+ * new IDs.
+ */
+
+#ifndef CAR_PARTITION_H
+#define CAR_PARTITION_H
+
+#include "car_cache.h"
+#include "car_order.h"
+#include "car_store.h"
+#include <stdint.h>
+
+/** Identifies a partition manifest. */
+#define PARTITION_MAGIC "CARPARTS"
+
+/** Current manifest format version; manifests with another version are not opened. */
+#define PARTITION_VERSION 1
+
+/** Name of the manifest inside the partition directory. */
+#define PARTITION_MANIFEST "manifest.txt"
+
+/** Distinct values of a string field the manifest keeps per partition before giving up on the field. */
+#define PARTITION_VALUES 64
+
+/** Years per partition when partitioning by year without giving a span. */
+#define PARTITION_YEAR_SPAN 5
+
+/** Longest path of a partition file or of the manifest. */
+#define PARTITION_PATH_LENGTH 1024
+
+/** Ways of assigning cars to partitions. */
+enum PartitionScheme {
+    PARTITION_NONE,      ///< Not partitioned: one base file.
+    PARTITION_BY_YEAR,   ///< One partition per range of years.
+    PARTITION_BY_BRAND,  ///< One partition per brand.
+};
+
+/**
+ * @struct PartitionValues
+ * @brief Distinct values of a string field in a partition.
+ */
+struct PartitionValues {
+    char *values[PARTITION_VALUES];  ///< The values (owned), in no particular order.
+    int count;                       ///< Number of values.
+    int overflow;                    ///< Non-zero once the field had too many values to keep; they are then dropped.
+};
+
+/**
+ * @struct PartitionStats
+ * @brief Statistics of the cars of a partition, as kept in the manifest.
+ *
+ * While cars are removed the statistics are not narrowed, so they always describe at least
+ * the live cars; they are recomputed when the partition is saved.
+ */
+struct PartitionStats {
+    int cars;                       ///< Cars described.
+    int minYear;                    ///< Smallest year.
+    int maxYear;                    ///< Largest year.
+    int minCapacity;                ///< Smallest engine capacity.
+    int maxCapacity;                ///< Largest engine capacity.
+    struct PartitionValues brands;  ///< Brands.
+    struct PartitionValues models;  ///< Models.
+    struct PartitionValues fuels;   ///< Fuels.
+    struct PartitionValues types;   ///< Vehicle types.
+};
+
+/**
+ * @struct Partition
+ * @brief One partition: its file, its statistics and, once loaded, its cars.
+ */
+struct Partition {
+    int file;                     ///< Number of the partition file, named part-N.txt.
+    int firstYear;                ///< First year of a year partition.
+    char *brand;                  ///< Brand of a brand partition (owned), NULL for year partitions.
+    int minId;                    ///< Smallest record ID of the partition's cars.
+    int maxId;                    ///< Largest record ID of the partition's cars.
+    int records;                  ///< Cars in the file when the database was opened.
+    uint64_t size;                ///< Size of the file when it was last written or checked.
+    int64_t time;                 ///< Modification time of the file at that point.
+    struct PartitionStats stats;  ///< Statistics of the cars.
+    struct Cars *cars;            ///< Cars of the partition with their record IDs, or NULL until loaded.
+    struct QueryCache cache;      ///< Results of recent searches of the partition's cars.
+    int changed;                  ///< Non-zero if cars were added or removed since the file was written.
+};
+
+/**
+ * @struct PartitionedCars
+ * @brief A partitioned database.
+ */
+struct PartitionedCars {
+    char *directory;                ///< Directory holding the partition files and the manifest (owned).
+    enum PartitionScheme scheme;    ///< How cars are assigned to partitions.
+    int yearSpan;                   ///< Years per partition when partitioned by year.
+    struct Partition *partitions;   ///< Partitions in key order: years ascending, brands in byte order.
+    int count;                      ///< Number of partitions.
+    int allocated;                  ///< Number of partitions there is room for.
+    int nextFile;                   ///< Number of the next partition file.
+    int nextId;                     ///< Record ID of the next added car.
+    int manifestChanged;            ///< Non-zero if the manifest must be written even when no partition changed.
+};
+
+/**
+ * @struct PartitionRow
+ * @brief One car of a listing merged from several partitions.
+ */
+struct PartitionRow {
+    const struct Cars *set;  ///< Cars of the partition holding the car.
+    int row;                 ///< Row of the car.
+    int rank;                ///< Rank the listing is sorted on first, such as an edit distance (0 when unused).
+};
+
+/**
+ * @struct PartitionMatches
+ * @brief Sorted cars of one partition, to be merged with those of the others.
+ */
+struct PartitionMatches {
+    const struct Cars *set;  ///< Cars of the partition.
+    int *rows;               ///< Rows, in the order of the listing.
+    int *ranks;              ///< Rank of each row, or NULL when the listing has no ranks.
+    int count;               ///< Number of rows.
+};
+
+/**
+ * @brief Parses a partitioning scheme written as "year", "year:SPAN", "brand" or "none".
+ * @param text The scheme.
+ * @param scheme Receives the scheme.
+ * @param yearSpan Receives the years per partition (PARTITION_YEAR_SPAN unless given).
+ * @return 0 on success, -1 if the text is not a scheme.
+ */
+int parsePartitionScheme(const char *text, enum PartitionScheme *scheme, int *yearSpan);
+
+/**
+ * @brief Checks whether a directory holds a partition manifest.
+ * @param directory Partition directory.
+ * @return Non-zero if the manifest exists.
+ */
+int partitionedLayoutExists(const char *directory);
+
+/**
+ * @brief Opens a partitioned database by reading its manifest; no partition is loaded unless
+ *        its file changed since the manifest was written.
+ * @param directory Partition directory.
+ * @return The database, or NULL if the manifest is missing or damaged.
+ */
+struct PartitionedCars *openPartitionedCars(const char *directory);
+
+/**
+ * @brief Creates an empty partitioned database in memory; nothing is written until it is saved.
+ * @param directory Partition directory, created when the database is saved.
+ * @param scheme PARTITION_BY_YEAR or PARTITION_BY_BRAND.
+ * @param yearSpan Years per partition when partitioning by year.
+ * @return The database.
+ */
+struct PartitionedCars *createPartitionedCars(const char *directory, enum PartitionScheme scheme, int yearSpan);
+
+/**
+ * @brief Frees a partitioned database, including its loaded cars, without saving it.
+ * @param parts Database to free (may be NULL).
+ */
+void closePartitionedCars(struct PartitionedCars *parts);
+
+/**
+ * @brief Returns the number of live cars, counting those of unloaded partitions from the manifest.
+ * @param parts The database.
+ * @return Number of cars.
+ */
+int partitionedLiveCars(const struct PartitionedCars *parts);
+
+/**
+ * @brief Returns the memory held by the loaded partitions.
+ * @param parts The database.
+ * @return Bytes.
+ */
+size_t partitionedBytes(const struct PartitionedCars *parts);
+
+/**
+ * @brief Returns the cars of a partition, loading its file first if needed.
+ *
+ * The program stops with a message if the file cannot be read, as saving without its cars
+ * would lose them.
+ *
+ * @param parts The database.
+ * @param index Partition to load.
+ * @return Cars of the partition.
+ */
+struct Cars *loadPartition(struct PartitionedCars *parts, int index);
+
+/**
+ * @brief Checks whether some car of a partition may match a query, from its statistics alone.
+ * @param partition The partition.
+ * @param query The query, or NULL for every car.
+ * @return Zero if no car of the partition can match, non-zero if some may.
+ */
+int partitionMayMatch(const struct Partition *partition, const struct QueryNode *query);
+
+/**
+ * @brief Checks whether some car of a partition may have a brand or model starting with a prefix.
+ * @param partition The partition.
+ * @param field FIELD_BRAND or FIELD_MODEL.
+ * @param prefix The prefix.
+ * @return Zero if no car of the partition can have it, non-zero if some may.
+ */
+int partitionMayStartWith(const struct Partition *partition, enum QueryField field, const char *prefix);
+
+/**
+ * @brief Adds a car to the partition of its year or brand, creating the partition if needed.
+ * @param parts The database.
+ * @param car The car.
+ * @return Record ID of the car.
+ */
+int addPartitionedCar(struct PartitionedCars *parts, const struct CarRecord *car);
+
+/**
+ * @brief Adds every live car of a set, in row order, keeping their record IDs.
+ * @param parts The database, whose cars all have smaller IDs than those of the set.
+ * @param set Cars to add.
+ */
+void addPartitionedCars(struct PartitionedCars *parts, const struct Cars *set);
+
+/**
+ * @brief Adds the cars of one partitioned database to another, in record-ID order and keeping their IDs.
+ * @param parts The database the cars are added to, with no cars yet.
+ * @param from The database the cars are taken from; every partition is loaded.
+ */
+void movePartitionedCars(struct PartitionedCars *parts, struct PartitionedCars *from);
+
+/**
+ * @brief Numbers the cars 1, 2, 3, ... again in record-ID order, as compacting a base file does.
+ *
+ * Every partition is loaded and marked as changed, so the next save writes the new IDs.
+ *
+ * @param parts The database.
+ */
+void renumberPartitionedCars(struct PartitionedCars *parts);
+
+/**
+ * @brief Finds the live car with a record ID, loading its partition if needed.
+ * @param parts The database.
+ * @param id Record ID.
+ * @param partition Receives the partition holding the car.
+ * @param row Receives the row of the car.
+ * @return 0 on success, -1 if there is no live car with that ID.
+ */
+int findPartitionedCar(struct PartitionedCars *parts, int id, int *partition, int *row);
+
+/**
+ * @brief Removes the live car with a record ID.
+ * @param parts The database.
+ * @param id Record ID.
+ * @return 0 on success, -1 if there is no live car with that ID.
+ */
+int removePartitionedCar(struct PartitionedCars *parts, int id);
+
+/**
+ * @brief Writes the files of the changed partitions, then the manifest.
+ *
+ * Each partition file is written with its ID file. A partition left without cars loses its
+ * files and its manifest entry.
+ *
+ * @param parts The database.
+ * @param everything Non-zero to load and rewrite every partition, as when compacting.
+ * @param bytes Receives the number of bytes written (may be NULL).
+ * @return Number of partition files written, or -1 if a file cannot be written.
+ */
+int savePartitionedCars(struct PartitionedCars *parts, int everything, size_t *bytes);
+
+/**
+ * @brief Writes every live car to one base.txt-format file, in record-ID order.
+ * @param parts The database.
+ * @param path Text file to write.
+ * @return 0 on success, -1 if the file cannot be written.
+ */
+int writePartitionedText(struct PartitionedCars *parts, const char *path);
+
+/**
+ * @brief Deletes the partition files and, optionally, the manifest and the directory.
+ * @param parts The database whose files are deleted.
+ * @param layout Non-zero to delete the manifest and the directory as well.
+ */
+void removePartitionFiles(const struct PartitionedCars *parts, int layout);
+
+/**
+ * @brief Merges sorted listings of several partitions into one.
+ *
+ * Cars are ordered by rank, then under the order if one is given, then by record ID.
+ *
+ * @param lists Sorted listing of each partition.
+ * @param count Number of listings.
+ * @param order Order of the listings, or NULL for record-ID order.
+ * @param keep Number of leading cars wanted, or 0 for all of them.
+ * @param merged Receives a malloc'd array of the merged cars (NULL when empty).
+ * @return Number of merged cars.
+ */
+int mergePartitionMatches(const struct PartitionMatches *lists, int count, const struct CarOrder *order, long keep,
+                          struct PartitionRow **merged);
+
+#endif // CAR_PARTITION_H
@@ -0,0 +1,446 @@
+/**
+ * @file car_prefix.c
+ * @brief Implementation of the radix tries on string columns.
+ */
+
+#include "car_prefix.h"
+#include "car_store.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @struct ValueText
+ * @brief Growable buffer holding the value spelled by the path to a node.
+ */
+struct ValueText {
+    char *text;     ///< The characters, NUL-terminated.
+    size_t length;  ///< Number of characters.
+    size_t size;    ///< Bytes allocated for @c text.
+};
+
+/**
+ * @brief Reallocates an array, exiting the program when memory runs out.
+ * @param array Array to resize (may be NULL).
+ * @param size New size in bytes.
+ * @return The resized array.
+ */
+static void *resizeArray(void *array, size_t size) {
+    void *tmp = realloc(array, size ? size : 1);
+    if (!tmp) {
+        fprintf(stderr, "Memory allocation error.\n");
+        exit(EXIT_FAILURE);
+    }
+    return tmp;
+}
+
+/**
+ * @brief Returns the first character of a node's label.
+ * @param trie The trie.
+ * @param node The node; not the root.
+ * @return The character.
+ */
+static unsigned char firstByte(const struct PrefixTrie *trie, int node) {
+    return (unsigned char)trie->labels[trie->nodes[node].label];
+}
+
+/**
+ * @brief Finds the child of a node whose label starts with a character.
+ * @param trie The trie.
+ * @param node Parent node.
+ * @param byte The character.
+ * @param previous Receives the child before the place of @p byte in the list, or -1 (may be NULL).
+ * @return The child, or -1 if there is none.
+ */
+static int findChild(const struct PrefixTrie *trie, int node, unsigned char byte, int *previous) {
+    int before = -1, child = trie->nodes[node].child;
+    while (child >= 0 && firstByte(trie, child) < byte) {
+        before = child;
+        child = trie->nodes[child].sibling;
+    }
+    if (previous) {
+        *previous = before;
+    }
+    return (child >= 0 && firstByte(trie, child) == byte) ? child : -1;
+}
+
+/**
+ * @brief Adds a node with no children or cars.
+ * @param trie The trie.
+ * @param label Offset of the node's label.
+ * @param length Length of the label.
+ * @return The new node.
+ */
+static int addNode(struct PrefixTrie *trie, unsigned int label, unsigned int length) {
+    if (trie->count == trie->allocated) {
+        trie->allocated = trie->allocated ? trie->allocated * 2 : 64;
+        trie->nodes = (struct PrefixNode *)resizeArray(trie->nodes, (size_t)trie->allocated * sizeof *trie->nodes);
+    }
+    struct PrefixNode *node = &trie->nodes[trie->count];
+    memset(node, 0, sizeof *node);
+    node->label = label;
+    node->length = length;
+    node->child = -1;
+    node->sibling = -1;
+    return trie->count++;
+}
+
+/**
+ * @brief Copies a label into the label buffer.
+ * @param trie The trie.
+ * @param text The label.
+ * @param length Its length.
+ * @return Offset of the copy.
+ */
+static unsigned int storeLabel(struct PrefixTrie *trie, const char *text, size_t length) {
+    if (trie->labelsUsed + length > trie->labelsSize) {
+        size_t size = trie->labelsSize ? trie->labelsSize : 1024;
+        while (size < trie->labelsUsed + length) {
+            size *= 2;
+        }
+        trie->labels = (char *)resizeArray(trie->labels, size);
+        trie->labelsSize = size;
+    }
+    memcpy(trie->labels + trie->labelsUsed, text, length);
+    trie->labelsUsed += length;
+    return (unsigned int)(trie->labelsUsed - length);
+}
+
+/**
+ * @brief Adds a row to the postings of the node where its value ends.
+ * @param node The node.
+ * @param row Row of the car.
+ */
+static void addPosting(struct PrefixNode *node, int row) {
+    if (node->count == node->allocated) {
+        node->allocated = node->allocated ? node->allocated * 2 : 4;
+        node->rows = (int *)resizeArray(node->rows, (size_t)node->allocated * sizeof *node->rows);
+    }
+    node->rows[node->count++] = row;
+    node->cars++;
+}
+
+/**
+ * @brief Inserts one car.
+ *
+ * The walk follows the value down the trie. An edge whose label only partly matches is split
+ * where the value leaves it; the characters left over when no edge matches become the label
+ * of a new leaf. Labels of split edges keep pointing into the same characters.
+ *
+ * @param trie The trie.
+ * @param value Value of the car.
+ * @param length Length of the value.
+ * @param row Row of the car.
+ */
+static void insertValue(struct PrefixTrie *trie, const char *value, size_t length, int row) {
+    int node = 0;
+    size_t position = 0;
+    trie->nodes[0].total++;
+    while (position < length) {
+        int previous;
+        int child = findChild(trie, node, (unsigned char)value[position], &previous);
+        if (child < 0) {
+            unsigned int label = storeLabel(trie, value + position, length - position);
+            int leaf = addNode(trie, label, (unsigned int)(length - position));
+            trie->nodes[leaf].sibling = previous >= 0 ? trie->nodes[previous].sibling : trie->nodes[node].child;
+            if (previous >= 0) {
+                trie->nodes[previous].sibling = leaf;
+            } else {
+                trie->nodes[node].child = leaf;
+            }
+            trie->nodes[leaf].total = 1;
+            addPosting(&trie->nodes[leaf], row);
+            return;
+        }
+
+        const char *label = trie->labels + trie->nodes[child].label;
+        unsigned int labelLength = trie->nodes[child].length, common = 1;
+        while (common < labelLength && position + common < length && label[common] == value[position + common]) {
+            common++;
+        }
+        if (common < labelLength) {
+            int middle = addNode(trie, trie->nodes[child].label, common);
+            trie->nodes[middle].child = child;
+            trie->nodes[middle].sibling = trie->nodes[child].sibling;
+            trie->nodes[middle].total = trie->nodes[child].total;
+            trie->nodes[child].label += common;
+            trie->nodes[child].length -= common;
+            trie->nodes[child].sibling = -1;
+            if (previous >= 0) {
+                trie->nodes[previous].sibling = middle;
+            } else {
+                trie->nodes[node].child = middle;
+            }
+            child = middle;
+        }
+        trie->nodes[child].total++;
+        node = child;
+        position += common;
+    }
+    addPosting(&trie->nodes[node], row);
+}
+
+/**
+ * @brief Inserts a newly appended car, if the trie has been built.
+ * @param trie Trie to update.
+ * @param value Value of the car in the indexed column.
+ * @param length Length of the value.
+ * @param row Row of the car; must be greater than every row already inserted.
+ */
+void appendPrefix(struct PrefixTrie *trie, const char *value, size_t length, int row) {
+    if (trie->valid) {
+        insertValue(trie, value, length, row);
+    }
+}
+
+/**
+ * @brief Subtracts a removed car from the counts, if the trie has been built.
+ *
+ * The row stays in the postings until remapPrefixTrie() drops it; nodes whose counts reach
+ * zero stay too and are skipped by the lookups.
+ *
+ * @param trie Trie to update.
+ * @param value Value of the car in the indexed column.
+ * @param length Length of the value.
+ */
+void erasePrefix(struct PrefixTrie *trie, const char *value, size_t length) {
+    if (!trie->valid) {
+        return;
+    }
+    int node = 0;
+    size_t position = 0;
+    trie->nodes[0].total--;
+    while (position < length) {
+        node = findChild(trie, node, (unsigned char)value[position], NULL);
+        trie->nodes[node].total--;
+        position += trie->nodes[node].length;
+    }
+    trie->nodes[node].cars--;
+}
+
+/**
+ * @brief Drops dead rows from the postings and renumbers the others after a purge.
+ * @param trie Trie to update.
+ * @param map New row of every old row, or -1 for dead rows.
+ */
+void remapPrefixTrie(struct PrefixTrie *trie, const int *map) {
+    if (!trie->valid) {
+        return;
+    }
+    for (int i = 0; i < trie->count; i++) {
+        struct PrefixNode *node = &trie->nodes[i];
+        int kept = 0;
+        for (int j = 0; j < node->count; j++) {
+            if (map[node->rows[j]] >= 0) {
+                node->rows[kept++] = map[node->rows[j]];
+            }
+        }
+        node->count = kept;
+    }
+}
+
+/**
+ * @brief Builds a trie over the live rows of a column if it has not been built yet.
+ * @param set Car set owning the column.
+ * @param trie Trie of the column.
+ * @param column String column to index.
+ * @return The trie.
+ */
+const struct PrefixTrie *refreshPrefixTrie(const struct Cars *set, struct PrefixTrie *trie,
+                                           const struct CarString *column) {
+    if (trie->valid) {
+        return trie;
+    }
+    freePrefixTrie(trie);
+    addNode(trie, 0, 0);
+    for (int row = nextLiveRow(set, 0); row < set->rows; row = nextLiveRow(set, row + 1)) {
+        insertValue(trie, carString(set, column[row]), column[row].length, row);
+    }
+    trie->valid = 1;
+    return trie;
+}
+
+/**
+ * @brief Appends characters to a value buffer.
+ * @param text The buffer.
+ * @param characters Characters to append.
+ * @param length Number of characters.
+ */
+static void extendText(struct ValueText *text, const char *characters, size_t length) {
+    if (text->length + length + 1 > text->size) {
+        text->size = (text->length + length + 1) * 2;
+        text->text = (char *)resizeArray(text->text, text->size);
+    }
+    memcpy(text->text + text->length, characters, length);
+    text->length += length;
+    text->text[text->length] = '\0';
+}
+
+/**
+ * @brief Finds the node whose path is the shortest one starting with a prefix.
+ * @param trie The trie.
+ * @param prefix The prefix.
+ * @param text Receives the value spelled by the path to the node (may be NULL).
+ * @return The node, or -1 if no value with live cars starts with the prefix.
+ */
+static int findPrefix(const struct PrefixTrie *trie, const char *prefix, struct ValueText *text) {
+    size_t length = strlen(prefix), position = 0;
+    int node = 0;
+    while (position < length) {
+        node = findChild(trie, node, (unsigned char)prefix[position], NULL);
+        if (node < 0) {
+            return -1;
+        }
+        size_t compared = trie->nodes[node].length;
+        if (compared > length - position) {
+            compared = length - position;
+        }
+        if (memcmp(trie->labels + trie->nodes[node].label, prefix + position, compared) != 0) {
+            return -1;
+        }
+        if (text) {
+            extendText(text, trie->labels + trie->nodes[node].label, trie->nodes[node].length);
+        }
+        position += trie->nodes[node].length;
+    }
+    return trie->nodes[node].total > 0 ? node : -1;
+}
+
+/**
+ * @brief Counts the live cars whose value starts with a prefix.
+ * @param trie Built trie.
+ * @param prefix The prefix.
+ * @return Number of cars.
+ */
+int countPrefix(const struct PrefixTrie *trie, const char *prefix) {
+    int node = findPrefix(trie, prefix, NULL);
+    return node >= 0 ? trie->nodes[node].total : 0;
+}
+
+/**
+ * @brief Counts the live cars with exactly a value.
+ * @param trie Built trie.
+ * @param value The value.
+ * @return Number of cars.
+ */
+int countValue(const struct PrefixTrie *trie, const char *value) {
+    struct ValueText text = {NULL, 0, 0};
+    int node = findPrefix(trie, value, &text);
+    int cars = (node >= 0 && text.length == strlen(value)) ? trie->nodes[node].cars : 0;
+    free(text.text);
+    return cars;
+}
+
+/**
+ * @brief Returns the length of the longest start of a text that some live car's value starts with.
+ * @param trie Built trie.
+ * @param text The text.
+ * @return Length of the shared start, 0 if no value starts with the first character.
+ */
+size_t sharedPrefix(const struct PrefixTrie *trie, const char *text) {
+    size_t length = strlen(text), position = 0;
+    int node = 0;
+    while (position < length) {
+        node = findChild(trie, node, (unsigned char)text[position], NULL);
+        if (node < 0 || trie->nodes[node].total == 0) {
+            break;
+        }
+        const char *label = trie->labels + trie->nodes[node].label;
+        for (unsigned int i = 0; i < trie->nodes[node].length; i++) {
+            if (position == length || label[i] != text[position]) {
+                return position;
+            }
+            position++;
+        }
+    }
+    return position;
+}
+
+/**
+ * @brief Visits the values with live cars in a subtree, in byte order.
+ * @param trie The trie.
+ * @param node Root of the subtree.
+ * @param text Value spelled by the path to @p node; restored on return.
+ * @param visit Visitor.
+ * @param context Passed to the visitor.
+ * @return Number of values visited.
+ */
+static int visitSubtree(const struct PrefixTrie *trie, int node, struct ValueText *text, PrefixVisitor visit,
+                        void *context) {
+    int values = 0;
+    if (trie->nodes[node].cars > 0) {
+        visit(text->text, &trie->nodes[node], context);
+        values++;
+    }
+    for (int child = trie->nodes[node].child; child >= 0; child = trie->nodes[child].sibling) {
+        if (trie->nodes[child].total > 0) {
+            size_t length = text->length;
+            extendText(text, trie->labels + trie->nodes[child].label, trie->nodes[child].length);
+            values += visitSubtree(trie, child, text, visit, context);
+            text->length = length;
+            text->text[length] = '\0';
+        }
+    }
+    return values;
+}
+
+/**
+ * @brief Calls a visitor for every value with live cars that starts with a prefix, in byte order.
+ * @param trie Built trie.
+ * @param prefix The prefix ("" for every value).
+ * @param visit Visitor.
+ * @param context Passed to the visitor.
+ * @return Number of values visited.
+ */
+int visitPrefix(const struct PrefixTrie *trie, const char *prefix, PrefixVisitor visit, void *context) {
+    struct ValueText text = {NULL, 0, 0};
+    extendText(&text, "", 0);
+    int node = findPrefix(trie, prefix, &text);
+    int values = node >= 0 ? visitSubtree(trie, node, &text, visit, context) : 0;
+    free(text.text);
+    return values;
+}
+
+/**
+ * @brief Adds the values and postings of a subtree to a footprint.
+ * @param trie The trie.
+ * @param node Root of the subtree.
+ * @param depth Length of the value spelled by the path to @p node.
+ * @param footprint Footprint to add to.
+ */
+static void measureSubtree(const struct PrefixTrie *trie, int node, size_t depth, struct PrefixFootprint *footprint) {
+    const struct PrefixNode *current = &trie->nodes[node];
+    footprint->values += current->cars > 0;
+    footprint->postingBytes += (size_t)current->allocated * sizeof *current->rows;
+    footprint->rawBytes += (size_t)current->cars * depth;
+    for (int child = current->child; child >= 0; child = trie->nodes[child].sibling) {
+        measureSubtree(trie, child, depth + trie->nodes[child].length, footprint);
+    }
+}
+
+/**
+ * @brief Measures the memory of a trie and of the strings it indexes.
+ * @param trie Built trie.
+ * @param footprint Receives the measurements.
+ */
+void measurePrefixTrie(const struct PrefixTrie *trie, struct PrefixFootprint *footprint) {
+    memset(footprint, 0, sizeof *footprint);
+    footprint->nodes = trie->count;
+    footprint->trieBytes = (size_t)trie->allocated * sizeof *trie->nodes + trie->labelsSize;
+    if (trie->count > 0) {
+        measureSubtree(trie, 0, 0, footprint);
+    }
+}
+
+/**
+ * @brief Releases the memory of a trie and marks it as not built.
+ * @param trie Trie to release.
+ */
+void freePrefixTrie(struct PrefixTrie *trie) {
+    for (int i = 0; i < trie->count; i++) {
+        free(trie->nodes[i].rows);
+    }
+    free(trie->nodes);
+    free(trie->labels);
+    memset(trie, 0, sizeof *trie);
+}
@@ -0,0 +1,157 @@
+/**
+ * @file car_prefix.h
+ * @brief Radix tries over string columns, for prefix search and completion of brands and models.
+ *
+ * Each distinct value of the column is a path from the root, with runs of single-child
+ * nodes merged into one edge labelled by several characters. A node where a value ends
+ * holds the rows of its cars (its postings) and their number, and every node holds the
+ * number of cars whose value passes through it. The distinct values starting with a
+ * prefix, with their counts, are therefore found by walking down the prefix and listing
+ * the subtree below it, and the number of cars with the prefix is a single walk, without
+ * touching the car columns.
+ *
+ * Like the aggregates, a trie is built the first time it is needed and maintained from
+ * then on: appended cars are inserted, removed cars are subtracted from the counts and stay
+ * in the postings until the rows are purged.
+ */
+
+#ifndef CAR_PREFIX_H
+#define CAR_PREFIX_H
+
+#include <stddef.h>
+
+struct Cars;
+struct CarString;
+
+/**
+ * @struct PrefixNode
+ * @brief A node of a radix trie and the edge leading to it.
+ */
+struct PrefixNode {
+    unsigned int label;   ///< Offset of the edge label in PrefixTrie::labels.
+    unsigned int length;  ///< Length of the edge label (0 for the root).
+    int child;            ///< First child, or -1; children are linked in byte order of their labels.
+    int sibling;          ///< Next child of the same parent, or -1.
+    int cars;             ///< Live cars whose value ends at this node.
+    int total;            ///< Live cars whose value ends at this node or below it.
+    int *rows;            ///< Rows of the cars whose value ends here, ascending; removed ones stay until purged.
+    int count;            ///< Number of rows.
+    int allocated;        ///< Number of rows there is room for.
+};
+
+/**
+ * @struct PrefixTrie
+ * @brief Radix trie over one string column; node 0 is the root.
+ */
+struct PrefixTrie {
+    int valid;                 ///< Non-zero once built; maintained incrementally from then on.
+    struct PrefixNode *nodes;  ///< Nodes (NULL until built).
+    int count;                 ///< Number of nodes.
+    int allocated;             ///< Number of nodes there is room for.
+    char *labels;              ///< Characters of the edge labels.
+    size_t labelsUsed;         ///< Bytes of @c labels in use.
+    size_t labelsSize;         ///< Bytes allocated for @c labels.
+};
+
+/**
+ * @struct PrefixFootprint
+ * @brief Memory used by a trie, next to the strings it indexes.
+ */
+struct PrefixFootprint {
+    int values;           ///< Distinct values with live cars.
+    int nodes;            ///< Nodes of the trie.
+    size_t trieBytes;     ///< Bytes of nodes and labels.
+    size_t postingBytes;  ///< Bytes of postings.
+    size_t rawBytes;      ///< Bytes of the indexed strings of the live cars, without terminators.
+};
+
+/**
+ * @brief Callback receiving the values found by visitPrefix().
+ * @param value The value.
+ * @param node Node where the value ends; its postings may include removed cars.
+ * @param context Context passed to visitPrefix().
+ */
+typedef void (*PrefixVisitor)(const char *value, const struct PrefixNode *node, void *context);
+
+/**
+ * @brief Inserts a newly appended car, if the trie has been built.
+ * @param trie Trie to update.
+ * @param value Value of the car in the indexed column.
+ * @param length Length of the value.
+ * @param row Row of the car; must be greater than every row already inserted.
+ */
+void appendPrefix(struct PrefixTrie *trie, const char *value, size_t length, int row);
+
+/**
+ * @brief Subtracts a removed car from the counts, if the trie has been built.
+ * @param trie Trie to update.
+ * @param value Value of the car in the indexed column.
+ * @param length Length of the value.
+ */
+void erasePrefix(struct PrefixTrie *trie, const char *value, size_t length);
+
+/**
+ * @brief Drops dead rows from the postings and renumbers the others after a purge.
+ * @param trie Trie to update.
+ * @param map New row of every old row, or -1 for dead rows.
+ */
+void remapPrefixTrie(struct PrefixTrie *trie, const int *map);
+
+/**
+ * @brief Builds a trie over the live rows of a column if it has not been built yet.
+ * @param set Car set owning the column.
+ * @param trie Trie of the column.
+ * @param column String column to index.
+ * @return The trie.
+ */
+const struct PrefixTrie *refreshPrefixTrie(const struct Cars *set, struct PrefixTrie *trie,
+                                           const struct CarString *column);
+
+/**
+ * @brief Counts the live cars whose value starts with a prefix.
+ * @param trie Built trie.
+ * @param prefix The prefix.
+ * @return Number of cars.
+ */
+int countPrefix(const struct PrefixTrie *trie, const char *prefix);
+
+/**
+ * @brief Counts the live cars with exactly a value.
+ * @param trie Built trie.
+ * @param value The value.
+ * @return Number of cars.
+ */
+int countValue(const struct PrefixTrie *trie, const char *value);
+
+/**
+ * @brief Returns the length of the longest start of a text that some live car's value starts with.
+ * @param trie Built trie.
+ * @param text The text.
+ * @return Length of the shared start, 0 if no value starts with the first character.
+ */
+size_t sharedPrefix(const struct PrefixTrie *trie, const char *text);
+
+/**
+ * @brief Calls a visitor for every value with live cars that starts with a prefix, in byte order.
+ * @param trie Built trie.
+ * @param prefix The prefix ("" for every value).
+ * @param visit Visitor.
+ * @param context Passed to the visitor.
+ * @return Number of values visited.
+ */
+int visitPrefix(const struct PrefixTrie *trie, const char *prefix, PrefixVisitor visit, void *context);
+
+/**
+ * @brief Measures the memory of a trie and of the strings it indexes.
+ * @param trie Built trie.
+ * @param footprint Receives the measurements.
+ */
+void measurePrefixTrie(const struct PrefixTrie *trie, struct PrefixFootprint *footprint);
+
+/**
+ * @brief Releases the memory of a trie and marks it as not built.
+ * @param trie Trie to release.
+ */
+void freePrefixTrie(struct PrefixTrie *trie);
+
+#endif // CAR_PREFIX_H
@@ -0,0 +1,1196 @@
+/**
+ * @file car_query.c
+ * @brief Implementation of the query engine: building, parsing, planning and running queries.
+ */
+
+#include "car_query.h"
+#include "car_bitmap.h"
+#include "car_hash.h"
+#include "car_order.h"
+#include "car_parallel.h"
+#include "car_range.h"
+#include "car_scan.h"
+#include "car_trigram.h"
+#include <ctype.h>
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** Maximum length of a value in a query, as for the fields of a car. */
+#define MAX_FIELD_LENGTH 99
+
+/** Rows tested to estimate the selectivity of a predicate no index can count. */
+#define QUERY_SAMPLE 256
+
+/** Range queries matching more than 1/DENSE_RANGE_FRACTION of the cars scan the column instead of the index. */
+#define DENSE_RANGE_FRACTION 64
+
+/** Relative cost of comparing a number. */
+#define NUMBER_TEST_COST 1.0
+
+/** Relative cost of comparing a whole string. */
+#define EXACT_TEST_COST 2.0
+
+/** Relative cost of looking for a part of a string. */
+#define CONTAINS_TEST_COST 6.0
+
+/** Relative cost of fetching one row from an index and merging it into a result. */
+#define INDEX_ROW_COST 4.0
+
+/** Relative cost of one row of a vectorized column scan. */
+#define VECTOR_ROW_COST 0.25
+
+/** Relative cost of listing one row of a bitmap. */
+#define BITMAP_ROW_COST 1.0
+
+/** Relative cost of combining one 64-bit word of two bitmaps. */
+#define BITMAP_WORD_COST 1.0
+
+/**
+ * @brief Allocates a zeroed query node.
+ * @param kind Kind of the node.
+ * @return New node.
+ */
+static struct QueryNode *newNode(enum QueryKind kind) {
+    struct QueryNode *node = (struct QueryNode *)calloc(1, sizeof *node);
+    if (!node) {
+        fprintf(stderr, "Memory allocation error.\n");
+        exit(EXIT_FAILURE);
+    }
+    node->kind = kind;
+    node->driver = -1;
+    return node;
+}
+
+/**
+ * @brief Creates a string predicate.
+ * @param field String field to test.
+ * @param kind QUERY_EXACT or QUERY_CONTAINS.
+ * @param text Value to look for (copied).
+ * @return New node; free the tree with freeQuery().
+ */
+struct QueryNode *stringPredicate(enum QueryField field, enum QueryKind kind, const char *text) {
+    struct QueryNode *node = newNode(kind);
+    node->field = field;
+    node->length = strlen(text);
+    node->text = (char *)malloc(node->length + 1);
+    if (!node->text) {
+        fprintf(stderr, "Memory allocation error.\n");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(node->text, text, node->length + 1);
+    return node;
+}
+
+/**
+ * @brief Creates a numeric range predicate.
+ * @param field FIELD_YEAR or FIELD_CAPACITY.
+ * @param min Smallest matching value.
+ * @param max Largest matching value.
+ * @return New node; free the tree with freeQuery().
+ */
+struct QueryNode *rangePredicate(enum QueryField field, int min, int max) {
+    struct QueryNode *node = newNode(QUERY_RANGE);
+    node->field = field;
+    node->min = min;
+    node->max = max;
+    return node;
+}
+
+/**
+ * @brief Appends a child to an AND/OR node.
+ * @param node Node to extend.
+ * @param child Child to append (taken over).
+ */
+static void appendChild(struct QueryNode *node, struct QueryNode *child) {
+    struct QueryNode **tmp =
+        (struct QueryNode **)realloc(node->children, (size_t)(node->childCount + 1) * sizeof *tmp);
+    if (!tmp) {
+        fprintf(stderr, "Memory allocation error.\n");
+        exit(EXIT_FAILURE);
+    }
+    node->children = tmp;
+    node->children[node->childCount++] = child;
+}
+
+/**
+ * @brief Combines two queries with AND or OR.
+ * @param kind QUERY_AND or QUERY_OR.
+ * @param left First query (taken over).
+ * @param right Second query (taken over).
+ * @return Combined query.
+ */
+struct QueryNode *combineQueries(enum QueryKind kind, struct QueryNode *left, struct QueryNode *right) {
+    struct QueryNode *node = left->kind == kind ? left : NULL;
+    if (!node) {
+        node = newNode(kind);
+        appendChild(node, left);
+    }
+
+    if (right->kind == kind) {
+        for (int i = 0; i < right->childCount; i++) {
+            appendChild(node, right->children[i]);
+        }
+        free(right->children);
+        free(right);
+    } else {
+        appendChild(node, right);
+    }
+    return node;
+}
+
+/**
+ * @brief Frees a query tree.
+ * @param query Query to free (may be NULL).
+ */
+void freeQuery(struct QueryNode *query) {
+    if (!query) {
+        return;
+    }
+    for (int i = 0; i < query->childCount; i++) {
+        freeQuery(query->children[i]);
+    }
+    free(query->children);
+    free(query->text);
+    free(query);
+}
+
+/* ------------------------------------------------------------------------------------------ */
+/* Parsing                                                                                     */
+/* ------------------------------------------------------------------------------------------ */
+
+/** Kinds of tokens in a query text. */
+enum TokenKind {
+    TOKEN_END,       ///< End of the text.
+    TOKEN_WORD,      ///< Field name, keyword or value.
+    TOKEN_EQUAL,     ///< =
+    TOKEN_CONTAINS,  ///< ~
+    TOKEN_LESS,      ///< <
+    TOKEN_AT_MOST,   ///< <=
+    TOKEN_GREATER,   ///< >
+    TOKEN_AT_LEAST,  ///< >=
+    TOKEN_OPEN,      ///< (
+    TOKEN_CLOSE,     ///< )
+};
+
+/**
+ * @struct QueryParser
+ * @brief State of the recursive-descent query parser.
+ */
+struct QueryParser {
+    const char *next;                    ///< Text after the current token.
+    enum TokenKind token;                ///< Current token.
+    char word[MAX_FIELD_LENGTH + 1];     ///< Text of the current token.
+    char *error;                         ///< Receives the first problem.
+    size_t errorSize;                    ///< Size of @c error.
+    int failed;                          ///< Non-zero once a problem was found.
+};
+
+/** Names of the fields, as written in queries. */
+static const char *const fieldNames[] = {"brand", "model", "year", "capacity", "fuel", "type", "registration"};
+
+/**
+ * @brief Records the first problem found while parsing.
+ * @param parser The parser.
+ * @param message printf-style description of the problem.
+ * @param detail Text substituted for %s in @p message.
+ */
+static void parseError(struct QueryParser *parser, const char *message, const char *detail) {
+    if (!parser->failed) {
+        snprintf(parser->error, parser->errorSize, message, detail);
+        parser->failed = 1;
+    }
+}
+
+/**
+ * @brief Reads the next token into the parser.
+ * @param parser The parser.
+ */
+static void advance(struct QueryParser *parser) {
+    const char *c = parser->next;
+    while (isspace((unsigned char)*c)) {
+        c++;
+    }
+
+    static const char operators[] = "=~<>()";
+    size_t length = 1;
+    switch (*c) {
+        case '\0': parser->token = TOKEN_END; length = 0; break;
+        case '=': parser->token = TOKEN_EQUAL; break;
+        case '~': parser->token = TOKEN_CONTAINS; break;
+        case '(': parser->token = TOKEN_OPEN; break;
+        case ')': parser->token = TOKEN_CLOSE; break;
+        case '<':
+            parser->token = c[1] == '=' ? TOKEN_AT_MOST : TOKEN_LESS;
+            length = c[1] == '=' ? 2 : 1;
+            break;
+        case '>':
+            parser->token = c[1] == '=' ? TOKEN_AT_LEAST : TOKEN_GREATER;
+            length = c[1] == '=' ? 2 : 1;
+            break;
+        default:
+            parser->token = TOKEN_WORD;
+            length = 0;
+            while (c[length] && !isspace((unsigned char)c[length]) && !strchr(operators, c[length])) {
+                length++;
+            }
+            break;
+    }
+
+    if (length > MAX_FIELD_LENGTH) {
+        parseError(parser, "a value is longer than 99 characters", NULL);
+        length = MAX_FIELD_LENGTH;
+    }
+    memcpy(parser->word, c, length);
+    parser->word[length] = '\0';
+    parser->next = c + length;
+}
+
+/**
+ * @brief Tests whether the current token is a keyword.
+ * @param parser The parser.
+ * @param keyword Keyword in lower case.
+ * @return Non-zero if the current token is the keyword, in any case.
+ */
+static int atKeyword(const struct QueryParser *parser, const char *keyword) {
+    if (parser->token != TOKEN_WORD) {
+        return 0;
+    }
+    const char *w = parser->word;
+    while (*keyword && tolower((unsigned char)*w) == *keyword) {
+        w++;
+        keyword++;
+    }
+    return *w == '\0' && *keyword == '\0';
+}
+
+/**
+ * @brief Parses a whole number.
+ * @param text Text of the number.
+ * @param value Receives the number.
+ * @return 0 on success, -1 if the text is not a number.
+ */
+static int parseInteger(const char *text, int *value) {
+    char *end;
+    long parsed = strtol(text, &end, 10);
+    if (end == text || *end != '\0' || parsed < INT_MIN || parsed > INT_MAX) {
+        return -1;
+    }
+    *value = (int)parsed;
+    return 0;
+}
+
+/**
+ * @brief Looks up a field by the name used in queries, in any case.
+ * @param name The name, e.g. "year".
+ * @param length Length of the name.
+ * @return The field, or -1 if no field has that name.
+ */
+int findQueryField(const char *name, size_t length) {
+    for (int f = 0; f < (int)(sizeof fieldNames / sizeof fieldNames[0]); f++) {
+        size_t i = 0;
+        while (i < length && fieldNames[f][i] && tolower((unsigned char)name[i]) == fieldNames[f][i]) {
+            i++;
+        }
+        if (i == length && fieldNames[f][i] == '\0') {
+            return f;
+        }
+    }
+    return -1;
+}
+
+static struct QueryNode *parseOr(struct QueryParser *parser);
+
+/**
+ * @brief Parses a predicate or a parenthesized query.
+ * @param parser The parser, positioned on the first token of the term.
+ * @return The term, or NULL after a problem.
+ */
+static struct QueryNode *parseTerm(struct QueryParser *parser) {
+    if (parser->token == TOKEN_OPEN) {
+        advance(parser);
+        struct QueryNode *inner = parseOr(parser);
+        if (inner && parser->token != TOKEN_CLOSE) {
+            parseError(parser, parser->token == TOKEN_END ? "a ')' is missing" : "expected ')' instead of '%s'",
+                       parser->word);
+            freeQuery(inner);
+            return NULL;
+        }
+        advance(parser);
+        return inner;
+    }
+
+    if (parser->token != TOKEN_WORD) {
+        if (parser->token == TOKEN_END) {
+            parseError(parser, "the query ends too early", NULL);
+        } else {
+            parseError(parser, "expected a field name instead of '%s'", parser->word);
+        }
+        return NULL;
+    }
+    int field = findQueryField(parser->word, strlen(parser->word));
+    if (field < 0) {
+        parseError(parser, "unknown field '%s'", parser->word);
+        return NULL;
+    }
+    int numeric = (field == FIELD_YEAR || field == FIELD_CAPACITY);
+
+    advance(parser);
+    enum TokenKind comparison = parser->token;
+    if (comparison < TOKEN_EQUAL || comparison > TOKEN_AT_LEAST) {
+        parseError(parser, "expected =, ~, <, <=, > or >= after %s", fieldNames[field]);
+        return NULL;
+    }
+    if (comparison == TOKEN_CONTAINS && numeric) {
+        parseError(parser, "'~' only applies to text fields, not %s", fieldNames[field]);
+        return NULL;
+    }
+    if (comparison != TOKEN_EQUAL && comparison != TOKEN_CONTAINS && !numeric) {
+        parseError(parser, "<, <=, > and >= only apply to year and capacity, not %s", fieldNames[field]);
+        return NULL;
+    }
+
+    advance(parser);
+    if (parser->token != TOKEN_WORD) {
+        parseError(parser, "expected a value after %s", fieldNames[field]);
+        return NULL;
+    }
+    char value[MAX_FIELD_LENGTH + 1];
+    memcpy(value, parser->word, sizeof value);
+    advance(parser);
+
+    if (!numeric) {
+        return stringPredicate((enum QueryField)field, comparison == TOKEN_EQUAL ? QUERY_EXACT : QUERY_CONTAINS, value);
+    }
+
+    int min = INT_MIN, max = INT_MAX, number;
+    char *dots = strstr(value, "..");
+    if (comparison == TOKEN_EQUAL && dots) {
+        *dots = '\0';
+        if (parseInteger(value, &min) != 0 || parseInteger(dots + 2, &max) != 0) {
+            *dots = '.';
+            parseError(parser, "invalid range '%s'; write it as MIN..MAX", value);
+            return NULL;
+        }
+        return rangePredicate((enum QueryField)field, min, max);
+    }
+    if (parseInteger(value, &number) != 0) {
+        parseError(parser, "invalid number '%s'", value);
+        return NULL;
+    }
+    switch (comparison) {
+        case TOKEN_EQUAL: min = max = number; break;
+        case TOKEN_LESS: max = number == INT_MIN ? INT_MIN : number - 1; min = number == INT_MIN ? 0 : INT_MIN; break;
+        case TOKEN_AT_MOST: max = number; break;
+        case TOKEN_GREATER: min = number == INT_MAX ? INT_MAX : number + 1; max = number == INT_MAX ? 0 : INT_MAX; break;
+        default: min = number; break;
+    }
+    return rangePredicate((enum QueryField)field, min, max);
+}
+
+/**
+ * @brief Parses terms joined by AND.
+ * @param parser The parser.
+ * @return The query, or NULL after a problem.
+ */
+static struct QueryNode *parseAnd(struct QueryParser *parser) {
+    struct QueryNode *query = parseTerm(parser);
+    while (query && atKeyword(parser, "and")) {
+        advance(parser);
+        struct QueryNode *right = parseTerm(parser);
+        if (!right) {
+            freeQuery(query);
+            return NULL;
+        }
+        query = combineQueries(QUERY_AND, query, right);
+    }
+    return query;
+}
+
+/**
+ * @brief Parses AND groups joined by OR.
+ * @param parser The parser.
+ * @return The query, or NULL after a problem.
+ */
+static struct QueryNode *parseOr(struct QueryParser *parser) {
+    struct QueryNode *query = parseAnd(parser);
+    while (query && atKeyword(parser, "or")) {
+        advance(parser);
+        struct QueryNode *right = parseAnd(parser);
+        if (!right) {
+            freeQuery(query);
+            return NULL;
+        }
+        query = combineQueries(QUERY_OR, query, right);
+    }
+    return query;
+}
+
+/**
+ * @brief Parses a query written as text.
+ * @param text The query.
+ * @param error Receives a description of the first problem if the query is invalid.
+ * @param errorSize Size of @p error.
+ * @return New query, or NULL if the text is not a valid query.
+ */
+struct QueryNode *parseQuery(const char *text, char *error, size_t errorSize) {
+    struct QueryParser parser = {text, TOKEN_END, "", error, errorSize, 0};
+    advance(&parser);
+    struct QueryNode *query = parseOr(&parser);
+    if (query && parser.token != TOKEN_END) {
+        parseError(&parser, "unexpected '%s'", parser.word);
+    }
+    if (parser.failed) {
+        freeQuery(query);
+        return NULL;
+    }
+    return query;
+}
+
+/**
+ * @brief Orders formatted children for qsort().
+ * @param a First child text.
+ * @param b Second child text.
+ * @return strcmp() of the two texts.
+ */
+static int compareTexts(const void *a, const void *b) {
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+/**
+ * @brief Writes a query as text in a normalized form.
+ *
+ * Predicates are written as "field = value", "field ~ value" or "field = MIN..MAX", and the
+ * children of every AND/OR node are sorted, with nested groups in parentheses. Queries that
+ * differ only in the order of their criteria, or in how they were entered, get the same text,
+ * which is itself a valid query.
+ *
+ * @param query Query to write.
+ * @param text Receives the text.
+ * @param size Size of @p text.
+ * @return Length of the text, or -1 if it does not fit in @p size bytes.
+ */
+int formatQuery(const struct QueryNode *query, char *text, size_t size) {
+    int length;
+    switch (query->kind) {
+        case QUERY_EXACT:
+        case QUERY_CONTAINS:
+            length = snprintf(text, size, "%s %c %s", fieldNames[query->field], query->kind == QUERY_EXACT ? '=' : '~',
+                              query->text);
+            break;
+        case QUERY_RANGE:
+            length = snprintf(text, size, "%s = %d..%d", fieldNames[query->field], query->min, query->max);
+            break;
+        default: {
+            char **children = (char **)calloc((size_t)query->childCount, sizeof *children);
+            if (!children) {
+                fprintf(stderr, "Memory allocation error.\n");
+                exit(EXIT_FAILURE);
+            }
+            length = 0;
+            for (int i = 0; i < query->childCount && length >= 0; i++) {
+                children[i] = (char *)malloc(size);
+                if (!children[i]) {
+                    fprintf(stderr, "Memory allocation error.\n");
+                    exit(EXIT_FAILURE);
+                }
+                int nested = query->children[i]->childCount > 0;
+                int written = formatQuery(query->children[i], children[i] + nested, size - 2);
+                if (written < 0) {
+                    length = -1;
+                } else if (nested) {
+                    children[i][0] = '(';
+                    memcpy(children[i] + written + 1, ")", 2);
+                }
+            }
+            if (length >= 0) {
+                qsort(children, (size_t)query->childCount, sizeof *children, compareTexts);
+                text[0] = '\0';
+                for (int i = 0; i < query->childCount && length >= 0; i++) {
+                    int written = snprintf(text + length, size - (size_t)length, "%s%s",
+                                           i == 0 ? "" : query->kind == QUERY_AND ? " and " : " or ", children[i]);
+                    length = written < 0 || (size_t)written >= size - (size_t)length ? -1 : length + written;
+                }
+            }
+            for (int i = 0; i < query->childCount; i++) {
+                free(children[i]);
+            }
+            free(children);
+            return length;
+        }
+    }
+    return length < 0 || (size_t)length >= size ? -1 : length;
+}
+
+/* ------------------------------------------------------------------------------------------ */
+/* Evaluation                                                                                  */
+/* ------------------------------------------------------------------------------------------ */
+
+/**
+ * @brief Returns the string column a predicate tests.
+ * @param set Car set holding the column.
+ * @param field String field.
+ * @return The column.
+ */
+static const struct CarString *stringColumn(const struct Cars *set, enum QueryField field) {
+    switch (field) {
+        case FIELD_BRAND: return set->brand;
+        case FIELD_MODEL: return set->model;
+        case FIELD_FUEL: return set->fuel;
+        case FIELD_TYPE: return set->type;
+        default: return set->registration;
+    }
+}
+
+/**
+ * @brief Returns the trigram index on a string field.
+ * @param set Car set holding the index.
+ * @param field String field.
+ * @return The index, or NULL if the field has none.
+ */
+static const struct TrigramIndex *trigramIndex(const struct Cars *set, enum QueryField field) {
+    return field == FIELD_BRAND ? &set->brandTrigrams : field == FIELD_MODEL ? &set->modelTrigrams : NULL;
+}
+
+/**
+ * @brief Returns the bitmap index on a string field.
+ * @param set Car set holding the index.
+ * @param field String field.
+ * @return The index, or NULL if the field has none or it is disabled.
+ */
+static const struct BitmapIndex *bitmapIndex(const struct Cars *set, enum QueryField field) {
+    const struct BitmapIndex *index =
+        field == FIELD_FUEL ? &set->fuelBitmaps : field == FIELD_TYPE ? &set->typeBitmaps : NULL;
+    return (index && !index->disabled) ? index : NULL;
+}
+
+/**
+ * @brief Collects the bitmaps of the dictionary values a string predicate accepts.
+ *
+ * An exact match accepts at most one value; a partial match accepts every value that
+ * contains the text, so it is answered by the union of their bitmaps.
+ *
+ * @param index Bitmap index on the predicate's field.
+ * @param node String predicate.
+ * @param bitmaps Receives up to BITMAP_MAX_VALUES bitmaps.
+ * @param matches Receives the total number of rows in them (may be NULL).
+ * @return Number of bitmaps.
+ */
+static int predicateBitmaps(const struct BitmapIndex *index, const struct QueryNode *node,
+                            const struct RowBitmap **bitmaps, long *matches) {
+    int count = 0;
+    long total = 0;
+    if (node->kind == QUERY_EXACT) {
+        bitmaps[0] = findBitmap(index, node->text, node->length);
+        count = bitmaps[0] != NULL;
+    } else {
+        for (int code = 0; code < index->count; code++) {
+            if (index->values[code].rows.count > 0 && strstr(index->values[code].text, node->text)) {
+                bitmaps[count++] = &index->values[code].rows;
+            }
+        }
+    }
+    for (int i = 0; i < count; i++) {
+        total += bitmaps[i]->count;
+    }
+    if (matches) {
+        *matches = total;
+    }
+    return count;
+}
+
+/**
+ * @brief Tests whether a child of an AND node is answered by a word-wise bitmap intersection.
+ * @param set Car set the query runs on.
+ * @param node Child to test.
+ * @return Non-zero for an exact match on a field with a bitmap index.
+ */
+static int isBitmapTerm(const struct Cars *set, const struct QueryNode *node) {
+    return node->kind == QUERY_EXACT && bitmapIndex(set, node->field) != NULL;
+}
+
+/**
+ * @brief Tests one row against a query, stopping at the first child that settles it.
+ * @param set Car set holding the row.
+ * @param node Query to test.
+ * @param row Row to test.
+ * @param skip Child of an AND node already known to match, or -1.
+ * @return Non-zero if the row matches.
+ */
+static int matchNode(const struct Cars *set, const struct QueryNode *node, int row, int skip) {
+    switch (node->kind) {
+        case QUERY_EXACT: {
+            struct CarString ref = stringColumn(set, node->field)[row];
+            return ref.length == node->length && memcmp(carString(set, ref), node->text, node->length) == 0;
+        }
+        case QUERY_CONTAINS:
+            return strstr(carString(set, stringColumn(set, node->field)[row]), node->text) != NULL;
+        case QUERY_RANGE: {
+            int value = node->field == FIELD_YEAR ? set->year[row] : set->capacity[row];
+            return value >= node->min && value <= node->max;
+        }
+        case QUERY_AND:
+            for (int i = 0; i < node->childCount; i++) {
+                if (i != skip && !matchNode(set, node->children[i], row, -1)) {
+                    return 0;
+                }
+            }
+            return 1;
+        default:
+            for (int i = 0; i < node->childCount; i++) {
+                if (matchNode(set, node->children[i], row, -1)) {
+                    return 1;
+                }
+            }
+            return 0;
+    }
+}
+
+/**
+ * @brief Adapts matchNode() to parallelScan().
+ * @param set Car set being scanned.
+ * @param row Row to test.
+ * @param context The query.
+ * @return Non-zero if the row matches.
+ */
+static int matchRow(const struct Cars *set, int row, const void *context) {
+    return matchNode(set, (const struct QueryNode *)context, row, -1);
+}
+
+/**
+ * @brief Estimates the fraction of rows a predicate matches by testing an even sample.
+ * @param set Car set to sample.
+ * @param node Predicate to estimate.
+ * @return Estimated fraction, never exactly 0 or 1.
+ */
+static double sampleSelectivity(const struct Cars *set, const struct QueryNode *node) {
+    int step = set->rows > QUERY_SAMPLE ? set->rows / QUERY_SAMPLE : 1;
+    int tested = 0, hits = 0;
+    for (int row = 0; row < set->rows; row += step) {
+        if (!isDeadRow(set, row)) {
+            tested++;
+            hits += matchNode(set, node, row, -1);
+        }
+    }
+    return (hits + 0.5) / (tested + 1.0);
+}
+
+/**
+ * @brief Keeps a selectivity away from zero before dividing by it.
+ * @param fraction Selectivity.
+ * @return @p fraction, or a tiny positive value if it is smaller.
+ */
+static double atLeast(double fraction) {
+    return fraction > 1e-9 ? fraction : 1e-9;
+}
+
+/**
+ * @brief Orders AND children: the cheapest test most likely to reject a row comes first.
+ * @param a First child.
+ * @param b Second child.
+ * @return Negative, zero or positive as @p a should run before, with or after @p b.
+ */
+static int compareAndChildren(const void *a, const void *b) {
+    const struct QueryNode *x = *(const struct QueryNode *const *)a, *y = *(const struct QueryNode *const *)b;
+    // Rank by cost per rejected row; the selectivities are fractions stored in estimate by planNode().
+    double rx = x->rowCost / atLeast(1.0 - x->estimate), ry = y->rowCost / atLeast(1.0 - y->estimate);
+    return (rx > ry) - (rx < ry);
+}
+
+/**
+ * @brief Orders OR children: the cheapest test most likely to accept a row comes first.
+ * @param a First child.
+ * @param b Second child.
+ * @return Negative, zero or positive as @p a should run before, with or after @p b.
+ */
+static int compareOrChildren(const void *a, const void *b) {
+    const struct QueryNode *x = *(const struct QueryNode *const *)a, *y = *(const struct QueryNode *const *)b;
+    double rx = x->rowCost / atLeast(x->estimate), ry = y->rowCost / atLeast(y->estimate);
+    return (rx > ry) - (rx < ry);
+}
+
+/**
+ * @brief Estimates the matches and costs of a query and orders the children of its nodes.
+ *
+ * Ranges are counted exactly by their index, exact plates by the hash index, fuel and type
+ * values by their bitmaps, and brand and model patterns are bounded by their shortest
+ * trigram posting list; other predicates are estimated from a sample. AND and OR estimates
+ * assume independent children.
+ *
+ * @param set Car set the query will run on.
+ * @param node Query to plan.
+ */
+static void planNode(const struct Cars *set, struct QueryNode *node) {
+    double rows = set->rows;
+    node->indexCost = INFINITY;
+    node->driver = -1;
+    node->intersect = 0;
+
+    switch (node->kind) {
+        case QUERY_EXACT:
+        case QUERY_CONTAINS: {
+            node->rowCost = node->kind == QUERY_EXACT ? EXACT_TEST_COST : CONTAINS_TEST_COST;
+            const struct TrigramIndex *trigrams = trigramIndex(set, node->field);
+            const struct BitmapIndex *bitmaps = bitmapIndex(set, node->field);
+            if (bitmaps) {
+                // Rows not synchronized yet are tested one by one.
+                const struct RowBitmap *accepted[BITMAP_MAX_VALUES];
+                long matches;
+                predicateBitmaps(bitmaps, node, accepted, &matches);
+                double pending = rows - bitmaps->indexed;
+                node->estimate = (double)matches + pending;
+                node->indexCost = (double)matches * BITMAP_ROW_COST + pending * node->rowCost;
+            } else if (node->field == FIELD_REGISTRATION && node->kind == QUERY_EXACT) {
+                node->estimate = findRegistrations(set, node->text, NULL, 0);
+                node->indexCost = 1.0 + node->estimate * INDEX_ROW_COST;
+            } else if (trigrams && node->length >= TRIGRAM_LENGTH) {
+                node->estimate = estimateSubstrings(trigrams, node->text);
+                node->indexCost = node->estimate * (INDEX_ROW_COST + node->rowCost);
+            } else {
+                node->estimate = sampleSelectivity(set, node) * rows;
+            }
+            break;
+        }
+
+        case QUERY_RANGE: {
+            const struct RangeIndex *index = node->field == FIELD_YEAR ? &set->years : &set->capacities;
+            node->rowCost = NUMBER_TEST_COST;
+            node->estimate = node->min <= node->max ? countRange(index, node->min, node->max) : 0;
+            node->indexCost = node->estimate > rows / DENSE_RANGE_FRACTION ? rows * VECTOR_ROW_COST
+                                                                           : node->estimate * INDEX_ROW_COST;
+            break;
+        }
+
+        case QUERY_AND:
+        case QUERY_OR: {
+            int isAnd = node->kind == QUERY_AND;
+            for (int i = 0; i < node->childCount; i++) {
+                planNode(set, node->children[i]);
+                // Sort on selectivities; the row estimates are restored below.
+                node->children[i]->estimate = rows > 0 ? node->children[i]->estimate / rows : 0.0;
+            }
+            qsort(node->children, (size_t)node->childCount, sizeof *node->children,
+                  isAnd ? compareAndChildren : compareOrChildren);
+
+            // Expected cost of testing a row, stopping at the first child that settles it.
+            double reach = 1.0, cost = 0.0, indexSum = 0.0;
+            for (int i = 0; i < node->childCount; i++) {
+                struct QueryNode *child = node->children[i];
+                cost += reach * child->rowCost;
+                reach *= isAnd ? child->estimate : 1.0 - child->estimate;
+                child->estimate *= rows;
+                indexSum += child->indexCost + child->estimate;
+            }
+            node->rowCost = cost;
+            node->estimate = (isAnd ? reach : 1.0 - reach) * rows;
+
+            if (!isAnd) {
+                node->indexCost = indexSum;  // Infinite unless every child has an index path.
+                break;
+            }
+            // Drive from the indexed child whose rows are cheapest to fetch and filter.
+            for (int i = 0; i < node->childCount; i++) {
+                const struct QueryNode *child = node->children[i];
+                double driven = child->indexCost + child->estimate * (cost - child->rowCost);
+                if (isfinite(driven) && driven < node->indexCost) {
+                    node->indexCost = driven;
+                    node->driver = i;
+                }
+            }
+
+            // Or start from the word-wise AND of every exact fuel and type match.
+            int terms = 0;
+            double selectivity = 1.0, otherCost = 0.0;
+            for (int i = 0; i < node->childCount; i++) {
+                const struct QueryNode *child = node->children[i];
+                if (isBitmapTerm(set, child)) {
+                    terms++;
+                    selectivity *= rows > 0 ? child->estimate / rows : 0.0;
+                } else {
+                    otherCost += child->rowCost;
+                }
+            }
+            double intersected = terms * (rows / 64) * BITMAP_WORD_COST + selectivity * rows * (BITMAP_ROW_COST + otherCost);
+            if (terms >= 2 && intersected < node->indexCost) {
+                node->indexCost = intersected;
+                node->driver = -1;
+                node->intersect = 1;
+            }
+            break;
+        }
+    }
+}
+
+/**
+ * @brief Drops removed cars from a row list, keeping the order.
+ * @param set Car set holding the rows.
+ * @param rows Row list.
+ * @param count Number of rows.
+ * @return Number of rows kept.
+ */
+static int dropDeadRows(const struct Cars *set, int *rows, int count) {
+    if (set->deadRows == 0) {
+        return count;
+    }
+    int kept = 0;
+    for (int i = 0; i < count; i++) {
+        if (!isDeadRow(set, rows[i])) {
+            rows[kept++] = rows[i];
+        }
+    }
+    return kept;
+}
+
+/**
+ * @brief Merges two ascending row lists into their union.
+ * @param a First list (freed).
+ * @param countA Length of the first list.
+ * @param b Second list (freed).
+ * @param countB Length of the second list.
+ * @param merged Receives the union (NULL when empty).
+ * @return Length of the union.
+ */
+static int mergeRows(int *a, int countA, int *b, int countB, int **merged) {
+    if (countA == 0 || countB == 0) {
+        *merged = countA ? a : b;
+        free(countA ? b : a);
+        return countA + countB;
+    }
+
+    int *out = (int *)malloc((size_t)(countA + countB) * sizeof *out);
+    if (!out) {
+        fprintf(stderr, "Memory allocation error.\n");
+        exit(EXIT_FAILURE);
+    }
+    int i = 0, j = 0, n = 0;
+    while (i < countA && j < countB) {
+        int next = a[i] < b[j] ? a[i] : b[j];
+        i += (a[i] == next);
+        j += (b[j] == next);
+        out[n++] = next;
+    }
+    while (i < countA) {
+        out[n++] = a[i++];
+    }
+    while (j < countB) {
+        out[n++] = b[j++];
+    }
+    free(a);
+    free(b);
+    *merged = out;
+    return n;
+}
+
+/**
+ * @brief Appends the matching rows an index has not synchronized yet.
+ * @param set Car set to query.
+ * @param node Query the rows must match.
+ * @param first First row the index does not cover.
+ * @param rows Ascending matches below @p first, extended in place (may be NULL).
+ * @param count Number of matches in @p rows.
+ * @param examined Incremented by the number of rows examined.
+ * @return Number of matches after appending.
+ */
+static int addPendingRows(const struct Cars *set, const struct QueryNode *node, int first, int **rows, int count,
+                          long *examined) {
+    int allocated = count;
+    for (int row = first; row < set->rows; row++) {
+        if (isDeadRow(set, row) || !matchNode(set, node, row, -1)) {
+            continue;
+        }
+        if (count == allocated) {
+            allocated = allocated ? allocated * 2 : 16;
+            int *tmp = (int *)realloc(*rows, (size_t)allocated * sizeof *tmp);
+            if (!tmp) {
+                fprintf(stderr, "Memory allocation error.\n");
+                exit(EXIT_FAILURE);
+            }
+            *rows = tmp;
+        }
+        (*rows)[count++] = row;
+    }
+    *examined += set->rows - first;
+    return count;
+}
+
+/**
+ * @brief Answers an AND node from the word-wise intersection of its fuel and type bitmaps.
+ *
+ * The other children are then tested on the intersected rows only. A term whose value no
+ * indexed row holds makes the intersection empty, leaving just the pending rows to test.
+ *
+ * @param set Car set to query.
+ * @param node AND node planned with @c intersect set.
+ * @param rows Receives a malloc'd array of matching live rows in ascending order (NULL when empty).
+ * @param examined Incremented by the number of rows examined.
+ * @return Number of matching rows.
+ */
+static int intersectBitmapTerms(const struct Cars *set, const struct QueryNode *node, int **rows, long *examined) {
+    const struct RowBitmap *terms[2 * BITMAP_MAX_VALUES];
+    int count = 0, first = set->rows, missing = 0;
+    for (int i = 0; i < node->childCount; i++) {
+        const struct QueryNode *child = node->children[i];
+        if (isBitmapTerm(set, child) && count < (int)(sizeof terms / sizeof terms[0])) {
+            const struct BitmapIndex *index = bitmapIndex(set, child->field);
+            first = index->indexed < first ? index->indexed : first;
+            terms[count] = findBitmap(index, child->text, child->length);
+            missing |= terms[count++] == NULL;
+        }
+    }
+
+    int matches = missing ? 0 : combineBitmaps(terms, count, 1, rows);
+    *examined += matches;
+    int kept = 0;
+    for (int i = 0; i < matches && (*rows)[i] < first; i++) {
+        int row = (*rows)[i], keep = 1;
+        for (int c = 0; c < node->childCount && keep; c++) {
+            keep = isBitmapTerm(set, node->children[c]) || matchNode(set, node->children[c], row, -1);
+        }
+        if (keep) {
+            (*rows)[kept++] = row;
+        }
+    }
+    return addPendingRows(set, node, first, rows, kept, examined);
+}
+
+/**
+ * @brief Fetches the rows matching a planned query, through indexes or a scan.
+ * @param set Car set to query.
+ * @param node Planned query.
+ * @param rows Receives a malloc'd array of matching live rows in ascending order (NULL when empty).
+ * @param examined Incremented by the number of rows examined.
+ * @return Number of matching rows.
+ */
+static int collectNode(const struct Cars *set, const struct QueryNode *node, int **rows, long *examined) {
+    *rows = NULL;
+    if (!(node->indexCost < set->rows * node->rowCost)) {
+        *examined += liveCars(set);
+        return parallelScan(set, matchRow, node, rows);
+    }
+
+    switch (node->kind) {
+        case QUERY_EXACT:
+        case QUERY_CONTAINS: {
+            int count;
+            const struct BitmapIndex *bitmaps = bitmapIndex(set, node->field);
+            if (bitmaps) {
+                const struct RowBitmap *accepted[BITMAP_MAX_VALUES];
+                int accepting = predicateBitmaps(bitmaps, node, accepted, NULL);
+                count = accepting ? combineBitmaps(accepted, accepting, 0, rows) : 0;
+                *examined += count;
+                return addPendingRows(set, node, bitmaps->indexed, rows, count, examined);
+            }
+            if (node->field == FIELD_REGISTRATION) {
+                count = findRegistrations(set, node->text, NULL, 0);
+                if (count == 0) {
+                    return 0;
+                }
+                *rows = (int *)malloc((size_t)count * sizeof **rows);
+                if (!*rows) {
+                    fprintf(stderr, "Memory allocation error.\n");
+                    exit(EXIT_FAILURE);
+                }
+                findRegistrations(set, node->text, *rows, count);
+                *examined += count;
+                return count;
+            }
+
+            count = findSubstrings(set, trigramIndex(set, node->field), stringColumn(set, node->field), node->text,
+                                   rows);
+            *examined += count;
+            if (node->kind == QUERY_EXACT) {
+                int kept = 0;
+                for (int i = 0; i < count; i++) {
+                    if (matchNode(set, node, (*rows)[i], -1)) {
+                        (*rows)[kept++] = (*rows)[i];
+                    }
+                }
+                count = kept;
+            }
+            return count;
+        }
+
+        case QUERY_RANGE: {
+            const struct RangeIndex *index = node->field == FIELD_YEAR ? &set->years : &set->capacities;
+            int count = countRange(index, node->min, node->max);
+            if (count == 0) {
+                return 0;
+            }
+            *rows = (int *)malloc(((size_t)count + SCAN_PADDING) * sizeof **rows);
+            if (!*rows) {
+                fprintf(stderr, "Memory allocation error.\n");
+                exit(EXIT_FAILURE);
+            }
+            // A dense range is cheaper to scan with the vector kernel than to gather from the index.
+            if (count > set->rows / DENSE_RANGE_FRACTION) {
+                scanIntRange(node->field == FIELD_YEAR ? set->year : set->capacity, set->rows, node->min, node->max,
+                             *rows);
+                *examined += set->rows;
+            } else {
+                collectRange(index, node->min, node->max, *rows);
+                *examined += count;
+            }
+            return dropDeadRows(set, *rows, count);
+        }
+
+        case QUERY_AND: {
+            if (node->intersect) {
+                return intersectBitmapTerms(set, node, rows, examined);
+            }
+            int count = collectNode(set, node->children[node->driver], rows, examined);
+            int kept = 0;
+            for (int i = 0; i < count; i++) {
+                if (matchNode(set, node, (*rows)[i], node->driver)) {
+                    (*rows)[kept++] = (*rows)[i];
+                }
+            }
+            return kept;
+        }
+
+        default: {
+            int count = 0;
+            for (int i = 0; i < node->childCount; i++) {
+                int *childRows;
+                int childCount = collectNode(set, node->children[i], &childRows, examined);
+                count = mergeRows(*rows, count, childRows, childCount, rows);
+            }
+            return count;
+        }
+    }
+}
+
+/**
+ * @brief Plans and runs a query.
+ * @param set Car set to query.
+ * @param query Query to run; its children are reordered by the planner.
+ * @param rows Receives a malloc'd array of the matching live rows in ascending order (NULL when empty).
+ * @param examined Receives the number of rows the query examined (may be NULL).
+ * @return Number of matching rows.
+ */
+int runQuery(const struct Cars *set, struct QueryNode *query, int **rows, long *examined) {
+    long scanned = 0;
+    int count = 0;
+    *rows = NULL;
+    if (set && set->rows > 0) {
+        planNode(set, query);
+        count = collectNode(set, query, rows, &scanned);
+    }
+    if (count == 0) {
+        free(*rows);
+        *rows = NULL;
+    }
+    if (examined) {
+        *examined = scanned;
+    }
+    return count;
+}
+
+/**
+ * @brief Keeps the rows of a list that match a query.
+ * @param set Car set holding the rows.
+ * @param query Query to test; its children are reordered by the planner.
+ * @param rows Row list, filtered in place; the order of the kept rows is preserved.
+ * @param count Number of rows.
+ * @return Number of rows kept at the front of @p rows.
+ */
+int filterRows(const struct Cars *set, struct QueryNode *query, int *rows, int count) {
+    if (count == 0) {
+        return 0;
+    }
+    planNode(set, query);
+    int kept = 0;
+    for (int i = 0; i < count; i++) {
+        if (matchNode(set, query, rows[i], -1)) {
+            rows[kept++] = rows[i];
+        }
+    }
+    return kept;
+}
+
+/**
+ * @brief Tests one row against a query, without planning it or using any index.
+ *
+ * For car sets that hold only columns, such as the pages of a paged file (see car_paged.h).
+ *
+ * @param set Car set holding the row; only its columns are read.
+ * @param query Query to test.
+ * @param row Row to test.
+ * @return Non-zero if the row matches.
+ */
+int matchesQuery(const struct Cars *set, const struct QueryNode *query, int row) {
+    return matchNode(set, query, row, -1);
+}
+
+/**
+ * @brief Plans and runs a query, listing its first matches under an order.
+ *
+ * Walking the order's index visits about keep / selectivity entries, each fetched and
+ * tested; it is chosen when that costs less than collecting every match the planned way
+ * and pushing them through a heap of @p keep rows.
+ *
+ * @param set Car set to query.
+ * @param query Query to run, or NULL to list every live car; its children are reordered by the planner.
+ * @param order Order of the listing.
+ * @param keep Number of leading rows wanted, or 0 for all of them.
+ * @param rows Receives a malloc'd array of the rows in order (NULL when empty).
+ * @param examined Receives the number of rows the query examined (may be NULL).
+ * @return Number of rows listed.
+ */
+int runOrderedQuery(const struct Cars *set, struct QueryNode *query, const struct CarOrder *order, long keep,
+                    int **rows, long *examined) {
+    long scanned = 0;
+    int count = 0;
+    *rows = NULL;
+    if (set && set->rows > 0) {
+        double live = liveCars(set), estimate = live, rowCost = 0.0, collectCost = set->rows * VECTOR_ROW_COST;
+        if (query) {
+            planNode(set, query);
+            estimate = query->estimate;
+            rowCost = query->rowCost;
+            collectCost = query->indexCost < set->rows * rowCost ? query->indexCost : set->rows * rowCost;
+        }
+        // Each match is compared with about log2(selected) rows on its way through the heap.
+        double selected = keep > 0 && keep < estimate ? (double)keep : estimate, depth = 1.0;
+        for (double size = 2.0; size < selected; size *= 2.0) {
+            depth++;
+        }
+        double selectCost = estimate * NUMBER_TEST_COST * depth;
+
+        const struct RangeIndex *index = orderIndex(set, order);
+        double walkCost = INFINITY;
+        if (index) {
+            double walked = keep > 0 ? keep * live / (estimate > 1.0 ? estimate : 1.0) : index->count;
+            walked = walked < index->count ? walked : index->count;
+            walkCost = (walked + index->count - index->sorted) * (INDEX_ROW_COST + rowCost);
+        }
+
+        if (walkCost < collectCost + selectCost) {
+            count = walkOrderIndex(set, order, query ? matchRow : NULL, query, keep, rows, &scanned);
+        } else {
+            if (query) {
+                count = collectNode(set, query, rows, &scanned);
+            } else {
+                *rows = (int *)malloc((size_t)set->rows * sizeof **rows);
+                if (!*rows) {
+                    fprintf(stderr, "Memory allocation error.\n");
+                    exit(EXIT_FAILURE);
+                }
+                for (int row = nextLiveRow(set, 0); row < set->rows; row = nextLiveRow(set, row + 1)) {
+                    (*rows)[count++] = row;
+                }
+                scanned = set->rows;
+            }
+            count = selectOrderedRows(set, order, *rows, count, keep);
+        }
+    }
+    if (count == 0) {
+        free(*rows);
+        *rows = NULL;
+    }
+    if (examined) {
+        *examined = scanned;
+    }
+    return count;
+}
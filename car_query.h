@@ -0,0 +1,188 @@
+/**
+ * @file car_query.h
+ * @brief Multi-predicate queries over a car set, with a selectivity-based planner.
+ *
+ * A query is a tree whose leaves are predicates on one field (a whole value, a part of a
+ * string, or a numeric range) and whose inner nodes combine their children with AND or OR.
+ * Before running, the planner estimates how many rows each node matches, using the range,
+ * registration and trigram indexes where they apply and a small sample of the rows where
+ * they do not. It then orders the children of every node so the cheapest and most decisive
+ * test comes first, and evaluation stops at the first child that settles the row.
+ *
+ * A node is answered from the indexes when that is estimated to cost less than a scan: an
+ * AND node fetches the rows of its most selective indexed child, or intersects the bitmaps
+ * of its exact fuel and type matches word by word, and tests the others on those rows only;
+ * an OR node whose children all have index paths merges their rows.
+ * Everything else is a full scan on the worker pool.
+ *
+ * Queries can also be written as text:
+ *
+ *     fuel = Diesel and type = SUV and year = 2015..2020 and capacity > 2000
+ *     (brand = Skoda or brand = Volkswagen) and model ~ tav
+ *
+ * where `=` matches a whole value (or a range written `MIN..MAX`), `~` a part of a string,
+ * `<`, `<=`, `>` and `>=` compare numbers, AND binds tighter than OR, and parentheses group.
+ */
+
+#ifndef CAR_QUERY_H
+#define CAR_QUERY_H
+
+#include "car_store.h"
+
+struct CarOrder;
+
+/** Fields a predicate can test. */
+enum QueryField {
+    FIELD_BRAND,
+    FIELD_MODEL,
+    FIELD_YEAR,
+    FIELD_CAPACITY,
+    FIELD_FUEL,
+    FIELD_TYPE,
+    FIELD_REGISTRATION,
+};
+
+/** Kinds of query nodes. */
+enum QueryKind {
+    QUERY_EXACT,     ///< The string field equals a value.
+    QUERY_CONTAINS,  ///< The string field contains a value.
+    QUERY_RANGE,     ///< The numeric field lies in [min, max].
+    QUERY_AND,       ///< Every child matches.
+    QUERY_OR,        ///< At least one child matches.
+};
+
+/**
+ * @struct QueryNode
+ * @brief One predicate, or an AND/OR of child nodes.
+ */
+struct QueryNode {
+    enum QueryKind kind;          ///< What the node tests.
+    enum QueryField field;        ///< Field a predicate tests.
+    char *text;                   ///< Value of a string predicate (owned).
+    size_t length;                ///< Length of @c text.
+    int min;                      ///< Smallest value of a range predicate.
+    int max;                      ///< Largest value of a range predicate.
+    struct QueryNode **children;  ///< Children of an AND/OR node, in evaluation order once planned.
+    int childCount;               ///< Number of children.
+    double estimate;              ///< Planner: estimated number of matching rows.
+    double rowCost;               ///< Planner: estimated cost of testing one row.
+    double indexCost;             ///< Planner: estimated cost of fetching the matches from indexes.
+    int driver;                   ///< Planner: child of an AND node whose rows the others filter, or -1.
+    int intersect;                ///< Planner: non-zero if an AND node starts from its intersected bitmaps.
+};
+
+/**
+ * @brief Creates a string predicate.
+ * @param field String field to test.
+ * @param kind QUERY_EXACT or QUERY_CONTAINS.
+ * @param text Value to look for (copied).
+ * @return New node; free the tree with freeQuery().
+ */
+struct QueryNode *stringPredicate(enum QueryField field, enum QueryKind kind, const char *text);
+
+/**
+ * @brief Creates a numeric range predicate.
+ * @param field FIELD_YEAR or FIELD_CAPACITY.
+ * @param min Smallest matching value.
+ * @param max Largest matching value.
+ * @return New node; free the tree with freeQuery().
+ */
+struct QueryNode *rangePredicate(enum QueryField field, int min, int max);
+
+/**
+ * @brief Combines two queries with AND or OR.
+ *
+ * Children of the same kind are merged into one node, so a chain of ANDs stays flat.
+ *
+ * @param kind QUERY_AND or QUERY_OR.
+ * @param left First query (taken over).
+ * @param right Second query (taken over).
+ * @return Combined query.
+ */
+struct QueryNode *combineQueries(enum QueryKind kind, struct QueryNode *left, struct QueryNode *right);
+
+/**
+ * @brief Looks up a field by the name used in queries, in any case.
+ * @param name The name, e.g. "year".
+ * @param length Length of the name.
+ * @return The field, or -1 if no field has that name.
+ */
+int findQueryField(const char *name, size_t length);
+
+/**
+ * @brief Parses a query written as text.
+ * @param text The query.
+ * @param error Receives a description of the first problem if the query is invalid.
+ * @param errorSize Size of @p error.
+ * @return New query, or NULL if the text is not a valid query.
+ */
+struct QueryNode *parseQuery(const char *text, char *error, size_t errorSize);
+
+/**
+ * @brief Writes a query as text in a normalized form.
+ *
+ * The children of every AND/OR node are sorted, so queries that differ only in the order of
+ * their criteria get the same text; the text parses back into an equivalent query.
+ *
+ * @param query Query to write.
+ * @param text Receives the text.
+ * @param size Size of @p text.
+ * @return Length of the text, or -1 if it does not fit in @p size bytes.
+ */
+int formatQuery(const struct QueryNode *query, char *text, size_t size);
+
+/**
+ * @brief Plans and runs a query.
+ * @param set Car set to query.
+ * @param query Query to run; its children are reordered by the planner.
+ * @param rows Receives a malloc'd array of the matching live rows in ascending order (NULL when empty).
+ * @param examined Receives the number of rows the query examined (may be NULL).
+ * @return Number of matching rows.
+ */
+int runQuery(const struct Cars *set, struct QueryNode *query, int **rows, long *examined);
+
+/**
+ * @brief Keeps the rows of a list that match a query.
+ * @param set Car set holding the rows.
+ * @param query Query to test; its children are reordered by the planner.
+ * @param rows Row list, filtered in place; the order of the kept rows is preserved.
+ * @param count Number of rows.
+ * @return Number of rows kept at the front of @p rows.
+ */
+int filterRows(const struct Cars *set, struct QueryNode *query, int *rows, int count);
+
+/**
+ * @brief Tests one row against a query, without planning it or using any index.
+ * @param set Car set holding the row; only its columns are read.
+ * @param query Query to test.
+ * @param row Row to test.
+ * @return Non-zero if the row matches.
+ */
+int matchesQuery(const struct Cars *set, const struct QueryNode *query, int row);
+
+/**
+ * @brief Plans and runs a query, listing its first matches under an order.
+ *
+ * When the order's field has a sorted index, reading the index in order and testing each
+ * row against the query may reach @p keep matches long before a plain run of the query
+ * has finished; the planner's estimates decide which way is cheaper. Otherwise the
+ * matches are collected as by runQuery() and the first @p keep of them selected.
+ *
+ * @param set Car set to query.
+ * @param query Query to run, or NULL to list every live car; its children are reordered by the planner.
+ * @param order Order of the listing.
+ * @param keep Number of leading rows wanted, or 0 for all of them.
+ * @param rows Receives a malloc'd array of the rows in order (NULL when empty).
+ * @param examined Receives the number of rows the query examined (may be NULL).
+ * @return Number of rows listed.
+ */
+int runOrderedQuery(const struct Cars *set, struct QueryNode *query, const struct CarOrder *order, long keep,
+                    int **rows, long *examined);
+
+/**
+ * @brief Frees a query tree.
+ * @param query Query to free (may be NULL).
+ */
+void freeQuery(struct QueryNode *query);
+
+#endif // CAR_QUERY_H
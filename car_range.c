@@ -0,0 +1,298 @@
+/**
+ * @file car_range.c
+ * @brief Implementation of the sorted range indexes.
+ */
+
+#include "car_range.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Orders range entries by key, then by row.
+ * @param a First entry.
+ * @param b Second entry.
+ * @return Negative, zero or positive as for qsort().
+ */
+static int compareEntries(const void *a, const void *b) {
+    const struct RangeEntry *x = (const struct RangeEntry *)a;
+    const struct RangeEntry *y = (const struct RangeEntry *)b;
+    if (x->key != y->key) {
+        return (x->key > y->key) - (x->key < y->key);
+    }
+    return (x->row > y->row) - (x->row < y->row);
+}
+
+/**
+ * @brief Orders row numbers ascending.
+ * @param a First row.
+ * @param b Second row.
+ * @return Negative, zero or positive as for qsort().
+ */
+static int compareRows(const void *a, const void *b) {
+    int x = *(const int *)a;
+    int y = *(const int *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief Sorts entries by key with a stable LSD radix sort.
+ *
+ * Pending entries are always in ascending row order (rows are appended in order and
+ * renumbering keeps their order), so a stable sort by key yields (key, row) order.
+ * Byte positions on which all keys agree, such as the high bytes of years, are skipped.
+ *
+ * @param entries Entries to sort.
+ * @param count Number of entries.
+ */
+static void radixSortByKey(struct RangeEntry *entries, int count) {
+    struct RangeEntry *buffer = (struct RangeEntry *)malloc((size_t)count * sizeof *buffer);
+    if (!buffer) {
+        fprintf(stderr, "Memory allocation error.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    struct RangeEntry *from = entries, *to = buffer;
+    for (int shift = 0; shift < 32; shift += 8) {
+        int histogram[256] = {0};
+        for (int i = 0; i < count; i++) {
+            // Flipping the sign bit makes unsigned byte order match signed key order.
+            histogram[(((unsigned int)from[i].key ^ 0x80000000u) >> shift) & 0xFF]++;
+        }
+
+        int skip = 0;
+        for (int b = 0; b < 256; b++) {
+            if (histogram[b] == count) {
+                skip = 1;
+            }
+        }
+        if (skip) {
+            continue;
+        }
+
+        int offset = 0;
+        for (int b = 0; b < 256; b++) {
+            int n = histogram[b];
+            histogram[b] = offset;
+            offset += n;
+        }
+        for (int i = 0; i < count; i++) {
+            to[histogram[(((unsigned int)from[i].key ^ 0x80000000u) >> shift) & 0xFF]++] = from[i];
+        }
+
+        struct RangeEntry *swap = from;
+        from = to;
+        to = swap;
+    }
+
+    if (from != entries) {
+        memcpy(entries, from, (size_t)count * sizeof *entries);
+    }
+    free(buffer);
+}
+
+/**
+ * @brief Finds the first sorted entry whose key is not less than @p key.
+ * @param index Index to search.
+ * @param key Key to look for.
+ * @return Position in [0, sorted].
+ */
+static int lowerBound(const struct RangeIndex *index, int key) {
+    int low = 0, high = index->sorted;
+    while (low < high) {
+        int mid = low + (high - low) / 2;
+        if (index->entries[mid].key < key) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+/**
+ * @brief Finds the first sorted entry whose key is greater than @p key.
+ * @param index Index to search.
+ * @param key Key to look for.
+ * @return Position in [0, sorted].
+ */
+static int upperBound(const struct RangeIndex *index, int key) {
+    int low = 0, high = index->sorted;
+    while (low < high) {
+        int mid = low + (high - low) / 2;
+        if (index->entries[mid].key <= key) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+/**
+ * @brief Appends an entry without sorting it in yet.
+ * @param index Index to append to.
+ * @param key Column value of the row.
+ * @param row Row of the car.
+ */
+void appendRangeEntry(struct RangeIndex *index, int key, int row) {
+    if (index->count == index->allocated) {
+        int allocated = index->allocated ? index->allocated * 2 : 16;
+        struct RangeEntry *tmp = (struct RangeEntry *)realloc(index->mapped ? NULL : index->entries,
+                                                              (size_t)allocated * sizeof *tmp);
+        if (!tmp) {
+            fprintf(stderr, "Memory allocation error.\n");
+            exit(EXIT_FAILURE);
+        }
+        if (index->mapped) {
+            // Entries loaded from a snapshot are copied out on the first append.
+            memcpy(tmp, index->entries, (size_t)index->count * sizeof *tmp);
+            index->mapped = 0;
+        }
+        index->entries = tmp;
+        index->allocated = allocated;
+    }
+
+    index->entries[index->count].key = key;
+    index->entries[index->count].row = row;
+    index->count++;
+}
+
+/**
+ * @brief Merges all pending entries into the sorted part.
+ *
+ * The pending entries are radix sorted on their own and merged backwards into place, so only
+ * the sorted entries greater than the smallest pending entry are moved. A single pending
+ * entry therefore costs one binary-search-sized merge plus the shift, not a re-sort.
+ *
+ * @param index Index to synchronize.
+ */
+void syncRangeIndex(struct RangeIndex *index) {
+    int pending = index->count - index->sorted;
+    if (pending == 0) {
+        return;
+    }
+
+    struct RangeEntry *tail = index->entries + index->sorted;
+    radixSortByKey(tail, pending);
+
+    if (index->sorted == 0 || compareEntries(&index->entries[index->sorted - 1], tail) <= 0) {
+        index->sorted = index->count;
+        return;
+    }
+
+    struct RangeEntry *incoming = (struct RangeEntry *)malloc((size_t)pending * sizeof *incoming);
+    if (!incoming) {
+        fprintf(stderr, "Memory allocation error.\n");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(incoming, tail, (size_t)pending * sizeof *incoming);
+
+    int i = index->sorted - 1;
+    int j = pending - 1;
+    int k = index->count - 1;
+    while (j >= 0) {
+        if (i >= 0 && compareEntries(&index->entries[i], &incoming[j]) > 0) {
+            index->entries[k--] = index->entries[i--];
+        } else {
+            index->entries[k--] = incoming[j--];
+        }
+    }
+
+    free(incoming);
+    index->sorted = index->count;
+}
+
+/**
+ * @brief Drops the entries of dead rows and renumbers the others after a purge.
+ *
+ * The purge keeps the live rows in order, so the (key, row) order of the sorted part is
+ * preserved and nothing has to be re-sorted.
+ *
+ * @param index Index to modify.
+ * @param map New row of every old row, or -1 for dead rows.
+ */
+void remapRangeIndex(struct RangeIndex *index, const int *map) {
+    int kept = 0, sorted = 0;
+    for (int i = 0; i < index->count; i++) {
+        int row = map[index->entries[i].row];
+        if (row < 0) {
+            continue;
+        }
+        if (i < index->sorted) {
+            sorted++;
+        }
+        index->entries[kept].key = index->entries[i].key;
+        index->entries[kept].row = row;
+        kept++;
+    }
+    index->count = kept;
+    index->sorted = sorted;
+}
+
+/**
+ * @brief Counts the rows whose value lies in [min, max].
+ * @param index Index to query.
+ * @param min Smallest matching value.
+ * @param max Largest matching value.
+ * @return Number of matching rows.
+ */
+int countRange(const struct RangeIndex *index, int min, int max) {
+    if (min > max) {
+        return 0;
+    }
+
+    int found = upperBound(index, max) - lowerBound(index, min);
+    for (int i = index->sorted; i < index->count; i++) {
+        if (index->entries[i].key >= min && index->entries[i].key <= max) {
+            found++;
+        }
+    }
+    return found;
+}
+
+/**
+ * @brief Collects the rows whose value lies in [min, max], in ascending row order.
+ *
+ * Costs two binary searches plus O(k log k) for the k matches, independent of the
+ * number of cars outside the range.
+ *
+ * @param index Index to query.
+ * @param min Smallest matching value.
+ * @param max Largest matching value.
+ * @param rows Receives the rows; must have room for countRange() entries.
+ * @return Number of rows written.
+ */
+int collectRange(const struct RangeIndex *index, int min, int max, int *rows) {
+    if (min > max) {
+        return 0;
+    }
+
+    int found = 0;
+    for (int i = lowerBound(index, min), end = upperBound(index, max); i < end; i++) {
+        rows[found++] = index->entries[i].row;
+    }
+    for (int i = index->sorted; i < index->count; i++) {
+        if (index->entries[i].key >= min && index->entries[i].key <= max) {
+            rows[found++] = index->entries[i].row;
+        }
+    }
+
+    qsort(rows, (size_t)found, sizeof *rows, compareRows);
+    return found;
+}
+
+/**
+ * @brief Releases the memory of a range index.
+ * @param index Index to release.
+ */
+void freeRangeIndex(struct RangeIndex *index) {
+    if (!index->mapped) {
+        free(index->entries);
+    }
+    index->entries = NULL;
+    index->count = 0;
+    index->sorted = 0;
+    index->allocated = 0;
+    index->mapped = 0;
+}
@@ -0,0 +1,81 @@
+/**
+ * @file car_range.h
+ * @brief Sorted secondary indexes for range queries on numeric columns.
+ */
+
+#ifndef CAR_RANGE_H
+#define CAR_RANGE_H
+
+/**
+ * @struct RangeEntry
+ * @brief One entry of a range index: a column value and the row holding it.
+ */
+struct RangeEntry {
+    int key;  ///< Column value.
+    int row;  ///< Row of the car.
+};
+
+/**
+ * @struct RangeIndex
+ * @brief Permutation of the rows sorted by (key, row).
+ *
+ * New entries are appended unsorted after the first @c sorted entries and merged in by
+ * syncRangeIndex(), so a bulk load sorts once instead of inserting one entry at a time.
+ * Queries also see entries that are still pending. Entries of removed cars stay until
+ * the rows are purged, so callers skip dead rows in the results.
+ */
+struct RangeIndex {
+    struct RangeEntry *entries;  ///< Sorted entries followed by pending ones.
+    int count;                   ///< Total number of entries.
+    int sorted;                  ///< Number of leading entries in sorted order.
+    int allocated;               ///< Number of entries the array has room for.
+    int mapped;                  ///< Non-zero while @c entries points into a snapshot mapping.
+};
+
+/**
+ * @brief Appends an entry without sorting it in yet.
+ * @param index Index to append to.
+ * @param key Column value of the row.
+ * @param row Row of the car.
+ */
+void appendRangeEntry(struct RangeIndex *index, int key, int row);
+
+/**
+ * @brief Merges all pending entries into the sorted part.
+ * @param index Index to synchronize.
+ */
+void syncRangeIndex(struct RangeIndex *index);
+
+/**
+ * @brief Drops the entries of dead rows and renumbers the others after a purge.
+ * @param index Index to modify.
+ * @param map New row of every old row, or -1 for dead rows.
+ */
+void remapRangeIndex(struct RangeIndex *index, const int *map);
+
+/**
+ * @brief Counts the rows whose value lies in [min, max].
+ * @param index Index to query.
+ * @param min Smallest matching value.
+ * @param max Largest matching value.
+ * @return Number of matching rows.
+ */
+int countRange(const struct RangeIndex *index, int min, int max);
+
+/**
+ * @brief Collects the rows whose value lies in [min, max], in ascending row order.
+ * @param index Index to query.
+ * @param min Smallest matching value.
+ * @param max Largest matching value.
+ * @param rows Receives the rows; must have room for countRange() entries.
+ * @return Number of rows written.
+ */
+int collectRange(const struct RangeIndex *index, int min, int max, int *rows);
+
+/**
+ * @brief Releases the memory of a range index.
+ * @param index Index to release.
+ */
+void freeRangeIndex(struct RangeIndex *index);
+
+#endif // CAR_RANGE_H
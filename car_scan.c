@@ -0,0 +1,242 @@
+/**
+ * @file car_scan.c
+ * @brief Implementation of the vectorized scan kernels.
+ */
+
+#include "car_scan.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+/** Kernel forced by setScanKernel(), or -1 to use the detected one. */
+static int forcedKernel = -1;
+
+/** Fastest kernel the CPU supports; SCAN_SCALAR until initScanKernel() has run. */
+static enum ScanKernel detectedKernel = SCAN_SCALAR;
+
+/**
+ * @brief Scalar kernel over rows [first, count): one row per step, without branches.
+ *
+ * The range test is a single unsigned comparison, and the row is always written and only
+ * kept when it matches, so the loop has no data-dependent branches. The vector kernels use
+ * it for the rows left over after their last full vector.
+ *
+ * @param column Packed int column.
+ * @param first First row to test.
+ * @param count Number of rows in the column.
+ * @param min Smallest matching value.
+ * @param max Largest matching value.
+ * @param rows Receives matching rows.
+ * @param found Number of rows already written to @p rows.
+ * @return Total number of matching rows written.
+ */
+static int scanScalar(const int *column, int first, int count, int min, int max, int *rows, int found) {
+    unsigned int width = (unsigned int)max - (unsigned int)min;
+    for (int i = first; i < count; i++) {
+        rows[found] = i;
+        found += ((unsigned int)column[i] - (unsigned int)min) <= width;
+    }
+    return found;
+}
+
+#ifdef SCAN_X86
+/**
+ * @brief Byte shuffles that move the selected 32-bit lanes of a 4-lane vector to the front,
+ *        indexed by the 4-bit match mask.
+ */
+static const unsigned char packShuffle[16][16] = {
+    {0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x02, 0x03, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x04, 0x05, 0x06, 0x07, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x08, 0x09, 0x0a, 0x0b, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x02, 0x03, 0x08, 0x09, 0x0a, 0x0b, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x80, 0x80, 0x80, 0x80},
+    {0x0c, 0x0d, 0x0e, 0x0f, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x02, 0x03, 0x0c, 0x0d, 0x0e, 0x0f, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x04, 0x05, 0x06, 0x07, 0x0c, 0x0d, 0x0e, 0x0f, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x0c, 0x0d, 0x0e, 0x0f, 0x80, 0x80, 0x80, 0x80},
+    {0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x02, 0x03, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0x80, 0x80, 0x80, 0x80},
+    {0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f},
+};
+
+/** Number of set bits in each 4-bit match mask. */
+static const unsigned char maskBits[16] = {0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4};
+
+/**
+ * @brief Appends the row numbers selected by a 4-bit mask without branching.
+ *
+ * All four lanes are stored, but the output position only advances past the matches,
+ * so the next store overwrites the unused lanes.
+ *
+ * @param indexes Row numbers of the four lanes.
+ * @param mask Match mask of the four lanes.
+ * @param rows Output array.
+ * @param found Number of rows already written, advanced past the new matches.
+ */
+__attribute__((target("sse4.2")))
+static inline void packRows(__m128i indexes, unsigned int mask, int *rows, int *found) {
+    __m128i shuffle = _mm_loadu_si128((const __m128i *)packShuffle[mask]);
+    _mm_storeu_si128((__m128i *)(rows + *found), _mm_shuffle_epi8(indexes, shuffle));
+    *found += maskBits[mask];
+}
+
+/**
+ * @brief SSE4.2 kernel: four rows per step.
+ * @param column Packed int column.
+ * @param count Number of rows.
+ * @param min Smallest matching value.
+ * @param max Largest matching value.
+ * @param rows Receives matching rows.
+ * @return Number of matching rows.
+ */
+__attribute__((target("sse4.2")))
+static int scanSse42(const int *column, int count, int min, int max, int *rows) {
+    __m128i low = _mm_set1_epi32(min);
+    __m128i high = _mm_set1_epi32(max);
+    __m128i indexes = _mm_setr_epi32(0, 1, 2, 3);
+    __m128i step = _mm_set1_epi32(4);
+    int found = 0;
+    int i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(column + i));
+        __m128i outside = _mm_or_si128(_mm_cmpgt_epi32(low, x), _mm_cmpgt_epi32(x, high));
+        unsigned int mask = ~(unsigned int)_mm_movemask_ps(_mm_castsi128_ps(outside)) & 0xFu;
+        packRows(indexes, mask, rows, &found);
+        indexes = _mm_add_epi32(indexes, step);
+    }
+
+    return scanScalar(column, i, count, min, max, rows, found);
+}
+
+/**
+ * @brief AVX2 kernel: eight rows per step.
+ *
+ * The comparison covers eight lanes at once; the matches of each half are then packed
+ * with the same branch-free shuffle as the SSE4.2 kernel.
+ *
+ * @param column Packed int column.
+ * @param count Number of rows.
+ * @param min Smallest matching value.
+ * @param max Largest matching value.
+ * @param rows Receives matching rows.
+ * @return Number of matching rows.
+ */
+__attribute__((target("avx2")))
+static int scanAvx2(const int *column, int count, int min, int max, int *rows) {
+    __m256i low = _mm256_set1_epi32(min);
+    __m256i high = _mm256_set1_epi32(max);
+    __m256i indexes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    __m256i step = _mm256_set1_epi32(8);
+    int found = 0;
+    int i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+        __m256i x = _mm256_loadu_si256((const __m256i *)(column + i));
+        __m256i outside = _mm256_or_si256(_mm256_cmpgt_epi32(low, x), _mm256_cmpgt_epi32(x, high));
+        unsigned int mask = ~(unsigned int)_mm256_movemask_ps(_mm256_castsi256_ps(outside)) & 0xFFu;
+        packRows(_mm256_castsi256_si128(indexes), mask & 0xFu, rows, &found);
+        packRows(_mm256_extracti128_si256(indexes, 1), mask >> 4, rows, &found);
+        indexes = _mm256_add_epi32(indexes, step);
+    }
+
+    return scanScalar(column, i, count, min, max, rows, found);
+}
+#endif
+
+#ifdef SCAN_X86
+/**
+ * @brief Detects the fastest kernel the CPU supports, once, before main() starts any thread.
+ */
+__attribute__((constructor)) static void initScanKernel(void) {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        detectedKernel = SCAN_AVX2;
+    } else if (__builtin_cpu_supports("sse4.2")) {
+        detectedKernel = SCAN_SSE42;
+    }
+}
+#endif
+
+/**
+ * @brief Returns the fastest kernel the CPU supports.
+ *
+ * The CPU features are read once at startup, so scanIntRange() only loads the result.
+ *
+ * @return Detected kernel.
+ */
+enum ScanKernel detectScanKernel(void) {
+    return detectedKernel;
+}
+
+/**
+ * @brief Forces the kernel used by scanIntRange(), e.g. to compare against the scalar path.
+ * @param kernel Kernel to use.
+ * @return 0 on success, -1 if the CPU does not support the kernel.
+ */
+int setScanKernel(enum ScanKernel kernel) {
+    if (kernel > detectScanKernel()) {
+        return -1;
+    }
+    forcedKernel = (int)kernel;
+    return 0;
+}
+
+/**
+ * @brief Returns the kernel scanIntRange() currently uses.
+ * @return Active kernel.
+ */
+enum ScanKernel activeScanKernel(void) {
+    return forcedKernel >= 0 ? (enum ScanKernel)forcedKernel : detectScanKernel();
+}
+
+/**
+ * @brief Returns a printable name for a kernel.
+ * @param kernel Kernel to name.
+ * @return Static string such as "avx2".
+ */
+const char *scanKernelName(enum ScanKernel kernel) {
+    switch (kernel) {
+        case SCAN_AVX2:
+            return "avx2";
+        case SCAN_SSE42:
+            return "sse4.2";
+        case SCAN_SCALAR:
+        default:
+            return "scalar";
+    }
+}
+
+/**
+ * @brief Collects the rows whose value lies in [min, max].
+ * @param column Packed int column.
+ * @param count Number of rows in the column.
+ * @param min Smallest matching value.
+ * @param max Largest matching value.
+ * @param rows Receives matching rows in ascending order; needs room for the number of
+ *             matches plus SCAN_PADDING entries.
+ * @return Number of matching rows.
+ */
+int scanIntRange(const int *column, int count, int min, int max, int *rows) {
+    if (min > max || count <= 0) {
+        return 0;
+    }
+
+    switch (activeScanKernel()) {
+#ifdef SCAN_X86
+        case SCAN_AVX2:
+            return scanAvx2(column, count, min, max, rows);
+        case SCAN_SSE42:
+            return scanSse42(column, count, min, max, rows);
+#endif
+        case SCAN_SCALAR:
+        default:
+            return scanScalar(column, 0, count, min, max, rows, 0);
+    }
+}
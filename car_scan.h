@@ -0,0 +1,64 @@
+/**
+ * @file car_scan.h
+ * @brief Vectorized scan kernels for predicates on packed int columns.
+ *
+ * Each kernel evaluates min <= x <= max (equality when min == max) over a whole column and
+ * writes the matching row numbers in ascending order. AVX2 and SSE4.2 variants are picked at
+ * runtime from the CPU features; every other target uses the scalar kernel.
+ */
+
+#ifndef CAR_SCAN_H
+#define CAR_SCAN_H
+
+/** Extra entries the output of scanIntRange() must have room for beyond the matches. */
+#define SCAN_PADDING 8
+
+/**
+ * @enum ScanKernel
+ * @brief Implementations of the scan kernels.
+ */
+enum ScanKernel {
+    SCAN_SCALAR,  ///< Portable branch-free C loop.
+    SCAN_SSE42,   ///< Four lanes per step with SSE4.2.
+    SCAN_AVX2     ///< Eight lanes per step with AVX2.
+};
+
+/**
+ * @brief Returns the fastest kernel the CPU supports.
+ * @return Detected kernel.
+ */
+enum ScanKernel detectScanKernel(void);
+
+/**
+ * @brief Forces the kernel used by scanIntRange(), e.g. to compare against the scalar path.
+ * @param kernel Kernel to use.
+ * @return 0 on success, -1 if the CPU does not support the kernel.
+ */
+int setScanKernel(enum ScanKernel kernel);
+
+/**
+ * @brief Returns the kernel scanIntRange() currently uses.
+ * @return Active kernel.
+ */
+enum ScanKernel activeScanKernel(void);
+
+/**
+ * @brief Returns a printable name for a kernel.
+ * @param kernel Kernel to name.
+ * @return Static string such as "avx2".
+ */
+const char *scanKernelName(enum ScanKernel kernel);
+
+/**
+ * @brief Collects the rows whose value lies in [min, max].
+ * @param column Packed int column.
+ * @param count Number of rows in the column.
+ * @param min Smallest matching value.
+ * @param max Largest matching value.
+ * @param rows Receives matching rows in ascending order; needs room for the number of
+ *             matches plus SCAN_PADDING entries.
+ * @return Number of matching rows.
+ */
+int scanIntRange(const int *column, int count, int min, int max, int *rows);
+
+#endif // CAR_SCAN_H
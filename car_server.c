@@ -0,0 +1,974 @@
+/**
+ * @file car_server.c
+ * @brief Implementation of the daemon mode: versioned car sets, epoch-based reclamation and the socket protocol.
+ */
+
+#include "car_server.h"
+#include "car_hash.h"
+#include "car_journal.h"
+#include "car_query.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/** Clients served at once; each holds one reader slot. */
+#define MAX_CLIENTS 64
+
+/** Bytes of reply buffered before they are sent. */
+#define REPLY_BYTES 65536
+
+/** Changes folded into a new base at the latest, however small the base. */
+#define MIN_MERGE_CHANGES 1024
+
+/** A base of n rows is rebuilt after n / MERGE_RATIO changes, if that is more than MIN_MERGE_CHANGES. */
+#define MERGE_RATIO 1024
+
+/** Milliseconds the accept loop waits before checking whether the server is stopping. */
+#define ACCEPT_POLL_MS 250
+
+/**
+ * @struct SharedSet
+ * @brief Car set shared by several versions and freed with the last of them.
+ */
+struct SharedSet {
+    struct Cars *set;  ///< The set; never modified once a version uses it.
+    int versions;      ///< Versions using the set (changed by writers only).
+};
+
+/**
+ * @struct CarVersion
+ * @brief One immutable state of the served car set.
+ *
+ * The cars of a version are the live rows of @c view followed by the rows of @c added.
+ * Car numbers only grow, so listing them in this order lists them in car-number order.
+ */
+struct CarVersion {
+    struct Cars view;                ///< Copy of the base's header, with this version's bitmap of removed rows.
+    struct SharedSet *base;          ///< Base set whose columns and indexes @c view uses.
+    struct SharedSet *added;         ///< Cars added since the base was built.
+    unsigned long number;            ///< Version number, starting from 1.
+    int changes;                     ///< Cars added and removed since the base was built.
+    unsigned long retired;           ///< Epoch in which the version was replaced.
+    struct CarVersion *nextRetired;  ///< Next replaced version waiting to be freed.
+};
+
+/**
+ * @struct ReaderSlot
+ * @brief Epoch announced by one client, alone on its cache line.
+ */
+struct ReaderSlot {
+    unsigned long epoch;                          ///< Epoch the client is reading in, or 0 when idle.
+    char padding[64 - sizeof(unsigned long)];     ///< Keeps other slots off the cache line.
+};
+
+/**
+ * @struct Client
+ * @brief One connected client and its buffered reply.
+ */
+struct Client {
+    struct ServerConnection connection;  ///< Socket and received bytes.
+    int slot;                            ///< Reader slot and index in the client table.
+    char reply[REPLY_BYTES];             ///< Reply bytes not sent yet.
+    size_t replyUsed;                    ///< Bytes used in @c reply.
+    int failed;                          ///< Non-zero once sending failed.
+};
+
+/**
+ * @brief State of the running server.
+ *
+ * @c current and the reader slots are shared without locks; everything a writer changes
+ * other than @c current is protected by @c writeLock.
+ */
+static struct {
+    struct CarVersion *current;          ///< Published version, read and written atomically.
+    unsigned long epoch;                 ///< Global epoch, starting from 1 and advanced atomically.
+    struct ReaderSlot readers[MAX_CLIENTS];  ///< Epoch announced by each client.
+    pthread_mutex_t writeLock;           ///< Held by the writer building the next version.
+    struct CarVersion *retired;          ///< Replaced versions not freed yet.
+    int retiredCount;                    ///< Number of versions in @c retired.
+    int nextId;                          ///< Car number of the next added car.
+    struct Journal *journal;             ///< Journal the changes are recorded in, or NULL.
+    pthread_mutex_t clientLock;          ///< Protects @c fds and @c clients.
+    pthread_cond_t clientsGone;          ///< Signalled when the last client disconnects.
+    int fds[MAX_CLIENTS];                ///< Socket of each client, or -1 for a free slot.
+    int clients;                         ///< Clients connected.
+    volatile sig_atomic_t stopping;      ///< Set by SHUTDOWN, SIGINT or SIGTERM.
+} server = {.writeLock = PTHREAD_MUTEX_INITIALIZER,
+            .clientLock = PTHREAD_MUTEX_INITIALIZER,
+            .clientsGone = PTHREAD_COND_INITIALIZER};
+
+/**
+ * @brief Wraps a car set for sharing between versions.
+ * @param set The set.
+ * @return Newly allocated shared set used by no version yet.
+ */
+static struct SharedSet *shareSet(struct Cars *set) {
+    struct SharedSet *shared = (struct SharedSet *)malloc(sizeof *shared);
+    if (!shared) {
+        fprintf(stderr, "Memory allocation error.\n");
+        exit(EXIT_FAILURE);
+    }
+    shared->set = set;
+    shared->versions = 0;
+    return shared;
+}
+
+/**
+ * @brief Drops one version's use of a shared set, freeing it after the last one.
+ * @param shared The shared set.
+ */
+static void releaseSet(struct SharedSet *shared) {
+    if (--shared->versions == 0) {
+        // The set is NULL if serveCars() handed it back to its caller.
+        destroyCarSet(shared->set);
+        free(shared);
+    }
+}
+
+/**
+ * @brief Creates a version from a base set, a bitmap of removed base rows and a set of added cars.
+ * @param base Base set.
+ * @param dead Bitmap of removed base rows, copied (NULL when none).
+ * @param deadRows Number of bits set in @p dead.
+ * @param added Cars added since the base was built.
+ * @param changes Cars added and removed since the base was built.
+ * @return Newly allocated version, not published yet.
+ */
+static struct CarVersion *createVersion(struct SharedSet *base, const uint64_t *dead, int deadRows,
+                                        struct SharedSet *added, int changes) {
+    struct CarVersion *version = (struct CarVersion *)calloc(1, sizeof *version);
+    if (!version) {
+        fprintf(stderr, "Memory allocation error.\n");
+        exit(EXIT_FAILURE);
+    }
+    version->view = *base->set;
+    version->view.dead = NULL;
+    version->view.deadRows = deadRows;
+    if (dead) {
+        size_t bytes = (size_t)(base->set->rows + 63) / 64 * sizeof *dead;
+        version->view.dead = (uint64_t *)malloc(bytes > 0 ? bytes : sizeof *dead);
+        if (!version->view.dead) {
+            fprintf(stderr, "Memory allocation error.\n");
+            exit(EXIT_FAILURE);
+        }
+        memcpy(version->view.dead, dead, bytes);
+    }
+    version->base = base;
+    version->added = added;
+    version->changes = changes;
+    base->versions++;
+    added->versions++;
+    return version;
+}
+
+/**
+ * @brief Frees a version and whatever sets no other version uses.
+ * @param version Version no reader can still be using.
+ */
+static void destroyVersion(struct CarVersion *version) {
+    free(version->view.dead);
+    releaseSet(version->base);
+    releaseSet(version->added);
+    free(version);
+}
+
+/**
+ * @brief Copies cars into a set, keeping their car numbers.
+ * @param target Set to append to; it must use explicit car numbers (see useCarIds()).
+ * @param source Set to copy from.
+ * @param skip Row of @p source not to copy, or -1.
+ */
+static void copyCars(struct Cars *target, const struct Cars *source, int skip) {
+    struct CarRecord car;
+    for (int row = nextLiveRow(source, 0); row < source->rows; row = nextLiveRow(source, row + 1)) {
+        if (row != skip) {
+            target->nextId = carId(source, row);
+            getCar(source, row, &car);
+            appendCar(target, &car);
+        }
+    }
+}
+
+/**
+ * @brief Builds a set of added cars: a copy of another one, less one row.
+ * @param source Added cars of the current version.
+ * @param skip Row of @p source to leave out, or -1.
+ * @return Newly allocated set with explicit car numbers and pending index entries.
+ */
+static struct Cars *copyAdded(const struct Cars *source, int skip) {
+    struct Cars *set = createCarSet();
+    reserveCars(set, source->rows + 1, source->heapUsed + SERVER_LINE_BYTES);
+    useCarIds(set);
+    copyCars(set, source, skip);
+    return set;
+}
+
+/**
+ * @brief Builds the base of the next version from the live cars of a version.
+ * @param version Version to fold.
+ * @return Newly allocated set holding every live car with its car number, indexes synchronized.
+ */
+static struct Cars *foldVersion(const struct CarVersion *version) {
+    const struct Cars *added = version->added->set;
+    struct Cars *set = createCarSet();
+    reserveCars(set, liveCars(&version->view) + added->rows, version->view.heapUsed + added->heapUsed);
+    useCarIds(set);
+    copyCars(set, &version->view, -1);
+    copyCars(set, added, -1);
+    set->nextId = server.nextId;
+    syncIndexes(set);
+    return set;
+}
+
+/**
+ * @brief Frees the replaced versions no reader can still be using.
+ *
+ * A version replaced in epoch e may still be read by a client that announced e or an
+ * earlier epoch; clients that announce a later epoch picked up a newer version.
+ * Called with the write lock held.
+ */
+static void reclaimVersions(void) {
+    unsigned long oldest = ULONG_MAX;
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        unsigned long epoch = __atomic_load_n(&server.readers[i].epoch, __ATOMIC_SEQ_CST);
+        if (epoch != 0 && epoch < oldest) {
+            oldest = epoch;
+        }
+    }
+
+    struct CarVersion **link = &server.retired;
+    while (*link) {
+        struct CarVersion *version = *link;
+        if (version->retired < oldest) {
+            *link = version->nextRetired;
+            destroyVersion(version);
+            __atomic_fetch_sub(&server.retiredCount, 1, __ATOMIC_RELAXED);
+        } else {
+            link = &version->nextRetired;
+        }
+    }
+}
+
+/**
+ * @brief Makes a version the current one and retires the one it replaces.
+ *
+ * Once enough changes have piled up on top of the base, the version is first folded into
+ * a new base, so the added cars stay few and the removed rows do not slow scans down.
+ * Called with the write lock held.
+ *
+ * @param next Version to publish.
+ */
+static void publishVersion(struct CarVersion *next) {
+    struct CarVersion *previous = server.current;
+    int rows = next->base->set->rows;
+    if (next->changes >= MIN_MERGE_CHANGES && next->changes >= rows / MERGE_RATIO) {
+        struct CarVersion *folded = createVersion(shareSet(foldVersion(next)), NULL, 0, shareSet(createCarSet()), 0);
+        useCarIds(folded->added->set);
+        destroyVersion(next);
+        next = folded;
+    }
+    next->number = previous->number + 1;
+
+    __atomic_store_n(&server.current, next, __ATOMIC_SEQ_CST);
+    previous->retired = __atomic_fetch_add(&server.epoch, 1, __ATOMIC_SEQ_CST);
+    previous->nextRetired = server.retired;
+    server.retired = previous;
+    __atomic_fetch_add(&server.retiredCount, 1, __ATOMIC_RELAXED);
+    reclaimVersions();
+}
+
+/**
+ * @brief Picks up the current version for reading.
+ *
+ * The epoch is announced before the version is loaded, so a writer that retires this
+ * version afterwards sees the announcement before it frees anything.
+ *
+ * @param slot Reader slot of the client.
+ * @return The current version, valid until leaveVersion().
+ */
+static const struct CarVersion *enterVersion(int slot) {
+    __atomic_store_n(&server.readers[slot].epoch, __atomic_load_n(&server.epoch, __ATOMIC_SEQ_CST), __ATOMIC_SEQ_CST);
+    return __atomic_load_n(&server.current, __ATOMIC_SEQ_CST);
+}
+
+/**
+ * @brief Ends a read started with enterVersion().
+ * @param slot Reader slot of the client.
+ */
+static void leaveVersion(int slot) {
+    __atomic_store_n(&server.readers[slot].epoch, 0, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Sends a whole buffer.
+ * @param fd Socket to send on.
+ * @param data Bytes to send.
+ * @param length Number of bytes.
+ * @return 0 on success, -1 if the connection failed.
+ */
+static int sendAll(int fd, const char *data, size_t length) {
+    while (length > 0) {
+        ssize_t sent = send(fd, data, length, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        data += sent;
+        length -= (size_t)sent;
+    }
+    return 0;
+}
+
+/**
+ * @brief Sends the buffered reply of a client.
+ * @param client The client.
+ */
+static void flushReply(struct Client *client) {
+    if (!client->failed && client->replyUsed > 0 &&
+        sendAll(client->connection.fd, client->reply, client->replyUsed) != 0) {
+        client->failed = 1;
+    }
+    client->replyUsed = 0;
+}
+
+/**
+ * @brief Appends a formatted line to the reply of a client, sending the buffer when it is full.
+ * @param client The client.
+ * @param format printf-style format of the line, including its newline.
+ */
+static void reply(struct Client *client, const char *format, ...) {
+    for (int attempt = 0; attempt < 2; attempt++) {
+        size_t room = REPLY_BYTES - client->replyUsed;
+        va_list args;
+        va_start(args, format);
+        int length = vsnprintf(client->reply + client->replyUsed, room, format, args);
+        va_end(args);
+        if (length >= 0 && (size_t)length < room) {
+            client->replyUsed += (size_t)length;
+            return;
+        }
+        flushReply(client);
+    }
+}
+
+/**
+ * @brief Appends the line of one car to a reply.
+ * @param client The client.
+ * @param set Set holding the car.
+ * @param row Row of the car.
+ */
+static void replyCar(struct Client *client, const struct Cars *set, int row) {
+    reply(client, "%d %s %s %d %d %s %s %s\n", carId(set, row), carString(set, set->brand[row]),
+          carString(set, set->model[row]), set->year[row], set->capacity[row], carString(set, set->fuel[row]),
+          carString(set, set->type[row]), carString(set, set->registration[row]));
+}
+
+/**
+ * @brief Collects the rows of a set that match a query.
+ * @param set Set to query.
+ * @param query The query, or NULL for every live row.
+ * @param rows Receives a malloc'd array of rows in ascending order (NULL when empty).
+ * @return Number of rows.
+ */
+static int matchingRows(const struct Cars *set, struct QueryNode *query, int **rows) {
+    *rows = NULL;
+    if (liveCars(set) == 0) {
+        return 0;
+    }
+    if (query) {
+        return runQuery(set, query, rows, NULL);
+    }
+
+    *rows = (int *)malloc((size_t)liveCars(set) * sizeof **rows);
+    if (!*rows) {
+        fprintf(stderr, "Memory allocation error.\n");
+        exit(EXIT_FAILURE);
+    }
+    int count = 0;
+    for (int row = nextLiveRow(set, 0); row < set->rows; row = nextLiveRow(set, row + 1)) {
+        (*rows)[count++] = row;
+    }
+    return count;
+}
+
+/**
+ * @brief Answers QUERY and COUNT from the current version.
+ * @param client The client.
+ * @param text Query text (empty for every car).
+ * @param list Non-zero to list the matching cars, zero to count them only.
+ */
+static void answerQuery(struct Client *client, const char *text, int list) {
+    char error[256];
+    struct QueryNode *query = NULL;
+    if (*text) {
+        query = parseQuery(text, error, sizeof error);
+        if (!query) {
+            reply(client, "ERR %s\n", error);
+            return;
+        }
+    }
+
+    const struct CarVersion *version = enterVersion(client->slot);
+    const struct Cars *sets[2] = {&version->view, version->added->set};
+    int total = 0;
+    for (int s = 0; s < 2; s++) {
+        int *rows;
+        int count = matchingRows(sets[s], query, &rows);
+        for (int i = 0; list && i < count; i++) {
+            replyCar(client, sets[s], rows[i]);
+        }
+        total += count;
+        free(rows);
+    }
+    leaveVersion(client->slot);
+
+    freeQuery(query);
+    reply(client, "OK %d\n", total);
+}
+
+/**
+ * @brief Answers GET from the current version.
+ * @param client The client.
+ * @param id Car number.
+ */
+static void answerGet(struct Client *client, int id) {
+    const struct CarVersion *version = enterVersion(client->slot);
+    const struct Cars *sets[2] = {&version->view, version->added->set};
+    int found = 0;
+    for (int s = 0; s < 2 && !found; s++) {
+        int row = findCarRow(sets[s], id);
+        if (row >= 0) {
+            replyCar(client, sets[s], row);
+            found = 1;
+        }
+    }
+    leaveVersion(client->slot);
+
+    if (found) {
+        reply(client, "OK 1\n");
+    } else {
+        reply(client, "ERR No car with number %d\n", id);
+    }
+}
+
+/**
+ * @brief Adds a car by publishing a version with it.
+ * @param client The client.
+ * @param text Fields of the car, in the order of base.txt.
+ */
+static void answerAdd(struct Client *client, const char *text) {
+    char brand[100], model[100], fuel[100], type[100], registration[100];
+    struct CarRecord car = {brand, model, 0, 0, fuel, type, registration};
+    if (sscanf(text, "%99s %99s %d %d %99s %99s %99s", brand, model, &car.year, &car.capacity, fuel, type,
+               registration) != 7) {
+        reply(client, "ERR Expected: ADD brand model year capacity fuel type registration\n");
+        return;
+    }
+
+    pthread_mutex_lock(&server.writeLock);
+    const struct CarVersion *current = server.current;
+    if (findRegistrations(&current->view, registration, NULL, 0) > 0 ||
+        findRegistrations(current->added->set, registration, NULL, 0) > 0) {
+        pthread_mutex_unlock(&server.writeLock);
+        reply(client, "ERR A car with registration number %s already exists\n", registration);
+        return;
+    }
+
+    struct Cars *added = copyAdded(current->added->set, -1);
+    int id = server.nextId++;
+    added->nextId = id;
+    appendCar(added, &car);
+    syncIndexes(added);
+    if (server.journal) {
+        journalAdd(server.journal, &car);
+    }
+    publishVersion(createVersion(current->base, current->view.dead, current->view.deadRows, shareSet(added),
+                                 current->changes + 1));
+    pthread_mutex_unlock(&server.writeLock);
+    reply(client, "OK %d\n", id);
+}
+
+/**
+ * @brief Removes a car by publishing a version without it.
+ * @param client The client.
+ * @param id Car number.
+ */
+static void answerRemove(struct Client *client, int id) {
+    pthread_mutex_lock(&server.writeLock);
+    const struct CarVersion *current = server.current;
+    struct CarVersion *next = NULL;
+    int row = findCarRow(&current->view, id);
+    if (row >= 0) {
+        next = createVersion(current->base, current->view.dead, current->view.deadRows + 1, current->added,
+                             current->changes + 1);
+        if (!next->view.dead) {
+            next->view.dead = (uint64_t *)calloc((size_t)(next->view.rows + 63) / 64, sizeof *next->view.dead);
+            if (!next->view.dead) {
+                fprintf(stderr, "Memory allocation error.\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+        next->view.dead[row >> 6] |= 1ULL << (row & 63);
+    } else if ((row = findCarRow(current->added->set, id)) >= 0) {
+        struct Cars *added = copyAdded(current->added->set, row);
+        syncIndexes(added);
+        next = createVersion(current->base, current->view.dead, current->view.deadRows, shareSet(added),
+                             current->changes + 1);
+    }
+
+    if (next) {
+        if (server.journal) {
+            journalRemove(server.journal, id);
+        }
+        publishVersion(next);
+    }
+    pthread_mutex_unlock(&server.writeLock);
+
+    if (next) {
+        reply(client, "OK %d\n", id);
+    } else {
+        reply(client, "ERR No car with number %d\n", id);
+    }
+}
+
+/**
+ * @brief Answers STATS from the current version.
+ * @param client The client.
+ */
+static void answerStats(struct Client *client) {
+    const struct CarVersion *version = enterVersion(client->slot);
+    unsigned long number = version->number;
+    int cars = liveCars(&version->view) + version->added->set->rows;
+    int baseRows = version->view.rows, addedRows = version->added->set->rows;
+    leaveVersion(client->slot);
+
+    // The count of retired versions is a snapshot taken without the write lock.
+    reply(client, "OK version %lu cars %d base %d added %d epoch %lu retired %d\n", number, cars, baseRows, addedRows,
+          __atomic_load_n(&server.epoch, __ATOMIC_RELAXED), __atomic_load_n(&server.retiredCount, __ATOMIC_RELAXED));
+}
+
+/**
+ * @brief Tests whether a request starts with a command word.
+ * @param line The request.
+ * @param command Command word, in capitals.
+ * @param rest Receives the text after the command and its spaces.
+ * @return Non-zero if the request is this command.
+ */
+static int isCommand(const char *line, const char *command, const char **rest) {
+    size_t length = strlen(command);
+    if (strncmp(line, command, length) != 0 || (line[length] != '\0' && line[length] != ' ')) {
+        return 0;
+    }
+    *rest = line + length;
+    while (**rest == ' ') {
+        (*rest)++;
+    }
+    return 1;
+}
+
+/**
+ * @brief Wakes the accept loop so the server stops.
+ * @param signal Signal number (unused).
+ */
+static void stopServer(int signal) {
+    (void)signal;
+    __atomic_store_n(&server.stopping, 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Body of a client thread: answers requests until the client leaves or the server stops.
+ * @param arg The client.
+ * @return NULL.
+ */
+static void *serveClient(void *arg) {
+    struct Client *client = (struct Client *)arg;
+    char line[SERVER_LINE_BYTES];
+    const char *rest;
+    int open = 1;
+
+    while (open && !client->failed && readLine(&client->connection, line, sizeof line) >= 0) {
+        size_t length = strlen(line);
+        if (length > 0 && line[length - 1] == '\r') {
+            line[length - 1] = '\0';
+        }
+        if (isCommand(line, "QUERY", &rest)) {
+            answerQuery(client, rest, 1);
+        } else if (isCommand(line, "COUNT", &rest)) {
+            answerQuery(client, rest, 0);
+        } else if (isCommand(line, "GET", &rest)) {
+            answerGet(client, atoi(rest));
+        } else if (isCommand(line, "ADD", &rest)) {
+            answerAdd(client, rest);
+        } else if (isCommand(line, "REMOVE", &rest)) {
+            answerRemove(client, atoi(rest));
+        } else if (isCommand(line, "STATS", &rest)) {
+            answerStats(client);
+        } else if (isCommand(line, "QUIT", &rest)) {
+            reply(client, "OK\n");
+            open = 0;
+        } else if (isCommand(line, "SHUTDOWN", &rest)) {
+            reply(client, "OK\n");
+            stopServer(0);
+            open = 0;
+        } else {
+            reply(client, "ERR Unknown request: %s\n", line);
+        }
+        flushReply(client);
+    }
+
+    pthread_mutex_lock(&server.clientLock);
+    server.fds[client->slot] = -1;
+    if (--server.clients == 0) {
+        pthread_cond_signal(&server.clientsGone);
+    }
+    pthread_mutex_unlock(&server.clientLock);
+    closeServer(&client->connection);
+    free(client);
+    return NULL;
+}
+
+/**
+ * @brief Hands a new connection to a client thread, or turns it away when every slot is taken.
+ * @param fd Accepted socket.
+ */
+static void admitClient(int fd) {
+    pthread_mutex_lock(&server.clientLock);
+    int slot = 0;
+    while (slot < MAX_CLIENTS && server.fds[slot] >= 0) {
+        slot++;
+    }
+    if (slot == MAX_CLIENTS) {
+        pthread_mutex_unlock(&server.clientLock);
+        const char *busy = "ERR Too many clients\n";
+        sendAll(fd, busy, strlen(busy));
+        close(fd);
+        return;
+    }
+
+    struct Client *client = (struct Client *)calloc(1, sizeof *client);
+    if (!client) {
+        fprintf(stderr, "Memory allocation error.\n");
+        exit(EXIT_FAILURE);
+    }
+    client->connection.fd = fd;
+    client->slot = slot;
+
+    pthread_t thread;
+    pthread_attr_t attributes;
+    pthread_attr_init(&attributes);
+    pthread_attr_setdetachstate(&attributes, PTHREAD_CREATE_DETACHED);
+    if (pthread_create(&thread, &attributes, serveClient, client) == 0) {
+        server.fds[slot] = fd;
+        server.clients++;
+    } else {
+        close(fd);
+        free(client);
+    }
+    pthread_attr_destroy(&attributes);
+    pthread_mutex_unlock(&server.clientLock);
+}
+
+/**
+ * @brief Creates the listening socket.
+ * @param socketPath Path of the socket.
+ * @return The socket, or -1 on failure.
+ */
+static int listenAt(const char *socketPath) {
+    struct sockaddr_un address;
+    if (strlen(socketPath) >= sizeof address.sun_path) {
+        return -1;
+    }
+    memset(&address, 0, sizeof address);
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, socketPath);
+
+    // A socket left behind by a server that did not stop cleanly is replaced.
+    struct stat status;
+    if (stat(socketPath, &status) == 0 && S_ISSOCK(status.st_mode)) {
+        unlink(socketPath);
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    if (bind(fd, (struct sockaddr *)&address, sizeof address) != 0 || listen(fd, SOMAXCONN) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * @brief Serves a car set over a Unix domain socket until a client sends SHUTDOWN or the process is interrupted.
+ *
+ * Each client gets a thread. When the server stops, the connections still open are shut
+ * down, the server waits for their threads to finish, and the current version is folded
+ * into one set, which replaces @p set.
+ *
+ * @param set Car set to serve (NULL for an empty one); on return, the set holding every change
+ *            made through the server, which replaces it.
+ * @param socketPath Path of the socket; a stale socket left there is replaced.
+ * @param journal Journal the changes are recorded in, or NULL.
+ * @return 0 when the server stopped normally, -1 if the socket could not be set up.
+ */
+int serveCars(struct Cars **set, const char *socketPath, struct Journal *journal) {
+    int listener = listenAt(socketPath);
+    if (listener < 0) {
+        return -1;
+    }
+
+    struct Cars *base = *set ? *set : createCarSet();
+    syncIndexes(base);
+    server.nextId = nextCarId(base);
+    server.journal = journal;
+    server.epoch = 1;
+    server.retired = NULL;
+    server.retiredCount = 0;
+    server.clients = 0;
+    server.stopping = 0;
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        server.fds[i] = -1;
+        server.readers[i].epoch = 0;
+    }
+    struct Cars *added = createCarSet();
+    useCarIds(added);
+    server.current = createVersion(shareSet(base), base->dead, base->deadRows, shareSet(added), 0);
+    server.current->number = 1;
+
+    struct sigaction action, oldInterrupt, oldTerminate;
+    memset(&action, 0, sizeof action);
+    action.sa_handler = stopServer;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, &oldInterrupt);
+    sigaction(SIGTERM, &action, &oldTerminate);
+
+    printf("Serving %d cars on %s.\n", liveCars(base), socketPath);
+    fflush(stdout);
+    struct pollfd waiting = {listener, POLLIN, 0};
+    while (!__atomic_load_n(&server.stopping, __ATOMIC_RELAXED)) {
+        if (poll(&waiting, 1, ACCEPT_POLL_MS) > 0) {
+            int fd = accept(listener, NULL, NULL);
+            if (fd >= 0) {
+                admitClient(fd);
+            }
+        }
+    }
+    close(listener);
+    unlink(socketPath);
+
+    // Clients blocked in a read see the end of their connection and leave.
+    pthread_mutex_lock(&server.clientLock);
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        if (server.fds[i] >= 0) {
+            shutdown(server.fds[i], SHUT_RDWR);
+        }
+    }
+    while (server.clients > 0) {
+        pthread_cond_wait(&server.clientsGone, &server.clientLock);
+    }
+    pthread_mutex_unlock(&server.clientLock);
+    sigaction(SIGINT, &oldInterrupt, NULL);
+    sigaction(SIGTERM, &oldTerminate, NULL);
+
+    struct CarVersion *current = server.current;
+    unsigned long number = current->number;
+    reclaimVersions();
+    if (current->changes > 0) {
+        *set = foldVersion(current);
+    } else {
+        // The base already holds every car, so it is handed back instead of a copy.
+        *set = current->base->set;
+        current->base->set = NULL;
+    }
+    destroyVersion(current);
+    server.current = NULL;
+    printf("Server stopped at version %lu.\n", number);
+    return 0;
+}
+
+/**
+ * @brief Connects to a server.
+ * @param connection Connection to set up.
+ * @param socketPath Path of the server's socket.
+ * @return 0 on success, -1 if the server cannot be reached.
+ */
+int connectServer(struct ServerConnection *connection, const char *socketPath) {
+    struct sockaddr_un address;
+    if (strlen(socketPath) >= sizeof address.sun_path) {
+        return -1;
+    }
+    memset(&address, 0, sizeof address);
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, socketPath);
+
+    connection->start = connection->end = 0;
+    connection->fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (connection->fd < 0) {
+        return -1;
+    }
+    if (connect(connection->fd, (struct sockaddr *)&address, sizeof address) != 0) {
+        close(connection->fd);
+        connection->fd = -1;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Sends one request line.
+ * @param connection Connection to the server.
+ * @param request The request, without the newline.
+ * @return 0 on success, -1 if the connection failed.
+ */
+int sendRequest(struct ServerConnection *connection, const char *request) {
+    char line[SERVER_LINE_BYTES];
+    int length = snprintf(line, sizeof line, "%s\n", request);
+    if (length < 0 || (size_t)length >= sizeof line) {
+        return -1;
+    }
+    return sendAll(connection->fd, line, (size_t)length);
+}
+
+/**
+ * @brief Reads one line, without its newline.
+ *
+ * Bytes are received a buffer at a time; the lines after the one returned stay in the
+ * buffer for the next call.
+ *
+ * @param connection Connection to read from.
+ * @param line Receives the line.
+ * @param size Size of @p line.
+ * @return Length of the line, or -1 at the end of the connection or on a line too long for @p line.
+ */
+int readLine(struct ServerConnection *connection, char *line, size_t size) {
+    for (;;) {
+        char *first = connection->buffer + connection->start;
+        char *newline = (char *)memchr(first, '\n', connection->end - connection->start);
+        if (newline) {
+            size_t length = (size_t)(newline - first);
+            if (length >= size) {
+                return -1;
+            }
+            memcpy(line, first, length);
+            line[length] = '\0';
+            connection->start += length + 1;
+            return (int)length;
+        }
+
+        memmove(connection->buffer, first, connection->end - connection->start);
+        connection->end -= connection->start;
+        connection->start = 0;
+        if (connection->end == sizeof connection->buffer) {
+            return -1;
+        }
+        ssize_t received = recv(connection->fd, connection->buffer + connection->end,
+                                sizeof connection->buffer - connection->end, 0);
+        if (received < 0 && errno == EINTR) {
+            continue;
+        }
+        if (received <= 0) {
+            return -1;
+        }
+        connection->end += (size_t)received;
+    }
+}
+
+/**
+ * @brief Closes a connection.
+ * @param connection Connection to close.
+ */
+void closeServer(struct ServerConnection *connection) {
+    if (connection->fd >= 0) {
+        close(connection->fd);
+        connection->fd = -1;
+    }
+}
+
+#else
+
+/**
+ * @brief Reports that the server is not available on Windows.
+ * @param set Car set (unused).
+ * @param socketPath Path of the socket (unused).
+ * @param journal Journal (unused).
+ * @return -1.
+ */
+int serveCars(struct Cars **set, const char *socketPath, struct Journal *journal) {
+    (void)set;
+    (void)socketPath;
+    (void)journal;
+    printf("The server needs Unix domain sockets and POSIX threads.\n");
+    return -1;
+}
+
+/**
+ * @brief Reports that servers cannot be reached on Windows.
+ * @param connection Connection (unused).
+ * @param socketPath Path of the socket (unused).
+ * @return -1.
+ */
+int connectServer(struct ServerConnection *connection, const char *socketPath) {
+    (void)socketPath;
+    connection->fd = -1;
+    return -1;
+}
+
+/**
+ * @brief Sends nothing: there are no connections on Windows.
+ * @param connection Connection (unused).
+ * @param request Request (unused).
+ * @return -1.
+ */
+int sendRequest(struct ServerConnection *connection, const char *request) {
+    (void)connection;
+    (void)request;
+    return -1;
+}
+
+/**
+ * @brief Reads nothing: there are no connections on Windows.
+ * @param connection Connection (unused).
+ * @param line Line (unused).
+ * @param size Size of @p line (unused).
+ * @return -1.
+ */
+int readLine(struct ServerConnection *connection, char *line, size_t size) {
+    (void)connection;
+    (void)line;
+    (void)size;
+    return -1;
+}
+
+/**
+ * @brief Does nothing: there are no connections on Windows.
+ * @param connection Connection (unused).
+ */
+void closeServer(struct ServerConnection *connection) {
+    (void)connection;
+}
+
+#endif
+
+/**
+ * @brief Tests whether a reply line is the status line that ends a reply.
+ * @param line Line read from the server.
+ * @return Non-zero for an "OK" or "ERR" line.
+ */
+int isStatusLine(const char *line) {
+    return strncmp(line, "OK", 2) == 0 || strncmp(line, "ERR", 3) == 0;
+}
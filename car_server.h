@@ -0,0 +1,103 @@
+/**
+ * @file car_server.h
+ * @brief Daemon mode: serving queries and changes to many clients over a Unix domain socket.
+ *
+ * The server loads nothing itself; it serves a car set already in memory. Each client sends
+ * requests of one line and gets back zero or more car lines followed by one status line that
+ * starts with "OK" or "ERR":
+ *
+ * - `QUERY [query]`: lists the matching cars (every car without a query), then `OK <count>`.
+ * - `COUNT [query]`: `OK <count>`.
+ * - `GET <number>`: the car with this car number, then `OK 1`.
+ * - `ADD <brand> <model> <year> <capacity> <fuel> <type> <registration>`: `OK <number>`.
+ * - `REMOVE <number>`: `OK <number>`.
+ * - `STATS`: `OK version <v> cars <n> base <rows> added <rows> epoch <e> retired <versions>`.
+ * - `QUIT` closes the connection; `SHUTDOWN` stops the server.
+ *
+ * Car lines have the layout of base.txt with the car number in front. Queries use the
+ * syntax of the query search (see car_query.h).
+ *
+ * Readers never take a lock: a request reads one immutable version of the car set from
+ * start to end, so a long scan sees a consistent fleet while cars are added and removed.
+ * A version is the base set, shared by many versions and never modified while it is
+ * served, plus a small set of the cars added since the base was built and a private copy
+ * of the bitmap of removed base rows. Writers take turns on a lock, build the next version
+ * next to the current one and publish it with a single atomic store. Once enough changes
+ * have piled up, a writer folds them into a new base. Replaced versions are freed through
+ * epoch-based reclamation: a reader announces the global epoch before it picks up the
+ * current version and clears it when done, and a version replaced at epoch e is freed once
+ * no reader still announces an epoch at or before e.
+ *
+ * The server needs POSIX threads and sockets; on Windows serveCars() only reports that.
+ */
+
+#ifndef CAR_SERVER_H
+#define CAR_SERVER_H
+
+#include "car_store.h"
+
+struct Journal;
+
+/** Longest request or reply line, including the newline. */
+#define SERVER_LINE_BYTES 4096
+
+/**
+ * @struct ServerConnection
+ * @brief One end of a connection, with the bytes received but not yet read as lines.
+ */
+struct ServerConnection {
+    int fd;                              ///< Connected socket.
+    char buffer[SERVER_LINE_BYTES];      ///< Received bytes.
+    size_t start;                        ///< First unread byte in @c buffer.
+    size_t end;                          ///< End of the received bytes in @c buffer.
+};
+
+/**
+ * @brief Serves a car set over a Unix domain socket until a client sends SHUTDOWN or the process is interrupted.
+ * @param set Car set to serve (NULL for an empty one); on return, the set holding every change
+ *            made through the server, which replaces it.
+ * @param socketPath Path of the socket; a stale socket left there is replaced.
+ * @param journal Journal the changes are recorded in, or NULL.
+ * @return 0 when the server stopped normally, -1 if the socket could not be set up.
+ */
+int serveCars(struct Cars **set, const char *socketPath, struct Journal *journal);
+
+/**
+ * @brief Connects to a server.
+ * @param connection Connection to set up.
+ * @param socketPath Path of the server's socket.
+ * @return 0 on success, -1 if the server cannot be reached.
+ */
+int connectServer(struct ServerConnection *connection, const char *socketPath);
+
+/**
+ * @brief Sends one request line.
+ * @param connection Connection to the server.
+ * @param request The request, without the newline.
+ * @return 0 on success, -1 if the connection failed.
+ */
+int sendRequest(struct ServerConnection *connection, const char *request);
+
+/**
+ * @brief Reads one line, without its newline.
+ * @param connection Connection to read from.
+ * @param line Receives the line.
+ * @param size Size of @p line.
+ * @return Length of the line, or -1 at the end of the connection or on a line too long for @p line.
+ */
+int readLine(struct ServerConnection *connection, char *line, size_t size);
+
+/**
+ * @brief Tests whether a reply line is the status line that ends a reply.
+ * @param line Line read from the server.
+ * @return Non-zero for an "OK" or "ERR" line.
+ */
+int isStatusLine(const char *line);
+
+/**
+ * @brief Closes a connection.
+ * @param connection Connection to close.
+ */
+void closeServer(struct ServerConnection *connection);
+
+#endif // CAR_SERVER_H
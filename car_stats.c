@@ -0,0 +1,260 @@
+/**
+ * @file car_stats.c
+ * @brief Implementation of the runtime statistics.
+ */
+
+#include "car_stats.h"
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * @struct OperationStats
+ * @brief Statistics of one kind of operation.
+ */
+struct OperationStats {
+    uint64_t calls;                  ///< Number of completed operations.
+    double totalSeconds;             ///< Sum of their latencies.
+    double maxSeconds;               ///< Largest latency.
+    uint64_t buckets[STAT_BUCKETS];  ///< Latency histogram (see STAT_BUCKETS).
+    uint64_t scanned;                ///< Rows examined.
+    uint64_t matched;                ///< Rows matched.
+    uint64_t bytesRead;              ///< Bytes read from files.
+    uint64_t bytesWritten;           ///< Bytes written to files.
+};
+
+int statsEnabled = 0;
+
+static struct OperationStats operations[STAT_OPERATIONS];  ///< Statistics per operation.
+static size_t peakMemory = 0;                              ///< Largest car set seen, in bytes.
+static uint64_t cacheLookups[CACHE_OUTCOMES];              ///< Query cache lookups per outcome.
+static uint64_t pageLookups[PAGE_OUTCOMES];                ///< Page cache events per outcome.
+static uint64_t partitionEvents[PARTITION_OUTCOMES];       ///< Partition events per outcome.
+
+/** Names of the operations, as printed and used as JSON keys. */
+static const char *const operationNames[STAT_OPERATIONS] = {
+    "load", "add", "import", "show", "search", "remove", "save", "compact", "summary",
+};
+
+/**
+ * @brief Returns the histogram bucket of a latency.
+ * @param seconds The latency.
+ * @return Bucket index in [0, STAT_BUCKETS).
+ */
+static int latencyBucket(double seconds) {
+    uint64_t micros = (uint64_t)(seconds * 1e6);
+    int bucket = 0;
+    while (micros > 0 && bucket < STAT_BUCKETS - 1) {
+        micros >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+/**
+ * @brief Returns the upper bound of a histogram bucket.
+ * @param bucket Bucket index.
+ * @return Upper bound in seconds.
+ */
+static double bucketLimit(int bucket) {
+    return (double)((uint64_t)1 << bucket) / 1e6;
+}
+
+/**
+ * @brief Estimates a latency percentile from the histogram.
+ * @param stats Statistics of the operation.
+ * @param fraction Percentile as a fraction, e.g. 0.99.
+ * @return Upper bound of the bucket holding the percentile, capped at the largest latency.
+ */
+static double percentile(const struct OperationStats *stats, double fraction) {
+    uint64_t rank = (uint64_t)(fraction * (double)stats->calls);
+    uint64_t seen = 0;
+    for (int b = 0; b < STAT_BUCKETS; b++) {
+        seen += stats->buckets[b];
+        if (seen > rank) {
+            double limit = bucketLimit(b);
+            return limit < stats->maxSeconds ? limit : stats->maxSeconds;
+        }
+    }
+    return stats->maxSeconds;
+}
+
+/**
+ * @brief Records the latency of an operation.
+ * @param operation Operation that finished.
+ * @param started Start time returned by beginSample().
+ * @param memory Bytes the car set occupies afterwards, or 0 if unknown.
+ */
+void recordSample(enum StatOperation operation, double started, size_t memory) {
+    double seconds = monotonicSeconds() - started;
+    struct OperationStats *stats = &operations[operation];
+    stats->calls++;
+    stats->totalSeconds += seconds;
+    if (seconds > stats->maxSeconds) {
+        stats->maxSeconds = seconds;
+    }
+    stats->buckets[latencyBucket(seconds)]++;
+    if (memory > peakMemory) {
+        peakMemory = memory;
+    }
+}
+
+/**
+ * @brief Adds to the rows examined and matched by an operation.
+ * @param operation Operation that examined the rows.
+ * @param scanned Rows examined.
+ * @param matched Rows that matched.
+ */
+void recordRows(enum StatOperation operation, long scanned, long matched) {
+    operations[operation].scanned += (uint64_t)scanned;
+    operations[operation].matched += (uint64_t)matched;
+}
+
+/**
+ * @brief Adds to the bytes read from and written to files by an operation.
+ * @param operation Operation that did the I/O.
+ * @param read Bytes read.
+ * @param written Bytes written.
+ */
+void recordBytes(enum StatOperation operation, size_t read, size_t written) {
+    operations[operation].bytesRead += read;
+    operations[operation].bytesWritten += written;
+}
+
+/**
+ * @brief Counts one lookup in the query result cache.
+ * @param outcome How the lookup was answered.
+ */
+void recordCacheLookup(enum CacheOutcome outcome) {
+    cacheLookups[outcome]++;
+}
+
+/**
+ * @brief Counts one event of the page cache.
+ * @param outcome What happened.
+ */
+void recordPageLookup(enum PageOutcome outcome) {
+    pageLookups[outcome]++;
+}
+
+/**
+ * @brief Counts one event of a partition.
+ * @param outcome What happened.
+ */
+void recordPartitionEvent(enum PartitionOutcome outcome) {
+    partitionEvents[outcome]++;
+}
+
+/**
+ * @brief Enables or disables sampling; the statistics gathered so far are kept.
+ * @param enabled Non-zero to enable sampling.
+ */
+void setStatsEnabled(int enabled) {
+    statsEnabled = enabled;
+}
+
+/**
+ * @brief Prints the statistics as a table.
+ *
+ * Only operations that ran are listed. Each is followed by its non-empty histogram buckets.
+ */
+void printStats(void) {
+    if (!statsEnabled) {
+        printf("Statistics are not being collected; start the program with --stats to collect them.\n");
+        return;
+    }
+
+    printf("%-8s %8s %11s %11s %11s %11s %12s %12s %12s %12s\n", "", "calls", "mean ms", "p50 ms", "p99 ms",
+           "max ms", "scanned", "matched", "read B", "written B");
+    for (int op = 0; op < STAT_OPERATIONS; op++) {
+        const struct OperationStats *stats = &operations[op];
+        if (stats->calls == 0) {
+            continue;
+        }
+        printf("%-8s %8llu %11.3f %11.3f %11.3f %11.3f %12llu %12llu %12llu %12llu\n", operationNames[op],
+               (unsigned long long)stats->calls, stats->totalSeconds / (double)stats->calls * 1e3,
+               percentile(stats, 0.5) * 1e3, percentile(stats, 0.99) * 1e3, stats->maxSeconds * 1e3,
+               (unsigned long long)stats->scanned, (unsigned long long)stats->matched,
+               (unsigned long long)stats->bytesRead, (unsigned long long)stats->bytesWritten);
+        for (int b = 0; b < STAT_BUCKETS; b++) {
+            if (stats->buckets[b] > 0) {
+                printf("         < %11.3f ms: %llu\n", bucketLimit(b) * 1e3, (unsigned long long)stats->buckets[b]);
+            }
+        }
+    }
+    if (cacheLookups[CACHE_HIT] + cacheLookups[CACHE_PARTIAL] + cacheLookups[CACHE_MISS] > 0) {
+        printf("Query cache: %llu hits, %llu partial hits, %llu misses\n", (unsigned long long)cacheLookups[CACHE_HIT],
+               (unsigned long long)cacheLookups[CACHE_PARTIAL], (unsigned long long)cacheLookups[CACHE_MISS]);
+    }
+    if (pageLookups[PAGE_HIT] + pageLookups[PAGE_MISS] > 0) {
+        printf("Page cache: %llu hits, %llu misses, %llu evictions\n", (unsigned long long)pageLookups[PAGE_HIT],
+               (unsigned long long)pageLookups[PAGE_MISS], (unsigned long long)pageLookups[PAGE_EVICTED]);
+    }
+    if (partitionEvents[PARTITION_SEARCHED] + partitionEvents[PARTITION_SKIPPED] + partitionEvents[PARTITION_LOADED] +
+            partitionEvents[PARTITION_WRITTEN] > 0) {
+        printf("Partitions: %llu searched, %llu skipped, %llu loaded, %llu written\n",
+               (unsigned long long)partitionEvents[PARTITION_SEARCHED],
+               (unsigned long long)partitionEvents[PARTITION_SKIPPED],
+               (unsigned long long)partitionEvents[PARTITION_LOADED],
+               (unsigned long long)partitionEvents[PARTITION_WRITTEN]);
+    }
+    printf("Peak car set size: %.1f MB\n", (double)peakMemory / 1e6);
+    size_t resident = peakResidentBytes();
+    if (resident > 0) {
+        printf("Peak resident memory: %.1f MB\n", (double)resident / 1e6);
+    }
+}
+
+/**
+ * @brief Writes the statistics as a JSON object.
+ *
+ * The object maps each operation name to its counters and its histogram, given as the
+ * bucket upper bounds in microseconds and the counts, and holds the peak car set size, the
+ * peak resident memory (0 where it cannot be measured), the cache lookups by outcome and the
+ * partition events.
+ *
+ * @param path File to write.
+ * @return 0 on success, -1 if the file cannot be written.
+ */
+int writeStatsJson(const char *path) {
+    FILE *file = fopen(path, "w");
+    if (!file) {
+        return -1;
+    }
+
+    fprintf(file, "{\n  \"peak_memory_bytes\": %llu,\n", (unsigned long long)peakMemory);
+    fprintf(file, "  \"peak_resident_bytes\": %llu,\n", (unsigned long long)peakResidentBytes());
+    fprintf(file, "  \"query_cache\": {\"hits\": %llu, \"partial_hits\": %llu, \"misses\": %llu},\n",
+            (unsigned long long)cacheLookups[CACHE_HIT], (unsigned long long)cacheLookups[CACHE_PARTIAL],
+            (unsigned long long)cacheLookups[CACHE_MISS]);
+    fprintf(file, "  \"page_cache\": {\"hits\": %llu, \"misses\": %llu, \"evictions\": %llu},\n",
+            (unsigned long long)pageLookups[PAGE_HIT], (unsigned long long)pageLookups[PAGE_MISS],
+            (unsigned long long)pageLookups[PAGE_EVICTED]);
+    fprintf(file, "  \"partitions\": {\"searched\": %llu, \"skipped\": %llu, \"loaded\": %llu, \"written\": %llu},\n",
+            (unsigned long long)partitionEvents[PARTITION_SEARCHED], (unsigned long long)partitionEvents[PARTITION_SKIPPED],
+            (unsigned long long)partitionEvents[PARTITION_LOADED], (unsigned long long)partitionEvents[PARTITION_WRITTEN]);
+    fprintf(file, "  \"operations\": {");
+    for (int op = 0; op < STAT_OPERATIONS; op++) {
+        const struct OperationStats *stats = &operations[op];
+        fprintf(file,
+                "%s\n    \"%s\": {\"calls\": %llu, \"total_seconds\": %.6f, \"max_seconds\": %.6f, "
+                "\"p50_seconds\": %.6f, \"p99_seconds\": %.6f, \"scanned\": %llu, \"matched\": %llu, "
+                "\"bytes_read\": %llu, \"bytes_written\": %llu, \"histogram_us\": [",
+                op ? "," : "", operationNames[op], (unsigned long long)stats->calls, stats->totalSeconds,
+                stats->maxSeconds, percentile(stats, 0.5), percentile(stats, 0.99),
+                (unsigned long long)stats->scanned, (unsigned long long)stats->matched,
+                (unsigned long long)stats->bytesRead, (unsigned long long)stats->bytesWritten);
+        int first = 1;
+        for (int b = 0; b < STAT_BUCKETS; b++) {
+            if (stats->buckets[b] > 0) {
+                fprintf(file, "%s[%llu, %llu]", first ? "" : ", ", (unsigned long long)1 << b,
+                        (unsigned long long)stats->buckets[b]);
+                first = 0;
+            }
+        }
+        fprintf(file, "]}");
+    }
+    fprintf(file, "\n  }\n}\n");
+
+    int failed = ferror(file);
+    return (fclose(file) != 0 || failed) ? -1 : 0;
+}
@@ -0,0 +1,203 @@
+/**
+ * @file car_stats.h
+ * @brief Runtime statistics of the database operations.
+ *
+ * While sampling is enabled, every operation records its latency on the monotonic clock into
+ * a per-operation histogram with power-of-two buckets, and searches and listings also count
+ * the rows they examined and the rows they matched. Loads and saves count the bytes they read
+ * and write, the size of the car set is tracked to report its peak, lookups in the query
+ * result cache and in the page cache of paged mode are counted by outcome, and so are the
+ * partitions of a partitioned database that operations searched, skipped, loaded or wrote.
+ * The peak resident memory of the process is reported next to them.
+ *
+ * Sampling is off unless the program is started with --stats or --stats-json. The hooks are
+ * inline and test a single flag first, so a disabled build of the hot paths pays one
+ * predictable branch per operation and never reads the clock.
+ */
+
+#ifndef CAR_STATS_H
+#define CAR_STATS_H
+
+#include "platform.h"
+#include <stddef.h>
+
+/** Number of latency buckets; bucket b counts operations that took [2^(b-1), 2^b) microseconds. */
+#define STAT_BUCKETS 32
+
+/** Operations whose statistics are kept. */
+enum StatOperation {
+    STAT_LOAD,     ///< readCars().
+    STAT_ADD,      ///< addCar(), after the car has been entered.
+    STAT_IMPORT,   ///< importFile().
+    STAT_SHOW,     ///< showCars().
+    STAT_SEARCH,   ///< search(), after the search term has been entered.
+    STAT_REMOVE,   ///< removeCar(), after the car numbers have been entered.
+    STAT_SAVE,     ///< saveCars().
+    STAT_COMPACT,  ///< compactDatabase().
+    STAT_SUMMARY,  ///< showSummary().
+    STAT_OPERATIONS
+};
+
+/** Outcomes of a lookup in the query result cache (see car_cache.h). */
+enum CacheOutcome {
+    CACHE_HIT,      ///< Answered with the cached result of the same query.
+    CACHE_PARTIAL,  ///< Answered by filtering the cached result of a broader query.
+    CACHE_MISS,     ///< Run against the car set.
+    CACHE_OUTCOMES
+};
+
+/** Outcomes of a lookup in the page cache of paged mode (see car_paged.h). */
+enum PageOutcome {
+    PAGE_HIT,      ///< The page was cached.
+    PAGE_MISS,     ///< The page was read and parsed.
+    PAGE_EVICTED,  ///< Not a lookup: a cached page was dropped to make room.
+    PAGE_OUTCOMES
+};
+
+/** What happened to a partition of a partitioned database (see car_partition.h). */
+enum PartitionOutcome {
+    PARTITION_SEARCHED,  ///< A search or listing went through the partition's cars.
+    PARTITION_SKIPPED,   ///< A search left the partition out because its statistics cannot match.
+    PARTITION_LOADED,    ///< The partition's file was read.
+    PARTITION_WRITTEN,   ///< The partition's file was rewritten.
+    PARTITION_OUTCOMES
+};
+
+/** Non-zero while sampling is enabled. */
+extern int statsEnabled;
+
+/**
+ * @brief Starts timing an operation.
+ * @return Start time to pass to endSample(), or 0 when sampling is disabled.
+ */
+static inline double beginSample(void) {
+    return statsEnabled ? monotonicSeconds() : 0.0;
+}
+
+/**
+ * @brief Records the latency of an operation.
+ * @param operation Operation that finished.
+ * @param started Start time returned by beginSample().
+ * @param memory Bytes the car set occupies afterwards (see carSetBytes()), or 0 if unknown.
+ */
+void recordSample(enum StatOperation operation, double started, size_t memory);
+
+/**
+ * @brief Finishes timing an operation.
+ * @param operation Operation that finished.
+ * @param started Start time returned by beginSample().
+ * @param memory Bytes the car set occupies afterwards, or 0 if unknown.
+ */
+static inline void endSample(enum StatOperation operation, double started, size_t memory) {
+    if (statsEnabled) {
+        recordSample(operation, started, memory);
+    }
+}
+
+/**
+ * @brief Adds to the rows examined and matched by an operation.
+ * @param operation Operation that examined the rows.
+ * @param scanned Rows examined, counting rows handed over by an index as examined.
+ * @param matched Rows that matched.
+ */
+void recordRows(enum StatOperation operation, long scanned, long matched);
+
+/**
+ * @brief Counts rows examined and matched, if sampling is enabled.
+ * @param operation Operation that examined the rows.
+ * @param scanned Rows examined.
+ * @param matched Rows that matched.
+ */
+static inline void countRows(enum StatOperation operation, long scanned, long matched) {
+    if (statsEnabled) {
+        recordRows(operation, scanned, matched);
+    }
+}
+
+/**
+ * @brief Adds to the bytes read from and written to files by an operation.
+ * @param operation Operation that did the I/O.
+ * @param read Bytes read.
+ * @param written Bytes written.
+ */
+void recordBytes(enum StatOperation operation, size_t read, size_t written);
+
+/**
+ * @brief Counts file bytes read and written, if sampling is enabled.
+ * @param operation Operation that did the I/O.
+ * @param read Bytes read.
+ * @param written Bytes written.
+ */
+static inline void countBytes(enum StatOperation operation, size_t read, size_t written) {
+    if (statsEnabled) {
+        recordBytes(operation, read, written);
+    }
+}
+
+/**
+ * @brief Counts one lookup in the query result cache.
+ * @param outcome How the lookup was answered.
+ */
+void recordCacheLookup(enum CacheOutcome outcome);
+
+/**
+ * @brief Counts one lookup in the query result cache, if sampling is enabled.
+ * @param outcome How the lookup was answered.
+ */
+static inline void countCacheLookup(enum CacheOutcome outcome) {
+    if (statsEnabled) {
+        recordCacheLookup(outcome);
+    }
+}
+
+/**
+ * @brief Counts one event of the page cache.
+ * @param outcome What happened.
+ */
+void recordPageLookup(enum PageOutcome outcome);
+
+/**
+ * @brief Counts one event of the page cache, if sampling is enabled.
+ * @param outcome What happened.
+ */
+static inline void countPageLookup(enum PageOutcome outcome) {
+    if (statsEnabled) {
+        recordPageLookup(outcome);
+    }
+}
+
+/**
+ * @brief Counts one event of a partition.
+ * @param outcome What happened.
+ */
+void recordPartitionEvent(enum PartitionOutcome outcome);
+
+/**
+ * @brief Counts one event of a partition, if sampling is enabled.
+ * @param outcome What happened.
+ */
+static inline void countPartitionEvent(enum PartitionOutcome outcome) {
+    if (statsEnabled) {
+        recordPartitionEvent(outcome);
+    }
+}
+
+/**
+ * @brief Enables or disables sampling; the statistics gathered so far are kept.
+ * @param enabled Non-zero to enable sampling.
+ */
+void setStatsEnabled(int enabled);
+
+/**
+ * @brief Prints the statistics as a table.
+ */
+void printStats(void);
+
+/**
+ * @brief Writes the statistics as a JSON object.
+ * @param path File to write.
+ * @return 0 on success, -1 if the file cannot be written.
+ */
+int writeStatsJson(const char *path);
+
+#endif // CAR_STATS_H
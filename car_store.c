@@ -0,0 +1,531 @@
+/**
+ * @file car_store.c
+ * @brief Implementation of the columnar storage engine.
+ */
+
+#include "car_store.h"
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** Bytes used by the column entries of one row. */
+#define ROW_BYTES (2 * sizeof(int) + 5 * sizeof(struct CarString))
+
+/**
+ * @brief Reallocates a column, exiting the program when memory runs out.
+ * @param column Column to resize (may be NULL).
+ * @param size New size in bytes.
+ * @return The resized column.
+ */
+static void *resizeColumn(void *column, size_t size) {
+    void *tmp = realloc(column, size);
+    if (!tmp) {
+        fprintf(stderr, "Memory allocation error.\n");
+        exit(EXIT_FAILURE);
+    }
+    return tmp;
+}
+
+/**
+ * @brief Creates an empty car set.
+ * @return Newly allocated car set; exits the program if memory runs out.
+ */
+struct Cars *createCarSet(void) {
+    struct Cars *set = (struct Cars *)calloc(1, sizeof *set);
+    if (!set) {
+        fprintf(stderr, "Memory allocation error.\n");
+        exit(EXIT_FAILURE);
+    }
+    return set;
+}
+
+/**
+ * @brief Releases a car set and all of its columns.
+ * @param set Car set to release (may be NULL).
+ */
+void destroyCarSet(struct Cars *set) {
+    if (!set) {
+        return;
+    }
+
+    if (!set->mapped) {
+        free(set->brand);
+        free(set->model);
+        free(set->year);
+        free(set->capacity);
+        free(set->fuel);
+        free(set->type);
+        free(set->registration);
+        free(set->heap);
+    }
+    free(set->dead);
+    free(set->ids);
+    freeRegistrationIndex(&set->registrations);
+    freeRangeIndex(&set->years);
+    freeRangeIndex(&set->capacities);
+    freeTrigramIndex(&set->brandTrigrams);
+    freeTrigramIndex(&set->modelTrigrams);
+    freeBitmapIndex(&set->fuelBitmaps);
+    freeBitmapIndex(&set->typeBitmaps);
+    freeAggregates(&set->aggregates);
+    freePlateTree(&set->plates);
+    freePrefixTrie(&set->brandPrefixes);
+    freePrefixTrie(&set->modelPrefixes);
+    unmapFile(&set->snapshot);
+    free(set);
+}
+
+/**
+ * @brief Copies a column out of the snapshot mapping into newly allocated memory.
+ * @param column Column inside the mapping.
+ * @param size Bytes to copy.
+ * @return The copy.
+ */
+static void *copyColumn(const void *column, size_t size) {
+    void *copy = resizeColumn(NULL, size ? size : 1);
+    memcpy(copy, column, size);
+    return copy;
+}
+
+/**
+ * @brief Moves the columns and the heap out of the snapshot mapping before they are resized.
+ *
+ * The indexes keep using the mapping until they grow themselves.
+ *
+ * @param set Car set loaded from a snapshot.
+ */
+static void detachColumns(struct Cars *set) {
+    size_t n = (size_t)set->allocated;
+    set->brand = copyColumn(set->brand, n * sizeof *set->brand);
+    set->model = copyColumn(set->model, n * sizeof *set->model);
+    set->year = copyColumn(set->year, n * sizeof *set->year);
+    set->capacity = copyColumn(set->capacity, n * sizeof *set->capacity);
+    set->fuel = copyColumn(set->fuel, n * sizeof *set->fuel);
+    set->type = copyColumn(set->type, n * sizeof *set->type);
+    set->registration = copyColumn(set->registration, n * sizeof *set->registration);
+    set->heap = copyColumn(set->heap, set->heapSize);
+    set->mapped = 0;
+}
+
+/**
+ * @brief Makes room for at least the given number of rows and heap bytes.
+ *
+ * Columns and heap grow geometrically, so a sequence of appends costs amortized O(1) each.
+ *
+ * @param set Car set to grow.
+ * @param rows Total number of rows required.
+ * @param heapBytes Total number of heap bytes required.
+ */
+void reserveCars(struct Cars *set, int rows, size_t heapBytes) {
+    if (set->mapped && (rows > set->allocated || heapBytes > set->heapSize)) {
+        detachColumns(set);
+    }
+
+    if (rows > set->allocated) {
+        int allocated = set->allocated ? set->allocated : 16;
+        while (allocated < rows) {
+            allocated = (allocated > INT_MAX / 2) ? INT_MAX : allocated * 2;
+        }
+
+        size_t n = (size_t)allocated;
+        set->brand = resizeColumn(set->brand, n * sizeof *set->brand);
+        set->model = resizeColumn(set->model, n * sizeof *set->model);
+        set->year = resizeColumn(set->year, n * sizeof *set->year);
+        set->capacity = resizeColumn(set->capacity, n * sizeof *set->capacity);
+        set->fuel = resizeColumn(set->fuel, n * sizeof *set->fuel);
+        set->type = resizeColumn(set->type, n * sizeof *set->type);
+        set->registration = resizeColumn(set->registration, n * sizeof *set->registration);
+        if (set->ids) {
+            set->ids = resizeColumn(set->ids, n * sizeof *set->ids);
+        }
+        if (set->dead) {
+            size_t oldWords = ((size_t)set->allocated + 63) / 64, words = (n + 63) / 64;
+            set->dead = resizeColumn(set->dead, words * sizeof *set->dead);
+            memset(set->dead + oldWords, 0, (words - oldWords) * sizeof *set->dead);
+        }
+        set->allocated = allocated;
+    }
+
+    if (heapBytes > set->heapSize) {
+        if (heapBytes > UINT_MAX) {
+            fprintf(stderr, "String heap limit exceeded.\n");
+            exit(EXIT_FAILURE);
+        }
+
+        size_t size = set->heapSize ? set->heapSize : 1024;
+        while (size < heapBytes) {
+            size *= 2;
+        }
+        if (size > UINT_MAX) {
+            size = UINT_MAX;
+        }
+
+        set->heap = resizeColumn(set->heap, size);
+        set->heapSize = size;
+    }
+}
+
+/**
+ * @brief Copies a string into the shared heap.
+ * @param set Car set owning the heap.
+ * @param text First character of the string (need not be NUL-terminated).
+ * @param length Number of characters to copy.
+ * @return Reference to the stored, NUL-terminated copy.
+ */
+struct CarString storeString(struct Cars *set, const char *text, size_t length) {
+    reserveCars(set, 0, set->heapUsed + length + 1);
+
+    struct CarString ref;
+    ref.offset = (unsigned int)set->heapUsed;
+    ref.length = (unsigned int)length;
+
+    memcpy(set->heap + set->heapUsed, text, length);
+    set->heap[set->heapUsed + length] = '\0';
+    set->heapUsed += length + 1;
+    return ref;
+}
+
+/**
+ * @brief Appends a row whose strings are already stored in the heap and indexes it.
+ * @param set Car set to append to.
+ * @param brand Brand reference.
+ * @param model Model reference.
+ * @param year Year of manufacture.
+ * @param capacity Engine capacity in cm^3.
+ * @param fuel Fuel reference.
+ * @param type Vehicle type reference.
+ * @param registration Registration number reference.
+ * @return Row index of the new car.
+ */
+int appendCarRow(struct Cars *set, struct CarString brand, struct CarString model, int year, int capacity,
+                 struct CarString fuel, struct CarString type, struct CarString registration) {
+    reserveCars(set, set->rows + 1, 0);
+
+    int row = set->rows++;
+    set->generation++;
+    set->brand[row] = brand;
+    set->model[row] = model;
+    set->year[row] = year;
+    set->capacity[row] = capacity;
+    set->fuel[row] = fuel;
+    set->type[row] = type;
+    set->registration[row] = registration;
+    if (set->ids) {
+        set->ids[row] = set->nextId++;
+    }
+
+    appendRangeEntry(&set->years, year, row);
+    appendRangeEntry(&set->capacities, capacity, row);
+    insertTrigrams(&set->brandTrigrams, carString(set, brand), brand.length, row);
+    insertTrigrams(&set->modelTrigrams, carString(set, model), model.length, row);
+    syncBitmapIndex(set, &set->fuelBitmaps, set->fuel);
+    syncBitmapIndex(set, &set->typeBitmaps, set->type);
+    aggregateCar(set, row);
+    appendPlate(&set->plates, row);
+    appendPrefix(&set->brandPrefixes, carString(set, brand), brand.length, row);
+    appendPrefix(&set->modelPrefixes, carString(set, model), model.length, row);
+    return row;
+}
+
+/**
+ * @brief Appends a copy of a car to the set.
+ * @param set Car set to append to.
+ * @param car Car to copy.
+ * @return Row index of the new car.
+ */
+int appendCar(struct Cars *set, const struct CarRecord *car) {
+    struct CarString brand = storeString(set, car->brand, strlen(car->brand));
+    struct CarString model = storeString(set, car->model, strlen(car->model));
+    struct CarString fuel = storeString(set, car->fuel, strlen(car->fuel));
+    struct CarString type = storeString(set, car->type, strlen(car->type));
+    struct CarString registration = storeString(set, car->registration, strlen(car->registration));
+    return appendCarRow(set, brand, model, car->year, car->capacity, fuel, type, registration);
+}
+
+/**
+ * @brief Folds rows appended since the last call into the indexes.
+ * @param set Car set whose indexes should be synchronized.
+ */
+void syncIndexes(struct Cars *set) {
+    syncRegistrations(set);
+    syncRangeIndex(&set->years);
+    syncRangeIndex(&set->capacities);
+    syncBitmapIndex(set, &set->fuelBitmaps, set->fuel);
+    syncBitmapIndex(set, &set->typeBitmaps, set->type);
+}
+
+/**
+ * @brief Moves one string into a new heap during compaction.
+ * @param heap New heap being filled.
+ * @param used Bytes of the new heap in use, advanced past the copy.
+ * @param oldHeap Heap the string currently lives in.
+ * @param ref Reference to update.
+ */
+static void moveString(char *heap, size_t *used, const char *oldHeap, struct CarString *ref) {
+    memcpy(heap + *used, oldHeap + ref->offset, ref->length + 1);
+    ref->offset = (unsigned int)*used;
+    *used += ref->length + 1;
+}
+
+/**
+ * @brief Rewrites the heap without the strings of removed cars.
+ * @param set Car set whose heap should be compacted.
+ */
+static void compactHeap(struct Cars *set) {
+    if (set->mapped) {
+        detachColumns(set);
+    }
+
+    size_t size = set->heapUsed - set->heapGarbage;
+    char *heap = (char *)malloc(size ? size : 1);
+    if (!heap) {
+        fprintf(stderr, "Memory allocation error.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    size_t used = 0;
+    for (int i = 0; i < set->rows; i++) {
+        moveString(heap, &used, set->heap, &set->brand[i]);
+        moveString(heap, &used, set->heap, &set->model[i]);
+        moveString(heap, &used, set->heap, &set->fuel[i]);
+        moveString(heap, &used, set->heap, &set->type[i]);
+        moveString(heap, &used, set->heap, &set->registration[i]);
+    }
+
+    free(set->heap);
+    set->heap = heap;
+    set->heapUsed = used;
+    set->heapSize = size ? size : 1;
+    set->heapGarbage = 0;
+}
+
+/**
+ * @brief Removes a car by marking its row dead.
+ * @param set Car set to modify.
+ * @param row Row of the car to remove; must be live.
+ */
+void eraseCar(struct Cars *set, int row) {
+    eraseCars(set, &row, 1);
+}
+
+/**
+ * @brief Removes several cars at once, purging at most once for the whole batch.
+ *
+ * Each removal sets a bit and drops the row from the hash and bitmap indexes, so it costs
+ * O(1). The other indexes keep dead rows until purgeCars() runs, which happens once more
+ * than 1/PURGE_DEAD_FRACTION of the rows are dead.
+ *
+ * @param set Car set to modify.
+ * @param rows Rows of the cars to remove; dead rows and repeats are ignored.
+ * @param count Number of rows.
+ * @return Number of cars removed.
+ */
+int eraseCars(struct Cars *set, const int *rows, int count) {
+    if (!set->dead && count > 0) {
+        set->dead = (uint64_t *)calloc(((size_t)set->allocated + 63) / 64, sizeof *set->dead);
+        if (!set->dead) {
+            fprintf(stderr, "Memory allocation error.\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    int removed = 0;
+    for (int i = 0; i < count; i++) {
+        int row = rows[i];
+        if (isDeadRow(set, row)) {
+            continue;
+        }
+        eraseRegistration(set, row);
+        eraseBitmapRow(set, &set->fuelBitmaps, set->fuel, row);
+        eraseBitmapRow(set, &set->typeBitmaps, set->type, row);
+        unaggregateCar(set, row);
+        erasePrefix(&set->brandPrefixes, carString(set, set->brand[row]), set->brand[row].length);
+        erasePrefix(&set->modelPrefixes, carString(set, set->model[row]), set->model[row].length);
+        set->dead[row >> 6] |= (uint64_t)1 << (row & 63);
+        set->heapGarbage += set->brand[row].length + set->model[row].length + set->fuel[row].length +
+                            set->type[row].length + set->registration[row].length + 5;
+        removed++;
+    }
+    set->deadRows += removed;
+    set->generation += removed > 0;
+
+    if ((long long)set->deadRows * PURGE_DEAD_FRACTION > set->rows) {
+        purgeCars(set);
+    }
+    return removed;
+}
+
+/**
+ * @brief Gives the set an explicit record ID column, if it does not have one yet.
+ *
+ * Every car keeps its current ID. Afterwards @c nextId may be set before each append to
+ * give the appended car any ID above the ones already in the set.
+ *
+ * @param set Car set to number explicitly.
+ */
+void useCarIds(struct Cars *set) {
+    if (set->ids) {
+        return;
+    }
+    set->ids = resizeColumn(NULL, (size_t)(set->allocated > 0 ? set->allocated : 1) * sizeof *set->ids);
+    for (int row = 0; row < set->rows; row++) {
+        set->ids[row] = row + 1;
+    }
+    set->nextId = set->rows + 1;
+}
+
+/**
+ * @brief Drops every dead row, moving the live rows down and updating the indexes.
+ *
+ * Record IDs are kept: the first purge gives the set an explicit ID column. Only the
+ * small column entries move; the strings of the dead cars stay in the heap as garbage
+ * until it makes up more than half of the heap, at which point the heap is compacted.
+ *
+ * @param set Car set to purge.
+ */
+void purgeCars(struct Cars *set) {
+    if (set->deadRows == 0) {
+        return;
+    }
+
+    useCarIds(set);
+    set->generation++;
+
+    int *map = (int *)malloc((size_t)set->rows * sizeof *map);
+    if (!map) {
+        fprintf(stderr, "Memory allocation error.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // Live rows only ever move down, so copying in ascending order is safe in place.
+    int live = 0;
+    for (int row = 0; row < set->rows; row++) {
+        if (isDeadRow(set, row)) {
+            map[row] = -1;
+            continue;
+        }
+        map[row] = live;
+        set->brand[live] = set->brand[row];
+        set->model[live] = set->model[row];
+        set->year[live] = set->year[row];
+        set->capacity[live] = set->capacity[row];
+        set->fuel[live] = set->fuel[row];
+        set->type[live] = set->type[row];
+        set->registration[live] = set->registration[row];
+        set->ids[live] = set->ids[row];
+        live++;
+    }
+
+    remapRegistrations(set, map);
+    remapRangeIndex(&set->years, map);
+    remapRangeIndex(&set->capacities, map);
+    remapTrigramIndex(&set->brandTrigrams, map);
+    remapTrigramIndex(&set->modelTrigrams, map);
+    remapPlateTree(&set->plates, map);
+    remapPrefixTrie(&set->brandPrefixes, map);
+    remapPrefixTrie(&set->modelPrefixes, map);
+    free(map);
+
+    memset(set->dead, 0, ((size_t)set->allocated + 63) / 64 * sizeof *set->dead);
+    set->rows = live;
+    set->deadRows = 0;
+    rebuildBitmapIndex(set, &set->fuelBitmaps, set->fuel);
+    rebuildBitmapIndex(set, &set->typeBitmaps, set->type);
+
+    if (set->heapGarbage > set->heapUsed / 2) {
+        compactHeap(set);
+    }
+}
+
+/**
+ * @brief Gives the cars the record IDs 1, 2, 3, ... in row order.
+ *
+ * Used after the set has been written out, so the IDs match what reloading it would give.
+ *
+ * @param set Car set without dead rows.
+ */
+void renumberCars(struct Cars *set) {
+    free(set->ids);
+    set->ids = NULL;
+    set->nextId = 0;
+}
+
+/**
+ * @brief Returns the first live row at or after a row.
+ *
+ * Whole words of the dead bitmap are skipped at a time.
+ *
+ * @param set Car set to walk.
+ * @param row Row to start from.
+ * @return First live row, or @c set->rows if there is none.
+ */
+int nextLiveRow(const struct Cars *set, int row) {
+    if (!set->dead || row >= set->rows) {
+        return row < set->rows ? row : set->rows;
+    }
+
+    size_t word = (size_t)row >> 6;
+    uint64_t live = ~set->dead[word] & (~(uint64_t)0 << (row & 63));
+    while (!live) {
+        if (++word * 64 >= (size_t)set->rows) {
+            return set->rows;
+        }
+        live = ~set->dead[word];
+    }
+    row = (int)(word * 64) + __builtin_ctzll(live);
+    return row < set->rows ? row : set->rows;
+}
+
+/**
+ * @brief Finds the row of the live car with a record ID.
+ *
+ * IDs grow with the row, so the ID column is binary searched.
+ *
+ * @param set Car set to search.
+ * @param id Record ID.
+ * @return Row of the car, or -1 if no live car has this ID.
+ */
+int findCarRow(const struct Cars *set, int id) {
+    int row = -1;
+    if (!set->ids) {
+        row = (id >= 1 && id <= set->rows) ? id - 1 : -1;
+    } else {
+        int low = 0, high = set->rows;
+        while (low < high) {
+            int mid = low + (high - low) / 2;
+            if (set->ids[mid] < id) {
+                low = mid + 1;
+            } else {
+                high = mid;
+            }
+        }
+        row = (low < set->rows && set->ids[low] == id) ? low : -1;
+    }
+    return (row >= 0 && !isDeadRow(set, row)) ? row : -1;
+}
+
+/**
+ * @brief Fills a row-oriented view of one car.
+ * @param set Car set to read from.
+ * @param row Row index of the car.
+ * @param car Receives the view; its strings point into the heap.
+ */
+void getCar(const struct Cars *set, int row, struct CarRecord *car) {
+    car->brand = carString(set, set->brand[row]);
+    car->model = carString(set, set->model[row]);
+    car->year = set->year[row];
+    car->capacity = set->capacity[row];
+    car->fuel = carString(set, set->fuel[row]);
+    car->type = carString(set, set->type[row]);
+    car->registration = carString(set, set->registration[row]);
+}
+
+/**
+ * @brief Returns the number of bytes the stored cars occupy (columns plus live strings).
+ * @param set Car set to measure.
+ * @return Bytes in use, excluding unused reserved space.
+ */
+size_t carSetBytes(const struct Cars *set) {
+    return (size_t)set->rows * ROW_BYTES + (set->heapUsed - set->heapGarbage);
+}
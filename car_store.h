@@ -0,0 +1,291 @@
+/**
+ * @file car_store.h
+ * @brief Columnar storage engine behind the car database.
+ *
+ * Cars are stored as a structure of arrays: one packed column per attribute, with all
+ * strings kept in a single shared heap and referenced by offset/length pairs.
+ */
+
+#ifndef CAR_STORE_H
+#define CAR_STORE_H
+
+#include "car_aggregate.h"
+#include "car_bitmap.h"
+#include "car_fuzzy.h"
+#include "car_hash.h"
+#include "car_prefix.h"
+#include "car_range.h"
+#include "car_trigram.h"
+#include "platform.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Size in bytes of one record in the original fixed-size layout
+ *        (five char[100] buffers and two ints), kept for memory reports.
+ */
+#define FIXED_RECORD_BYTES (5 * 100 + 2 * sizeof(int))
+
+/** Removed cars are purged once they make up more than 1/PURGE_DEAD_FRACTION of the rows. */
+#define PURGE_DEAD_FRACTION 4
+
+/**
+ * @struct CarString
+ * @brief Reference to a NUL-terminated string stored in the shared string heap.
+ */
+struct CarString {
+    unsigned int offset;  ///< Byte offset of the first character in the heap.
+    unsigned int length;  ///< Length in bytes, not counting the terminating NUL.
+};
+
+/**
+ * @struct CarRecord
+ * @brief Row-oriented view of a single car, used to pass cars in and out of the store.
+ */
+struct CarRecord {
+    const char *brand;         ///< Brand of the car.
+    const char *model;         ///< Model of the car.
+    int year;                  ///< Year of manufacture.
+    int capacity;              ///< Engine capacity in cm^3.
+    const char *fuel;          ///< Type of fuel used.
+    const char *type;          ///< Type of the vehicle.
+    const char *registration;  ///< Registration number of the car.
+};
+
+/**
+ * @struct Cars
+ * @brief Columnar set of cars.
+ *
+ * Row @c i of every column belongs to the same car. Numeric attributes are packed
+ * int columns; string attributes are CarString references into @c heap. Indexes are
+ * kept up to date by appendCarRow() and purgeCars(). The hash and range indexes queue
+ * appended rows and syncIndexes() folds a whole batch into them at once; lookups
+ * already see queued rows, so syncing only affects speed. The bitmap indexes are not
+ * stored in snapshots, so syncIndexes() also builds them for a set loaded from one.
+ *
+ * Removing a car only sets its bit in the @c dead bitmap. Its row stays in place, and in
+ * the range and trigram indexes, until purgeCars() drops every dead row at once; readers
+ * skip dead rows with isDeadRow() or nextLiveRow(). Each car keeps its record ID across
+ * purges, so rows are internal positions while IDs are what the user sees. Every change to
+ * the rows bumps @c generation, so results computed from the set can be checked for staleness.
+ *
+ * A set loaded from a snapshot uses the columns, heap and indexes in place inside a
+ * copy-on-write mapping of the file. Each array is copied to the heap the first time
+ * it has to grow, and the mapping is released with the set.
+ */
+struct Cars {
+    int rows;                         ///< Number of rows, including dead ones.
+    int deadRows;                     ///< Rows removed but not purged yet.
+    uint64_t *dead;                   ///< Bitmap of dead rows (NULL until the first removal).
+    int *ids;                         ///< Record ID column (NULL while every ID is its row + 1).
+    int nextId;                       ///< ID of the next appended car while @c ids is in use.
+    unsigned long generation;         ///< Bumped whenever rows are appended, removed or moved.
+    int allocated;                    ///< Number of rows the columns have room for.
+    struct CarString *brand;          ///< Brand column.
+    struct CarString *model;          ///< Model column.
+    int *year;                        ///< Year of manufacture column.
+    int *capacity;                    ///< Engine capacity column, in cm^3.
+    struct CarString *fuel;           ///< Fuel column.
+    struct CarString *type;           ///< Vehicle type column.
+    struct CarString *registration;   ///< Registration number column.
+    char *heap;                       ///< Shared string heap.
+    size_t heapUsed;                  ///< Bytes of the heap in use.
+    size_t heapSize;                  ///< Bytes allocated for the heap.
+    size_t heapGarbage;               ///< Bytes in use by strings of removed cars.
+    int mapped;                       ///< Non-zero while the columns and the heap point into @c snapshot.
+    struct MappedFile snapshot;       ///< Snapshot mapping the set uses in place (data is NULL when none).
+    struct RegistrationIndex registrations;  ///< Hash index on the registration column.
+    struct RangeIndex years;          ///< Sorted index on the year column.
+    struct RangeIndex capacities;     ///< Sorted index on the capacity column.
+    struct TrigramIndex brandTrigrams;  ///< Trigram index on the brand column.
+    struct TrigramIndex modelTrigrams;  ///< Trigram index on the model column.
+    struct BitmapIndex fuelBitmaps;   ///< Bitmap index on the fuel column.
+    struct BitmapIndex typeBitmaps;   ///< Bitmap index on the vehicle type column.
+    struct Aggregates aggregates;     ///< Fleet aggregates, maintained once first computed.
+    struct BkTree plates;             ///< BK-tree on the registration column, maintained once first built.
+    struct PrefixTrie brandPrefixes;  ///< Radix trie on the brand column, maintained once first built.
+    struct PrefixTrie modelPrefixes;  ///< Radix trie on the model column, maintained once first built.
+};
+
+/**
+ * @brief Returns the characters of a string stored in the car set.
+ * @param set Car set owning the string.
+ * @param ref Reference to the string.
+ * @return Pointer to the NUL-terminated string inside the heap.
+ */
+static inline const char *carString(const struct Cars *set, struct CarString ref) {
+    return set->heap + ref.offset;
+}
+
+/**
+ * @brief Tests whether a row holds a removed car.
+ * @param set Car set to check.
+ * @param row Row to test.
+ * @return Non-zero if the row is dead.
+ */
+static inline int isDeadRow(const struct Cars *set, int row) {
+    return set->dead && (set->dead[row >> 6] >> (row & 63) & 1);
+}
+
+/**
+ * @brief Returns the number of cars in a set, not counting removed ones.
+ * @param set Car set to count.
+ * @return Number of live cars.
+ */
+static inline int liveCars(const struct Cars *set) {
+    return set->rows - set->deadRows;
+}
+
+/**
+ * @brief Returns the record ID of the car in a row.
+ * @param set Car set holding the car.
+ * @param row Row of the car.
+ * @return Record ID, starting from 1.
+ */
+static inline int carId(const struct Cars *set, int row) {
+    return set->ids ? set->ids[row] : row + 1;
+}
+
+/**
+ * @brief Returns the record ID the next appended car will receive.
+ * @param set Car set to append to.
+ * @return Record ID.
+ */
+static inline int nextCarId(const struct Cars *set) {
+    return set->ids ? set->nextId : set->rows + 1;
+}
+
+/**
+ * @brief Creates an empty car set.
+ * @return Newly allocated car set; exits the program if memory runs out.
+ */
+struct Cars *createCarSet(void);
+
+/**
+ * @brief Releases a car set and all of its columns.
+ * @param set Car set to release (may be NULL).
+ */
+void destroyCarSet(struct Cars *set);
+
+/**
+ * @brief Makes room for at least the given number of rows and heap bytes.
+ * @param set Car set to grow.
+ * @param rows Total number of rows required.
+ * @param heapBytes Total number of heap bytes required.
+ */
+void reserveCars(struct Cars *set, int rows, size_t heapBytes);
+
+/**
+ * @brief Copies a string into the shared heap.
+ * @param set Car set owning the heap.
+ * @param text First character of the string (need not be NUL-terminated).
+ * @param length Number of characters to copy.
+ * @return Reference to the stored, NUL-terminated copy.
+ */
+struct CarString storeString(struct Cars *set, const char *text, size_t length);
+
+/**
+ * @brief Appends a row whose strings are already stored in the heap and indexes it.
+ * @param set Car set to append to.
+ * @param brand Brand reference.
+ * @param model Model reference.
+ * @param year Year of manufacture.
+ * @param capacity Engine capacity in cm^3.
+ * @param fuel Fuel reference.
+ * @param type Vehicle type reference.
+ * @param registration Registration number reference.
+ * @return Row index of the new car.
+ */
+int appendCarRow(struct Cars *set, struct CarString brand, struct CarString model, int year, int capacity,
+                 struct CarString fuel, struct CarString type, struct CarString registration);
+
+/**
+ * @brief Appends a copy of a car to the set.
+ * @param set Car set to append to.
+ * @param car Car to copy.
+ * @return Row index of the new car.
+ */
+int appendCar(struct Cars *set, const struct CarRecord *car);
+
+/**
+ * @brief Folds rows appended since the last call into the indexes.
+ * @param set Car set whose indexes should be synchronized.
+ */
+void syncIndexes(struct Cars *set);
+
+/**
+ * @brief Removes a car by marking its row dead.
+ * @param set Car set to modify.
+ * @param row Row of the car to remove; must be live.
+ */
+void eraseCar(struct Cars *set, int row);
+
+/**
+ * @brief Removes several cars at once, purging at most once for the whole batch.
+ * @param set Car set to modify.
+ * @param rows Rows of the cars to remove; dead rows and repeats are ignored.
+ * @param count Number of rows.
+ * @return Number of cars removed.
+ */
+int eraseCars(struct Cars *set, const int *rows, int count);
+
+/**
+ * @brief Gives the set an explicit record ID column, if it does not have one yet.
+ *
+ * Every car keeps its current ID; setting @c nextId before an append then chooses the ID
+ * of the appended car, which must be above every ID in the set.
+ *
+ * @param set Car set to number explicitly.
+ */
+void useCarIds(struct Cars *set);
+
+/**
+ * @brief Drops every dead row, moving the live rows down and updating the indexes.
+ *
+ * Record IDs are kept. Rows that were handed out before the purge are no longer valid.
+ *
+ * @param set Car set to purge.
+ */
+void purgeCars(struct Cars *set);
+
+/**
+ * @brief Gives the cars the record IDs 1, 2, 3, ... in row order.
+ *
+ * Used after the set has been written out, so the IDs match what reloading it would give.
+ *
+ * @param set Car set without dead rows.
+ */
+void renumberCars(struct Cars *set);
+
+/**
+ * @brief Returns the first live row at or after a row.
+ * @param set Car set to walk.
+ * @param row Row to start from.
+ * @return First live row, or @c set->rows if there is none.
+ */
+int nextLiveRow(const struct Cars *set, int row);
+
+/**
+ * @brief Finds the row of the live car with a record ID.
+ * @param set Car set to search.
+ * @param id Record ID.
+ * @return Row of the car, or -1 if no live car has this ID.
+ */
+int findCarRow(const struct Cars *set, int id);
+
+/**
+ * @brief Fills a row-oriented view of one car.
+ * @param set Car set to read from.
+ * @param row Row index of the car.
+ * @param car Receives the view; its strings point into the heap.
+ */
+void getCar(const struct Cars *set, int row, struct CarRecord *car);
+
+/**
+ * @brief Returns the number of bytes the stored cars occupy (columns plus live strings).
+ * @param set Car set to measure.
+ * @return Bytes in use, excluding unused reserved space.
+ */
+size_t carSetBytes(const struct Cars *set);
+
+#endif // CAR_STORE_H
@@ -0,0 +1,363 @@
+/**
+ * @file car_trigram.c
+ * @brief Implementation of the trigram inverted indexes.
+ */
+
+#include "car_trigram.h"
+#include "car_store.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** Number of table slots allocated by the first insert. */
+#define INITIAL_LISTS 256
+
+/** Upper bound on the trigrams of a pattern or stored string handled without allocation. */
+#define MAX_TRIGRAMS 128
+
+/**
+ * @brief Packs the three bytes at @p text into a non-zero table key.
+ * @param text First of three bytes.
+ * @return Table key.
+ */
+static unsigned int packTrigram(const char *text) {
+    return (((unsigned int)(unsigned char)text[0] << 16) |
+            ((unsigned int)(unsigned char)text[1] << 8) |
+            (unsigned int)(unsigned char)text[2]) + 1;
+}
+
+/**
+ * @brief Returns the home slot of a trigram key.
+ * @param index Index being probed.
+ * @param key Trigram key.
+ * @return Slot number.
+ */
+static size_t homeSlot(const struct TrigramIndex *index, unsigned int key) {
+    return (key * 2654435761u) & index->mask;
+}
+
+/**
+ * @brief Finds the posting list of a trigram.
+ * @param index Index to search.
+ * @param key Trigram key.
+ * @return The list, or NULL if no indexed string contains the trigram.
+ */
+static struct PostingList *findList(const struct TrigramIndex *index, unsigned int key) {
+    if (!index->lists) {
+        return NULL;
+    }
+
+    for (size_t i = homeSlot(index, key); index->lists[i].trigram != 0; i = (i + 1) & index->mask) {
+        if (index->lists[i].trigram == key) {
+            return &index->lists[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Doubles the table and moves every posting list to its new slot.
+ * @param index Index to grow.
+ */
+static void growTable(struct TrigramIndex *index) {
+    size_t oldCount = index->lists ? index->mask + 1 : 0;
+    size_t count = oldCount ? oldCount * 2 : INITIAL_LISTS;
+
+    struct PostingList *lists = (struct PostingList *)calloc(count, sizeof *lists);
+    if (!lists) {
+        fprintf(stderr, "Memory allocation error.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    struct PostingList *old = index->lists;
+    index->lists = lists;
+    index->mask = count - 1;
+    for (size_t i = 0; i < oldCount; i++) {
+        if (old[i].trigram != 0) {
+            size_t j = homeSlot(index, old[i].trigram);
+            while (lists[j].trigram != 0) {
+                j = (j + 1) & index->mask;
+            }
+            lists[j] = old[i];
+        }
+    }
+    free(old);
+}
+
+/**
+ * @brief Finds the posting list of a trigram, creating an empty one if needed.
+ * @param index Index to search.
+ * @param key Trigram key.
+ * @return The list.
+ */
+static struct PostingList *obtainList(struct TrigramIndex *index, unsigned int key) {
+    struct PostingList *list = findList(index, key);
+    if (list) {
+        return list;
+    }
+
+    if (!index->lists || (index->used + 1) * 10 > (index->mask + 1) * 7) {
+        growTable(index);
+    }
+
+    size_t i = homeSlot(index, key);
+    while (index->lists[i].trigram != 0) {
+        i = (i + 1) & index->mask;
+    }
+    index->lists[i].trigram = key;
+    index->used++;
+    return &index->lists[i];
+}
+
+/**
+ * @brief Collects the distinct trigram keys of a string.
+ * @param text String to split.
+ * @param length Length of the string.
+ * @param keys Receives up to MAX_TRIGRAMS distinct keys.
+ * @return Number of distinct keys.
+ */
+static int distinctTrigrams(const char *text, size_t length, unsigned int *keys) {
+    int count = 0;
+    for (size_t i = 0; i + TRIGRAM_LENGTH <= length && count < MAX_TRIGRAMS; i++) {
+        unsigned int key = packTrigram(text + i);
+        int seen = 0;
+        for (int k = 0; k < count && !seen; k++) {
+            seen = (keys[k] == key);
+        }
+        if (!seen) {
+            keys[count++] = key;
+        }
+    }
+    return count;
+}
+
+/**
+ * @brief Adds a row to the posting lists of every distinct trigram of its string.
+ *
+ * Rows arrive in ascending order, so each list stays sorted by plain appending.
+ *
+ * @param index Index to update.
+ * @param text String of the row.
+ * @param length Length of the string.
+ * @param row Row of the car; must be greater than every row already indexed.
+ */
+void insertTrigrams(struct TrigramIndex *index, const char *text, size_t length, int row) {
+    unsigned int keys[MAX_TRIGRAMS];
+    int count = distinctTrigrams(text, length, keys);
+
+    for (int k = 0; k < count; k++) {
+        struct PostingList *list = obtainList(index, keys[k]);
+        if (list->count == list->allocated) {
+            int allocated = list->allocated ? list->allocated * 2 : 4;
+            int *tmp = (int *)realloc(list->mapped ? NULL : list->rows, (size_t)allocated * sizeof *tmp);
+            if (!tmp) {
+                fprintf(stderr, "Memory allocation error.\n");
+                exit(EXIT_FAILURE);
+            }
+            if (list->mapped) {
+                memcpy(tmp, list->rows, (size_t)list->count * sizeof *tmp);
+                list->mapped = 0;
+            }
+            list->rows = tmp;
+            list->allocated = allocated;
+        }
+        list->rows[list->count++] = row;
+    }
+}
+
+/**
+ * @brief Finds the first position at or after @p from whose row is not less than @p target.
+ *
+ * Gallops forward in doubling steps and finishes with a binary search, so walking a long
+ * list in step with a short one costs O(short * log(long / short)).
+ *
+ * @param rows Ascending rows.
+ * @param count Number of rows.
+ * @param from Position to start at.
+ * @param target Row to look for.
+ * @return Position in [from, count].
+ */
+static int gallop(const int *rows, int count, int from, int target) {
+    int step = 1;
+    int low = from, high = from;
+    while (high < count && rows[high] < target) {
+        low = high + 1;
+        high = from + step;
+        step *= 2;
+    }
+    if (high > count) {
+        high = count;
+    }
+
+    while (low < high) {
+        int mid = low + (high - low) / 2;
+        if (rows[mid] < target) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+/**
+ * @brief Drops dead rows from every posting list and renumbers the others after a purge.
+ *
+ * The purge keeps the live rows in order, so every list stays ascending. Lists loaded
+ * from a snapshot are rewritten in place in the copy-on-write mapping.
+ *
+ * @param index Index to update.
+ * @param map New row of every old row, or -1 for dead rows.
+ */
+void remapTrigramIndex(struct TrigramIndex *index, const int *map) {
+    for (size_t i = 0; index->lists && i <= index->mask; i++) {
+        struct PostingList *list = &index->lists[i];
+        int kept = 0;
+        for (int j = 0; j < list->count; j++) {
+            int row = map[list->rows[j]];
+            if (row >= 0) {
+                list->rows[kept++] = row;
+            }
+        }
+        list->count = kept;
+    }
+}
+
+/**
+ * @brief Bounds the number of rows whose string contains a pattern, without touching them.
+ *
+ * Every match appears in the posting list of each of the pattern's trigrams, so the shortest
+ * of those lists is an upper bound; removed cars still in the lists are counted too.
+ *
+ * @param index Trigram index over the column.
+ * @param pattern Pattern of at least TRIGRAM_LENGTH characters.
+ * @return Length of the shortest posting list among the pattern's trigrams (0 if one is missing).
+ */
+int estimateSubstrings(const struct TrigramIndex *index, const char *pattern) {
+    unsigned int keys[MAX_TRIGRAMS];
+    int count = distinctTrigrams(pattern, strlen(pattern), keys);
+    int shortest = -1;
+    for (int k = 0; k < count; k++) {
+        const struct PostingList *list = findList(index, keys[k]);
+        if (!list || list->count == 0) {
+            return 0;
+        }
+        if (shortest < 0 || list->count < shortest) {
+            shortest = list->count;
+        }
+    }
+    return shortest < 0 ? 0 : shortest;
+}
+
+/**
+ * @brief Finds the rows whose string contains a pattern.
+ *
+ * Candidates are the intersection of the posting lists of the pattern's trigrams, starting
+ * from the shortest list; each is confirmed with strstr(), so the result equals a full
+ * strstr() scan. Dead rows are skipped.
+ *
+ * @param set Car set owning the column.
+ * @param index Trigram index over the column.
+ * @param column String column to search.
+ * @param pattern Pattern of at least TRIGRAM_LENGTH characters.
+ * @param rows Receives a malloc'd array of matching rows in ascending order (NULL when empty).
+ * @return Number of matching rows.
+ */
+int findSubstrings(const struct Cars *set, const struct TrigramIndex *index, const struct CarString *column,
+                   const char *pattern, int **rows) {
+    unsigned int keys[MAX_TRIGRAMS];
+    const struct PostingList *lists[MAX_TRIGRAMS];
+    int count = distinctTrigrams(pattern, strlen(pattern), keys);
+    *rows = NULL;
+
+    for (int k = 0; k < count; k++) {
+        const struct PostingList *list = findList(index, keys[k]);
+        if (!list || list->count == 0) {
+            return 0;
+        }
+
+        // Keep the lists ordered by length so the intersection starts from the rarest trigram.
+        int j = k;
+        while (j > 0 && lists[j - 1]->count > list->count) {
+            lists[j] = lists[j - 1];
+            j--;
+        }
+        lists[j] = list;
+    }
+    if (count == 0) {
+        return 0;
+    }
+
+    int found = lists[0]->count;
+    int *candidates = (int *)malloc((size_t)found * sizeof *candidates);
+    if (!candidates) {
+        fprintf(stderr, "Memory allocation error.\n");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(candidates, lists[0]->rows, (size_t)found * sizeof *candidates);
+
+    for (int k = 1; k < count && found > 0; k++) {
+        int kept = 0, position = 0;
+        for (int i = 0; i < found; i++) {
+            position = gallop(lists[k]->rows, lists[k]->count, position, candidates[i]);
+            if (position == lists[k]->count) {
+                break;
+            }
+            if (lists[k]->rows[position] == candidates[i]) {
+                candidates[kept++] = candidates[i];
+            }
+        }
+        found = kept;
+    }
+
+    int matched = 0;
+    for (int i = 0; i < found; i++) {
+        if (!isDeadRow(set, candidates[i]) && strstr(carString(set, column[candidates[i]]), pattern) != NULL) {
+            candidates[matched++] = candidates[i];
+        }
+    }
+
+    if (matched == 0) {
+        free(candidates);
+        return 0;
+    }
+    *rows = candidates;
+    return matched;
+}
+
+/**
+ * @brief Installs a posting list whose rows live in a snapshot mapping.
+ *
+ * The rows are used in place until the list first grows, when they are copied out.
+ *
+ * @param index Index to extend.
+ * @param trigram Packed trigram key, as stored in PostingList::trigram.
+ * @param rows Ascending rows containing the trigram.
+ * @param count Number of rows.
+ */
+void attachPostingList(struct TrigramIndex *index, unsigned int trigram, int *rows, int count) {
+    struct PostingList *list = obtainList(index, trigram);
+    if (!list->mapped) {
+        free(list->rows);
+    }
+    list->rows = rows;
+    list->count = count;
+    list->allocated = count;
+    list->mapped = 1;
+}
+
+/**
+ * @brief Releases the memory of a trigram index.
+ * @param index Index to release.
+ */
+void freeTrigramIndex(struct TrigramIndex *index) {
+    for (size_t i = 0; index->lists && i <= index->mask; i++) {
+        if (!index->lists[i].mapped) {
+            free(index->lists[i].rows);
+        }
+    }
+    free(index->lists);
+    index->lists = NULL;
+    index->mask = 0;
+    index->used = 0;
+}
@@ -0,0 +1,97 @@
+/**
+ * @file car_trigram.h
+ * @brief Trigram inverted indexes for substring search on string columns.
+ */
+
+#ifndef CAR_TRIGRAM_H
+#define CAR_TRIGRAM_H
+
+#include <stddef.h>
+
+struct Cars;
+struct CarString;
+
+/** Shortest pattern the trigram index can answer; shorter ones need a scan. */
+#define TRIGRAM_LENGTH 3
+
+/**
+ * @struct PostingList
+ * @brief Ascending list of the rows whose string contains one trigram.
+ */
+struct PostingList {
+    unsigned int trigram;  ///< The three bytes packed into 24 bits, plus one (0 marks a free slot).
+    int count;             ///< Number of rows in the list.
+    int allocated;         ///< Number of rows the list has room for.
+    int mapped;            ///< Non-zero while @c rows points into a snapshot mapping.
+    int *rows;             ///< Rows in ascending order.
+};
+
+/**
+ * @struct TrigramIndex
+ * @brief Open-addressing table of posting lists, keyed by trigram.
+ */
+struct TrigramIndex {
+    struct PostingList *lists;  ///< Table of posting lists (NULL until the first insert).
+    size_t mask;                ///< Number of table slots minus one; a power of two.
+    size_t used;                ///< Number of distinct trigrams.
+};
+
+/**
+ * @brief Adds a row to the posting lists of every distinct trigram of its string.
+ * @param index Index to update.
+ * @param text String of the row.
+ * @param length Length of the string.
+ * @param row Row of the car; must be greater than every row already indexed.
+ */
+void insertTrigrams(struct TrigramIndex *index, const char *text, size_t length, int row);
+
+/**
+ * @brief Drops dead rows from every posting list and renumbers the others after a purge.
+ * @param index Index to update.
+ * @param map New row of every old row, or -1 for dead rows.
+ */
+void remapTrigramIndex(struct TrigramIndex *index, const int *map);
+
+/**
+ * @brief Finds the rows whose string contains a pattern.
+ *
+ * Candidates are the intersection of the posting lists of the pattern's trigrams; each is
+ * confirmed with strstr(), so the result equals a full strstr() scan. Dead rows are skipped.
+ *
+ * @param set Car set owning the column.
+ * @param index Trigram index over the column.
+ * @param column String column to search.
+ * @param pattern Pattern of at least TRIGRAM_LENGTH characters.
+ * @param rows Receives a malloc'd array of matching rows in ascending order (NULL when empty).
+ * @return Number of matching rows.
+ */
+int findSubstrings(const struct Cars *set, const struct TrigramIndex *index, const struct CarString *column,
+                   const char *pattern, int **rows);
+
+/**
+ * @brief Bounds the number of rows whose string contains a pattern, without touching them.
+ * @param index Trigram index over the column.
+ * @param pattern Pattern of at least TRIGRAM_LENGTH characters.
+ * @return Length of the shortest posting list among the pattern's trigrams (0 if one is missing).
+ */
+int estimateSubstrings(const struct TrigramIndex *index, const char *pattern);
+
+/**
+ * @brief Installs a posting list whose rows live in a snapshot mapping.
+ *
+ * The rows are used in place until the list first grows, when they are copied out.
+ *
+ * @param index Index to extend.
+ * @param trigram Packed trigram key, as stored in PostingList::trigram.
+ * @param rows Ascending rows containing the trigram.
+ * @param count Number of rows.
+ */
+void attachPostingList(struct TrigramIndex *index, unsigned int trigram, int *rows, int count);
+
+/**
+ * @brief Releases the memory of a trigram index.
+ * @param index Index to release.
+ */
+void freeTrigramIndex(struct TrigramIndex *index);
+
+#endif // CAR_TRIGRAM_H
@@ -4,8 +4,14 @@
  */
 
 #include "car_database.h"
+#include "car_order.h"
+#include "car_output.h"
+#include "car_parallel.h"
+#include "car_stats.h"
 #include "menu.h"
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 
 /**
@@ -14,16 +20,132 @@
  * This program allows users to manage a database of cars, including adding cars,
  * displaying the cars, saving to a file, searching, removing cars, and exiting the program.
  *
+ * Command-line options:
+ * - `--threads N`: number of threads used by full-fleet searches and by loading base.txt
+ *   (default: one per processor).
+ * - `--import FILE`: imports cars from a CSV, TSV or base.txt-format file, saves and exits
+ *   without showing the menu.
+ * - `--format csv|tsv|text`: format of the import file (default: taken from its extension).
+ * - `--offset N`, `--limit N`: skip the first N cars of every listing, or show at most N.
+ * - `--compact`: list one car per line.
+ * - `--order FIELD[:asc|:desc]`: sort the car list and search results on a field, e.g.
+ *   `year:desc`; with `--limit` only the shown cars are selected, not the whole list sorted.
+ * - `--serve SOCKET`: serve queries, additions and removals to many clients at once over a
+ *   Unix domain socket instead of showing the menu; the changes are saved when the server stops.
+ * - `--paged MB`: open base.txt without loading it, for files larger than the memory: only
+ *   an index of where its pages begin is built, cars are read through a page cache when
+ *   listed or removed, searches stream over the file, and the program stays within MB
+ *   megabytes. Cannot be combined with `--import` or `--serve`.
+ * - `--partition year[:N]|brand|none`: store the cars in base.parts/, one file per range of
+ *   N years (default 5) or per brand, with a manifest of statistics that lets searches skip
+ *   partitions they cannot match; `none` merges them back into base.txt. A partitioned
+ *   database is opened that way without the option. Cannot be combined with `--paged`.
+ * - `--stats`: collect runtime statistics, shown by menu option 8.
+ * - `--stats-json FILE`: collect runtime statistics and write them to FILE as JSON on exit.
+ *
+ * @param argc Number of command-line arguments.
+ * @param argv Command-line arguments.
  * @return 0 on successful execution.
  */
-int main() {
+int main(int argc, char *argv[]) {
     struct Cars *carSet = NULL; ///< Pointer to the car database.
     int count = 0;              ///< Initial number of cars, to be increased by reference.
     char choice;                ///< User's choice for the main menu.
+    const char *importPath = NULL;    ///< File to import, if any.
+    const char *importFormat = NULL;  ///< Format of the import file, if given.
+    long offset = 0, limit = 0;       ///< Pagination of the listings.
+    int compact = 0;                  ///< Non-zero for one line per car in the listings.
+    struct CarOrder order = {0};      ///< Order of the listings (car-number order while inactive).
+    const char *statsPath = NULL;     ///< File the statistics are written to on exit, if any.
+    const char *socketPath = NULL;    ///< Socket to serve the database on, if any.
+    long pagedMegabytes = 0;          ///< Memory limit of paged mode, or 0 to load the whole file.
+    const char *partitioning = NULL;  ///< Requested partitioned layout, if any.
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            setScanThreads(atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--import") == 0 && i + 1 < argc) {
+            importPath = argv[++i];
+        } else if (strcmp(argv[i], "--format") == 0 && i + 1 < argc) {
+            importFormat = argv[++i];
+        } else if (strcmp(argv[i], "--offset") == 0 && i + 1 < argc) {
+            offset = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--limit") == 0 && i + 1 < argc) {
+            limit = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--compact") == 0) {
+            compact = 1;
+        } else if (strcmp(argv[i], "--order") == 0 && i + 1 < argc) {
+            if (parseOrder(argv[++i], &order) != 0) {
+                printf("Unknown order: %s\n", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--serve") == 0 && i + 1 < argc) {
+            socketPath = argv[++i];
+        } else if (strcmp(argv[i], "--paged") == 0 && i + 1 < argc) {
+            pagedMegabytes = atol(argv[++i]);
+            if (pagedMegabytes <= 0) {
+                printf("Invalid memory limit: %s\n", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--partition") == 0 && i + 1 < argc) {
+            enum PartitionScheme scheme;
+            int yearSpan;
+            partitioning = argv[++i];
+            if (parsePartitionScheme(partitioning, &scheme, &yearSpan) != 0) {
+                printf("Unknown partitioning: %s\n", partitioning);
+                return 1;
+            }
+            setPartitioning(scheme, yearSpan);
+        } else if (strcmp(argv[i], "--stats") == 0) {
+            setStatsEnabled(1);
+        } else if (strcmp(argv[i], "--stats-json") == 0 && i + 1 < argc) {
+            statsPath = argv[++i];
+            setStatsEnabled(1);
+        } else {
+            printf("Unknown option: %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    if (pagedMegabytes > 0 && (importPath || socketPath)) {
+        printf("--paged cannot be combined with --import or --serve.\n");
+        return 1;
+    }
+    if (pagedMegabytes > 0 && partitioning) {
+        printf("--paged cannot be combined with --partition.\n");
+        return 1;
+    }
+
+    setOutputOptions(offset, limit, compact);
+    setListingOrder(&order);
+    setPagedMode((size_t)pagedMegabytes * 1000000);
 
     // Read existing cars from a file
     readCars(&carSet, &count);
 
+    // Non-interactive bulk import: import, save and exit
+    if (importPath) {
+        int status = importFile(&carSet, &count, importPath, importFormat) == 0 ? 0 : 1;
+        if (status == 0) {
+            saveCars(carSet, count);
+        }
+        if (statsPath && writeStatsJson(statsPath) != 0) {
+            printf("Unable to write the statistics to %s.\n", statsPath);
+        }
+        freeCarArray(carSet);
+        return status;
+    }
+
+    // Daemon mode: serve clients until stopped, save and exit
+    if (socketPath) {
+        int status = serveDatabase(&carSet, &count, socketPath) == 0 ? 0 : 1;
+        if (statsPath && writeStatsJson(statsPath) != 0) {
+            printf("Unable to write the statistics to %s.\n", statsPath);
+        }
+        freeCarArray(carSet);
+        return status;
+    }
+
     // Main program loop
     do {
         displayMenu();          // Display the main menu
@@ -33,6 +155,10 @@ int main() {
 
     printf("Thank you for using my program!\n");
 
+    if (statsPath && writeStatsJson(statsPath) != 0) {
+        printf("Unable to write the statistics to %s.\n", statsPath);
+    }
+
     // Free allocated memory
     freeCarArray(carSet);
 
@@ -7,6 +7,7 @@
 
 #include "menu.h"
 #include "car_database.h"
+#include "car_stats.h"
 #include <stdio.h>
 
 /**
@@ -22,6 +23,9 @@ void displayMenu() {
     printf("4-Search\n");
     printf("5-Remove a car\n");
     printf("6-Exit\n");
+    printf("7-Compact the database file\n");
+    printf("8-Show runtime statistics\n");
+    printf("9-Show fleet summary\n");
 }
 
 /**
@@ -58,6 +62,7 @@ void executeChoice(struct Cars **carSet, int *count, char choice) {
         printf("6-Type\n");
         printf("7-Registration Number\n");
         printf("8-Back to the main menu\n");
+        printf("9-Several criteria\n");
         char searchOption;
         scanf(" %c", &searchOption);
         if (searchOption == '8') {
@@ -72,6 +77,20 @@ void executeChoice(struct Cars **carSet, int *count, char choice) {
         break;
     case '6':
         break;
+    case '7':
+        printf("\nCompact the database file!\n");
+        compactDatabase(*carSet, *count);
+        printf("\nCompacted!\n\n");
+        break;
+    case '8':
+        printf("\nRuntime statistics:\n");
+        printStats();
+        printf("\n");
+        break;
+    case '9':
+        printf("\nFleet summary:\n");
+        showSummary(*carSet, *count);
+        break;
     default:
         printf("Invalid menu option. Try again.\n");
         break;
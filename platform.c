@@ -0,0 +1,360 @@
+/**
+ * @file platform.c
+ * @brief Implementation of the portability layer.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "platform.h"
+#include <errno.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#include <io.h>
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+/**
+ * @brief Maps a whole file into memory.
+ *
+ * An empty file is mapped successfully with a NULL data pointer and a size of zero,
+ * because neither mmap nor MapViewOfFile accept zero-length views.
+ *
+ * @param path Path of the file to map.
+ * @param file Receives the mapping.
+ * @param copyOnWrite Non-zero for a writable private view, zero for a read-only sequential one.
+ * @return 0 on success, -1 if the file cannot be opened or mapped.
+ */
+static int mapWholeFile(const char *path, struct MappedFile *file, int copyOnWrite) {
+    file->data = NULL;
+    file->size = 0;
+    file->handle = NULL;
+
+#ifdef _WIN32
+    HANDLE fh = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                            FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (fh == INVALID_HANDLE_VALUE) {
+        return -1;
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(fh, &size)) {
+        CloseHandle(fh);
+        return -1;
+    }
+    if (size.QuadPart == 0) {
+        CloseHandle(fh);
+        return 0;
+    }
+
+    HANDLE mapping = CreateFileMappingA(fh, NULL, copyOnWrite ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(fh);
+    if (!mapping) {
+        return -1;
+    }
+
+    void *view = MapViewOfFile(mapping, copyOnWrite ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0);
+    if (!view) {
+        CloseHandle(mapping);
+        return -1;
+    }
+
+    file->data = (const char *)view;
+    file->size = (size_t)size.QuadPart;
+    file->handle = mapping;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return -1;
+    }
+    if (st.st_size == 0) {
+        close(fd);
+        return 0;
+    }
+
+    void *view = mmap(NULL, (size_t)st.st_size, copyOnWrite ? PROT_READ | PROT_WRITE : PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (view == MAP_FAILED) {
+        return -1;
+    }
+    if (!copyOnWrite) {
+        posix_madvise(view, (size_t)st.st_size, POSIX_MADV_SEQUENTIAL);
+    }
+
+    file->data = (const char *)view;
+    file->size = (size_t)st.st_size;
+#endif
+
+    return 0;
+}
+
+/**
+ * @brief Maps a whole file into memory for reading.
+ *
+ * An empty file is mapped successfully with a NULL data pointer and a size of zero.
+ * The kernel is told the file will be read sequentially.
+ *
+ * @param path Path of the file to map.
+ * @param file Receives the mapping.
+ * @return 0 on success, -1 if the file cannot be opened or mapped.
+ */
+int mapFile(const char *path, struct MappedFile *file) {
+    return mapWholeFile(path, file, 0);
+}
+
+/**
+ * @brief Maps a whole file as a private, writable copy-on-write view.
+ *
+ * Writes through the view change only this process's copy of the touched pages, never
+ * the file.
+ *
+ * @param path Path of the file to map.
+ * @param file Receives the mapping; cast @c data to a non-const pointer to write.
+ * @return 0 on success, -1 if the file cannot be opened or mapped.
+ */
+int mapFileCopy(const char *path, struct MappedFile *file) {
+    return mapWholeFile(path, file, 1);
+}
+
+/**
+ * @brief Releases a mapping created by mapFile() or mapFileCopy().
+ * @param file Mapping to release.
+ */
+void unmapFile(struct MappedFile *file) {
+    if (file->data) {
+#ifdef _WIN32
+        UnmapViewOfFile(file->data);
+        CloseHandle((HANDLE)file->handle);
+#else
+        munmap((void *)file->data, file->size);
+#endif
+    }
+
+    file->data = NULL;
+    file->size = 0;
+    file->handle = NULL;
+}
+
+/**
+ * @brief Returns the size and modification time of a file.
+ *
+ * The time keeps the full resolution the file system records (100 ns on NTFS, usually
+ * 1 ns on Linux), so a file rewritten within the same second still gets a new stamp.
+ *
+ * @param path File to inspect.
+ * @param size Receives the size in bytes.
+ * @param time Receives the modification time in nanoseconds since the epoch.
+ * @return 0 on success, -1 if the file does not exist.
+ */
+int fileStamp(const char *path, uint64_t *size, int64_t *time) {
+#ifdef _WIN32
+    WIN32_FILE_ATTRIBUTE_DATA info;
+    if (!GetFileAttributesExA(path, GetFileExInfoStandard, &info)) {
+        return -1;
+    }
+    *size = (uint64_t)info.nFileSizeHigh << 32 | info.nFileSizeLow;
+    // FILETIME counts 100 ns ticks since 1601, 11644473600 seconds before the Unix epoch.
+    uint64_t ticks = (uint64_t)info.ftLastWriteTime.dwHighDateTime << 32 | info.ftLastWriteTime.dwLowDateTime;
+    *time = ((int64_t)ticks - 116444736000000000LL) * 100;
+#else
+    struct stat info;
+    if (stat(path, &info) != 0) {
+        return -1;
+    }
+    *size = (uint64_t)info.st_size;
+#ifdef __APPLE__
+    *time = (int64_t)info.st_mtime * 1000000000 + info.st_mtimensec;
+#else
+    *time = (int64_t)info.st_mtim.tv_sec * 1000000000 + info.st_mtim.tv_nsec;
+#endif
+#endif
+    return 0;
+}
+
+/**
+ * @brief Replaces a file with another one, in one step where the system allows it.
+ *
+ * rename() does not replace an existing file on Windows, so MoveFileExA() is used there.
+ *
+ * @param from File to move.
+ * @param to File to replace; it need not exist.
+ * @return 0 on success, -1 if the file cannot be moved.
+ */
+int replaceFile(const char *from, const char *to) {
+#ifdef _WIN32
+    return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING) ? 0 : -1;
+#else
+    return rename(from, to) == 0 ? 0 : -1;
+#endif
+}
+
+/**
+ * @brief Creates a directory unless it exists already.
+ * @param path Directory to create.
+ * @return 0 on success or if the directory exists, -1 otherwise.
+ */
+int makeDirectory(const char *path) {
+#ifdef _WIN32
+    int made = _mkdir(path);
+#else
+    int made = mkdir(path, 0777);
+#endif
+    struct stat info;
+    return made == 0 || (errno == EEXIST && stat(path, &info) == 0 && S_ISDIR(info.st_mode)) ? 0 : -1;
+}
+
+/**
+ * @brief Removes an empty directory.
+ * @param path Directory to remove.
+ * @return 0 on success, -1 if it does not exist or is not empty.
+ */
+int removeDirectory(const char *path) {
+#ifdef _WIN32
+    return _rmdir(path) == 0 ? 0 : -1;
+#else
+    return rmdir(path) == 0 ? 0 : -1;
+#endif
+}
+
+/**
+ * @brief Flushes a stream and forces its data to stable storage.
+ * @param file Stream to synchronize.
+ * @return 0 on success, -1 on an I/O error.
+ */
+int syncFile(FILE *file) {
+    if (fflush(file) != 0) {
+        return -1;
+    }
+#ifdef _WIN32
+    return _commit(_fileno(file)) == 0 ? 0 : -1;
+#else
+    return fsync(fileno(file)) == 0 ? 0 : -1;
+#endif
+}
+
+/**
+ * @brief Writes bytes straight to the file descriptor behind a stream.
+ * @param file Stream whose descriptor is written to.
+ * @param data Bytes to write.
+ * @param size Number of bytes.
+ * @return 0 on success, -1 on an I/O error.
+ */
+int writeStream(FILE *file, const void *data, size_t size) {
+    if (fflush(file) != 0) {
+        return -1;
+    }
+
+    const char *next = (const char *)data;
+    while (size > 0) {
+#ifdef _WIN32
+        int written = _write(_fileno(file), next, size > 0x40000000 ? 0x40000000u : (unsigned)size);
+#else
+        ssize_t written = write(fileno(file), next, size);
+#endif
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        next += written;
+        size -= (size_t)written;
+    }
+    return 0;
+}
+
+/**
+ * @brief Moves a stream to a byte offset, which may lie beyond 2 GB.
+ * @param file Stream to move.
+ * @param offset Offset from the start of the file.
+ * @return 0 on success, -1 on an I/O error.
+ */
+int seekFile(FILE *file, uint64_t offset) {
+#ifdef _WIN32
+    return _fseeki64(file, (__int64)offset, SEEK_SET) == 0 ? 0 : -1;
+#else
+    return fseeko(file, (off_t)offset, SEEK_SET) == 0 ? 0 : -1;
+#endif
+}
+
+/**
+ * @brief Tells the operating system that a file will be read from start to end, so it reads ahead.
+ *
+ * On Linux this doubles the readahead window of the file. Windows takes the hint when a
+ * file is opened (see mapWholeFile()), which stdio does not offer, and macOS has no
+ * equivalent, so there it does nothing.
+ *
+ * @param file Stream about to be read sequentially.
+ */
+void adviseSequential(FILE *file) {
+#if !defined(_WIN32) && defined(POSIX_FADV_SEQUENTIAL)
+    posix_fadvise(fileno(file), 0, 0, POSIX_FADV_SEQUENTIAL);
+#else
+    (void)file;
+#endif
+}
+
+/**
+ * @brief Returns the largest resident set size of the process so far.
+ * @return Peak resident memory in bytes, or 0 where it cannot be measured.
+ */
+size_t peakResidentBytes(void) {
+#ifdef _WIN32
+    return 0;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+#ifdef __APPLE__
+    return (size_t)usage.ru_maxrss;  // Bytes on macOS.
+#else
+    return (size_t)usage.ru_maxrss * 1024;  // Kilobytes on Linux.
+#endif
+#endif
+}
+
+/**
+ * @brief Returns a monotonic timestamp in seconds.
+ * @return Seconds since an unspecified starting point.
+ */
+double monotonicSeconds(void) {
+#ifdef _WIN32
+    LARGE_INTEGER frequency, counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (double)counter.QuadPart / (double)frequency.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+#endif
+}
+
+/**
+ * @brief Returns the number of processors available to the program.
+ * @return Number of online processors, at least 1.
+ */
+int processorCount(void) {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors > 0 ? (int)info.dwNumberOfProcessors : 1;
+#else
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (int)count : 1;
+#endif
+}
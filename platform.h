@@ -0,0 +1,134 @@
+/**
+ * @file platform.h
+ * @brief Thin portability layer for memory-mapped files, file metadata and directories, timing and processor count.
+ *
+ * The rest of the program only talks to these helpers, so the POSIX and
+ * Windows specifics stay in one place.
+ */
+
+#ifndef PLATFORM_H
+#define PLATFORM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * @struct MappedFile
+ * @brief Read-only view of a whole file mapped into memory.
+ */
+struct MappedFile {
+    const char *data;  ///< First byte of the file (NULL when the file is empty).
+    size_t size;       ///< Size of the file in bytes.
+    void *handle;      ///< Platform-specific mapping handle.
+};
+
+/**
+ * @brief Maps a whole file into memory for reading.
+ * @param path Path of the file to map.
+ * @param file Receives the mapping.
+ * @return 0 on success, -1 if the file cannot be opened or mapped.
+ */
+int mapFile(const char *path, struct MappedFile *file);
+
+/**
+ * @brief Maps a whole file as a private, writable copy-on-write view.
+ * @param path Path of the file to map.
+ * @param file Receives the mapping; cast @c data to a non-const pointer to write.
+ * @return 0 on success, -1 if the file cannot be opened or mapped.
+ */
+int mapFileCopy(const char *path, struct MappedFile *file);
+
+/**
+ * @brief Releases a mapping created by mapFile() or mapFileCopy().
+ * @param file Mapping to release.
+ */
+void unmapFile(struct MappedFile *file);
+
+/**
+ * @brief Returns the size and modification time of a file.
+ * @param path File to inspect.
+ * @param size Receives the size in bytes.
+ * @param time Receives the modification time in nanoseconds since the epoch.
+ * @return 0 on success, -1 if the file does not exist.
+ */
+int fileStamp(const char *path, uint64_t *size, int64_t *time);
+
+/**
+ * @brief Replaces a file with another one, in one step where the system allows it.
+ * @param from File to move.
+ * @param to File to replace; it need not exist.
+ * @return 0 on success, -1 if the file cannot be moved.
+ */
+int replaceFile(const char *from, const char *to);
+
+/**
+ * @brief Creates a directory unless it exists already.
+ * @param path Directory to create.
+ * @return 0 on success or if the directory exists, -1 otherwise.
+ */
+int makeDirectory(const char *path);
+
+/**
+ * @brief Removes an empty directory.
+ * @param path Directory to remove.
+ * @return 0 on success, -1 if it does not exist or is not empty.
+ */
+int removeDirectory(const char *path);
+
+/**
+ * @brief Flushes a stream and forces its data to stable storage.
+ * @param file Stream to synchronize.
+ * @return 0 on success, -1 on an I/O error.
+ */
+int syncFile(FILE *file);
+
+/**
+ * @brief Writes bytes straight to the file descriptor behind a stream.
+ *
+ * The stream is flushed first, so the bytes follow anything already printed to it. Short
+ * writes and interrupted calls are retried until everything is written.
+ *
+ * @param file Stream whose descriptor is written to.
+ * @param data Bytes to write.
+ * @param size Number of bytes.
+ * @return 0 on success, -1 on an I/O error.
+ */
+int writeStream(FILE *file, const void *data, size_t size);
+
+/**
+ * @brief Moves a stream to a byte offset, which may lie beyond 2 GB.
+ * @param file Stream to move.
+ * @param offset Offset from the start of the file.
+ * @return 0 on success, -1 on an I/O error.
+ */
+int seekFile(FILE *file, uint64_t offset);
+
+/**
+ * @brief Tells the operating system that a file will be read from start to end, so it reads ahead.
+ *
+ * Only a hint; it does nothing where it is not supported.
+ *
+ * @param file Stream about to be read sequentially.
+ */
+void adviseSequential(FILE *file);
+
+/**
+ * @brief Returns the largest resident set size of the process so far.
+ * @return Peak resident memory in bytes, or 0 where it cannot be measured.
+ */
+size_t peakResidentBytes(void);
+
+/**
+ * @brief Returns a monotonic timestamp in seconds.
+ * @return Seconds since an unspecified starting point.
+ */
+double monotonicSeconds(void);
+
+/**
+ * @brief Returns the number of processors available to the program.
+ * @return Number of online processors, at least 1.
+ */
+int processorCount(void);
+
+#endif // PLATFORM_H
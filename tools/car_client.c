@@ -0,0 +1,87 @@
+/**
+ * @file car_client.c
+ * @brief Command-line client for a car database started with --serve.
+ *
+ * Usage:
+ *
+ *     car_client SOCKET REQUEST...
+ *     car_client SOCKET < requests.txt
+ *
+ * With a request on the command line (its words are joined with spaces), the client sends
+ * it, prints the reply and exits with status 1 if the reply is an error. Otherwise every
+ * line of the standard input is sent as a request in turn and every reply is printed.
+ *
+ *     car_client /tmp/cars.sock COUNT fuel = Diesel and year >= 2015
+ *     car_client /tmp/cars.sock ADD Skoda Octavia 2019 1500 Petrol Combi WX12345
+ *
+ * Build from the repository root:
+ *
+ *     gcc -O2 -I. tools/car_client.c car_server.c car_query.c car_order.c car_journal.c car_parallel.c car_scan.c car_store.c car_hash.c car_range.c car_trigram.c car_bitmap.c car_aggregate.c car_fuzzy.c car_prefix.c platform.c -o car_client -lpthread
+ */
+
+#include "car_server.h"
+#include <stdio.h>
+#include <string.h>
+
+/**
+ * @brief Sends one request and prints its reply.
+ * @param connection Connection to the server.
+ * @param request The request.
+ * @return 0 for an OK reply, 1 for an error reply, -1 if the connection failed.
+ */
+static int runRequest(struct ServerConnection *connection, const char *request) {
+    char line[SERVER_LINE_BYTES];
+    if (sendRequest(connection, request) != 0) {
+        return -1;
+    }
+    while (readLine(connection, line, sizeof line) >= 0) {
+        puts(line);
+        if (isStatusLine(line)) {
+            return strncmp(line, "OK", 2) == 0 ? 0 : 1;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Entry point: SOCKET [REQUEST...].
+ * @param argc Argument count.
+ * @param argv Socket path and the words of a request.
+ * @return 0 on success, 1 on an error reply or a connection failure.
+ */
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s SOCKET [REQUEST...]\n", argv[0]);
+        return 1;
+    }
+
+    struct ServerConnection connection;
+    if (connectServer(&connection, argv[1]) != 0) {
+        fprintf(stderr, "Unable to connect to %s.\n", argv[1]);
+        return 1;
+    }
+
+    char request[SERVER_LINE_BYTES];
+    int status = 0;
+    if (argc > 2) {
+        size_t used = 0;
+        request[0] = '\0';
+        for (int i = 2; i < argc && used < sizeof request; i++) {
+            used += (size_t)snprintf(request + used, sizeof request - used, i > 2 ? " %s" : "%s", argv[i]);
+        }
+        status = runRequest(&connection, request);
+    } else {
+        while (status >= 0 && fgets(request, sizeof request, stdin)) {
+            request[strcspn(request, "\r\n")] = '\0';
+            if (request[0] != '\0') {
+                status = runRequest(&connection, request);
+            }
+        }
+    }
+
+    if (status < 0) {
+        fprintf(stderr, "Connection to %s lost.\n", argv[1]);
+    }
+    closeServer(&connection);
+    return status == 0 ? 0 : 1;
+}
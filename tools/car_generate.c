@@ -0,0 +1,398 @@
+/**
+ * @file car_generate.c
+ * @brief Generates synthetic car fleets in the base.txt format.
+ *
+ * Usage:
+ *
+ *     car_generate [--cars N] [--seed S] [--output FILE] [--years MIN-MAX]
+ *                  [--brands LIST] [--fuels LIST] [--types LIST] [--plates LIST]
+ *
+ * A LIST is a comma-separated list of NAME:WEIGHT pairs, for example
+ * `--fuels Petrol:50,Diesel:30,Electric:20`; each value is drawn with a probability
+ * proportional to its weight. Brands known to the built-in catalog get their usual models,
+ * other brands get numbered ones. Production years lean towards the newer end of the range,
+ * and engine capacities depend on the fuel (electric cars have none).
+ *
+ * Plate formats are patterns in which `L` stands for a letter, `D` for a digit, and any other
+ * character for itself, for example `--plates LLDDDDD:70,WALLDDD:30`. Every plate in a
+ * fleet is unique as long as no two formats can produce the same text; each format walks
+ * its whole space in a scrambled order before repeating, so the generator fails if a
+ * format runs out of plates.
+ *
+ * The same size and seed always produce the same file. Without --output the fleet is
+ * written to standard output.
+ *
+ * Build from the repository root:
+ *
+ *     gcc -O2 -I. tools/car_generate.c -o car_generate
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** Largest number of values in one weighted list. */
+#define MAX_CHOICES 64
+
+/** Largest number of models per catalog brand. */
+#define MAX_MODELS 6
+
+/** Largest number of plates a single format may describe. */
+#define MAX_PLATE_SPACE (UINT64_C(1) << 62)
+
+/**
+ * @struct Choice
+ * @brief One value of a weighted list.
+ */
+struct Choice {
+    char name[100];       ///< The value.
+    unsigned weight;      ///< Relative probability of drawing it.
+    uint64_t space;       ///< Plate formats: number of distinct plates the pattern describes.
+    uint64_t multiplier;  ///< Plate formats: step of the walk through the space, coprime to it.
+    uint64_t start;       ///< Plate formats: where the walk starts.
+    uint64_t used;        ///< Plate formats: plates handed out so far.
+};
+
+/**
+ * @struct ChoiceList
+ * @brief Weighted list of values.
+ */
+struct ChoiceList {
+    struct Choice items[MAX_CHOICES];  ///< The values.
+    int count;                         ///< Number of values.
+    uint64_t totalWeight;              ///< Sum of the weights.
+};
+
+/**
+ * @struct CatalogBrand
+ * @brief A brand with its usual models.
+ */
+struct CatalogBrand {
+    const char *brand;               ///< Brand name.
+    unsigned weight;                 ///< Default share of the fleet.
+    const char *models[MAX_MODELS];  ///< Models, NULL-terminated when fewer than MAX_MODELS.
+};
+
+/** Brands and models used unless --brands says otherwise. */
+static const struct CatalogBrand catalog[] = {
+    {"Toyota", 14, {"Corolla", "Yaris", "RAV4", "Camry", "Auris", "CHR"}},
+    {"Volkswagen", 14, {"Golf", "Passat", "Polo", "Tiguan", "Touran", NULL}},
+    {"Skoda", 12, {"Octavia", "Fabia", "Superb", "Kodiaq", "Karoq", NULL}},
+    {"Ford", 9, {"Focus", "Fiesta", "Mondeo", "Kuga", NULL}},
+    {"Opel", 8, {"Astra", "Corsa", "Insignia", "Zafira", NULL}},
+    {"BMW", 6, {"X1", "X3", "X5", "M3", NULL}},
+    {"Audi", 6, {"A3", "A4", "A6", "Q5", NULL}},
+    {"Renault", 6, {"Clio", "Megane", "Captur", NULL}},
+    {"Hyundai", 5, {"i20", "i30", "Tucson", NULL}},
+    {"Kia", 5, {"Rio", "Ceed", "Sportage", NULL}},
+    {"Mercedes", 5, {"A180", "C200", "E220", "GLC", NULL}},
+    {"Peugeot", 5, {"208", "308", "3008", NULL}},
+    {"Fiat", 3, {"Panda", "Punto", "Tipo", NULL}},
+};
+
+/** Default fuel mix. */
+static const char *const defaultFuels = "Petrol:50,Diesel:30,Hybrid:10,LPG:6,Electric:4";
+
+/** Default body types. */
+static const char *const defaultTypes = "Sedan:30,Hatchback:30,SUV:20,StationWagon:15,Van:5";
+
+/** Default plate formats. */
+static const char *const defaultPlates = "LLDDDDD:60,LLLDDDD:30,LDDDDLL:10";
+
+/** State of the random number generator. */
+static uint64_t randomState;
+
+/**
+ * @brief Returns the next pseudo-random number (splitmix64).
+ * @return 64 random bits.
+ */
+static uint64_t nextRandom(void) {
+    uint64_t z = (randomState += UINT64_C(0x9E3779B97F4A7C15));
+    z = (z ^ (z >> 30)) * UINT64_C(0xBF58476D1CE4E5B9);
+    z = (z ^ (z >> 27)) * UINT64_C(0x94D049BB133111EB);
+    return z ^ (z >> 31);
+}
+
+/**
+ * @brief Returns a pseudo-random number below a bound.
+ * @param bound Exclusive upper bound, greater than zero.
+ * @return Number in [0, bound).
+ */
+static uint64_t randomBelow(uint64_t bound) {
+    return (uint64_t)(((unsigned __int128)nextRandom() * bound) >> 64);
+}
+
+/**
+ * @brief Returns the greatest common divisor of two numbers.
+ * @param a First number.
+ * @param b Second number.
+ * @return gcd(a, b).
+ */
+static uint64_t greatestCommonDivisor(uint64_t a, uint64_t b) {
+    while (b != 0) {
+        uint64_t r = a % b;
+        a = b;
+        b = r;
+    }
+    return a;
+}
+
+/**
+ * @brief Computes the number of plates a pattern describes.
+ * @param pattern Plate pattern.
+ * @return Number of distinct plates, or 0 if the pattern is too long or has no L or D.
+ */
+static uint64_t plateSpace(const char *pattern) {
+    uint64_t space = 1;
+    for (const char *c = pattern; *c; c++) {
+        unsigned radix = *c == 'L' ? 26 : *c == 'D' ? 10 : 1;
+        if (space > MAX_PLATE_SPACE / radix) {
+            return 0;
+        }
+        space *= radix;
+    }
+    return space > 1 ? space : 0;
+}
+
+/**
+ * @brief Parses a NAME:WEIGHT list.
+ * @param text The list.
+ * @param list Receives the values.
+ * @param plates Non-zero if the values are plate formats, which are validated and prepared.
+ * @return 0 on success, -1 on a malformed list.
+ */
+static int parseChoices(const char *text, struct ChoiceList *list, int plates) {
+    list->count = 0;
+    list->totalWeight = 0;
+
+    const char *next = text;
+    while (*next) {
+        const char *end = strchr(next, ',');
+        size_t length = end ? (size_t)(end - next) : strlen(next);
+        const char *colon = memchr(next, ':', length);
+        size_t nameLength = colon ? (size_t)(colon - next) : length;
+        if (list->count == MAX_CHOICES || nameLength == 0 || nameLength >= sizeof list->items[0].name) {
+            return -1;
+        }
+
+        struct Choice *choice = &list->items[list->count++];
+        memcpy(choice->name, next, nameLength);
+        choice->name[nameLength] = '\0';
+        if (strpbrk(choice->name, " \t\r\n")) {
+            return -1;
+        }
+        choice->weight = colon ? (unsigned)strtoul(colon + 1, NULL, 10) : 1;
+        list->totalWeight += choice->weight;
+
+        if (plates) {
+            choice->space = plateSpace(choice->name);
+            if (choice->space == 0) {
+                return -1;
+            }
+            // Any multiplier coprime to the space visits every plate exactly once.
+            choice->multiplier = UINT64_C(0x9E3779B97F4A7C15) % choice->space;
+            while (greatestCommonDivisor(choice->multiplier, choice->space) != 1) {
+                choice->multiplier = (choice->multiplier + 1) % choice->space;
+            }
+            choice->used = 0;
+        }
+        next = end ? end + 1 : next + length;
+    }
+    return list->count > 0 && list->totalWeight > 0 ? 0 : -1;
+}
+
+/**
+ * @brief Draws a value from a weighted list.
+ * @param list The list.
+ * @return Index of the drawn value.
+ */
+static int drawChoice(const struct ChoiceList *list) {
+    uint64_t ticket = randomBelow(list->totalWeight);
+    int i = 0;
+    while (ticket >= list->items[i].weight) {
+        ticket -= list->items[i++].weight;
+    }
+    return i;
+}
+
+/**
+ * @brief Writes the next unused plate of a format.
+ * @param format The plate format.
+ * @param plate Receives the plate; must hold the pattern and its terminating NUL.
+ * @return 0 on success, -1 if the format has no plates left.
+ */
+static int nextPlate(struct Choice *format, char *plate) {
+    if (format->used == format->space) {
+        return -1;
+    }
+    uint64_t value = (uint64_t)(((unsigned __int128)format->used++ * format->multiplier + format->start) %
+                                format->space);
+
+    size_t length = strlen(format->name);
+    plate[length] = '\0';
+    for (size_t i = length; i-- > 0;) {
+        char c = format->name[i];
+        if (c == 'L') {
+            plate[i] = (char)('A' + value % 26);
+            value /= 26;
+        } else if (c == 'D') {
+            plate[i] = (char)('0' + value % 10);
+            value /= 10;
+        } else {
+            plate[i] = c;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Draws an engine capacity that suits a fuel.
+ * @param fuel The fuel.
+ * @return Capacity in cm^3, in steps of 100; 0 for electric cars.
+ */
+static int drawCapacity(const char *fuel) {
+    if (strcmp(fuel, "Electric") == 0) {
+        return 0;
+    }
+    int smallest = strcmp(fuel, "Diesel") == 0 ? 14 : 10;
+    // The smaller of two draws makes small engines more common than large ones.
+    int a = (int)randomBelow(31 - smallest), b = (int)randomBelow(31 - smallest);
+    return (smallest + (a < b ? a : b)) * 100;
+}
+
+/**
+ * @brief Prints the command-line usage.
+ * @param program Name the tool was started with.
+ */
+static void printUsage(const char *program) {
+    fprintf(stderr, "Usage: %s [--cars N] [--seed S] [--output FILE] [--years MIN-MAX]\n", program);
+    fprintf(stderr, "       [--brands LIST] [--fuels LIST] [--types LIST] [--plates LIST]\n");
+    fprintf(stderr, "LIST is NAME:WEIGHT,NAME:WEIGHT,...; plate formats use L for a letter and D for a digit.\n");
+}
+
+/**
+ * @brief Entry point.
+ * @param argc Argument count.
+ * @param argv Arguments.
+ * @return 0 on success, 1 on a usage or I/O error.
+ */
+int main(int argc, char **argv) {
+    long cars = 10000;
+    uint64_t seed = 1;
+    const char *output = NULL;
+    int minYear = 1995, maxYear = 2024;
+    char brandList[MAX_CHOICES * 24] = "";
+    const char *brands = NULL, *fuels = defaultFuels, *types = defaultTypes, *plates = defaultPlates;
+
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 >= argc) {
+            printUsage(argv[0]);
+            return 1;
+        }
+        if (strcmp(argv[i], "--cars") == 0) {
+            cars = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0) {
+            seed = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--output") == 0) {
+            output = argv[++i];
+        } else if (strcmp(argv[i], "--years") == 0) {
+            if (sscanf(argv[++i], "%d-%d", &minYear, &maxYear) != 2 || minYear > maxYear) {
+                printUsage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--brands") == 0) {
+            brands = argv[++i];
+        } else if (strcmp(argv[i], "--fuels") == 0) {
+            fuels = argv[++i];
+        } else if (strcmp(argv[i], "--types") == 0) {
+            types = argv[++i];
+        } else if (strcmp(argv[i], "--plates") == 0) {
+            plates = argv[++i];
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (!brands) {
+        for (size_t b = 0; b < sizeof catalog / sizeof catalog[0]; b++) {
+            size_t used = strlen(brandList);
+            snprintf(brandList + used, sizeof brandList - used, "%s%s:%u", b ? "," : "", catalog[b].brand,
+                     catalog[b].weight);
+        }
+        brands = brandList;
+    }
+
+    static struct ChoiceList brandChoices, fuelChoices, typeChoices, plateChoices;
+    if (cars < 0 || parseChoices(brands, &brandChoices, 0) != 0 || parseChoices(fuels, &fuelChoices, 0) != 0 ||
+        parseChoices(types, &typeChoices, 0) != 0 || parseChoices(plates, &plateChoices, 1) != 0) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    // Catalog entry of each brand, or -1 for brands that get numbered models.
+    int brandCatalog[MAX_CHOICES];
+    for (int b = 0; b < brandChoices.count; b++) {
+        brandCatalog[b] = -1;
+        for (size_t c = 0; c < sizeof catalog / sizeof catalog[0]; c++) {
+            if (strcmp(brandChoices.items[b].name, catalog[c].brand) == 0) {
+                brandCatalog[b] = (int)c;
+            }
+        }
+    }
+
+    FILE *file = output ? fopen(output, "w") : stdout;
+    if (!file) {
+        fprintf(stderr, "Unable to open %s for writing.\n", output);
+        return 1;
+    }
+    static char fileBuffer[1 << 20];
+    setvbuf(file, fileBuffer, _IOFBF, sizeof fileBuffer);
+
+    randomState = seed;
+    for (int p = 0; p < plateChoices.count; p++) {
+        plateChoices.items[p].start = randomBelow(plateChoices.items[p].space);
+    }
+    for (long i = 0; i < cars; i++) {
+        int b = drawChoice(&brandChoices);
+        const char *brand = brandChoices.items[b].name;
+        char model[120];
+        if (brandCatalog[b] >= 0) {
+            const struct CatalogBrand *entry = &catalog[brandCatalog[b]];
+            int models = 0;
+            while (models < MAX_MODELS && entry->models[models]) {
+                models++;
+            }
+            snprintf(model, sizeof model, "%s", entry->models[randomBelow((uint64_t)models)]);
+        } else {
+            snprintf(model, sizeof model, "%.3s%d", brand, 1 + (int)randomBelow(5));
+        }
+
+        // The later of two draws makes newer cars more common than older ones.
+        int a = (int)randomBelow((uint64_t)(maxYear - minYear + 1));
+        int c = (int)randomBelow((uint64_t)(maxYear - minYear + 1));
+        int year = minYear + (a > c ? a : c);
+
+        const char *fuel = fuelChoices.items[drawChoice(&fuelChoices)].name;
+        const char *type = typeChoices.items[drawChoice(&typeChoices)].name;
+
+        char plate[sizeof plateChoices.items[0].name];
+        struct Choice *format = &plateChoices.items[drawChoice(&plateChoices)];
+        if (nextPlate(format, plate) != 0) {
+            fprintf(stderr, "Plate format %s has room for only %llu plates.\n", format->name,
+                    (unsigned long long)format->space);
+            return 1;
+        }
+
+        fprintf(file, "%s%s\n%s\n%d\n%d\n%s\n%s\n%s", i ? "\n" : "", brand, model, year, drawCapacity(fuel), fuel,
+                type, plate);
+    }
+
+    int failed = ferror(file);
+    if ((output ? fclose(file) : fflush(file)) != 0 || failed) {
+        fprintf(stderr, "Unable to write the fleet.\n");
+        return 1;
+    }
+    return 0;
+}